@@ -56,6 +56,10 @@ endfunction(piglit_include_target_api)
 # In addition to calling `add_executable`, it adds to each object file
 # a dependency on piglit_dispatch's generated files.
 #
+# With PIGLIT_BUILD_ZYGOTE, GL executables are also built as modules in
+# lib/zygote, with main renamed to piglit_zygote_main, for piglit-zygote to
+# load.
+#
 function(piglit_add_executable name)
 
     list(REMOVE_AT ARGV 0)
@@ -64,6 +68,18 @@ function(piglit_add_executable name)
 
     install(TARGETS ${name} DESTINATION ${PIGLIT_INSTALL_LIBDIR}/bin)
 
+    if(PIGLIT_BUILD_ZYGOTE AND piglit_target_api STREQUAL "gl")
+        add_library(${name}_zygote MODULE ${ARGV})
+        add_dependencies(${name}_zygote piglit_dispatch_gen)
+        set_target_properties(${name}_zygote PROPERTIES
+            PREFIX ""
+            OUTPUT_NAME ${name}
+            LIBRARY_OUTPUT_DIRECTORY ${piglit_BINARY_DIR}/lib/zygote
+            COMPILE_DEFINITIONS main=piglit_zygote_main)
+        install(TARGETS ${name}_zygote
+                DESTINATION ${PIGLIT_INSTALL_LIBDIR}/lib/zygote)
+    endif()
+
 endfunction(piglit_add_executable)
 
 #
@@ -0,0 +1,317 @@
+# Copyright (c) 2017 The Piglit project
+
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Append only results log backend.
+
+The json backend writes (and syncs) a file per test, and at the end of the run
+reads all of them back to write results.json. This backend instead appends
+every result to a single file, results.jsonlog, as soon as it is written, and
+there is nothing left to merge at the end of the run.
+
+Each record in the log is a header of a little endian uint32 length and crc32,
+followed by that many bytes of json. A test gets an incomplete record when it
+starts and a second record with its result when it is done; the last record
+for a name wins. A record that was cut short, for example by a crash, ends the
+log.
+
+Next to the log, jsonlog.idx has a line per record with its offset,
+the test status (or a tag for metadata records) and the test name. Loading
+uses it to read only the latest record of each test, without decoding the
+ones it replaced.
+
+The log is flushed after every record, and synced to disk after every record
+with -s/--sync, otherwise every SYNC_RECORDS records or SYNC_SECONDS seconds.
+
+"""
+
+from __future__ import (
+    absolute_import, division, print_function, unicode_literals
+)
+import collections
+import contextlib
+import io
+import os
+import struct
+import threading
+import time
+import zlib
+
+try:
+    import simplejson as json
+except ImportError:
+    import json
+
+import six
+
+from framework import options, results, exceptions
+from framework.status import INCOMPLETE
+from .abstract import Backend, write_compressed
+from .json import CURRENT_JSON_VERSION, piglit_encoder, piglit_decoder
+from .register import Registry
+
+__all__ = [
+    'REGISTRY',
+    'JSONLogBackend',
+    'write_json',
+]
+
+LOG_NAME = 'results.jsonlog'
+INDEX_NAME = 'jsonlog.idx'
+
+SYNC_RECORDS = 256
+SYNC_SECONDS = 5.0
+
+_HEADER = struct.Struct('<II')
+
+# Index tags of records that aren't tests. Statuses never start with '@'.
+_METADATA = '@metadata'
+
+
+def _crc(payload):
+    return zlib.crc32(payload) & 0xffffffff
+
+
+class JSONLogBackend(Backend):
+    """Writes results to an append only log.
+
+    Writes from several threads are serialized with a lock. A resumed run
+    reopens the log and appends to it.
+
+    """
+    _INCOMPLETE = results.TestResult(result=INCOMPLETE)
+
+    def __init__(self, dest, **kwargs):
+        self._dest = dest
+        self._lock = threading.Lock()
+        self._log = None
+        self._index = None
+        self._unsynced = 0
+        self._last_sync = time.time()
+
+    def _append(self, record, tag, name=''):
+        payload = json.dumps(record, default=piglit_encoder).encode('utf-8')
+
+        with self._lock:
+            if self._log is None:
+                self._log = io.open(os.path.join(self._dest, LOG_NAME), 'ab')
+                self._index = io.open(os.path.join(self._dest, INDEX_NAME),
+                                      'a', encoding='utf-8')
+
+            offset = self._log.tell()
+            self._log.write(_HEADER.pack(len(payload), _crc(payload)))
+            self._log.write(payload)
+            self._log.flush()
+            self._index.write('{} {} {}\n'.format(offset, tag, name))
+            self._index.flush()
+
+            self._unsynced += 1
+            if (options.OPTIONS.sync or self._unsynced >= SYNC_RECORDS or
+                    time.time() - self._last_sync >= SYNC_SECONDS):
+                self._sync()
+
+    def _sync(self):
+        os.fsync(self._log.fileno())
+        os.fsync(self._index.fileno())
+        self._unsynced = 0
+        self._last_sync = time.time()
+
+    def initialize(self, metadata):
+        metadata['results_version'] = CURRENT_JSON_VERSION
+        self._append({'metadata': metadata}, _METADATA)
+
+    def finalize(self, metadata=None):
+        self._append({'metadata': metadata or {}}, _METADATA)
+
+        with self._lock:
+            self._sync()
+            self._log.close()
+            self._index.close()
+            self._log = self._index = None
+
+    @contextlib.contextmanager
+    def write_test(self, name):
+        """Write a test.
+
+        An incomplete record is appended when the context manager is opened,
+        and the result appended when it is called.
+
+        """
+        def finish(val):
+            self._append({'name': name, 'result': val},
+                         six.text_type(val.result), name)
+
+        self._append({'name': name, 'result': self._INCOMPLETE},
+                     six.text_type(INCOMPLETE), name)
+
+        yield finish
+
+
+def _read_record(f):
+    """Read the record at the current position of f.
+
+    Returns the decoded record, or None at the end of the log or at a torn
+    record.
+
+    """
+    header = f.read(_HEADER.size)
+    if len(header) < _HEADER.size:
+        return None
+
+    length, crc = _HEADER.unpack(header)
+    payload = f.read(length)
+    if len(payload) < length or _crc(payload) != crc:
+        return None
+
+    return json.loads(payload.decode('utf-8'), object_hook=piglit_decoder)
+
+
+def _read_index(results_dir):
+    """Return a list of (offset, tag, name) for the records of a log.
+
+    Records appended after the last index line that made it to disk are
+    found by scanning the end of the log.
+
+    """
+    entries = []
+    try:
+        with io.open(os.path.join(results_dir, INDEX_NAME), 'r',
+                     encoding='utf-8') as f:
+            for line in f:
+                if not line.endswith('\n'):
+                    break
+                offset, tag, name = line[:-1].split(' ', 2)
+                entries.append((int(offset), tag, name))
+    except IOError:
+        pass
+
+    with io.open(os.path.join(results_dir, LOG_NAME), 'rb') as f:
+        if entries:
+            f.seek(entries[-1][0])
+            if _read_record(f) is None:
+                # The index is ahead of a torn log, don't trust it
+                del entries[:]
+                f.seek(0)
+
+        while True:
+            offset = f.tell()
+            record = _read_record(f)
+            if record is None:
+                break
+            if 'name' in record:
+                entries.append((offset, six.text_type(record['result'].result),
+                                record['name']))
+            else:
+                entries.append((offset, _METADATA, ''))
+
+    return entries
+
+
+def _latest(entries):
+    """Split index entries into metadata offsets, and an OrderedDict of test
+    name to the offset of the last record of that test.
+    """
+    metadata = []
+    tests = collections.OrderedDict()
+    for offset, tag, name in entries:
+        if tag == _METADATA:
+            metadata.append(offset)
+        else:
+            tests[name] = offset
+    return metadata, tests
+
+
+def _iter_log(results_dir):
+    """Yield the merged metadata dict, then (name, TestResult) pairs.
+
+    Only the records that are needed are read, one at a time.
+
+    """
+    metadata, tests = _latest(_read_index(results_dir))
+
+    with io.open(os.path.join(results_dir, LOG_NAME), 'rb') as f:
+        meta = {}
+        for offset in metadata:
+            f.seek(offset)
+            meta.update(_read_record(f)['metadata'])
+        yield meta
+
+        for name, offset in six.iteritems(tests):
+            f.seek(offset)
+            yield name, _read_record(f)['result']
+
+
+def load_results(filename, compression_):
+    """Load a results log, from its directory or the log file itself."""
+    if not os.path.isdir(filename):
+        filename = os.path.dirname(filename)
+
+    if not os.path.exists(os.path.join(filename, LOG_NAME)):
+        raise exceptions.PiglitFatalError(
+            'No results log found in "{}"'.format(filename))
+
+    records = _iter_log(filename)
+    meta = next(records)
+    meta['tests'] = collections.OrderedDict(records)
+
+    return results.TestrunResult.from_dict(meta)
+
+
+def write_json(results_dir, filename):
+    """Write a results log out as a results.json file.
+
+    The tests are streamed from the log to the (possibly compressed) output
+    one at a time, rather than loading the whole run first.
+
+    """
+    records = _iter_log(results_dir)
+    meta = next(records)
+    totals = results.TestrunResult()
+
+    def dump(value):
+        return json.dumps(value, default=piglit_encoder)
+
+    with write_compressed(filename) as f:
+        f.write('{"__type__": "TestrunResult",\n')
+        for key, value in six.iteritems(meta):
+            f.write('{}: {},\n'.format(dump(key), dump(value)))
+
+        f.write('"tests": {\n')
+        for i, (name, result) in enumerate(records):
+            f.write('{}{}: {}'.format(',\n' if i else '', dump(name),
+                                      dump(result)))
+            # calculate_group_totals() adds to what is already there
+            totals.tests = {name: result}
+            totals.calculate_group_totals()
+        f.write('\n},\n')
+
+        f.write('"totals": {}\n}}\n'.format(dump(totals.totals)))
+
+
+def set_meta(results):
+    """Set jsonlog specific metadata on a TestrunResult."""
+    results.results_version = CURRENT_JSON_VERSION
+
+
+REGISTRY = Registry(
+    extensions=['.jsonlog'],
+    backend=JSONLogBackend,
+    load=load_results,
+    meta=set_meta,
+)
@@ -117,6 +117,18 @@ def get_config(arg=None):
                 pass
 
 
+def cache_dir():
+    """Return the directory piglit keeps its caches in.
+
+    This is $XDG_CACHE_HOME/piglit, or ~/.cache/piglit. It may not exist yet.
+
+    """
+    return os.path.join(
+        os.environ.get('XDG_CACHE_HOME',
+                       os.path.join(os.path.expanduser('~'), '.cache')),
+        'piglit')
+
+
 def check_dir(dirname, failifexists=False, handler=None):
     """Check for the existence of a directory and create it if possible.
 
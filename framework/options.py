@@ -179,6 +179,20 @@ class _Options(object):  # pylint: disable=too-many-instance-attributes
     valgrind -- True if valgrind is to be used
     dmesg -- True if dmesg checking is desired. This forces concurrency off
     monitored -- True if monitoring is desired. This forces concurrency off
+    shader_batch -- the number of shader tests to run in one shader_runner
+                    process, 0 or 1 runs each in its own process
+    subtest_shards -- the number of processes the subtests of a test are
+                      split across, 0 or 1 runs them all in one process
+    zygote -- True to fork the tests that were built as modules from
+              piglit-zygote
+    program_cache -- a directory to cache linked GL programs in, or None
+    golden_hashes -- a directory of per-test golden image hashes, or None
+    golden_hash_mode -- 'check' to skip comparing images that match their
+                        golden hash, 'record' to store the hashes of
+                        images that pass
+    jobs -- the number of tests to run at once, None for one per CPU
+    schedule_from -- results of an earlier run whose test times are used to
+                     start the longest tests first, or None
     env -- environment variables set for each test before run
 
     """
@@ -195,6 +209,14 @@ class _Options(object):  # pylint: disable=too-many-instance-attributes
         self.dmesg = False
         self.monitored = False
         self.sync = False
+        self.shader_batch = 0
+        self.subtest_shards = 0
+        self.zygote = False
+        self.program_cache = None
+        self.golden_hashes = None
+        self.golden_hash_mode = 'check'
+        self.jobs = None
+        self.schedule_from = None
 
         # env is used to set some base environment variables that are not going
         # to change across runs, without sending them to os.environ which is
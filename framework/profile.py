@@ -31,19 +31,26 @@ from __future__ import (
 )
 import collections
 import contextlib
+import datetime
 import importlib
 import itertools
 import multiprocessing
-import multiprocessing.dummy
 import os
+import sys
+import threading
+import time
+import traceback
 
 import six
 
-from framework import grouptools, exceptions, options
+from framework import grouptools, exceptions, options, schedule
 from framework.dmesg import get_dmesg
 from framework.log import LogManager
 from framework.monitoring import Monitoring
 from framework.test.base import Test
+from framework.test.gleantest import MultiGleanTest, batch_glean_tests
+from framework.test.piglit_test import SubtestShard, shard_subtests
+from framework.test.shader_test import MultiShaderTest, batch_shader_tests
 
 __all__ = [
     'TestProfile',
@@ -52,6 +59,14 @@ __all__ = [
 ]
 
 
+class _LazyTest(object):
+    """A test in a TestDict that hasn't been created yet."""
+    __slots__ = ['load']
+
+    def __init__(self, load):
+        self.load = load
+
+
 class TestDict(collections.MutableMapping):
     """A special kind of dict for tests.
 
@@ -121,16 +136,51 @@ class TestDict(collections.MutableMapping):
         self.__container[key] = value
 
     def __getitem__(self, key):
-        """Lower the value before returning."""
-        return self.__container[key.lower()]
+        """Lower the value before returning.
+
+        A test added with add_lazy() is created here, the first time it is
+        looked up.
+
+        """
+        key = key.lower()
+        value = self.__container[key]
+        if isinstance(value, _LazyTest):
+            value = self.__container[key] = value.load()
+        return value
 
     def __delitem__(self, key):
         """Lower the value before returning."""
         del self.__container[key.lower()]
 
+    def __contains__(self, key):
+        # Without this Mapping would look the test up, creating a lazy one
+        return key.lower() in self.__container
+
     def __len__(self):
         return len(self.__container)
 
+    def add_lazy(self, key, load):
+        """Add a test that is only created when it is looked up.
+
+        This follows the same rules as __setitem__, but the test is only
+        compared to one it replaces once it has been loaded.
+
+        Arguments:
+        key -- the name of the test
+        load -- a callable that takes no arguments and returns the Test
+
+        """
+        if not isinstance(key, six.text_type):
+            raise exceptions.PiglitFatalError(
+                "TestDict keys must be strings, but was {}".format(type(key)))
+
+        key = key.lower()
+        if not self.__allow_reassignment and key in self.__container:
+            raise exceptions.PiglitFatalError(
+                "A test has already been assigned the name: {}".format(key))
+
+        self.__container[key] = _LazyTest(load)
+
     def __iter__(self):
         return iter(self.__container)
 
@@ -168,6 +218,17 @@ class TestDict(collections.MutableMapping):
             if not callable((k, v)):
                 del self[k]
 
+    def filter_names(self, callable):
+        """Filter tests out of the testdict by name.
+
+        This is like filter(), but callable is only passed the name of each
+        test, so tests added with add_lazy() are not created.
+
+        """
+        for k in list(self.__container):
+            if not callable(k):
+                del self.__container[k]
+
     def reorder(self, order):
         """Reorder the TestDict to match the order of the provided list."""
         new = collections.OrderedDict()
@@ -255,20 +316,17 @@ class TestProfile(object):
         def matches_any_regexp(x, re_list):
             return any(r.search(x) for r in re_list)
 
-        # The extra argument is needed to match check_all's API
-        def test_matches(path, test):
+        def test_matches(path):
             """Filter for user-specified restrictions"""
             return ((not options.OPTIONS.include_filter or
                      matches_any_regexp(path, options.OPTIONS.include_filter))
                     and path not in options.OPTIONS.exclude_tests
                     and not matches_any_regexp(path, options.OPTIONS.exclude_filter))
 
-        filters = self.filters + [test_matches]
-
         def check_all(item):
             """ Checks group and test name against all filters """
             path, test = item
-            for f in filters:
+            for f in self.filters:
                 if not f(path, test):
                     return False
             return True
@@ -277,10 +335,13 @@ class TestProfile(object):
             # Remove all tests not in the test list, then reorder the tests to
             # match the testlist. This still allows additional filters to be
             # run afterwards.
-            self.test_list.filter(lambda i: i[0] in self.forced_test_list)
+            forced = set(self.forced_test_list)
+            self.test_list.filter_names(lambda n: n in forced)
             self.test_list.reorder(self.forced_test_list)
 
-        # Filter out unwanted tests
+        # Filter out unwanted tests. The user's filters only need the name, so
+        # they go first and tests that aren't going to run are never loaded.
+        self.test_list.filter_names(test_matches)
         self.test_list.filter(check_all)
 
         if not self.test_list:
@@ -304,15 +365,17 @@ class TestProfile(object):
         pass
 
     def run(self, logger, backend):
-        """ Runs all tests using Thread pool
+        """ Runs all tests using worker threads
 
         When called this method will flatten out self.tests into
         self.test_list, then will prepare a logger, and begin executing tests
-        through it's Thread pools.
+        on options.OPTIONS.jobs worker threads (one per CPU by default).
 
         Based on the value of options.OPTIONS.concurrent it will either run all
-        the tests concurrently, all serially, or first the thread safe tests
-        then the serial tests.
+        the tests concurrently, all serially, or the thread safe tests
+        concurrently and the others while nothing else is running. If
+        options.OPTIONS.schedule_from names an earlier run the longest tests
+        are started first (see framework.schedule).
 
         Finally it will print a final summary of the tests
 
@@ -323,47 +386,92 @@ class TestProfile(object):
 
         self._pre_run_hook()
 
-        chunksize = 1
-
         self._prepare_test_list()
         log = LogManager(logger, len(self.test_list))
 
-        def test(pair, this_pool=None):
-            """Function to call test.execute from map"""
+        tests = list(six.iteritems(self.test_list))
+        # valgrind, dmesg and monitoring check whole processes
+        batch = not (options.OPTIONS.valgrind or options.OPTIONS.dmesg or
+                     options.OPTIONS.monitored)
+        if batch and options.OPTIONS.shader_batch > 1:
+            tests = list(batch_shader_tests(tests,
+                                            options.OPTIONS.shader_batch))
+        if batch:
+            tests = list(batch_glean_tests(tests))
+        jobs = options.OPTIONS.jobs or multiprocessing.cpu_count()
+        if batch and options.OPTIONS.subtest_shards > 1:
+            tests = list(shard_subtests(tests, options.OPTIONS.subtest_shards,
+                                        jobs))
+
+        def test(pair, this_scheduler):
+            """Function to call test.execute from a worker thread"""
             name, test = pair
+            if isinstance(test, (MultiShaderTest, MultiGleanTest)):
+                test.execute(name, log, self.dmesg, self.monitoring)
+                for subname, subtest in test.tests:
+                    with backend.write_test(subname) as w:
+                        w(subtest.result)
+                return
+            if isinstance(test, SubtestShard):
+                # The last shard to finish writes the merged result
+                if test.execute(name, log, self.dmesg, self.monitoring):
+                    with backend.write_test(name) as w:
+                        w(test.group.test.result)
+                return
+
             with backend.write_test(name) as w:
                 test.execute(name, log.get(), self.dmesg, self.monitoring)
                 w(test.result)
             if self._monitoring.abort_needed:
-                this_pool.terminate()
+                this_scheduler.stop()
 
-        def run_threads(pool, testlist):
-            """ Open a pool, close it, and join it """
-            pool.imap(lambda pair: test(pair, pool), testlist, chunksize)
-            pool.close()
-            pool.join()
+        durations = {}
+        if options.OPTIONS.schedule_from:
+            durations = schedule.load_durations(options.OPTIONS.schedule_from)
 
-        # Multiprocessing.dummy is a wrapper around Threading that provides a
-        # multiprocessing compatible API
-        #
-        # The default value of pool is the number of virtual processor cores
-        single = multiprocessing.dummy.Pool(1)
-        multi = multiprocessing.dummy.Pool()
-
-        if options.OPTIONS.concurrent == "all":
-            run_threads(multi, six.iteritems(self.test_list))
-        elif options.OPTIONS.concurrent == "none":
-            run_threads(single, six.iteritems(self.test_list))
-        else:
-            # Filter and return only thread safe tests to the threaded pool
-            run_threads(multi, (x for x in six.iteritems(self.test_list)
-                                if x[1].run_concurrent))
-            # Filter and return the non thread safe tests to the single pool
-            run_threads(single, (x for x in six.iteritems(self.test_list)
-                                 if not x[1].run_concurrent))
+        scheduler = schedule.Scheduler(
+            tests, durations,
+            jobs=jobs,
+            concurrent=options.OPTIONS.concurrent)
+
+        def worker():
+            """Run tests from the scheduler until there are none left.
+
+            An exception from one test is printed and the worker goes on
+            with the next one, so the rest of the run isn't lost.
+
+            """
+            while True:
+                pair = scheduler.next()
+                if pair is None:
+                    return
+                try:
+                    test(pair, scheduler)
+                except Exception:  # pylint: disable=broad-except
+                    print('Error running {}:'.format(pair[0]),
+                          file=sys.stderr)
+                    traceback.print_exc(file=sys.stderr)
+                finally:
+                    scheduler.done(pair)
+
+        expected = scheduler.expected_makespan()
+        start = time.time()
+
+        threads = [threading.Thread(target=worker)
+                   for _ in range(scheduler.jobs)]
+        for thread in threads:
+            thread.daemon = True
+            thread.start()
+        for thread in threads:
+            thread.join()
 
         log.get().summary()
 
+        if durations:
+            print('Expected run time {}, actual {}'.format(
+                datetime.timedelta(seconds=int(expected)),
+                datetime.timedelta(seconds=int(time.time() - start))))
+
         self._post_run_hook()
 
         if self._monitoring.abort_needed:
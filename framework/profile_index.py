@@ -0,0 +1,194 @@
+# Copyright (c) 2017 The Piglit project
+
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""An on disk index of the shader and glslparser tests in a directory.
+
+Creating a ShaderTest or GLSLParserTest opens the file and parses its
+requirements, and all.py creates one for every file in the tree. The index
+keeps each test pickled, along with the mtime and size of the file it was
+made from, so only new or changed files are parsed again. The tests are added
+to the profile still pickled, and are only unpickled when they are looked up,
+after the -t and -x filters have removed the tests that won't run.
+
+The index lives in the piglit cache directory (see core.cache_dir()), with a
+file per directory. Its name is a hash of everything else a test depends on:
+the directory, the python version, where the test binaries are, and the
+modules that define the test classes.
+
+Setting PIGLIT_NO_PROFILE_INDEX parses every file, as before.
+
+"""
+
+from __future__ import (
+    absolute_import, division, print_function, unicode_literals
+)
+import functools
+import hashlib
+import io
+import os
+import sys
+
+from six.moves import cPickle as pickle
+
+from framework import core, grouptools
+from framework.results import TestResult
+from framework.test import (base, glsl_parser_test, opengl, piglit_test,
+                            shader_test)
+
+__all__ = [
+    'add_shader_tests',
+]
+
+_DISABLED = bool(os.environ.get('PIGLIT_NO_PROFILE_INDEX', False))
+
+_GLSLPARSER_EXTENSIONS = frozenset(
+    ['.vert', '.tesc', '.tese', '.geom', '.frag', '.comp'])
+
+# The pickled tests depend on how these modules build them.
+_MODULES = [base, glsl_parser_test, opengl, piglit_test, shader_test]
+
+
+def _index_path(basedir):
+    key = hashlib.sha1()
+    for part in [basedir, os.path.abspath(basedir),
+                 '.'.join(str(v) for v in sys.version_info[:2]),
+                 piglit_test.TEST_BIN_DIR,
+                 os.environ.get('PIGLIT_FORCE_GLSLPARSER_DESKTOP', ''),
+                 glsl_parser_test._HAS_GL_BIN,  # pylint: disable=protected-access
+                 glsl_parser_test._HAS_GLES_BIN]:  # pylint: disable=protected-access
+        key.update('{}\n'.format(part).encode('utf-8'))
+    for module in _MODULES:
+        source = os.path.splitext(module.__file__)[0] + '.py'
+        key.update('{} {}\n'.format(
+            source, os.stat(source).st_mtime).encode('utf-8'))
+
+    return os.path.join(core.cache_dir(),
+                        'profile-index-{}.pickle'.format(key.hexdigest()))
+
+
+def _read(path):
+    """Return the index at path, or an empty one."""
+    try:
+        with io.open(path, 'rb') as f:
+            return pickle.load(f)
+    except Exception:  # pylint: disable=broad-except
+        # Missing, from an older piglit, or cut short: start over
+        return {}
+
+
+def _write(path, index):
+    """Write the index, ignoring errors.
+
+    The index is written under a temporary name and renamed into place so
+    concurrent runs never read half of one.
+
+    """
+    tmp = '{}.{}'.format(path, os.getpid())
+    try:
+        if not os.path.exists(os.path.dirname(path)):
+            os.makedirs(os.path.dirname(path))
+        with io.open(tmp, 'wb') as f:
+            pickle.dump(index, f, pickle.HIGHEST_PROTOCOL)
+        os.rename(tmp, path)
+    except (IOError, OSError):
+        pass
+
+
+def _make_test(path, filename):
+    """Create the test for a file.
+
+    Returns a (name, test) pair, or None for a glslparser test without a
+    config, which is assumed to be a legacy test.
+
+    """
+    testname, ext = os.path.splitext(filename)
+    if ext == '.shader_test':
+        return testname, shader_test.ShaderTest(path)
+
+    try:
+        test = glsl_parser_test.GLSLParserTest(path)
+    except glsl_parser_test.GLSLParserNoConfigError:
+        return None
+
+    # For glslparser tests you can have multiple tests with the same name,
+    # but a different stage, so keep the extension.
+    return filename, test
+
+
+def _pickle(pair):
+    if pair is None:
+        return None
+    name, test = pair
+    test.result = None
+    return name, pickle.dumps(test, pickle.HIGHEST_PROTOCOL)
+
+
+def _unpickle(data):
+    test = pickle.loads(data)
+    test.result = TestResult()
+    return test
+
+
+def add_shader_tests(test_list, basedir):
+    """Add every shader_test and glslparser test under basedir.
+
+    Tests are named by their path relative to basedir, and added to
+    test_list (a profile.TestDict) without being created, see
+    TestDict.add_lazy().
+
+    """
+    path = None if _DISABLED else _index_path(basedir)
+    old = _read(path) if path else {}
+    new = {}
+
+    for dirpath, _, filenames in os.walk(basedir):
+        reldir = os.path.relpath(dirpath, basedir)
+        group = grouptools.from_path(reldir)
+
+        for filename in filenames:
+            ext = os.path.splitext(filename)[1]
+            if ext != '.shader_test' and ext not in _GLSLPARSER_EXTENSIONS:
+                continue
+
+            filepath = os.path.join(dirpath, filename)
+            if _DISABLED:
+                pair = _make_test(filepath, filename)
+                if pair is not None:
+                    name = grouptools.join(group, pair[0])
+                    assert name not in test_list, name
+                    test_list[name] = pair[1]
+                continue
+
+            st = os.stat(filepath)
+            relpath = os.path.join(reldir, filename)
+            entry = old.get(relpath)
+            if entry is None or entry[:2] != (st.st_mtime, st.st_size):
+                entry = (st.st_mtime, st.st_size,
+                         _pickle(_make_test(filepath, filename)))
+            new[relpath] = entry
+
+            if entry[2] is not None:
+                name = grouptools.join(group, entry[2][0])
+                assert name not in test_list, name
+                test_list.add_lazy(name,
+                                   functools.partial(_unpickle, entry[2][1]))
+
+    if path and new != old:
+        _write(path, new)
@@ -32,7 +32,8 @@ import shutil
 
 import six
 
-from framework import core, backends, exceptions, options
+from framework import core, backends, exceptions, options, zygote
+from framework.test import piglit_test
 import framework.results
 import framework.profile
 from . import parsers
@@ -126,6 +127,17 @@ def _run_parser(input_):
                              const="none",
                              dest="concurrency",
                              help="Disable concurrent test runs")
+    parser.add_argument("-j", "--jobs",
+                        type=int,
+                        metavar="<count>",
+                        help="Run up to <count> tests at once. Defaults to "
+                             "the number of CPUs")
+    parser.add_argument("--schedule-from",
+                        type=path.realpath,
+                        metavar="<results>",
+                        help="Start the tests that took longest in the "
+                             "results of an earlier run first, and report "
+                             "the expected and actual run time")
     parser.add_argument("-p", "--platform",
                         choices=core.PLATFORMS,
                         default=_default_platform(),
@@ -147,6 +159,44 @@ def _run_parser(input_):
     parser.add_argument("-s", "--sync",
                         action="store_true",
                         help="Sync results to disk after every test")
+    parser.add_argument("--shader-batch",
+                        type=int,
+                        default=0,
+                        metavar="<count>",
+                        help="Run up to <count> shader tests that need the "
+                             "same context in one shader_runner process")
+    parser.add_argument("--subtest-shards",
+                        type=int,
+                        default=0,
+                        metavar="<count>",
+                        help="Split the subtests of each test that supports "
+                             "-subtest across <count> concurrent processes")
+    parser.add_argument("--zygote",
+                        action="store_true",
+                        help="Fork tests that were also built as modules "
+                             "(PIGLIT_BUILD_ZYGOTE) from piglit-zygote, "
+                             "which loads the GL libraries once, rather "
+                             "than starting each test binary")
+    parser.add_argument("--program-cache",
+                        type=path.abspath,
+                        metavar="<directory>",
+                        help="Store linked GL programs in <directory> and "
+                             "reuse them in later runs, skipping the "
+                             "compile. Not used by compiler and linker "
+                             "tests")
+    parser.add_argument("--golden-hashes",
+                        type=path.abspath,
+                        metavar="<directory>",
+                        help="Keep a file of golden image hashes per test "
+                             "in <directory>. Images whose hash matches "
+                             "are not compared pixel by pixel")
+    parser.add_argument("--golden-hash-mode",
+                        choices=['check', 'record'],
+                        default='check',
+                        help="With --golden-hashes, 'check' skips the "
+                             "comparison of matching images and 'record' "
+                             "compares every image and stores the hashes "
+                             "of those that pass")
     parser.add_argument("--junit_suffix",
                         type=str,
                         default="",
@@ -190,6 +240,7 @@ def _create_metadata(args, name):
     opts = dict(options.OPTIONS)
     opts['profile'] = args.test_profile
     opts['log_level'] = args.log_level
+    opts['backend'] = args.backend
     if args.platform:
         opts['platform'] = args.platform
 
@@ -200,6 +251,28 @@ def _create_metadata(args, name):
     return metadata
 
 
+def _set_program_cache_env(log_level):
+    """Tell the tests where the program cache is, if there is one."""
+    if options.OPTIONS.program_cache:
+        options.OPTIONS.env['PIGLIT_PROGRAM_CACHE_DIR'] = \
+            options.OPTIONS.program_cache
+        if log_level == 'verbose':
+            options.OPTIONS.env['PIGLIT_PROGRAM_CACHE_VERBOSE'] = '1'
+
+
+def _set_golden_hash_env():
+    """Tell the tests whether to check or record golden hashes.
+
+    The reference file itself is set per test, by Test.execute().
+
+    """
+    if options.OPTIONS.golden_hashes:
+        if options.OPTIONS.golden_hash_mode == 'record':
+            core.check_dir(options.OPTIONS.golden_hashes)
+        options.OPTIONS.env['PIGLIT_GOLDEN_HASH_MODE'] = \
+            options.OPTIONS.golden_hash_mode
+
+
 def _disable_windows_exception_messages():
     """Disable Windows error message boxes for this and all child processes."""
     if sys.platform == 'win32':
@@ -219,6 +292,18 @@ def _disable_windows_exception_messages():
         ctypes.windll.kernel32.SetErrorMode(uMode)
 
 
+def _run_profile(profile, log_level, backend):
+    """Run the profile, from piglit-zygote if that was asked for."""
+    if not options.OPTIONS.zygote:
+        profile.run(log_level, backend)
+        return
+
+    env = dict(os.environ)
+    env.update(options.OPTIONS.env)
+    with zygote.started(piglit_test.ZYGOTE_BIN, env):
+        profile.run(log_level, backend)
+
+
 def _results_handler(path):
     """Handler for core.check_dir."""
     if os.path.isdir(path):
@@ -252,9 +337,19 @@ def run(input_):
     options.OPTIONS.dmesg = args.dmesg
     options.OPTIONS.monitored = args.monitored
     options.OPTIONS.sync = args.sync
+    options.OPTIONS.shader_batch = args.shader_batch
+    options.OPTIONS.subtest_shards = args.subtest_shards
+    options.OPTIONS.zygote = args.zygote
+    options.OPTIONS.program_cache = args.program_cache
+    options.OPTIONS.golden_hashes = args.golden_hashes
+    options.OPTIONS.golden_hash_mode = args.golden_hash_mode
+    options.OPTIONS.jobs = args.jobs
+    options.OPTIONS.schedule_from = args.schedule_from
 
     # Set the platform to pass to waffle
     options.OPTIONS.env['PIGLIT_PLATFORM'] = args.platform
+    _set_program_cache_env(args.log_level)
+    _set_golden_hash_env()
 
     # Change working directory to the root of the piglit directory
     piglit_dir = path.dirname(path.realpath(sys.argv[0]))
@@ -301,7 +396,7 @@ def run(input_):
     if args.monitored:
         profile.monitoring = args.monitored
 
-    profile.run(args.log_level, backend)
+    _run_profile(profile, args.log_level, backend)
 
     results.time_elapsed.end = time.time()
     backend.finalize({'time_elapsed': results.time_elapsed})
@@ -338,16 +433,28 @@ def resume(input_):
     options.OPTIONS.dmesg = results.options['dmesg']
     options.OPTIONS.monitored = results.options['monitored']
     options.OPTIONS.sync = results.options['sync']
+    options.OPTIONS.shader_batch = results.options.get('shader_batch', 0)
+    options.OPTIONS.subtest_shards = results.options.get('subtest_shards', 0)
+    options.OPTIONS.zygote = results.options.get('zygote', False)
+    options.OPTIONS.program_cache = results.options.get('program_cache')
+    options.OPTIONS.golden_hashes = results.options.get('golden_hashes')
+    options.OPTIONS.golden_hash_mode = \
+        results.options.get('golden_hash_mode', 'check')
+    options.OPTIONS.jobs = results.options.get('jobs')
+    options.OPTIONS.schedule_from = results.options.get('schedule_from')
 
     core.get_config(args.config_file)
 
     options.OPTIONS.env['PIGLIT_PLATFORM'] = results.options['platform']
+    _set_program_cache_env(results.options['log_level'])
+    _set_golden_hash_env()
 
     results.options['env'] = core.collect_system_info()
     results.options['name'] = results.name
 
-    # Resume only works with the JSON backend
-    backend = backends.get_backend('json')(
+    # Resume works with the json and jsonlog backends, results from before
+    # the backend was recorded are json
+    backend = backends.get_backend(results.options.get('backend', 'json'))(
         args.results_path,
         file_start_count=len(results.tests) + 1)
     # Specifically do not initialize again, everything initialize does is done.
@@ -367,7 +474,7 @@ def resume(input_):
         profile.monitoring = options.OPTIONS.monitored
 
     # This is resumed, don't bother with time since it won't be accurate anyway
-    profile.run(results.options['log_level'], backend)
+    _run_profile(profile, results.options['log_level'], backend)
 
     backend.finalize()
 
@@ -57,7 +57,14 @@ def html(input_):
     parser = argparse.ArgumentParser(parents=[parsers.CONFIG])
     parser.add_argument("-o", "--overwrite",
                         action="store_true",
-                        help="Overwrite existing directories")
+                        help="Overwrite existing directories. Pages of a "
+                             "summary generated by this version of piglit "
+                             "are only rewritten if they have changed")
+    parser.add_argument("-j", "--jobs",
+                        type=int,
+                        metavar="<count>",
+                        help="Write pages with up to <count> processes. "
+                             "Defaults to the number of CPUs")
     parser.add_argument("-l", "--list",
                         action="store",
                         help="Load a newline separated list of results. These "
@@ -96,8 +103,11 @@ def html(input_):
                 status.status_lookup(i) for i in args.exclude_details)
 
 
-    # if overwrite is requested delete the output directory
-    if path.exists(args.summaryDir) and args.overwrite:
+    # if overwrite is requested delete the output directory, unless it has a
+    # manifest, in which case only the pages that changed are written
+    if (path.exists(args.summaryDir) and args.overwrite and not
+            path.exists(path.join(args.summaryDir,
+                                  summary.html_.MANIFEST_NAME))):
         shutil.rmtree(args.summaryDir)
 
     # If the requested directory doesn't exist, create it or throw an error
@@ -114,7 +124,8 @@ def html(input_):
         args.resultsFiles.extend(core.parse_listfile(args.list))
 
     # Create the HTML output
-    summary.html(args.resultsFiles, args.summaryDir, args.exclude_details)
+    summary.html(args.resultsFiles, args.summaryDir, args.exclude_details,
+                 args.jobs)
 
 
 @exceptions.handler
@@ -223,6 +234,15 @@ def aggregate(input_):
     # args.results_folder must be a path with a 'tests' directory in it, not
     # the tests directory itself.
     outfile = os.path.join(args.results_folder, args.output)
+
+    # A results log can be written out without loading the whole run
+    if os.path.exists(os.path.join(args.results_folder,
+                                   backends.jsonlog.LOG_NAME)):
+        backends.jsonlog.write_json(args.results_folder, outfile)
+        print("Aggregated file written to: {}.{}".format(
+            outfile, backends.compression.get_mode()))
+        return
+
     try:
         results = backends.load(args.results_folder)
     except backends.BackendError:
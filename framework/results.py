@@ -148,7 +148,7 @@ class TestResult(object):
     """An object represting the result of a single test."""
     __slots__ = ['returncode', '_err', '_out', 'time', 'command', 'traceback',
                  'environment', 'subtests', 'dmesg', '__result', 'images',
-                 'exception', 'pid']
+                 'exception', 'pid', 'phase_times']
     err = StringDescriptor('_err')
     out = StringDescriptor('_out')
 
@@ -163,6 +163,7 @@ class TestResult(object):
         self.traceback = None
         self.exception = None
         self.pid = None
+        self.phase_times = None
         if result:
             self.result = result
         else:
@@ -206,6 +207,7 @@ class TestResult(object):
             'traceback': self.traceback,
             'dmesg': self.dmesg,
             'pid': self.pid,
+            'phase_times': self.phase_times,
         }
         return obj
 
@@ -225,7 +227,8 @@ class TestResult(object):
         inst = cls()
 
         for each in ['returncode', 'command', 'exception', 'environment',
-                     'time', 'traceback', 'result', 'dmesg', 'pid']:
+                     'time', 'traceback', 'result', 'dmesg', 'pid',
+                     'phase_times']:
             if each in dict_:
                 setattr(inst, each, dict_[each])
 
@@ -254,6 +257,8 @@ class TestResult(object):
             self.result = dict_['result']
         elif 'subtest' in dict_:
             self.subtests.update(dict_['subtest'])
+        elif 'phase_times' in dict_:
+            self.phase_times = dict_['phase_times']
 
 
 @compat.python_2_bool_compatible
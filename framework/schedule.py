@@ -0,0 +1,235 @@
+# Copyright (c) 2017 The Piglit project
+
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Schedules the tests of a run across worker threads.
+
+Tests are handed out longest first, using how long each test took in an
+earlier run, so that the slow tests don't start last and leave the other
+workers idle at the end of the run. Tests without a previous time are
+assumed to take the median time. Without any previous times the tests are
+handed out in profile order.
+
+Tests that can't run concurrently are placed in the same longest first
+order as the others, rather than in a separate phase at the end. When a
+serial test is next in line no new concurrent test is started, except for
+the shortest ones that are expected to end before the tests already
+running, to fill the wait; the serial test starts as soon as nothing else
+runs, and nothing else starts until it is done. Without earlier times there
+is nothing to order them by and the serial tests run after all of the
+concurrent ones.
+
+"""
+
+from __future__ import (
+    absolute_import, division, print_function, unicode_literals
+)
+import collections
+import heapq
+import threading
+import time
+
+import six
+
+from framework import backends
+from framework.test.piglit_test import SubtestShard
+from framework.test.shader_test import MultiShaderTest
+
+__all__ = [
+    'Scheduler',
+    'load_durations',
+]
+
+
+def load_durations(results_path):
+    """Return a dict of test name to run time in seconds from a results file
+    or directory.
+    """
+    results = backends.load(results_path)
+    return {name: result.time.total
+            for name, result in six.iteritems(results.tests)
+            if result.time.total > 0}
+
+
+def _now():
+    return time.time()
+
+
+# A test in one of the scheduler's queues; index is its position in the
+# profile, which orders tests with the same expected time.
+_Entry = collections.namedtuple('_Entry', ['time', 'index', 'pair'])
+
+
+def _median(values):
+    values = sorted(values)
+    if not values:
+        return 0.0
+    mid = len(values) // 2
+    if len(values) % 2:
+        return values[mid]
+    return (values[mid - 1] + values[mid]) / 2
+
+
+class Scheduler(object):
+    """Hands (name, test) pairs to worker threads.
+
+    Arguments:
+    tests -- a list of (name, test) pairs
+    durations -- a dict of test name to expected run time in seconds
+    jobs -- the number of workers that will call next()
+    concurrent -- "all", "none" or "some", as options.OPTIONS.concurrent
+
+    Each worker calls next() until it returns None, and calls done() with
+    each test it was given once it has run it.
+
+    """
+    def __init__(self, tests, durations=None, jobs=1, concurrent='some'):
+        self.jobs = max(1, jobs)
+        self._durations = durations or {}
+        self._default = _median(six.itervalues(self._durations))
+        self._cond = threading.Condition()
+        self._running = {}
+        self._exclusive = False
+        self._stopped = False
+
+        if concurrent == 'none':
+            self.jobs = 1
+
+        def is_concurrent(pair):
+            if concurrent == 'some':
+                return pair[1].run_concurrent
+            return concurrent == 'all'
+
+        # sorted() is stable, so without durations profile order is kept
+        ordered = sorted(
+            (_Entry(self.expected(p), i, p) for i, p in enumerate(tests)),
+            key=lambda e: e.time, reverse=True)
+        self._concurrent = collections.deque(
+            e for e in ordered if is_concurrent(e.pair))
+        self._serial = collections.deque(
+            e for e in ordered if not is_concurrent(e.pair))
+
+    def expected(self, pair):
+        """Expected run time of a (name, test) pair in seconds."""
+        name, test = pair
+        if isinstance(test, MultiShaderTest):
+            return sum(self._durations.get(n, self._default)
+                       for n, _ in test.tests)
+        if isinstance(test, SubtestShard):
+            return (self._durations.get(name, self._default) /
+                    len(test.group.shards))
+        return self._durations.get(name, self._default)
+
+    def _serial_due(self, concurrent, serial):
+        """Whether the next serial test comes before the next concurrent
+        one.
+        """
+        if not serial:
+            return False
+        if not concurrent:
+            return True
+        if not self._durations:
+            return False
+        return ((-serial[0].time, serial[0].index) <
+                (-concurrent[0].time, concurrent[0].index))
+
+    def _pick(self, concurrent, serial, running, now):
+        """Pop the entry to start at time now from the queues and return it
+        with whether it is a serial test, or return (None, False) if nothing
+        may start yet.
+
+        running maps the tests that are running, none of them serial, to the
+        times they are expected to end.
+
+        """
+        if not self._serial_due(concurrent, serial):
+            if concurrent:
+                return concurrent.popleft(), False
+            return None, False
+
+        if not running:
+            return serial.popleft(), True
+
+        # Fill the wait for the running tests with the shortest concurrent
+        # tests, as long as they are expected to end by the time those do
+        if (concurrent and self._durations and
+                now + concurrent[-1].time <= max(six.itervalues(running))):
+            return concurrent.pop(), False
+        return None, False
+
+    def expected_makespan(self):
+        """Expected wall time of the whole schedule in seconds.
+
+        The tests are run through the same choices next() makes, with each
+        test taking its expected time.
+
+        """
+        concurrent = collections.deque(self._concurrent)
+        serial = collections.deque(self._serial)
+        running = {}
+        now = 0.0
+
+        while True:
+            while len(running) < self.jobs:
+                entry, exclusive = self._pick(concurrent, serial, running, now)
+                if entry is None:
+                    break
+                running[entry.index] = now + entry.time
+                if exclusive:
+                    # Nothing else can start until it is done
+                    now = running.pop(entry.index)
+
+            if not running:
+                return now
+
+            index = min(running, key=running.get)
+            now = running.pop(index)
+
+    def next(self):
+        """Block until a test may start and return it, or return None when
+        there are no more tests (or stop() was called).
+        """
+        with self._cond:
+            while True:
+                if self._stopped or not (self._concurrent or self._serial):
+                    return None
+
+                if not self._exclusive:
+                    entry, exclusive = self._pick(
+                        self._concurrent, self._serial, self._running,
+                        _now())
+                    if entry is not None:
+                        self._exclusive = exclusive
+                        self._running[id(entry.pair)] = _now() + entry.time
+                        return entry.pair
+
+                self._cond.wait()
+
+    def done(self, pair):
+        """Mark a test returned by next() as finished."""
+        with self._cond:
+            self._running.pop(id(pair), None)
+            self._exclusive = False
+            self._cond.notify_all()
+
+    def stop(self):
+        """Don't hand out any more tests."""
+        with self._cond:
+            self._stopped = True
+            self._cond.notify_all()
@@ -25,6 +25,7 @@
 from __future__ import (
     absolute_import, division, print_function, unicode_literals
 )
+import collections
 import re
 import operator
 
@@ -37,6 +38,9 @@ import framework.status as so
 from framework.core import lazy_property
 from framework import grouptools
 
+# The phases native tests report times for, in the order they happen
+PHASES = ['context', 'init', 'compile', 'display', 'readback', 'teardown']
+
 
 class Results(object):  # pylint: disable=too-few-public-methods
     """Container object for results.
@@ -49,6 +53,11 @@ class Results(object):  # pylint: disable=too-few-public-methods
         self.names = Names(self)
         self.counts = Counts(self)
 
+    @lazy_property
+    def phase_times(self):
+        """A list with the phase totals of each run."""
+        return [phase_totals(r) for r in self.results]
+
     def get_result(self, name):
         """Get all results for a single test.
 
@@ -65,6 +74,26 @@ class Results(object):  # pylint: disable=too-few-public-methods
         return results
 
 
+def phase_totals(results):
+    """Return the time spent in each phase by all the tests of a run.
+
+    Returns an OrderedDict mapping phase names to seconds, in the order of
+    PHASES and then of name for any other phase.  It is empty if no test
+    reported phase times.
+
+    """
+    totals = {}
+    for test in six.itervalues(results.tests):
+        for phase, time in six.iteritems(test.phase_times or {}):
+            totals[phase] = totals.get(phase, 0.0) + time
+
+    ordered = collections.OrderedDict()
+    for phase in PHASES + sorted(set(totals) - set(PHASES)):
+        if phase in totals:
+            ordered[phase] = totals[phase]
+    return ordered
+
+
 class Names(object):
     """Class containing names of tests for various statuses.
 
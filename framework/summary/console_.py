@@ -88,6 +88,17 @@ def _print_summary(results):
             str(sum(six.itervalues(x.totals['root'])))
             for x in results.results])))
 
+    if any(results.phase_times):
+        phases = []
+        for times in results.phase_times:
+            phases.extend(p for p in times if p not in phases)
+
+        print('phase times (s):')
+        for phase in phases:
+            print('{: >11}: {}'.format(phase, print_template.format(*[
+                '{:.3f}'.format(t[phase]) if phase in t else '-'
+                for t in results.phase_times])))
+
 
 def _print_result(results, list_):
     """Takes a list of test names to print and prints the name and result."""
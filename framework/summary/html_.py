@@ -20,13 +20,28 @@
 # OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 # SOFTWARE.
 
-"""Genrate html summaries."""
+"""Genrate html summaries.
+
+Pages are only written when their inputs have changed since the last time
+the summary was generated into the same directory. A manifest in the
+destination records a digest of the inputs of each page, and pages that are
+no longer generated are removed.
+
+The per test pages are rendered by a pool of worker processes, and the
+results files are loaded one at a time: once the pages of a run are written
+only the status of each of its tests is kept for the comparison pages.
+
+"""
 
 from __future__ import (
     absolute_import, division, print_function, unicode_literals
 )
 import errno
 import getpass
+import hashlib
+import io
+import json
+import multiprocessing
 import os
 import shutil
 import sys
@@ -38,12 +53,14 @@ import six
 
 # a local variable status exists, prevent accidental overloading by renaming
 # the module
-from framework import backends, exceptions, core
+from framework import backends, exceptions, core, results as results_
+from framework.backends.json import piglit_encoder
 
 from .common import Results, escape_filename, escape_pathname
 from .feature import FeatResults
 
 __all__ = [
+    'MANIFEST_NAME',
     'html',
     'feat'
 ]
@@ -67,6 +84,82 @@ _TEMPLATES = TemplateLookup(
     output_encoding='utf-8',
     module_directory=os.path.join(_TEMP_DIR, "html-summary"))
 
+# Number of per test pages handed to a worker at a time
+_CHUNK_SIZE = 64
+
+MANIFEST_NAME = 'summary.manifest'
+
+
+def _digest(*parts):
+    """Return a hex digest of json serializable parts."""
+    return hashlib.sha1(json.dumps(
+        parts, default=piglit_encoder, sort_keys=True).encode('utf-8')
+    ).hexdigest()
+
+
+def _template_digest():
+    """Return a digest of the templates and the version of mako.
+
+    Any change to them changes every page.
+
+    """
+    digest = hashlib.sha1(mako.__version__.encode('utf-8'))
+    for name in sorted(os.listdir(_TEMPLATE_DIR)):
+        with io.open(os.path.join(_TEMPLATE_DIR, name), 'rb') as f:
+            digest.update(f.read())
+    return digest.hexdigest()
+
+
+class _Manifest(object):
+    """The pages in a summary directory and the digest of their inputs.
+
+    needs() is called for every page that is part of the summary, and
+    returns whether it has to be written. write() removes the pages from
+    the previous summary that weren't part of this one and saves the
+    manifest; it must only be called once every page has been recorded,
+    or the pages that weren't would be removed.
+
+    """
+    def __init__(self, destination):
+        self.destination = destination
+        self.templates = _template_digest()
+        self.__new = {}
+        try:
+            with io.open(os.path.join(destination, MANIFEST_NAME), 'r',
+                         encoding='utf-8') as f:
+                self.__old = json.load(f)
+        except (IOError, ValueError):
+            self.__old = {}
+
+    def needs(self, path, *inputs):
+        """Record a page and return True if it must be (re)written.
+
+        Arguments:
+        path -- the path of the page
+        inputs -- everything the page is generated from
+
+        """
+        rel = os.path.relpath(path, self.destination)
+        digest = _digest(self.templates, inputs)
+        self.__new[rel] = digest
+        return self.__old.get(rel) != digest or not os.path.exists(path)
+
+    def write(self):
+        """Remove stale pages and write the manifest."""
+        for rel in six.iterkeys(self.__old):
+            if rel not in self.__new:
+                try:
+                    os.unlink(os.path.join(self.destination, rel))
+                except OSError as e:
+                    if e.errno != errno.ENOENT:
+                        raise
+
+        name = os.path.join(self.destination, MANIFEST_NAME)
+        with io.open(name + '.tmp', 'w', encoding='utf-8') as f:
+            f.write(six.text_type(json.dumps(self.__new, indent=1,
+                                             sort_keys=True)))
+        os.rename(name + '.tmp', name)
+
 
 def _copy_static_files(destination):
     """Copy static files into the results directory."""
@@ -76,70 +169,163 @@ def _copy_static_files(destination):
                 os.path.join(destination, "result.css"))
 
 
-def _make_testrun_info(results, destination, exclude=None):
-    """Create the pages for each results file."""
+def _write_test_page(page):
+    """Render a single test page, this is run by the worker processes."""
+    html_path, testname, value, css, index = page
+    core.check_dir(os.path.dirname(html_path))
+
+    with open(html_path, 'wb') as out:
+        out.write(_TEMPLATES.get_template('test_result.mako').render(
+            testname=testname,
+            value=value,
+            css=css,
+            index=index))
+
+
+class _Writer(object):
+    """Writes pages, spreading the per test pages across processes."""
+    def __init__(self, destination, jobs=None):
+        self.manifest = _Manifest(destination)
+        self.names = set()
+
+        # Compile the template before forking, so that the workers don't
+        # each compile it again
+        self.__pool = None
+        _TEMPLATES.get_template('test_result.mako')
+        jobs = jobs or multiprocessing.cpu_count()
+        if jobs > 1:
+            self.__pool = multiprocessing.Pool(jobs)
+
+    def test_pages(self, pages):
+        """Write an iterable of per test pages, see _write_test_page."""
+        if self.__pool is None:
+            for page in pages:
+                _write_test_page(page)
+        else:
+            for _ in self.__pool.imap_unordered(_write_test_page, pages,
+                                                _CHUNK_SIZE):
+                pass
+
+    def close(self):
+        """Finish writing, and prune the old pages and save the manifest."""
+        if self.__pool is not None:
+            self.__pool.close()
+            self.__pool.join()
+        self.manifest.write()
+
+    def abort(self):
+        """Stop writing, leaving the old manifest and pages alone.
+
+        The pages already rewritten don't match the old manifest and are
+        rewritten again by the next summary.
+
+        """
+        if self.__pool is not None:
+            self.__pool.terminate()
+            self.__pool.join()
+
+
+def _make_testrun_info(each, destination, writer, exclude=None):
+    """Create the pages for a results file."""
     exclude = exclude or {}
     result_css = os.path.join(destination, "result.css")
     index = os.path.join(destination, "index.html")
 
-    for each in results.results:
-        name = escape_pathname(each.name)
-        try:
-            core.check_dir(os.path.join(destination, name), True)
-        except exceptions.PiglitException:
-            raise exceptions.PiglitFatalError(
-                'Two or more of your results have the same "name" '
-                'attribute. Try changing one or more of the "name" '
-                'values in your json files.\n'
-                'Duplicate value: {}'.format(name))
-
-        with open(os.path.join(destination, name, "index.html"), 'wb') as out:
+    name = escape_pathname(each.name)
+    if name in writer.names:
+        raise exceptions.PiglitFatalError(
+            'Two or more of your results have the same "name" '
+            'attribute. Try changing one or more of the "name" '
+            'values in your json files.\n'
+            'Duplicate value: {}'.format(name))
+    writer.names.add(name)
+    core.check_dir(os.path.join(destination, name))
+
+    info = dict(
+        name=each.name,
+        totals=each.totals['root'],
+        time=each.time_elapsed.delta,
+        options=each.options,
+        uname=each.uname,
+        glxinfo=each.glxinfo,
+        clinfo=each.clinfo,
+        lspci=each.lspci)
+    info_path = os.path.join(destination, name, "index.html")
+    if writer.manifest.needs(info_path, info):
+        with open(info_path, 'wb') as out:
             out.write(_TEMPLATES.get_template('testrun_info.mako').render(
-                name=each.name,
-                totals=each.totals['root'],
-                time=each.time_elapsed.delta,
-                options=each.options,
-                uname=each.uname,
-                glxinfo=each.glxinfo,
-                clinfo=each.clinfo,
-                lspci=each.lspci))
-
-        # Then build the individual test results
+                **info))
+
+    # Then build the individual test results
+    def pages():
         for key, value in six.iteritems(each.tests):
+            if value.result in exclude:
+                continue
+
             html_path = os.path.join(destination, name,
                                      escape_filename(key + ".html"))
             temp_path = os.path.dirname(html_path)
+            css = os.path.relpath(result_css, temp_path)
+            index_ = os.path.relpath(index, temp_path)
+
+            if writer.manifest.needs(html_path, key, value, value.images,
+                                     css, index_):
+                yield html_path, key, value, css, index_
 
-            if value.result not in exclude:
-                core.check_dir(temp_path)
+    writer.test_pages(pages())
 
-                with open(html_path, 'wb') as out:
-                    out.write(_TEMPLATES.get_template(
-                        'test_result.mako').render(
-                            testname=key,
-                            value=value,
-                            css=os.path.relpath(result_css, temp_path),
-                            index=os.path.relpath(index, temp_path)))
 
+def _statuses(run):
+    """Return a copy of a run with only what the comparison pages use.
 
-def _make_comparison_pages(results, destination, exclude):
+    The output, environment and so on of every test is dropped, so that only
+    one complete run at a time needs to be kept in memory.
+
+    """
+    slim = results_.TestrunResult()
+    slim.name = run.name
+    slim.totals = run.totals
+    slim.time_elapsed = run.time_elapsed
+    for key, value in six.iteritems(run.tests):
+        result = results_.TestResult(value.result)
+        result.subtests.update(value.subtests)
+        slim.tests[key] = result
+    return slim
+
+
+def _make_comparison_pages(results, destination, writer, exclude):
     """Create the pages of comparisons."""
-    pages = frozenset(['changes', 'problems', 'skips', 'fixes',
-                       'regressions', 'enabled', 'disabled'])
+    # A fixed order, so that unchanged pages are rendered identically
+    pages = ('changes', 'problems', 'skips', 'fixes', 'regressions',
+             'enabled', 'disabled')
+
+    # Every comparison page depends on the status of every test
+    inputs = _digest(
+        sorted(str(e) for e in exclude),
+        [(r.name, r.totals,
+          [(k, v.result, sorted(six.iteritems(v.subtests)))
+           for k, v in six.iteritems(r.tests)])
+         for r in results.results])
 
     # Index.html is a bit of a special case since there is index, all, and
     # alltests, where the other pages all use the same name. ie,
     # changes.html, changes, and page=changes.
-    with open(os.path.join(destination, "index.html"), 'wb') as out:
-        out.write(_TEMPLATES.get_template('index.mako').render(
-            results=results,
-            page='all',
-            pages=pages,
-            exclude=exclude))
+    path = os.path.join(destination, "index.html")
+    if writer.manifest.needs(path, inputs, 'all'):
+        with open(path, 'wb') as out:
+            out.write(_TEMPLATES.get_template('index.mako').render(
+                results=results,
+                page='all',
+                pages=pages,
+                exclude=exclude))
 
     # Generate the rest of the pages
     for page in pages:
-        with open(os.path.join(destination, page + '.html'), 'wb') as out:
+        path = os.path.join(destination, page + '.html')
+        if not writer.manifest.needs(path, inputs, page):
+            continue
+
+        with open(path, 'wb') as out:
             # If there is information to display display it
             if sum(getattr(results.counts, page)) > 0:
                 out.write(_TEMPLATES.get_template('index.mako').render(
@@ -162,7 +348,7 @@ def _make_feature_info(results, destination):
             results=results))
 
 
-def html(results, destination, exclude):
+def html(results, destination, exclude, jobs=None):
     """
     Produce HTML summaries.
 
@@ -171,19 +357,46 @@ def html(results, destination, exclude):
     The beauty of this approach is that mako is leveraged to do the
     heavy lifting, this method just passes it a bunch of dicts and lists
     of dicts, which mako turns into pretty HTML.
-    """
-    results = Results([backends.load(i) for i in results])
 
+    Arguments:
+    results -- a list of paths to results
+    destination -- the directory to write the summary to
+    exclude -- statuses to not write test pages for
+    jobs -- number of processes to render test pages with, one per CPU by
+            default
+
+    """
     _copy_static_files(destination)
-    _make_testrun_info(results, destination, exclude)
-    _make_comparison_pages(results, destination, exclude)
 
+    writer = _Writer(destination, jobs)
+    try:
+        runs = []
+        for path in results:
+            run = backends.load(path)
+            _make_testrun_info(run, destination, writer, exclude)
+            runs.append(_statuses(run))
+            del run
 
-def feat(results, destination, feat_desc):
+        _make_comparison_pages(Results(runs), destination, writer, exclude)
+    except BaseException:
+        writer.abort()
+        raise
+    writer.close()
+
+
+def feat(results, destination, feat_desc, jobs=None):
     """Produce HTML feature readiness summary."""
 
     feat_res = FeatResults([backends.load(i) for i in results], feat_desc)
 
     _copy_static_files(destination)
-    _make_testrun_info(feat_res, destination)
+
+    writer = _Writer(destination, jobs)
+    try:
+        for each in feat_res.results:
+            _make_testrun_info(each, destination, writer)
+    except BaseException:
+        writer.abort()
+        raise
+    writer.close()
     _make_feature_info(feat_res, destination)
@@ -26,6 +26,7 @@ from __future__ import (
     absolute_import, division, print_function, unicode_literals
 )
 import errno
+import hashlib
 import os
 import time
 import sys
@@ -33,6 +34,7 @@ import traceback
 import itertools
 import abc
 import copy
+import re
 import signal
 import warnings
 
@@ -131,6 +133,20 @@ class TestRunError(exceptions.PiglitException):
         self.status = status
 
 
+def golden_hash_file(name):
+    """Return the golden hash reference file of the test called name.
+
+    Each test gets its own file in options.OPTIONS.golden_hashes, named
+    after the test with anything that isn't safe in a file name replaced,
+    and a hash of the real name so that names which only differ in those
+    characters don't share a file.
+
+    """
+    return os.path.join(options.OPTIONS.golden_hashes, '{}-{}.hashes'.format(
+        re.sub(r'[^\w@.+-]', '_', name),
+        hashlib.sha1(name.encode('utf-8')).hexdigest()[:8]))
+
+
 def is_crash_returncode(returncode):
     """Determine whether the given process return code correspond to a
     crash.
@@ -173,6 +189,9 @@ class Test(object):
     __slots__ = ['run_concurrent', 'env', 'result', 'cwd', '_command']
     timeout = None
 
+    # Whether execute() points the test at its golden hash file
+    golden_hashes = True
+
     def __init__(self, command, run_concurrent=False, timeout=None):
         assert isinstance(command, list), command
 
@@ -199,6 +218,8 @@ class Test(object):
 
         """
         log.start(path)
+        if options.OPTIONS.golden_hashes and self.golden_hashes:
+            self.env['PIGLIT_GOLDEN_HASH_FILE'] = golden_hash_file(path)
         # Run the test
         if options.OPTIONS.execute:
             try:
@@ -282,13 +303,8 @@ class Test(object):
         """
         pass
 
-    def _run_command(self):
-        """ Run the test command and get the result
-
-        This method sets environment options, then runs the executable. If the
-        executable isn't found it sets the result to skip.
-
-        """
+    def _environment(self):
+        """Return the full environment to run the test command in."""
         # Setup the environment for the test. Environment variables are taken
         # from the following sources, listed in order of increasing precedence:
         #
@@ -311,14 +327,21 @@ class Test(object):
         _base = itertools.chain(six.iteritems(os.environ),
                                 six.iteritems(options.OPTIONS.env),
                                 six.iteritems(self.env))
-        fullenv = {f(k): f(v) for k, v in _base}
+        return {f(k): f(v) for k, v in _base}
+
+    def _run_command(self):
+        """ Run the test command and get the result
 
+        This method sets environment options, then runs the executable. If the
+        executable isn't found it sets the result to skip.
+
+        """
         try:
             proc = subprocess.Popen(self.command,
                                     stdout=subprocess.PIPE,
                                     stderr=subprocess.PIPE,
                                     cwd=self.cwd,
-                                    env=fullenv,
+                                    env=self._environment(),
                                     universal_newlines=True,
                                     **_EXTRA_POPEN_ARGS)
 
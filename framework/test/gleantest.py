@@ -25,14 +25,23 @@
 from __future__ import (
     absolute_import, division, print_function, unicode_literals
 )
+import collections
+import json
 import os
+import sys
+import time
+import traceback
 
-from framework import options
-from .base import Test, TestIsSkip
+import six
+
+from framework import options, status
+from .base import Test, TestIsSkip, is_crash_returncode
 from .piglit_test import TEST_BIN_DIR
 
 __all__ = [
     'GleanTest',
+    'MultiGleanTest',
+    'batch_glean_tests',
 ]
 
 
@@ -71,3 +80,160 @@ class GleanTest(Test):
                 'but the platform is "{}"'.format(
                     options.OPTIONS.env['PIGLIT_PLATFORM']))
         super(GleanTest, self).is_skip()
+
+
+class MultiGleanTest(GleanTest):
+    """Run several GleanTests of one glean test in a single process.
+
+    glsl1, fragProg1 and vertProg1 each run one of their programs when
+    PIGLIT_TEST names it. Without PIGLIT_TEST they run all of them, and
+    report each program as a piglit subtest named after it. This runs the
+    glean test once that way, and gives each GleanTest the result of the
+    subtest its PIGLIT_TEST names, along with the output that came before
+    that subtest.
+
+    A GleanTest whose subtest was not reported crashed with the process if
+    it crashed, and was not applicable otherwise.
+
+    Arguments:
+    tests -- a list of (name, GleanTest) pairs, which only differ by their
+             PIGLIT_TEST. batch_glean_tests() creates these.
+
+    """
+    def __init__(self, tests):
+        assert len(tests) > 1
+        self.tests = tests
+        # pylint: disable=bad-super-call
+        super(GleanTest, self).__init__(
+            list(tests[0][1]._command),
+            run_concurrent=tests[0][1].run_concurrent)
+        self.env = {k: v for k, v in six.iteritems(tests[0][1].env)
+                    if k != 'PIGLIT_TEST'}
+
+    def execute(self, path, log, dmesg, monitoring):
+        """Run the tests, and log a result for each of them.
+
+        Like MultiShaderTest.execute this takes the LogManager rather than a
+        log, since there is a log entry for each test.
+
+        """
+        logs = []
+        for name, _ in self.tests:
+            logs.append(log.get())
+            logs[-1].start(name)
+
+        if not options.OPTIONS.execute:
+            for l in logs:
+                l.log('dry-run')
+            return
+
+        try:
+            self.result.time.start = time.time()
+            self.run()
+            self.result.time.end = time.time()
+            self.__distribute()
+        # This is a rare case where a bare exception is okay, since we're
+        # using it to log exceptions
+        except:
+            exc_type, exc_value, exc_traceback = sys.exc_info()
+            traceback.print_exc(file=sys.stderr)
+            for _, test in self.tests:
+                if test.result.result == status.NOTRUN:
+                    test.result.result = 'fail'
+                    test.result.exception = "{}{}".format(exc_type,
+                                                           exc_value)
+                    test.result.traceback = "".join(
+                        traceback.format_tb(exc_traceback))
+
+        for l, (_, test) in six.moves.zip(logs, self.tests):
+            l.log(test.result.result)
+
+    def __split(self):
+        """Return dicts of the status and the output of each subtest.
+
+        A subtest that is reported more than once, because the glean test
+        ran on several visuals, gets the worst of its statuses.
+
+        """
+        statuses = {}
+        outputs = collections.defaultdict(list)
+        pending = []
+        for line in self.result.out.split('\n'):
+            if not line.startswith('PIGLIT:'):
+                pending.append(line)
+                continue
+
+            for name, value in six.iteritems(
+                    json.loads(line[8:]).get('subtest', {})):
+                value = status.status_lookup(value)
+                statuses[name] = max(statuses.get(name, value), value)
+                outputs[name].extend(pending)
+                pending = []
+
+        return statuses, outputs
+
+    def __distribute(self):
+        """Give each test its result."""
+        if self.result.returncode is None:
+            # The process didn't run: it was skipped or timed out.
+            statuses, outputs = {}, {}
+        else:
+            statuses, outputs = self.__split()
+
+        step = (self.result.time.end - self.result.time.start) / \
+            len(self.tests)
+        for i, (_, test) in enumerate(self.tests):
+            name = test.env['PIGLIT_TEST']
+            test.result.command = self.result.command
+            test.result.environment = self.result.environment
+            test.result.pid = self.result.pid
+            test.result.returncode = self.result.returncode
+            test.result.err = self.result.err
+            test.result.time.start = self.result.time.start + i * step
+            test.result.time.end = self.result.time.start + (i + 1) * step
+
+            if self.result.returncode is None:
+                test.result.result = self.result.result
+                test.result.out = self.result.out
+            elif name in statuses:
+                test.result.result = statuses[name]
+                test.result.out = '\n'.join(outputs[name])
+            elif is_crash_returncode(self.result.returncode):
+                test.result.result = 'crash'
+            else:
+                test.result.result = 'skip'
+                test.result.out = 'Not applicable to this GL implementation'
+
+    def interpret_result(self):
+        """Results are assigned to each test, nothing to do here."""
+        pass
+
+
+def batch_glean_tests(tests):
+    """Collect the GleanTests that run one program of the same glean test.
+
+    Yields (name, test) pairs. GleanTests that set PIGLIT_TEST and differ
+    only by it are replaced by one MultiGleanTest, named like the first of
+    them, which is yielded after all of the other tests.
+
+    Arguments:
+    tests -- an iterable of (name, Test) pairs
+
+    """
+    batches = collections.OrderedDict()
+    for name, test in tests:
+        # pylint: disable=unidiomatic-typecheck
+        if type(test) is not GleanTest or 'PIGLIT_TEST' not in test.env:
+            yield name, test
+            continue
+
+        key = (tuple(test.command), test.run_concurrent,
+               tuple(sorted((k, v) for k, v in six.iteritems(test.env)
+                            if k != 'PIGLIT_TEST')))
+        batches.setdefault(key, []).append((name, test))
+
+    for batch in six.itervalues(batches):
+        if len(batch) == 1:
+            yield batch[0]
+        else:
+            yield batch[0][0], MultiGleanTest(batch)
@@ -24,6 +24,9 @@ from __future__ import (
     absolute_import, division, print_function, unicode_literals
 )
 import errno
+import hashlib
+import io
+import json
 import os
 import subprocess
 import warnings
@@ -33,6 +36,7 @@ import six
 from framework import exceptions, core
 from framework.options import OPTIONS
 from .base import TestIsSkip
+from .piglit_test import TEST_BIN_DIR
 
 # pylint: disable=too-few-public-methods
 
@@ -44,6 +48,78 @@ __all__ = [
 # stubbing it out
 _DISABLED = bool(os.environ.get('PIGLIT_NO_FAST_SKIP', False))
 
+# The helper that reports every context flavor in one process, see
+# tests/util/piglit-capabilities.c. It's only built with waffle.
+_CAPABILITIES_BIN = os.path.join(TEST_BIN_DIR, 'piglit-capabilities')
+
+# Environment variables that change which driver is loaded or what it
+# reports, and so are part of the capability cache key.
+_CACHE_ENV = ['PIGLIT_PLATFORM', 'DISPLAY', 'WAYLAND_DISPLAY',
+              'LD_LIBRARY_PATH']
+_CACHE_ENV_PREFIXES = ('MESA_', 'LIBGL_', 'GALLIUM_', '__GL')
+
+
+def _cache_key():
+    """Hash everything that may change what piglit-capabilities reports,
+    other than the driver libraries themselves.
+    """
+    env = dict(os.environ)
+    env.update(OPTIONS.env)
+    key = hashlib.sha1()
+    for name in sorted(env):
+        if name in _CACHE_ENV or name.startswith(_CACHE_ENV_PREFIXES):
+            key.update('{}={}\n'.format(name, env[name]).encode('utf-8'))
+    key.update('{} {}\n'.format(
+        _CAPABILITIES_BIN,
+        os.stat(_CAPABILITIES_BIN).st_mtime).encode('utf-8'))
+    return key.hexdigest()
+
+
+def _library_mtimes(libraries):
+    """Return a dict of library path to mtime, skipping the ones that are
+    gone.
+    """
+    mtimes = {}
+    for lib in libraries:
+        try:
+            mtimes[lib] = os.stat(lib).st_mtime
+        except OSError:
+            pass
+    return mtimes
+
+
+def _read_cache(path):
+    """Return the cached capabilities in path, or None if there are none or
+    any library they were read with has changed since.
+    """
+    try:
+        with io.open(path, 'r', encoding='utf-8') as f:
+            cached = json.load(f)
+    except (IOError, OSError, ValueError):
+        return None
+
+    if _library_mtimes(cached['libraries']) != cached['mtimes']:
+        return None
+    return cached
+
+
+def _write_cache(path, caps):
+    """Write capabilities to the cache, ignoring any errors.
+
+    The file is written under a temporary name and renamed into place, so
+    that concurrent piglit runs never see half of it.
+    """
+    caps = dict(caps, mtimes=_library_mtimes(caps['libraries']))
+    tmp = '{}.{}'.format(path, os.getpid())
+    try:
+        if not os.path.exists(os.path.dirname(path)):
+            os.makedirs(os.path.dirname(path))
+        with io.open(tmp, 'w', encoding='utf-8') as f:
+            f.write(six.text_type(json.dumps(caps)))
+        os.rename(tmp, path)
+    except (IOError, OSError):
+        pass
+
 
 class StopWflinfo(exceptions.PiglitException):
     """Exception called when wlfinfo getter should stop."""
@@ -106,6 +182,59 @@ class WflInfo(object):
                 raise
         return raw.decode('utf-8')
 
+    @core.lazy_property
+    def _capabilities(self):
+        """Everything piglit-capabilities reports, or None if it isn't
+        available.
+
+        The output is cached on disk, keyed by the platform and the
+        environment, and reused until one of the libraries it was read with
+        changes. The properties below fall back to calling wflinfo once per
+        api and profile when this is None.
+
+        """
+        if not os.path.exists(_CAPABILITIES_BIN):
+            return None
+
+        path = os.path.join(core.cache_dir(),
+                            'capabilities-{}.json'.format(_cache_key()))
+        caps = _read_cache(path)
+        if caps is not None:
+            return caps
+
+        env = dict(os.environ)
+        env.update(OPTIONS.env)
+        with open(os.devnull, 'w') as d:
+            try:
+                raw = subprocess.check_output([_CAPABILITIES_BIN], stderr=d,
+                                              env=env)
+                caps = json.loads(raw.decode('utf-8'))
+            except (subprocess.CalledProcessError, OSError, ValueError):
+                return None
+
+        if not isinstance(caps, dict) or 'contexts' not in caps:
+            return None
+        caps.setdefault('libraries', [])
+        _write_cache(path, caps)
+        return caps
+
+    def __context(self, flavors):
+        """Return the first of flavors that piglit-capabilities could create
+        a context for, or None.
+        """
+        for flavor in flavors:
+            if flavor in self._capabilities['contexts']:
+                return self._capabilities['contexts'][flavor]
+        return None
+
+    @staticmethod
+    def __version(context, key, parse):
+        """Parse a version from a context, None if it isn't a version."""
+        try:
+            return parse(context[key])
+        except (AttributeError, IndexError, KeyError, TypeError, ValueError):
+            return None
+
     @staticmethod
     def __getline(lines, name):
         """Find a line in a list return it."""
@@ -125,6 +254,15 @@ class WflInfo(object):
         shouldn't.
 
         """
+        if self._capabilities is not None:
+            all_ = set()
+            for context in six.itervalues(self._capabilities['contexts']):
+                all_.update(context.get('extensions', []))
+            ret = {e.strip() for e in all_}
+            if ret == {'WFLINFO_GL_ERROR'}:
+                return set()
+            return ret
+
         _trim = len('OpenGL extensions: ')
         all_ = set()
 
@@ -172,6 +310,13 @@ class WflInfo(object):
         terms of support.
 
         """
+        if self._capabilities is not None:
+            context = self.__context(['gl core', 'gl compat', 'gl none'])
+            if context is None:
+                return None
+            return self.__version(
+                context, 'version', lambda v: float(v.split()[0][:3]))
+
         ret = None
         for profile in ['core', 'compat', 'none']:
             try:
@@ -210,6 +355,13 @@ class WflInfo(object):
         than skip a few tests that should be run.
 
         """
+        if self._capabilities is not None:
+            context = self.__context(['gles3', 'gles2', 'gles1'])
+            if context is None:
+                return None
+            return self.__version(
+                context, 'version', lambda v: float(v.split()[2]))
+
         ret = None
         for api in ['gles3', 'gles2', 'gles1']:
             try:
@@ -236,6 +388,13 @@ class WflInfo(object):
     @core.lazy_property
     def glsl_version(self):
         """Calculate the maximum OpenGL Shader Language version."""
+        if self._capabilities is not None:
+            context = self.__context(['gl core', 'gl compat', 'gl none'])
+            if context is None:
+                return None
+            return self.__version(
+                context, 'glsl', lambda v: float(v.split()[-1][:4]))
+
         ret = None
         for profile in ['core', 'compat', 'none']:
             try:
@@ -262,6 +421,13 @@ class WflInfo(object):
     @core.lazy_property
     def glsl_es_version(self):
         """Calculate the maximum OpenGL ES Shader Language version."""
+        if self._capabilities is not None:
+            context = self.__context(['gles3', 'gles2'])
+            if context is None:
+                return None
+            return self.__version(
+                context, 'glsl', lambda v: float(v.split()[-1][:3]))
+
         ret = None
         for api in ['gles3', 'gles2']:
             try:
@@ -25,21 +25,32 @@
 from __future__ import (
     absolute_import, division, print_function, unicode_literals
 )
+import copy
 import glob
+import io
+import itertools
 import os
+import subprocess
 import sys
+import threading
+from multiprocessing.dummy import Pool
 try:
     import simplejson as json
 except ImportError:
     import json
 
-from framework import core, options
-from .base import Test, WindowResizeMixin, ValgrindMixin, TestIsSkip
+import six
+
+from framework import core, options, zygote
+from .base import (Test, WindowResizeMixin, ValgrindMixin, TestIsSkip,
+                   TestRunError)
 
 
 __all__ = [
     'PiglitCLTest',
     'PiglitGLTest',
+    'ShardedTest',
+    'SubtestShard',
     'CL_CONCURRENT',
     'TEST_BIN_DIR',
 ]
@@ -53,6 +64,14 @@ else:
 CL_CONCURRENT = (not sys.platform.startswith('linux') or
                  glob.glob('/dev/dri/render*'))
 
+# piglit-zygote and the modules it runs, see framework.zygote
+ZYGOTE_BIN = os.path.join(TEST_BIN_DIR, 'piglit-zygote')
+ZYGOTE_MODULE_DIR = os.path.normpath(os.path.join(TEST_BIN_DIR, '..', 'lib',
+                                                  'zygote'))
+
+# Seconds a test gets to list its subtests, see list_subtests()
+LIST_SUBTESTS_TIMEOUT = 10
+
 
 class PiglitBaseTest(ValgrindMixin, Test):
     """
@@ -80,6 +99,42 @@ class PiglitBaseTest(ValgrindMixin, Test):
 
         super(PiglitBaseTest, self).interpret_result()
 
+    def _zygote_module(self):
+        """Return the module to run the test from in the zygote, or None to
+        run the test binary.
+        """
+        if zygote.get() is None or options.OPTIONS.valgrind:
+            return None
+        module = os.path.join(ZYGOTE_MODULE_DIR,
+                              os.path.basename(self._command[0]) + '.so')
+        return module if os.path.exists(module) else None
+
+    def _run_command(self):
+        module = self._zygote_module()
+        if module is None:
+            super(PiglitBaseTest, self)._run_command()
+            return
+
+        try:
+            self.result.pid, returncode, out, err = zygote.get().run(
+                module, self.command, self._environment(), self.cwd,
+                self.timeout)
+        except zygote.ZygoteTimeout:
+            raise TestRunError(
+                'Test run time exceeded timeout value ({} seconds)\n'.format(
+                    self.timeout),
+                'timeout')
+        except zygote.ZygoteUnreachable:
+            # The zygote died, the test binary still works.
+            super(PiglitBaseTest, self)._run_command()
+            return
+        except zygote.ZygoteError as e:
+            raise TestRunError('{}\n'.format(e), 'fail')
+
+        self.result.out = out
+        self.result.err = err
+        self.result.returncode = returncode
+
 
 class PiglitGLTest(WindowResizeMixin, PiglitBaseTest):
     """ OpenGL specific Piglit test class
@@ -162,3 +217,264 @@ class PiglitCLTest(PiglitBaseTest):  # pylint: disable=too-few-public-methods
     """
     def __init__(self, command, run_concurrent=CL_CONCURRENT, **kwargs):
         super(PiglitCLTest, self).__init__(command, run_concurrent, **kwargs)
+
+
+def _subtest_cache_path():
+    return os.path.join(core.cache_dir(), 'subtests.json')
+
+
+def _read_subtest_cache():
+    """Return the cached subtest lists, an empty dict if there are none."""
+    try:
+        with io.open(_subtest_cache_path(), 'r', encoding='utf-8') as f:
+            cache = json.load(f)
+    except (IOError, OSError, ValueError):
+        return {}
+    return cache if isinstance(cache, dict) else {}
+
+
+def _write_subtest_cache(cache):
+    """Write the subtest lists to the cache, ignoring any errors.
+
+    Like the capability cache it is written under a temporary name and
+    renamed into place.
+    """
+    path = _subtest_cache_path()
+    tmp = '{}.{}'.format(path, os.getpid())
+    try:
+        if not os.path.exists(os.path.dirname(path)):
+            os.makedirs(os.path.dirname(path))
+        with io.open(tmp, 'w', encoding='utf-8') as f:
+            f.write(six.text_type(json.dumps(cache)))
+        os.rename(tmp, path)
+    except (IOError, OSError):
+        pass
+
+
+def list_subtests(test):
+    """Return the subtests of a PiglitGLTest as a list of (option, name).
+
+    This runs the test with -list-subtests, which the GL framework handles
+    before it creates a context. Tests that don't use the subtest framework
+    exit with an error, and have no subtests.
+
+    The list is only trusted when it starts with the framework's
+    'PIGLIT: {"subtests": <count>}' line and has that many entries, since a
+    test that ignores the flag runs as usual and can print anything. Such a
+    test is killed after LIST_SUBTESTS_TIMEOUT seconds.
+
+    """
+    env = dict(os.environ)
+    env.update(options.OPTIONS.env)
+    env.update(test.env)
+    with open(os.devnull, 'w') as d:
+        try:
+            proc = subprocess.Popen(test.command + ['-list-subtests'],
+                                    stdout=subprocess.PIPE, stderr=d,
+                                    env=env, cwd=test.cwd)
+        except OSError:
+            return []
+        timer = threading.Timer(LIST_SUBTESTS_TIMEOUT, proc.kill)
+        timer.start()
+        try:
+            raw, _ = proc.communicate()
+        finally:
+            timer.cancel()
+    if proc.returncode != 0:
+        return []
+
+    lines = raw.decode('utf-8', 'replace').splitlines()
+    try:
+        count = json.loads(lines[0].partition('PIGLIT: ')[2])['subtests']
+    except (IndexError, ValueError, KeyError, TypeError):
+        return []
+    if len(lines) != count + 1:
+        return []
+
+    subtests = []
+    for line in lines[1:]:
+        option, sep, name = line.partition(': ')
+        if not sep:
+            return []
+        subtests.append((option, name))
+    return subtests
+
+
+class _ShardLog(object):
+    """Swallows the log calls of a single shard, the merged test is logged
+    by its ShardedTest instead.
+    """
+    def start(self, name):
+        pass
+
+    def log(self, status):
+        pass
+
+
+class SubtestShard(object):
+    """Runs some of the subtests of a test in their own process.
+
+    The shard runs a copy of the test with a -subtest argument for each of
+    its subtests. Like MultiShaderTest.execute, execute() takes the
+    LogManager; it returns True for the last shard of the test to finish,
+    at which point the test's result holds the merged result of all of its
+    shards.
+
+    """
+    run_concurrent = True
+
+    def __init__(self, group, subtests):
+        self.group = group
+        self.subtests = subtests
+        self.test = copy.deepcopy(group.test)
+        self.test._command = self.test._command + list(
+            itertools.chain.from_iterable(('-subtest', option)
+                                          for option, _ in subtests))
+        # The shards would all load and rewrite the test's golden hash
+        # file, and their keys don't match those of an unsharded run.
+        self.test.golden_hashes = False
+
+    def execute(self, path, log, dmesg, monitoring):
+        self.group.start(path, log)
+        self.test.execute(path, _ShardLog(), dmesg, monitoring)
+        return self.group.finish()
+
+
+class ShardedTest(object):
+    """A test whose subtests are split across several shards.
+
+    Arguments:
+    test -- the PiglitGLTest to shard
+    subtests -- its subtests, as returned by list_subtests()
+    count -- the number of shards, at most one per subtest
+
+    """
+    def __init__(self, test, subtests, count):
+        self.test = test
+        count = min(count, len(subtests))
+        self.shards = [SubtestShard(self, subtests[i::count])
+                       for i in range(count)]
+        self.__lock = threading.Lock()
+        self.__log = None
+        self.__finished = 0
+
+    def start(self, path, log):
+        """Start logging the test when its first shard starts."""
+        with self.__lock:
+            if self.__log is None:
+                self.__log = log.get()
+                self.__log.start(path)
+
+    def finish(self):
+        """Mark a shard as done, merging and logging the results after the
+        last one. Returns True if that was the last shard.
+        """
+        with self.__lock:
+            self.__finished += 1
+            if self.__finished < len(self.shards):
+                return False
+
+        if options.OPTIONS.execute:
+            self.merge()
+            self.__log.log(self.test.result.result)
+        else:
+            self.__log.log('dry-run')
+        return True
+
+    def merge(self):
+        """Merge the results of the shards into the result of the test.
+
+        The subtests reported by each shard are merged as if one process had
+        reported all of them. Subtests that a shard didn't get to report,
+        because it crashed, timed out or failed before running them, get
+        that shard's status.
+
+        """
+        result = self.test.result
+        results = [s.test.result for s in self.shards]
+
+        result.command = ' '.join(self.test.command)
+        result.environment = results[0].environment
+        result.out = '\n'.join(r.out for r in results)
+        result.err = '\n'.join(r.err for r in results if r.err)
+        result.pid = results[0].pid
+        result.time.start = min(r.time.start for r in results)
+        result.time.end = max(r.time.end for r in results)
+        result.result = max(r.result for r in results)
+        result.returncode = next((r.returncode for r in results
+                                  if r.returncode), results[0].returncode)
+
+        for r in results:
+            result.subtests.update(r.subtests)
+            if r.exception and not result.exception:
+                result.exception = r.exception
+                result.traceback = r.traceback
+            if r.phase_times:
+                if result.phase_times is None:
+                    result.phase_times = {}
+                for phase, secs in six.iteritems(r.phase_times):
+                    result.phase_times[phase] = \
+                        result.phase_times.get(phase, 0.0) + secs
+
+        # A test that fails before its first subtest, like one that skips
+        # for a missing extension, reports no subtests in any shard.
+        if result.subtests:
+            for shard, r in six.moves.zip(self.shards, results):
+                for _, name in shard.subtests:
+                    if name not in result.subtests:
+                        result.subtests[name] = r.result
+
+
+def shard_subtests(tests, count, jobs=1):
+    """Split the subtests of PiglitGLTests across count processes each.
+
+    Yields (name, test) pairs: every shard of a sharded test is yielded
+    under the test's name, the other tests are yielded unchanged. Only
+    concurrent PiglitGLTests with more than one subtest are sharded.
+
+    The subtest lists are read with -list-subtests, on jobs threads, and
+    cached in the piglit cache directory until the test binary changes.
+
+    Arguments:
+    tests -- an iterable of (name, Test) pairs
+    count -- the number of shards per test
+    jobs -- the number of tests to list the subtests of at once
+
+    """
+    tests = list(tests)
+    cache = _read_subtest_cache()
+    dirty = []
+
+    def lookup(test):
+        key = ' '.join(test.command)
+        try:
+            mtime = os.stat(test.command[0]).st_mtime
+        except OSError:
+            return []
+        cached = cache.get(key)
+        if cached and cached.get('mtime') == mtime:
+            return [tuple(s) for s in cached['subtests']]
+        subtests = list_subtests(test)
+        cache[key] = {'mtime': mtime, 'subtests': subtests}
+        dirty.append(key)
+        return subtests
+
+    candidates = [t for _, t in tests
+                  if isinstance(t, PiglitGLTest) and t.run_concurrent]
+    pool = Pool(max(1, jobs))
+    try:
+        subtests = dict(six.moves.zip(
+            (id(t) for t in candidates), pool.map(lookup, candidates)))
+    finally:
+        pool.close()
+        pool.join()
+
+    if dirty:
+        _write_subtest_cache(cache)
+
+    for name, test in tests:
+        if len(subtests.get(id(test), [])) < 2:
+            yield name, test
+            continue
+        for shard in ShardedTest(test, subtests[id(test)], count).shards:
+            yield name, shard
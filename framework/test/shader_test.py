@@ -26,17 +26,36 @@
 from __future__ import (
     absolute_import, division, print_function, unicode_literals
 )
+import collections
 import re
 import io
+import os
+import sys
+import time
+import traceback
 
-from framework import exceptions
+import six
+
+from framework import exceptions, options, status
+from .base import (
+    TestIsSkip, TestRunError, golden_hash_file, is_crash_returncode
+)
 from .opengl import FastSkipMixin
 from .piglit_test import PiglitBaseTest
 
 __all__ = [
+    'MultiShaderTest',
     'ShaderTest',
+    'batch_shader_tests',
 ]
 
+# The GL version shader_runner asks for to satisfy a GLSL requirement, this
+# mirrors required_gl_version_from_glsl_version() in piglit-util-gl.c
+_GLSL_TO_GL_VERSION = {
+    110: 20, 120: 21, 130: 21, 140: 31, 150: 32, 330: 33,
+    400: 40, 410: 41, 420: 42, 430: 43,
+}
+
 
 class ShaderTest(FastSkipMixin, PiglitBaseTest):
     """ Parse a shader test file and return a PiglitTest instance
@@ -44,15 +63,31 @@ class ShaderTest(FastSkipMixin, PiglitBaseTest):
     This function parses a shader test to determine if it's a GL, GLES2 or
     GLES3 test, and then returns a PiglitTest setup properly.
 
+    A comment line "# expect_result: fail" before the [require] section
+    makes a test that shader_runner fails pass, and one it passes fail.
+
     """
     _is_gl = re.compile(r'GL (<|<=|=|>=|>) \d\.\d')
     _match_gl_version = re.compile(
         r'^GL\s+(?P<es>ES)?\s*(?P<op>(<|<=|=|>=|>))\s*(?P<ver>\d\.\d)')
     _match_glsl_version = re.compile(
         r'^GLSL\s+(?P<es>ES)?\s*(?P<op>(<|<=|=|>=|>))\s*(?P<ver>\d\.\d+)')
+    _match_context_gl = re.compile(
+        r'^GL\s+(?P<core>CORE\s+)?(?P<es>ES\s*)?(?P<op>(==|=|>=|>))\s*'
+        r'(?P<major>\d)\.(?P<minor>\d)')
+    _match_context_glsl = re.compile(
+        r'^GLSL\s+(ES\s*)?>=\s*(?P<major>\d)\.(?P<minor>\d+)')
+    _match_size = re.compile(r'^SIZE\s+(?P<width>\d+)\s+(?P<height>\d+)')
+    _match_expect = re.compile(r'^#\s*expect_result:\s*(?P<result>\w+)\s*$')
+
+    # Tests in these directories are about the compiler and linker, a cached
+    # program would skip what they test.
+    _no_program_cache_dirs = frozenset(['compiler', 'linker'])
 
     def __init__(self, filename):
         self.gl_required = set()
+        self.filename = filename
+        self.expect_result = 'pass'
 
         # Iterate over the lines in shader file looking for the config section.
         # By using a generator this can be split into two for loops at minimal
@@ -72,6 +107,16 @@ class ShaderTest(FastSkipMixin, PiglitBaseTest):
                 # block.
                 if line.startswith('[require]'):
                     break
+
+                # A comment line "# expect_result: fail" marks a test of
+                # shader_runner's own error handling.
+                m = self._match_expect.match(line)
+                if m:
+                    if m.group('result') not in ['pass', 'fail']:
+                        raise exceptions.PiglitFatalError(
+                            "In file {}: expect_result must be pass or "
+                            "fail".format(filename))
+                    self.expect_result = m.group('result')
             else:
                 raise exceptions.PiglitFatalError(
                     "In file {}: Config block not found".format(filename))
@@ -84,6 +129,11 @@ class ShaderTest(FastSkipMixin, PiglitBaseTest):
 
         # This needs to be run after super or gl_required will be reset
         self.__find_requirements(lines)
+        self.context = self.__find_context(prog, lines)
+
+        parts = os.path.normpath(filename).split(os.sep)
+        if self._no_program_cache_dirs.intersection(parts[:-1]):
+            self.env['PIGLIT_NO_PROGRAM_CACHE'] = '1'
 
     def __find_gl(self, lines, filename):
         """Find the OpenGL API to use."""
@@ -144,7 +194,250 @@ class ShaderTest(FastSkipMixin, PiglitBaseTest):
             if line.startswith('['):
                 break
 
+    def __find_context(self, prog, lines):
+        """Find the context shader_runner will create for this test.
+
+        This follows get_required_config() in shader_runner.c. Tests with the
+        same context can be run by a single shader_runner process.
+
+        """
+        gl = (False, False, 10)
+        glsl = 0
+        size = None
+        depthbuffer = False
+
+        for line in lines:
+            line = line.strip()
+            if line.startswith('['):
+                break
+
+            m = self._match_context_gl.match(line)
+            if m:
+                gl = (bool(m.group('es')), bool(m.group('core')),
+                      int(m.group('major')) * 10 + int(m.group('minor')))
+                continue
+
+            m = self._match_context_glsl.match(line)
+            if m:
+                glsl = int(m.group('major')) * 100 + int(m.group('minor'))
+                continue
+
+            m = self._match_size.match(line)
+            if m:
+                size = (int(m.group('width')), int(m.group('height')))
+            elif line.startswith('depthbuffer'):
+                depthbuffer = True
+
+        es, core, version = gl
+        if es:
+            api = 'es'
+        else:
+            version = max(version, _GLSL_TO_GL_VERSION.get(glsl, 0))
+            if version < 31:
+                api, version = 'compat', 10
+            elif core:
+                api = 'core'
+            else:
+                api = 'core-or-compat'
+
+        return (prog, api, version, size, depthbuffer)
+
+    @PiglitBaseTest.command.getter
+    def command(self):
+        """ Add -auto to the test command """
+        return self._command + ['-auto']
+
+    def interpret_result(self):
+        """Swap pass and fail for a test that is expected to fail."""
+        super(ShaderTest, self).interpret_result()
+
+        if self.expect_result == 'fail':
+            if self.result.result == 'fail':
+                self.result.result = 'pass'
+            elif self.result.result == 'pass':
+                self.result.result = 'fail'
+
+
+class MultiShaderTest(PiglitBaseTest):
+    """Run several ShaderTests with a single shader_runner process.
+
+    shader_runner runs all of the scripts it is given in the context created
+    for the first one, which saves creating a process and a context for each
+    test. All of the tests must want the same context (see
+    ShaderTest.context), batch_shader_tests() takes care of that.
+
+    shader_runner prints a "PIGLIT TEST: <index> - <file>" line before each
+    script, the output between two of those lines belongs to one test. If a
+    script ends the process, because it failed or crashed, shader_runner is
+    started again with the scripts that have not run yet.
+
+    With golden hashes, PIGLIT_GOLDEN_HASH_FILES lists the reference file
+    of each script that is run, in order, so that a test uses the same file
+    whether it is batched or not.
+
+    Arguments:
+    tests -- a list of (name, ShaderTest) pairs
+
+    """
+    _match_marker = re.compile(r'^PIGLIT TEST: (?P<index>\d+) - ',
+                               re.MULTILINE)
+    _match_result = re.compile(r'^PIGLIT: {"result"', re.MULTILINE)
+
+    def __init__(self, tests):
+        assert len(tests) > 1
+        self.tests = tests
+        super(MultiShaderTest, self).__init__(
+            [tests[0][1].command[0]], run_concurrent=True)
+        self.env = dict(tests[0][1].env)
+
     @PiglitBaseTest.command.getter
     def command(self):
         """ Add -auto to the test command """
         return self._command + ['-auto']
+
+    def execute(self, path, log, dmesg, monitoring):
+        """Run the tests, and log a result for each of them.
+
+        Unlike Test.execute this takes the LogManager rather than a log, since
+        there is a log entry for each test.
+
+        """
+        logs = []
+        for name, _ in self.tests:
+            logs.append(log.get())
+            logs[-1].start(name)
+
+        try:
+            self.run()
+        # This is a rare case where a bare exception is okay, since we're
+        # using it to log exceptions
+        except:
+            exc_type, exc_value, exc_traceback = sys.exc_info()
+            traceback.print_exc(file=sys.stderr)
+            for _, test in self.tests:
+                if test.result.result == status.NOTRUN:
+                    test.result.result = 'fail'
+                    test.result.exception = "{}{}".format(exc_type,
+                                                           exc_value)
+                    test.result.traceback = "".join(
+                        traceback.format_tb(exc_traceback))
+
+        for l, (_, test) in six.moves.zip(logs, self.tests):
+            l.log(test.result.result)
+
+    def run(self):
+        pending = []
+        for name, test in self.tests:
+            test.result.command = ' '.join(test.command)
+            try:
+                test.is_skip()
+            except TestIsSkip as e:
+                test.result.result = 'skip'
+                test.result.out = e.reason
+                test.result.returncode = None
+            else:
+                pending.append((name, test))
+
+        while pending:
+            self._command = [self._command[0]] + \
+                [t.filename for _, t in pending]
+            if options.OPTIONS.golden_hashes:
+                self.env['PIGLIT_GOLDEN_HASH_FILES'] = os.pathsep.join(
+                    golden_hash_file(n) for n, _ in pending)
+            start = time.time()
+            try:
+                self._run_command()
+            except TestRunError as e:
+                for _, test in pending:
+                    test.result.result = six.text_type(e.status)
+                    test.result.out = six.text_type(e)
+                    test.result.returncode = None
+                return
+            done = self.__interpret(pending, start, time.time())
+            pending = pending[done:]
+
+    def __split(self, output):
+        """Split output at the markers, return a dict of index: output."""
+        chunks = {}
+        parts = self._match_marker.split(output)
+        for index, text in six.moves.zip(parts[1::2], parts[2::2]):
+            chunks[int(index)] = text.split('\n', 1)[-1]
+        return chunks
+
+    def __interpret(self, pending, start, end):
+        """Give each test run by the last process its part of the output.
+
+        Returns the number of tests that got a result.
+
+        """
+        returncode = self.result.returncode
+        out = self.__split(self.result.out)
+        err = self.__split(self.result.err)
+
+        if out:
+            ran = max(out) + 1
+        else:
+            # shader_runner stopped before it started the first script.
+            ran = 1
+            out = {0: self.result.out}
+            err = {0: self.result.err}
+
+        step = (end - start) / ran
+        for i, (_, test) in enumerate(pending[:ran]):
+            test.result.out = out.get(i, '')
+            test.result.err = err.get(i, '')
+            test.result.pid = self.result.pid
+            test.result.time.start = start + i * step
+            test.result.time.end = start + (i + 1) * step
+
+            # Only the last script can have ended the process, the return
+            # code belongs to it if it did not print a result or crashed.
+            if i == ran - 1 and (is_crash_returncode(returncode) or
+                                 not self._match_result.search(
+                                     test.result.out)):
+                test.result.returncode = returncode
+            else:
+                test.result.returncode = 0
+            test.interpret_result()
+
+        return ran
+
+    def interpret_result(self):
+        """Results are assigned to each test, nothing to do here."""
+        pass
+
+
+def batch_shader_tests(tests, size):
+    """Collect ShaderTests that want the same context into MultiShaderTests.
+
+    Tests are only batched with tests that have the same environment.
+
+    Yields (name, test) pairs, with tests that cannot be batched passed
+    through unmodified. The name of a MultiShaderTest is the name of its
+    first test.
+
+    Arguments:
+    tests -- an iterable of (name, Test) pairs
+    size -- the largest number of tests to put in one MultiShaderTest
+
+    """
+    def make(batch):
+        if len(batch) == 1:
+            return batch[0]
+        return batch[0][0], MultiShaderTest(batch)
+
+    batches = collections.OrderedDict()
+    for name, test in tests:
+        if type(test) is not ShaderTest:  # pylint: disable=unidiomatic-typecheck
+            yield name, test
+            continue
+
+        key = (test.context, tuple(sorted(six.iteritems(test.env))))
+        batch = batches.setdefault(key, [])
+        batch.append((name, test))
+        if len(batch) == size:
+            yield make(batch)
+            del batches[key]
+
+    for batch in six.itervalues(batches):
+        yield make(batch)
@@ -0,0 +1,225 @@
+# Copyright (c) 2017 The Piglit project
+
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Runs tests in children of piglit-zygote.
+
+piglit-zygote (see tests/util/piglit-zygote.c) loads the piglit util library
+and the GL libraries once, then forks a child for each test that runs the
+test's module, built with PIGLIT_BUILD_ZYGOTE, instead of starting the test
+binary. This module starts a zygote for a run, with started(), and talks to
+it over a unix socket.
+
+"""
+
+from __future__ import (
+    absolute_import, division, print_function, unicode_literals
+)
+import contextlib
+import os
+import select
+import shutil
+import socket
+import subprocess
+import tempfile
+import time
+
+import six
+
+from framework import exceptions
+
+__all__ = [
+    'Zygote',
+    'ZygoteError',
+    'ZygoteTimeout',
+    'ZygoteUnreachable',
+    'get',
+    'started',
+]
+
+_ZYGOTE = None
+
+
+class ZygoteError(exceptions.PiglitException):
+    """The zygote went away or didn't understand the request."""
+
+
+class ZygoteUnreachable(ZygoteError):
+    """The zygote can't be reached, the test didn't start."""
+
+
+class ZygoteTimeout(exceptions.PiglitException):
+    """The test ran for longer than its timeout, and was killed."""
+
+
+class _Reader(object):
+    """Reads the zygote's reply, raising ZygoteTimeout after the deadline."""
+    def __init__(self, sock, deadline):
+        self.__sock = sock
+        self.__deadline = deadline
+        self.__buf = b''
+
+    def __fill(self):
+        if self.__deadline is not None:
+            left = self.__deadline - time.time()
+            if left <= 0:
+                raise ZygoteTimeout()
+            self.__sock.settimeout(left)
+        try:
+            data = self.__sock.recv(65536)
+        except socket.timeout:
+            raise ZygoteTimeout()
+        if not data:
+            raise ZygoteError('piglit-zygote closed the connection')
+        self.__buf += data
+
+    def line(self):
+        """Return the next line, without the newline, split into words."""
+        while b'\n' not in self.__buf:
+            self.__fill()
+        line, self.__buf = self.__buf.split(b'\n', 1)
+        return line.decode('ascii').split()
+
+    def read(self, size):
+        """Return the next size bytes."""
+        while len(self.__buf) < size:
+            self.__fill()
+        data, self.__buf = self.__buf[:size], self.__buf[size:]
+        return data
+
+
+class Zygote(object):
+    """A running piglit-zygote.
+
+    Arguments:
+    binary -- the piglit-zygote executable
+    env -- the environment to start it in, which is the environment the GL
+           libraries are loaded in
+
+    """
+    # Seconds to wait for piglit-zygote to load the libraries and say it is
+    # ready
+    START_TIMEOUT = 60
+
+    def __init__(self, binary, env=None):
+        self.__dir = tempfile.mkdtemp(prefix='piglit-zygote')
+        self.path = os.path.join(self.__dir, 'socket')
+        try:
+            self.__proc = subprocess.Popen([binary, self.path],
+                                           stdout=subprocess.PIPE, env=env)
+        except OSError as e:
+            shutil.rmtree(self.__dir)
+            raise exceptions.PiglitFatalError(
+                'Cannot start {}: {}'.format(binary, e))
+
+        if not self.__wait_ready():
+            self.stop()
+            raise exceptions.PiglitFatalError(
+                '{} failed to start'.format(binary))
+
+    def __wait_ready(self):
+        """Return whether the zygote said it is ready within START_TIMEOUT.
+
+        The first line is read from the pipe directly, since readline()
+        would wait forever on a zygote that hangs.
+
+        """
+        deadline = time.time() + self.START_TIMEOUT
+        fd = self.__proc.stdout.fileno()
+        line = b''
+        while not line.endswith(b'\n'):
+            left = deadline - time.time()
+            if left <= 0 or not select.select([fd], [], [], left)[0]:
+                return False
+            data = os.read(fd, 64)
+            if not data:
+                return False
+            line += data
+        return line.startswith(b'ready')
+
+    def stop(self):
+        """Stop the zygote. Tests that are still running are not killed."""
+        if self.__proc.poll() is None:
+            self.__proc.terminate()
+        self.__proc.wait()
+        self.__proc.stdout.close()
+        shutil.rmtree(self.__dir, ignore_errors=True)
+
+    def run(self, module, command, env, cwd=None, timeout=None):
+        """Run a test in a child of the zygote.
+
+        Returns (pid, returncode, out, err) as Popen would have, the
+        returncode is negative if the test was killed by a signal. Raises
+        ZygoteTimeout if the test is still running after timeout seconds,
+        after killing it along with its process group. Raises
+        ZygoteUnreachable if the test couldn't be started, because the
+        zygote is gone, and ZygoteError if it went away during the test.
+
+        Arguments:
+        module -- the module built from the test's sources
+        command -- the test's command line, command[0] is the test binary,
+                   which is run if the module can't be loaded
+        env -- the test's full environment, as a dict
+
+        """
+        fields = ([module, cwd or os.getcwd(), six.text_type(len(command))] +
+                  list(command) +
+                  ['{}={}'.format(k, v) for k, v in six.iteritems(env)])
+        payload = b''.join(six.text_type(f).encode('utf-8') + b'\0'
+                           for f in fields)
+        deadline = time.time() + timeout if timeout else None
+
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            try:
+                sock.connect(self.path)
+                sock.sendall('{}\n'.format(len(payload)).encode('ascii') +
+                             payload)
+            except socket.error as e:
+                raise ZygoteUnreachable(
+                    'Cannot reach piglit-zygote: {}'.format(e))
+            reader = _Reader(sock, deadline)
+
+            pid = int(reader.line()[1])
+            _, returncode, outlen, errlen = reader.line()
+            out = reader.read(int(outlen))
+            err = reader.read(int(errlen))
+        finally:
+            # Closing the socket early kills the test
+            sock.close()
+
+        return (pid, int(returncode), out.decode('utf-8', 'replace'),
+                err.decode('utf-8', 'replace'))
+
+
+def get():
+    """Return the zygote started by started(), or None."""
+    return _ZYGOTE
+
+
+@contextlib.contextmanager
+def started(binary, env=None):
+    """Start a zygote that get() returns for the duration of the block."""
+    global _ZYGOTE  # pylint: disable=global-statement
+    _ZYGOTE = Zygote(binary, env)
+    try:
+        yield _ZYGOTE
+    finally:
+        _ZYGOTE.stop()
+        _ZYGOTE = None
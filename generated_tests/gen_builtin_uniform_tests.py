@@ -606,7 +606,7 @@ class ShaderTest(object):
         filename = self.filename()
         dirname = os.path.dirname(filename)
         utils.safe_makedirs(dirname)
-        with open(filename, 'w') as f:
+        with utils.open_if_changed(filename) as f:
             f.write(shader_test)
 
 
@@ -879,11 +879,13 @@ def main():
         action='store_true',
         help="Don't output files, just generate a list of filenames to stdout")
     options, args = parser.parse_args()
-    for test in all_tests():
+    def generate(test):
         if not options.names_only:
             test.generate_shader_test()
         print(test.filename())
 
+    utils.run_parallel(generate, all_tests())
+
 
 if __name__ == '__main__':
     main()
@@ -84,7 +84,7 @@ def main():
 
         print(name)
 
-        with open(name, 'w') as f:
+        with utils.open_if_changed(name) as f:
             f.write(TEMPLATE.render_unicode(
                 func='equal', input=x[0:2], expected=x[2]))
 
@@ -101,7 +101,7 @@ def main():
 
         print(name)
 
-        with open(name, 'w') as f:
+        with utils.open_if_changed(name) as f:
             f.write(TEMPLATE.render_unicode(
                 func='notEqual', input=x[0:2], expected=expected))
 
@@ -210,7 +210,7 @@ class ParserTest(object):
         filename = self.filename()
         dirname = os.path.dirname(filename)
         utils.safe_makedirs(dirname)
-        with open(filename, 'w') as f:
+        with utils.open_if_changed(filename) as f:
             f.write(parser_test)
 
 
@@ -269,11 +269,13 @@ def main():
                            "filenames to stdout")
     options, args = parser.parse_args()
 
-    for test in all_tests():
+    def generate(test):
         if not options.names_only:
             test.generate_parser_test()
         print(test.filename())
 
+    utils.run_parallel(generate, all_tests())
+
 
 if __name__ == '__main__':
     main()
@@ -387,7 +387,7 @@ class RegularTestTuple(TestTuple):
         self._filenames.append(filename)
 
         if not self._names_only:
-            with open(filename, 'w') as test_file:
+            with utils.open_if_changed(filename) as test_file:
                 test_file.write(TEMPLATES.get_template(
                     'compiler.{}.mako'.format(self._stage)).render_unicode(
                         ver=self._ver,
@@ -406,7 +406,7 @@ class RegularTestTuple(TestTuple):
         self._filenames.append(filename)
 
         if not self._names_only:
-            with open(filename, 'w') as test_file:
+            with utils.open_if_changed(filename) as test_file:
                 test_file.write(TEMPLATES.get_template(
                     'execution.{}.shader_test.mako'.format(self._stage)).render_unicode(
                         ver=self._ver,
@@ -532,7 +532,7 @@ class ZeroSignTestTuple(TestTuple):
         self._filenames.append(filename)
 
         if not self._names_only:
-            with open(filename, 'w') as test_file:
+            with utils.open_if_changed(filename) as test_file:
                 test_file.write(TEMPLATES.get_template(
                     'execution-zero-sign.{}.shader_test.mako'.format(
                         self._stage)).render_unicode(
@@ -66,7 +66,7 @@ def main():
                     vec='-ivec' if params.vec_type == 'ivec' else ''))
 
             print(name)
-            with open(name, 'w+') as f:
+            with utils.open_if_changed(name) as f:
                 f.write(TEMPLATE.render_unicode(params=params,
                                                 type=type_,
                                                 shader=shader))
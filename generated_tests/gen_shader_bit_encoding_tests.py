@@ -163,7 +163,7 @@ def main():
                     elif in_modifier_func == 'neg_abs':
                         in_modifier_func = '-abs'
 
-                    with open(filename, 'w') as f:
+                    with utils.open_if_changed(filename) as f:
                         f.write(TEMPLATE.render_unicode(
                             version=version,
                             extensions=extensions,
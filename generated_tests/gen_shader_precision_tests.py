@@ -59,6 +59,7 @@ import six
 from six.moves import range
 
 from templates import template_file
+from modules import utils
 
 
 
@@ -248,7 +249,7 @@ def main():
                 num_elements = signature.rettype.num_cols * signature.rettype.num_rows
                 invocation = signature.template.format( *['arg{0}'.format(i)
                                                         for i in range(len(signature.argtypes))])
-                with open(output_filename, 'w') as f:
+                with utils.open_if_changed(output_filename) as f:
                     f.write(template.render_unicode( signature=signature,
                                                      is_complex_tolerance=_is_sequence(tolerance),
                                                      complex_tol_type=signature.rettype,
@@ -45,6 +45,8 @@ import textwrap
 
 from six.moves import range
 
+from modules import utils
+
 
 class Test(object):
     def __init__(self, type_name, array, name):
@@ -281,7 +283,7 @@ class Test(object):
         dirname = os.path.dirname(filename)
         if not os.path.exists(dirname):
             os.makedirs(dirname)
-        with open(filename, 'w') as f:
+        with utils.open_if_changed(filename) as f:
             f.write(test)
 
 
@@ -108,7 +108,7 @@ def main():
                                                      file_extension))
                 print(filename)
 
-                with open(filename, "w") as f:
+                with utils.open_if_changed(filename) as f:
                     f.write(TEMPLATE.render_unicode(
                         version=requirement['version'],
                         extensions=requirements,
@@ -27,7 +27,7 @@ import itertools
 from six.moves import range
 
 from templates import template_dir
-from modules.utils import lazy_property, safe_makedirs
+from modules.utils import lazy_property, open_if_changed, safe_makedirs
 
 TEMPLATES = template_dir(os.path.basename(os.path.splitext(__file__)[0]))
 FS_TEMPLATE = TEMPLATES.get_template('fs.shader_test.mako')
@@ -149,7 +149,7 @@ def make_fs(name, params):
     """Generate a fragment shader test."""
     dirname = DIRNAME.format(params.formated_version)
     safe_makedirs(dirname)
-    with open(os.path.join(dirname, name), 'w') as f:
+    with open_if_changed(os.path.join(dirname, name)) as f:
         f.write(FS_TEMPLATE.render_unicode(params=params))
     print(name)
 
@@ -158,7 +158,7 @@ def make_vs(name, params):
     """Generate a vertex shader test."""
     dirname = DIRNAME.format(params.formated_version)
     safe_makedirs(dirname)
-    with open(os.path.join(dirname, name), 'w') as f:
+    with open_if_changed(os.path.join(dirname, name)) as f:
         f.write(VS_TEMPLATE.render_unicode(params=params))
     print(name)
 
@@ -53,7 +53,7 @@ def main():
         for target in targets_1:
             fname = os.path.join(dirname,
                                  "{}-{:0>2d}.txt".format(inst.lower(), i))
-            with open(fname, 'w') as f:
+            with utils.open_if_changed(fname) as f:
                 f.write(template.render_unicode(target=target, inst=inst))
             print(fname)
             i += 1
@@ -62,7 +62,7 @@ def main():
         for target in targets_1:
             fname = os.path.join(dirname,
                                  "{}-{:0>2d}.txt".format(inst.lower(), i))
-            with open(fname, 'w') as f:
+            with utils.open_if_changed(fname) as f:
                 f.write(template.render_unicode(target=target, inst=inst))
             print(fname)
             i += 1
@@ -71,14 +71,14 @@ def main():
         for target in ["CUBE", "RECT"]:
             fname = os.path.join(dirname,
                                  "{}-{:0>2d}.txt".format(inst.lower(), i))
-            with open(fname, 'w') as f:
+            with utils.open_if_changed(fname) as f:
                 f.write(template.render_unicode(target=target, inst=inst))
             print(fname)
             i += 1
 
         template = TEMPLATES.get_template('nvvp3.mako')
         fname = os.path.join(dirname, "{}-{:0>2d}.txt".format(inst.lower(), i))
-        with open(fname, 'w') as f:
+        with utils.open_if_changed(fname) as f:
             f.write(template.render_unicode(target="SHADOWRECT", inst=inst))
         print(fname)
         i += 1
@@ -87,7 +87,7 @@ def main():
         for target in ["SHADOW1D", "SHADOW2D", "SHADOWRECT"]:
             fname = os.path.join(dirname,
                                  "{}-{:0>2d}.txt".format(inst.lower(), i))
-            with open(fname, 'w') as f:
+            with utils.open_if_changed(fname) as f:
                 f.write(template.render_unicode(target=target, inst=inst))
             print(fname)
             i += 1
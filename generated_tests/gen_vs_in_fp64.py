@@ -462,7 +462,7 @@ class RegularTestTuple(TestTuple):
         filename += '.shader_test'
 
         if not self._names_only:
-            with open(filename, 'w') as test_file:
+            with utils.open_if_changed(filename) as test_file:
                 test_file.write(TEMPLATES.get_template(
                     'regular.shader_test.mako').render_unicode(
                         ver=self._ver,
@@ -517,7 +517,7 @@ class ColumnsTestTuple(TestTuple):
         filename += '.shader_test'
 
         if not self._names_only:
-            with open(filename, 'w') as test_file:
+            with utils.open_if_changed(filename) as test_file:
                 test_file.write(TEMPLATES.get_template(
                     'columns.shader_test.mako').render_unicode(
                         ver=self._ver,
@@ -541,9 +541,10 @@ def main():
         help="Don't output files, just generate a list of filenames to stdout")
     args = parser.parse_args()
 
-    for test in itertools.chain(RegularTestTuple.all_tests(args.names_only),
-                                ColumnsTestTuple.all_tests(args.names_only)):
-        test.generate()
+    utils.run_parallel(
+        lambda test: test.generate(),
+        itertools.chain(RegularTestTuple.all_tests(args.names_only),
+                        ColumnsTestTuple.all_tests(args.names_only)))
 
 
 if __name__ == '__main__':
@@ -3,6 +3,8 @@ import os
 
 import six
 
+from modules import utils
+
 __all__ = ['gen', 'DATA_SIZES', 'MAX_VALUES', 'MAX', 'MIN', 'BMIN', 'BMAX',
            'SMIN', 'SMAX', 'UMIN', 'UMAX', 'TYPE', 'T', 'U', 'B']
 
@@ -436,7 +438,7 @@ def gen(types, minVersions, functions, testDefs, dirName):
 
             fileName = os.path.join(dirName, fileName)
 
-            f = open(fileName, 'w')
+            f = utils.open_if_changed(fileName)
             print(fileName)
             # Write the file header
             f.write('/*!\n' +
@@ -480,4 +482,4 @@ def gen(types, minVersions, functions, testDefs, dirName):
             # Generate the actual kernels
             generate_kernels(f, dataType, fnName, functionDef)
 
-        f.close()
+            f.close()
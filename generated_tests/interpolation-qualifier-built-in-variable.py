@@ -78,7 +78,7 @@ def make_fs_vs_tests(fs_mode, vs_mode, dirname):
                 VS_TO_FS_VARIABLE_MAP[var]))
         print(filename)
 
-        with open(filename, 'w') as f:
+        with utils.open_if_changed(filename) as f:
             f.write(TEMPLATES.get_template('vs-fs.shader_test.mako').render_unicode(
                 vs_mode=vs_mode,
                 vs_variable=var,
@@ -98,7 +98,7 @@ def make_vs_unused_tests(vs_mode, dirname):
                 VS_TO_FS_VARIABLE_MAP[var]))
         print(filename)
 
-        with open(filename, 'w') as f:
+        with utils.open_if_changed(filename) as f:
             f.write(
                 TEMPLATES.get_template('vs-unused.shader_test.mako').render_unicode(
                     vs_mode=vs_mode,
@@ -117,7 +117,7 @@ def make_fs_unused_tests(fs_mode, vs_mode, dirname):
                 VS_TO_FS_VARIABLE_MAP[var]))
         print(filename)
 
-        with open(filename, 'w') as f:
+        with utils.open_if_changed(filename) as f:
             f.write(TEMPLATES.get_template('fs-unused.shader_test.mako').render_unicode(
                 vs_mode=vs_mode,
                 vs_variable=var,
@@ -137,7 +137,7 @@ def make_vs_fs_unused_tests(fs_mode, vs_mode, dirname):
                 VS_TO_FS_VARIABLE_MAP[var]))
         print(filename)
 
-        with open(filename, 'w') as f:
+        with utils.open_if_changed(filename) as f:
             f.write(TEMPLATES.get_template(
                 'fs-vs-unused.shader_test.mako').render_unicode(
                     vs_mode=vs_mode,
@@ -158,7 +158,7 @@ def make_vs_fs_flip_tests(fs_mode, vs_mode, dirname):
                 vs_mode, this_side, fs_mode, other_side))
         print(filename)
 
-        with open(filename, 'w') as f:
+        with utils.open_if_changed(filename) as f:
             f.write(TEMPLATES.get_template(
                 'vs-fs-flip.shader_test.mako').render_unicode(
                     vs_mode=vs_mode,
@@ -21,9 +21,25 @@
 """Helper functions for test generators."""
 
 from __future__ import print_function, absolute_import
-import os
+import collections
 import errno
 import functools
+import locale
+import multiprocessing
+import os
+import sys
+
+import six
+
+#: The number of processes run_parallel() uses. run_generator.py sets it,
+#: generators run on their own do everything in one process.
+JOBS = 1
+
+#: Counts of the files open_if_changed() wrote and left alone, by
+#: 'written' and 'unchanged'.
+FILES = collections.Counter()
+
+_PARALLEL = None
 
 
 def safe_makedirs(dirs):
@@ -65,3 +81,131 @@ class lazy_property(object):
         value = self.__func(obj)
         setattr(obj, self.__func.__name__, value)
         return value
+
+
+class _ChangedFile(object):
+    """The file-like object open_if_changed() returns."""
+    def __init__(self, filename, binary):
+        self.name = filename
+        self.closed = False
+        self.__binary = binary
+        self.__chunks = []
+
+    def write(self, data):
+        self.__chunks.append(data)
+
+    def writelines(self, lines):
+        self.__chunks.extend(lines)
+
+    def close(self):
+        if self.closed:
+            return
+        self.closed = True
+
+        data = (b'' if self.__binary else '').join(self.__chunks)
+        if not self.__binary:
+            data = data.replace('\n', os.linesep)
+            if isinstance(data, six.text_type):
+                data = data.encode(locale.getpreferredencoding(False))
+
+        try:
+            if os.path.getsize(self.name) == len(data):
+                with open(self.name, 'rb') as f:
+                    if f.read() == data:
+                        FILES['unchanged'] += 1
+                        return
+        except (IOError, OSError):
+            pass
+
+        with open(self.name, 'wb') as f:
+            f.write(data)
+        FILES['written'] += 1
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        # Leave the file alone rather than write half a test
+        if exc_type is None:
+            self.close()
+        self.closed = True
+
+
+def open_if_changed(filename, mode='w'):
+    """Open a file for writing, but only write it if its contents change.
+
+    Use it in place of open(filename, mode) for the files a generator
+    creates. What is written is kept in memory until the file is closed,
+    then compared with what the file already holds: the file is only
+    replaced if they differ, otherwise it is left alone, mtime and all.
+    Regenerating the tests then doesn't touch the tests that didn't change,
+    and what depends on their mtimes doesn't redo them.
+
+    mode is 'w' or 'wb' ('w+' is accepted for 'w'); the file can only be
+    written to.
+
+    """
+    assert mode in ('w', 'w+', 'wb'), mode
+    return _ChangedFile(filename, 'b' in mode)
+
+
+def _run_item(index):
+    """Run one item of run_parallel() in a worker process."""
+    func, items = _PARALLEL
+    before = FILES.copy()
+    stdout, sys.stdout = sys.stdout, six.moves.StringIO()
+    try:
+        func(items[index])
+        out = sys.stdout.getvalue()
+    finally:
+        sys.stdout = stdout
+    FILES.subtract(before)
+    return out, dict(FILES)
+
+
+def _pool(processes):
+    """Return a pool of processes forked from this one."""
+    try:
+        return multiprocessing.get_context('fork').Pool(processes)
+    except AttributeError:
+        # Python 2 forks on all the platforms that can
+        return multiprocessing.Pool(processes)
+
+
+def run_parallel(func, items):
+    """Call func(item) for each of items, across JOBS processes.
+
+    This is for the loop at the heart of a generator, where each call
+    renders and writes one or a few tests. Whatever func prints is printed
+    in the order of items, as if the calls were made one after the other,
+    so the list of files a generator prints doesn't change.
+
+    The worker processes are forked with func and items, so neither needs
+    to be picklable, but whatever func changes other than the files it
+    writes is lost. Without fork, or with JOBS of 1, the calls are made in
+    this process.
+
+    """
+    global _PARALLEL  # pylint: disable=global-statement
+
+    items = list(items)
+    if JOBS <= 1 or len(items) < 2 or not hasattr(os, 'fork'):
+        for item in items:
+            func(item)
+        return
+
+    # The workers would print whatever is still buffered again on exit
+    sys.stdout.flush()
+
+    _PARALLEL = (func, items)
+    pool = _pool(JOBS)
+    try:
+        for out, files in pool.imap(_run_item, range(len(items)),
+                                    max(1, len(items) // (JOBS * 8))):
+            sys.stdout.write(out)
+            FILES.update(files)
+        pool.close()
+    finally:
+        pool.terminate()
+        pool.join()
+        _PARALLEL = None
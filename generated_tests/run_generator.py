@@ -0,0 +1,83 @@
+# Copyright (c) 2017 The Piglit project
+
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Run a test generator for the build.
+
+The generator is run in this process as if it had been run on its own, its
+arguments are the ones that follow it and the list of files it prints goes
+to stdout. On top of that utils.run_parallel() uses --jobs processes, and
+once the generator is done a line with the time it took and the number of
+files it wrote and left unchanged is printed on stderr and, with --timing,
+written to a file.
+
+--jobs defaults to the number of CPUs, as a few generators take far longer
+than all the others and would otherwise hold up the build on their own.
+
+"""
+
+from __future__ import print_function, division, absolute_import
+import argparse
+import multiprocessing
+import os
+import runpy
+import sys
+import time
+
+from modules import utils
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument(
+        '-j', '--jobs',
+        type=int,
+        default=multiprocessing.cpu_count(),
+        help='Processes to spread the generation over (default: %(default)s)')
+    parser.add_argument(
+        '--timing',
+        metavar='<file>',
+        help='Also write the timing line to this file')
+    parser.add_argument('generator')
+    parser.add_argument('args', nargs=argparse.REMAINDER)
+    args = parser.parse_args()
+
+    utils.JOBS = args.jobs
+    sys.argv = [args.generator] + args.args
+    sys.path[0] = os.path.dirname(os.path.abspath(args.generator))
+
+    start = time.time()
+    try:
+        runpy.run_path(args.generator, run_name='__main__')
+    except SystemExit as e:
+        if e.code:
+            raise
+    sys.stdout.flush()
+
+    line = '{:8.2f}s {:6d} written {:6d} unchanged  {}'.format(
+        time.time() - start, utils.FILES['written'],
+        utils.FILES['unchanged'], os.path.basename(args.generator))
+    print(line, file=sys.stderr)
+    if args.timing:
+        with open(args.timing, 'w') as f:
+            print(line, file=f)
+
+
+if __name__ == '__main__':
+    main()
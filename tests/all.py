@@ -12,8 +12,8 @@ from six.moves import range
 
 from framework import grouptools
 from framework.profile import TestProfile
-from framework.test import (PiglitGLTest, GleanTest, ShaderTest,
-                            GLSLParserTest, GLSLParserNoConfigError)
+from framework.profile_index import add_shader_tests
+from framework.test import PiglitGLTest, GleanTest
 from .py_modules.constants import TESTS_DIR, GENERATED_TESTS_DIR
 
 __all__ = ['profile']
@@ -213,33 +213,10 @@ def power_set(s):
 # Collecting all tests
 profile = TestProfile()  # pylint: disable=invalid-name
 
-# Find and add all shader tests.
+# Find and add all shader tests. They are only created when they are looked
+# up, see framework.profile_index.
 for basedir in [TESTS_DIR, GENERATED_TESTS_DIR]:
-    for dirpath, _, filenames in os.walk(basedir):
-        for filename in filenames:
-            testname, ext = os.path.splitext(filename)
-            if ext == '.shader_test':
-                test = ShaderTest(os.path.join(dirpath, filename))
-            elif ext in ['.vert', '.tesc', '.tese', '.geom', '.frag', '.comp']:
-                try:
-                    test = GLSLParserTest(os.path.join(dirpath, filename))
-                except GLSLParserNoConfigError:
-                    # In the event that there is no config assume that it is a
-                    # legacy test, and continue
-                    continue
-
-                # For glslparser tests you can have multiple tests with the
-                # same name, but a different stage, so keep the extension.
-                testname = filename
-            else:
-                continue
-
-            group = grouptools.join(
-                grouptools.from_path(os.path.relpath(dirpath, basedir)),
-                testname)
-            assert group not in profile.test_list, group
-
-            profile.test_list[group] = test
+    add_shader_tests(profile.test_list, basedir)
 
 # Collect and add all asmparsertests
 for basedir in [TESTS_DIR, GENERATED_TESTS_DIR]:
@@ -469,7 +446,8 @@ glean_vp_tests = ['ABS test',
                   'State reference test 2 (light products)',
                   'State reference test 3 (fog params)',
                   'Divide by zero test',
-                  'Infinity and nan test']
+                  'Infinity and nan test',
+                  'Bad program test']
 
 for pairs in [(['glsl1'], glean_glsl_tests),
               (['fragProg1'], glean_fp_tests),
@@ -1019,6 +997,7 @@ with profile.group_manager(
       'tex-miplevel-selection')
     g(['tex-miplevel-selection', '-nobias'], 'tex-miplevel-selection-lod')
     g(['tex-miplevel-selection'], 'tex-miplevel-selection-lod-bias')
+    g(['texref-selftest'])
 
 with profile.group_manager(
         PiglitGLTest,
@@ -3223,6 +3202,9 @@ with profile.group_manager(
         PiglitGLTest,
         grouptools.join('spec', 'ext_packed_float')) as g:
     g(['ext_packed_float-pack'], 'pack')
+    g(['packed-float-array-selftest'], 'packed-float-array-selftest')
+    g(['packed-float-array-selftest', '-exhaustive'],
+      'packed-float-array-selftest-exhaustive')
     g(['getteximage-invalid-format-for-packed-type'],
       'getteximage-invalid-format-for-packed-type')
     add_msaa_formats_tests(g, 'GL_EXT_packed_float')
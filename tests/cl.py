@@ -101,20 +101,26 @@ with profile.group_manager(PiglitCLTest, 'interop') as g:
     g(['cl-interop-egl_khr_cl_event2'], 'EGL_KHR_cl_event2')
 
 
-def add_program_test_dir(group, dirpath):
+def add_program_test_dir(group, dirpath, program_cache=True):
     for filename in os.listdir(dirpath):
         testname, ext = os.path.splitext(filename)
         if ext not in ['.cl', '.program_test']:
             continue
 
-        profile.test_list[grouptools.join(group, testname)] = PiglitCLTest(
+        test = PiglitCLTest(
             ['cl-program-tester', os.path.join(dirpath, filename)])
+        if not program_cache:
+            test.env['PIGLIT_NO_PROGRAM_CACHE'] = '1'
+        profile.test_list[grouptools.join(group, testname)] = test
 
 
+# The build tests are testing the compiler, don't let them skip it
 add_program_test_dir(grouptools.join('program', 'build'),
-                     os.path.join(TESTS_DIR, 'cl', 'program', 'build'))
+                     os.path.join(TESTS_DIR, 'cl', 'program', 'build'),
+                     program_cache=False)
 add_program_test_dir(grouptools.join('program', 'build', 'fail'),
-                     os.path.join(TESTS_DIR, 'cl', 'program', 'build', 'fail'))
+                     os.path.join(TESTS_DIR, 'cl', 'program', 'build', 'fail'),
+                     program_cache=False)
 add_program_test_dir(grouptools.join('program', 'execute'),
                      os.path.join(TESTS_DIR, 'cl', 'program', 'execute'))
 add_program_test_dir(grouptools.join('program', 'execute'),
@@ -32,6 +32,7 @@
 #include <math.h>
 #include <regex.h>
 #include <libgen.h>
+#include <ctype.h>
 
 #include "piglit-framework-cl-program.h"
 
@@ -63,6 +64,7 @@
 
 /* Values */
 #define REGEX_ARRAY_DELIMITER        "[[:space:]]+"
+#define ARRAY_DELIMITER_CHARS        " \f\n\r\t\v" /* [[:space:]] */
 #define REGEX_DEFINE_ARRAY(element)  "((" element REGEX_ARRAY_DELIMITER ")*" element ")"
 #define REGEX_NAN          "(nan|NAN|NaN)"
 #define REGEX_PNAN         "([+]?" REGEX_NAN ")"
@@ -283,6 +285,9 @@ size_t   global_offset[3] = {0, 0, 0};
 bool     local_work_size_null = false;
 bool     global_offset_null = true;
 
+// Print every mismatch, not just the first few
+bool     verbose = false;
+
 /* Helper functions */
 
 void
@@ -532,6 +537,9 @@ free_tests()
 		}
 		free(tests[i].args_out);
 	}
+
+	free(tests); tests = NULL;
+	num_tests = 0;
 }
 
 /* Strings */
@@ -566,6 +574,67 @@ free_dynamic_strs()
 		}
 
 		free(dynamic_strs);
+		dynamic_strs = NULL;
+		num_dynamic_strs = 0;
+	}
+}
+
+/* Regex cache */
+
+/*
+ * Compiled regexes, keyed by pattern and cflags.  The same patterns are
+ * matched against every line and every array element, and compiling one
+ * costs much more than matching it, so each is only compiled once.
+ *
+ * Patterns are looked up by address, so they must be string constants, like
+ * the REGEX_* defines.
+ */
+#define REGEX_CACHE_SIZE 256
+
+struct cached_regex {
+	const char* pattern;
+	int cflags;
+	regex_t r;
+};
+
+static struct cached_regex regex_cache[REGEX_CACHE_SIZE];
+
+static regex_t*
+get_regex(const char* pattern, int cflags)
+{
+	size_t i = ((uintptr_t)pattern / sizeof(void*) + cflags) % REGEX_CACHE_SIZE;
+	size_t probes;
+
+	for(probes = 0; probes < REGEX_CACHE_SIZE; probes++) {
+		struct cached_regex* entry = &regex_cache[i];
+
+		if(entry->pattern == pattern && entry->cflags == cflags) {
+			return &entry->r;
+		}
+		if(entry->pattern == NULL) {
+			if(regcomp(&entry->r, pattern, REG_EXTENDED | cflags)) {
+				return NULL;
+			}
+			entry->pattern = pattern;
+			entry->cflags = cflags;
+			return &entry->r;
+		}
+		i = (i + 1) % REGEX_CACHE_SIZE;
+	}
+
+	return NULL;
+}
+
+static void
+free_regex_cache(void)
+{
+	unsigned i;
+
+	for(i = 0; i < REGEX_CACHE_SIZE; i++) {
+		if(regex_cache[i].pattern != NULL) {
+			regfree(&regex_cache[i].r);
+			regex_cache[i].pattern = NULL;
+		}
 	}
 }
 
@@ -578,6 +647,7 @@ clean(const int argc,
 {
 	free_dynamic_strs();
 	free_tests();
+	free_regex_cache();
 }
 
 NORETURN void
@@ -585,6 +655,7 @@ exit_report_result(enum piglit_result result)
 {
 	free_dynamic_strs();
 	free_tests();
+	free_regex_cache();
 	piglit_report_result(result);
 }
 
@@ -598,24 +669,22 @@ regex_get_matches(const char* src,
                   int cflags)
 {
 	int errcode;
-	regex_t r;
+	regex_t* r;
 
-	/* Build regex */
-	errcode = regcomp(&r, pattern, REG_EXTENDED | cflags);
-	if(errcode) {
+	/* Get compiled regex */
+	r = get_regex(pattern, cflags);
+	if(r == NULL) {
 		fprintf(stderr, "Invalid regular expression: '%s'\n", pattern);
 		return false;
 	}
 
 	/* Match regex and if pmatch != NULL && size > 0 return matched */
 	if(pmatch == NULL || size == 0) {
-		errcode = regexec(&r, src, 0, NULL, 0);
+		errcode = regexec(r, src, 0, NULL, 0);
 	} else {
-		errcode = regexec(&r, src, size, pmatch, 0);
+		errcode = regexec(r, src, size, pmatch, 0);
 	}
 
-	regfree(&r);
-
 	return errcode == 0;
 }
 
@@ -662,12 +731,112 @@ regex_match(const char* src, const char* pattern)
 	return regex_get_matches(src, pattern, NULL, 0, REG_NEWLINE);
 }
 
+/*
+ * Hand written matchers for REGEX_LINE, REGEX_SECTION and REGEX_KEY_VALUE,
+ * which are run on every line of a config.  Each fills pmatch like
+ * regexec() would for a src of a single line.
+ */
+
+static bool
+is_word_char(char c) /* [[:alnum:]_] */
+{
+	return isalnum((unsigned char)c) || c == '_';
+}
+
+static const char*
+skip_space(const char* s)
+{
+	while(isspace((unsigned char)*s)) {
+		s++;
+	}
+	return s;
+}
+
+static const char*
+trim_space(const char* start, const char* end)
+{
+	while(end > start && isspace((unsigned char)end[-1])) {
+		end--;
+	}
+	return end;
+}
+
+/* src may continue past the line, which ends at a newline */
+static bool
+scan_line(const char* src, regmatch_t pmatch[2])
+{
+	pmatch[0].rm_so = pmatch[1].rm_so = 0;
+	pmatch[0].rm_eo = strcspn(src, "\n");
+	pmatch[1].rm_eo = strcspn(src, "#\n");
+
+	return true;
+}
+
+static bool
+scan_section(const char* src, regmatch_t pmatch[2])
+{
+	const char* s = skip_space(src);
+	const char* name;
+
+	if(*s != '[') {
+		return false;
+	}
+	name = s = skip_space(s+1);
+	while(is_word_char(*s) || isspace((unsigned char)*s)) {
+		s++;
+	}
+	if(*s != ']' || trim_space(name, s) == name) {
+		return false;
+	}
+
+	pmatch[1].rm_so = name - src;
+	pmatch[1].rm_eo = trim_space(name, s) - src;
+	s = skip_space(s+1);
+	pmatch[0].rm_so = 0;
+	pmatch[0].rm_eo = s - src;
+
+	return *s == '\0';
+}
+
+static bool
+scan_key_value(const char* src, regmatch_t pmatch[3])
+{
+	const char* s = skip_space(src);
+	const char* key = s;
+	const char* end;
+
+	while(is_word_char(*s)) {
+		s++;
+	}
+	if(s == key) {
+		return false;
+	}
+	pmatch[1].rm_so = key - src;
+	pmatch[1].rm_eo = s - src;
+
+	s = skip_space(s);
+	if(*s != ':') {
+		return false;
+	}
+	s = skip_space(s+1);
+	end = trim_space(s, s + strlen(s));
+	if(end == s || strcspn(s, "#\n") < (size_t)(end - s)) {
+		return false;
+	}
+	pmatch[2].rm_so = s - src;
+	pmatch[2].rm_eo = end - src;
+	pmatch[0].rm_so = 0;
+	pmatch[0].rm_eo = strlen(src);
+
+	return true;
+}
+
 bool
 regex_section(const char* src, char** section)
 {
 	regmatch_t pmatch[2];
 
-	if(regex_get_matches(src, REGEX_SECTION, pmatch, 2, REG_NEWLINE)) {
+	if(scan_section(src, pmatch)) {
 		return regex_get_match_str(section, src, pmatch, 1);
 	}
 
@@ -679,7 +848,7 @@ regex_key_value(const char* src, char** key, char** value)
 {
 	regmatch_t pmatch[3];
 
-	if(regex_get_matches(src, REGEX_KEY_VALUE, pmatch, 3, REG_NEWLINE)) {
+	if(scan_key_value(src, pmatch)) {
 		*key = NULL;
 		*value = NULL;
 		if(   regex_get_match_str(key, src, pmatch, 1)
@@ -694,12 +863,189 @@ regex_key_value(const char* src, char** key, char** value)
 	return false;
 }
 
+/*
+ * Scanners for values and arrays.  Arrays can have thousands of elements, so
+ * instead of running regexes on them these check the same grammars as
+ * REGEX_BOOL, REGEX_INT, REGEX_UINT, REGEX_FLOAT and REGEX_DEFINE_ARRAY() by
+ * hand.  Keep them in sync with the regexes.
+ *
+ * Each returns whether all of [s, end) matches.
+ */
+typedef bool scan_func_t(const char* s, const char* end);
+
+static bool
+scan_digits(const char* s, const char* end, bool hex)
+{
+	const char* start = s;
+
+	while(s < end &&
+	      (hex ? isxdigit((unsigned char)*s) : isdigit((unsigned char)*s))) {
+		s++;
+	}
+
+	return s != start && s == end;
+}
+
+static bool
+scan_words(const char* s, const char* end, const char* const* words)
+{
+	for(; *words != NULL; words++) {
+		if(   strlen(*words) == (size_t)(end - s)
+		   && !strncmp(s, *words, end - s)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static const char* const null_words[] = { "NULL", "null", NULL };
+static const char* const bool_words[] = { "0", "1", "false", "true", NULL };
+static const char* const nan_words[] = { "nan", "NAN", "NaN", NULL };
+static const char* const inf_words[] = {
+	"infinity", "INFINITY", "Infinity", "inf", "INF", "Inf", NULL
+};
+
+/* The part of REGEX_INT or REGEX_UINT after the sign */
+static bool
+scan_unsigned(const char* s, const char* end)
+{
+	if(end - s > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+		return scan_digits(s+2, end, true);
+	}
+	return scan_digits(s, end, false);
+}
+
+/* The decimal and hex parts of REGEX_FLOAT after the sign */
+static bool
+scan_float_number(const char* s, const char* end)
+{
+	if(end - s > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+		/* [[:digit:]abcdefABCDEF.]+[[:digit:]pP+-]* */
+		const char* start = s += 2;
+
+		while(s < end && (isxdigit((unsigned char)*s) || *s == '.')) {
+			s++;
+		}
+		if(s == start) {
+			return false;
+		}
+		while(s < end && (isdigit((unsigned char)*s) || strchr("pP+-", *s))) {
+			s++;
+		}
+		return s == end;
+	}
+
+	/* [[:digit:]]+(\.[[:digit:]]+)?e*[+-]*[[:digit:]]* */
+	if(s == end || !isdigit((unsigned char)*s)) {
+		return false;
+	}
+	while(s < end && isdigit((unsigned char)*s)) {
+		s++;
+	}
+	if(s < end && *s == '.') {
+		if(++s == end || !isdigit((unsigned char)*s)) {
+			return false;
+		}
+		while(s < end && isdigit((unsigned char)*s)) {
+			s++;
+		}
+	}
+	while(s < end && *s == 'e') {
+		s++;
+	}
+	while(s < end && (*s == '+' || *s == '-')) {
+		s++;
+	}
+	while(s < end && isdigit((unsigned char)*s)) {
+		s++;
+	}
+	return s == end;
+}
+
+static bool
+scan_null(const char* s, const char* end)
+{
+	return scan_words(s, end, null_words);
+}
+
+static bool
+scan_bool(const char* s, const char* end)
+{
+	return scan_words(s, end, bool_words);
+}
+
+static bool
+scan_uint(const char* s, const char* end)
+{
+	if(s < end && *s == '+') {
+		s++;
+	}
+	return scan_unsigned(s, end);
+}
+
+static bool
+scan_int(const char* s, const char* end)
+{
+	if(s < end && (*s == '+' || *s == '-')) {
+		s++;
+	}
+	return scan_unsigned(s, end);
+}
+
+static bool
+scan_float(const char* s, const char* end)
+{
+	if(s < end && (*s == '+' || *s == '-')) {
+		s++;
+	}
+	return   scan_words(s, end, nan_words)
+	      || scan_words(s, end, inf_words)
+	      || scan_float_number(s, end);
+}
+
+/*
+ * Whitespace separated elements that all match scan_element.  If they do,
+ * the number of elements is stored in length.
+ */
+static bool
+scan_array(const char* src, scan_func_t* scan_element, size_t* length)
+{
+	const char* s = src;
+	size_t n = 0;
+
+	while(true) {
+		const char* end = s + strcspn(s, ARRAY_DELIMITER_CHARS);
+
+		if(!scan_element(s, end)) {
+			return false;
+		}
+		n++;
+
+		if(*end == '\0') {
+			break;
+		}
+		s = end + strspn(end, ARRAY_DELIMITER_CHARS);
+		if(*s == '\0') {
+			return false;
+		}
+	}
+
+	*length = n;
+	return true;
+}
+
+static bool
+scan_str(const char* src, scan_func_t* scan)
+{
+	return scan(src, src + strlen(src));
+}
+
 bool
 get_bool(const char* src)
 {
-	if(regex_match(src, REGEX_FULL_MATCH(REGEX_BOOL_TRUE))) {
+	if(!strcmp(src, "1") || !strcmp(src, "true")) {
 		return true;
-	} else if(regex_match(src, REGEX_FULL_MATCH(REGEX_BOOL_FALSE))) {
+	} else if(!strcmp(src, "0") || !strcmp(src, "false")) {
 		return false;
 	} else {
 		fprintf(stderr,
@@ -713,9 +1059,9 @@ get_bool(const char* src)
 int64_t
 get_int(const char* src)
 {
-	if(regex_match(src, REGEX_FULL_MATCH(REGEX_UINT))) {
+	if(scan_str(src, scan_uint)) {
 		return strtoull(src, NULL, 0);
-	} else if(regex_match(src, REGEX_FULL_MATCH(REGEX_INT))) {
+	} else if(scan_str(src, scan_int)) {
 		return strtoll(src, NULL, 0);
 	} else {
 		fprintf(stderr,
@@ -729,7 +1075,7 @@ get_int(const char* src)
 uint64_t
 get_uint(const char* src)
 {
-	if(regex_match(src, REGEX_FULL_MATCH(REGEX_UINT))) {
+	if(scan_str(src, scan_uint)) {
 		return strtoull(src, NULL, 0);
 	} else {
 		fprintf(stderr,
@@ -743,15 +1089,14 @@ get_uint(const char* src)
 double
 get_float(const char* src)
 {
-	if(regex_match(src, REGEX_FULL_MATCH(REGEX_FLOAT))) {
-		if(regex_match(src, REGEX_FULL_MATCH(REGEX_PNAN))) {
-			return NAN;
-		} else if(regex_match(src, REGEX_FULL_MATCH(REGEX_NNAN))) {
-			return -NAN;
-		} else if(regex_match(src, REGEX_FULL_MATCH(REGEX_PINF))) {
-			return INFINITY;
-		} else if(regex_match(src, REGEX_FULL_MATCH(REGEX_NINF))) {
-			return -INFINITY;
+	const char* s = (src[0] == '+' || src[0] == '-') ? src+1 : src;
+	const char* end = src + strlen(src);
+
+	if(scan_float(src, end)) {
+		if(scan_words(s, end, nan_words)) {
+			return src[0] == '-' ? -NAN : NAN;
+		} else if(scan_words(s, end, inf_words)) {
+			return src[0] == '-' ? -INFINITY : INFINITY;
 		} else {
 			return strtod(src, NULL);
 		}
@@ -764,26 +1109,27 @@ get_float(const char* src)
 	}
 }
 
+/* REGEX_FULL_MATCH(REGEX_ARRAY) */
+static bool
+scan_any_array(const char* src, size_t* length)
+{
+	if(scan_str(src, scan_null)) {
+		*length = 0;
+		return true;
+	}
+
+	return   scan_array(src, scan_bool, length)
+	      || scan_array(src, scan_int, length)
+	      || scan_array(src, scan_uint, length)
+	      || scan_array(src, scan_float, length);
+}
+
 size_t
 get_array_length(const char* src)
 {
 	size_t size = 0;
 
-	if(regex_match(src, REGEX_FULL_MATCH(REGEX_ARRAY))) {
-		regmatch_t pmatch[1];
-
-		while(regex_get_matches(src,
-		                        REGEX_ARRAY_VALUE REGEX_ARRAY_DELIMITER,
-		                        pmatch,
-		                        1,
-		                        REG_NEWLINE)) {
-			src += pmatch[0].rm_eo;
-			size++;
-		}
-		if(regex_match(src, REGEX_ARRAY_VALUE)) {
-			size++;
-		}
-	} else {
+	if(!scan_any_array(src, &size)) {
 		fprintf(stderr,
 		        "Invalid configuration, could not convert to an array: %s\n",
 		        src);
@@ -797,35 +1143,37 @@ size_t
 get_array(const char* src, void** array, size_t size, char* array_pattern)
 {
 	bool regex_matched;
-	size_t i = 0;
+	size_t i;
 	size_t actual_size;
 	char* type;
 	char* value;
-	char* value_pattern;
-	regmatch_t pmatch[2];
+	char* elements;
+	char* saveptr;
+	size_t length;
+	scan_func_t* scan = NULL;
 
 	actual_size = get_array_length(src);
 
 	if(!strcmp(array_pattern, REGEX_BOOL_ARRAY)) {
 		type = "bool";
-		value_pattern = REGEX_BOOL REGEX_ARRAY_DELIMITER;
 		*(bool**)array = malloc(actual_size * sizeof(bool));
-		regex_matched = regex_match(src, REGEX_FULL_MATCH(REGEX_BOOL_ARRAY));
+		scan = scan_bool;
+		regex_matched = scan_array(src, scan, &length);
 	} else if(!strcmp(array_pattern, REGEX_INT_ARRAY)) {
 		type = "long";
-		value_pattern = REGEX_INT REGEX_ARRAY_DELIMITER;
 		*(int64_t**)array = malloc(actual_size * sizeof(int64_t));
-		regex_matched = regex_match(src, REGEX_FULL_MATCH(REGEX_INT_ARRAY));
+		scan = scan_int;
+		regex_matched = scan_array(src, scan, &length);
 	} else if(!strcmp(array_pattern, REGEX_UINT_ARRAY)) {
 		type = "ulong";
-		value_pattern = REGEX_UINT REGEX_ARRAY_DELIMITER;
 		*(uint64_t**)array = malloc(actual_size * sizeof(uint64_t));
-		regex_matched = regex_match(src, REGEX_FULL_MATCH(REGEX_UINT_ARRAY));
+		scan = scan_uint;
+		regex_matched = scan_array(src, scan, &length);
 	} else if(!strcmp(array_pattern, REGEX_FLOAT_ARRAY)) {
 		type = "double";
-		value_pattern = REGEX_FLOAT REGEX_ARRAY_DELIMITER;
 		*(double**)array = malloc(actual_size * sizeof(double));
-		regex_matched = regex_match(src, REGEX_FULL_MATCH(REGEX_FLOAT_ARRAY));
+		scan = scan_float;
+		regex_matched = scan_array(src, scan, &length);
 	} else {
 		fprintf(stderr,
 		        "Internal error, invalid array pattern: %s\n",
@@ -840,7 +1188,7 @@ get_array(const char* src, void** array, size_t size, char* array_pattern)
 		exit_report_result(PIGLIT_WARN);
 	}
 
-	if(regex_match(src, REGEX_FULL_MATCH(REGEX_NULL))) {
+	if(scan_str(src, scan_null)) {
 		free(*array);
 		*array = NULL;
 		return 0;
@@ -853,38 +1201,22 @@ get_array(const char* src, void** array, size_t size, char* array_pattern)
 		exit_report_result(PIGLIT_WARN);
 	}
 
-	while(regex_get_matches(src, value_pattern, pmatch, 2, 0)) {
-		if(regex_get_match_str(&value, src, pmatch, 1)) {
-			if(!strcmp(array_pattern, REGEX_BOOL_ARRAY)) {
-				(*(bool**)array)[i] = get_bool(value);
-			} else if(!strcmp(array_pattern, REGEX_INT_ARRAY)) {
-				(*(int64_t**)array)[i] = get_int(value);
-			} else if(!strcmp(array_pattern, REGEX_UINT_ARRAY)) {
-				(*(uint64_t**)array)[i] = get_uint(value);
-			} else if(!strcmp(array_pattern, REGEX_FLOAT_ARRAY)) {
-				(*(double**)array)[i] = get_float(value);
-			}
-			free(value);
-		} else {
-			fprintf(stderr,
-			        "Invalid configuration, could not read %s on index %zu: %s\n",
-			        type, i, src);
-			exit_report_result(PIGLIT_WARN);
+	/* The array matched, so its elements are separated by whitespace */
+	elements = strdup(src);
+	for(i = 0, value = strtok_r(elements, ARRAY_DELIMITER_CHARS, &saveptr);
+	    value != NULL;
+	    i++, value = strtok_r(NULL, ARRAY_DELIMITER_CHARS, &saveptr)) {
+		if(scan == scan_bool) {
+			(*(bool**)array)[i] = get_bool(value);
+		} else if(scan == scan_int) {
+			(*(int64_t**)array)[i] = get_int(value);
+		} else if(scan == scan_uint) {
+			(*(uint64_t**)array)[i] = get_uint(value);
+		} else if(scan == scan_float) {
+			(*(double**)array)[i] = get_float(value);
 		}
-
-		src += pmatch[0].rm_eo;
-		i++;
-	}
-
-	if(!strcmp(array_pattern, REGEX_BOOL_ARRAY)) {
-		(*(bool**)array)[i] = get_bool(src);
-	} else if(!strcmp(array_pattern, REGEX_INT_ARRAY)) {
-		(*(int64_t**)array)[i] = get_int(src);
-	} else if(!strcmp(array_pattern, REGEX_UINT_ARRAY)) {
-		(*(uint64_t**)array)[i] = get_uint(src);
-	} else if(!strcmp(array_pattern, REGEX_FLOAT_ARRAY)) {
-		(*(double**)array)[i] = get_float(src);
 	}
+	free(elements);
 
 	return actual_size;
 }
@@ -921,13 +1253,18 @@ print_usage(const int argc, const char** argv)
 	printf("Usage:\n" \
 	       "  %s [options] CONFIG.program_test\n"
 	       "  %s [options] [-config CONFIG.program_test] PROGRAM.cl|PROGRAM.bin\n"
+	       "  %s -parse-benchmark REPEAT CONFIG.program_test...\n"
 	       "\n"
 	       "Notes:\n"
 	       "  - If CONFIG is not specified and PROGRAM has a comment config then a\n"
 	       "    comment config is used.\n"
 	       "  - If there is no CONFIG or comment config, then the program is only\n"
-	       "    tested to build properly.\n",
-	       argv[0], argv[0]);
+	       "    tested to build properly.\n"
+	       "  - -parse-benchmark only parses each CONFIG REPEAT times and prints\n"
+	       "    how long it took, without running anything.\n"
+	       "  - When PIGLIT_CL_VERBOSE is set every value that doesn't match is\n"
+	       "    printed, instead of the first few.\n",
+	       argv[0], argv[0], argv[0]);
 }
 
 void
@@ -1097,18 +1434,19 @@ get_test_arg(const char* src, struct test* test, bool arg_in)
 	struct test_arg test_arg = create_test_arg();
 	bool has_type = true;
 
-	/* Get matches */
+	/* Get matches, and remember which one so they aren't matched again */
 	if(regex_get_matches(src, REGEX_FULL_MATCH(REGEX_ARG_VALUE),
 	                     pmatch, 5, REG_NEWLINE)) { // value
-		// do nothing
+		test_arg.type = TEST_ARG_VALUE;
 	} else if(regex_get_matches(src, REGEX_FULL_MATCH(REGEX_ARG_BUFFER),
 	                            pmatch, 5, REG_NEWLINE)) { // buffer
-		// do nothing
+		test_arg.type = TEST_ARG_BUFFER;
 	} else if(regex_get_matches(src, REGEX_FULL_MATCH(REGEX_ARG_IMAGE),
 	                            pmatch, 5, REG_NEWLINE)) { // image
-		// do nothing
+		test_arg.type = TEST_ARG_IMAGE;
 	} else if(regex_get_matches(src, REGEX_FULL_MATCH(REGEX_ARG_SAMPLER),
 	                            pmatch, 5, REG_NEWLINE)) { // sampler
+		test_arg.type = TEST_ARG_SAMPLER;
 		has_type = false;
 	} else {
 		fprintf(stderr,
@@ -1162,7 +1500,7 @@ get_test_arg(const char* src, struct test* test, bool arg_in)
 	}
 
 	/* Get arg type, size and value */
-	if(regex_match(src, REGEX_FULL_MATCH(REGEX_ARG_VALUE))) { // value
+	if(test_arg.type == TEST_ARG_VALUE) { // value
 		/* Values are only allowed for in arguments */
 		if(!arg_in) {
 			fprintf(stderr,
@@ -1185,7 +1523,7 @@ get_test_arg(const char* src, struct test* test, bool arg_in)
 			get_test_arg_value(&test_arg, value, test_arg.cl_size);
 		}
 		free(value);
-	} else if(regex_match(src, REGEX_FULL_MATCH(REGEX_ARG_BUFFER))) { // buffer
+	} else if(test_arg.type == TEST_ARG_BUFFER) { // buffer
 		char* array_length_str = NULL;
 		const char* tolerance_str = NULL;
 
@@ -1250,7 +1588,7 @@ get_test_arg(const char* src, struct test* test, bool arg_in)
 			}
 		}
 		free(value);
-	} else if(regex_match(src, REGEX_FULL_MATCH(REGEX_ARG_IMAGE))) { // image
+	} else if(test_arg.type == TEST_ARG_IMAGE) { // image
 		char* str = NULL;
 		const char* properties_str = src + pmatch[3].rm_eo;
 		const char* tolerance_str = NULL;
@@ -1439,7 +1777,7 @@ get_test_arg(const char* src, struct test* test, bool arg_in)
 		}
 		free(value);
 
-	} else if(regex_match(src, REGEX_FULL_MATCH(REGEX_ARG_SAMPLER))) { // sampler
+	} else if(test_arg.type == TEST_ARG_SAMPLER) { // sampler
 		char* str = NULL;
 
 		/* Samplers are only allowed for in arguments */
@@ -1564,11 +1902,11 @@ parse_config(const char* config_str,
 	/* parse config string by each line */
 	pch = config_str;
 	while(pch < (config_str+length)) {
-		regmatch_t pmatch[2];
+		regmatch_t pmatch[3];
 		size_t line_length;
 
 		/* Get line */
-		regex_get_matches(pch, REGEX_LINE, pmatch, 2, REG_NEWLINE);
+		scan_line(pch, pmatch);
 		line_length = pmatch[0].rm_eo - pmatch[0].rm_so;
 		if(!regex_get_match_str(&line, pch, pmatch, 1)) {
 			/* Line is empty */
@@ -1577,7 +1915,7 @@ parse_config(const char* config_str,
 		}
 
 		/* Get more lines if it is a multiline */
-		if(   regex_match(line, REGEX_KEY_VALUE)
+		if(   scan_key_value(line, pmatch)
 		   && regex_match(line, REGEX_MULTILINE)) {
 			char* multiline = malloc(sizeof(char));
 			multiline[0] = '\0';
@@ -1590,7 +1928,7 @@ parse_config(const char* config_str,
 				char* new_multiline;
 
 				/* Get line */
-				regex_get_matches(pch, REGEX_LINE, pmatch, 2, REG_NEWLINE);
+				scan_line(pch, pmatch);
 				line_length = pmatch[0].rm_eo - pmatch[0].rm_so;
 				if(!regex_get_match_str(&line, pch, pmatch, 1)) {
 					/* Line is empty */
@@ -1862,6 +2200,52 @@ get_comment_config_str(const char* src)
 	return NULL;
 }
 
+/* Time parsing configs, for -parse-benchmark */
+
+NORETURN void
+parse_benchmark(const int argc,
+                const char** argv,
+                const struct piglit_cl_program_test_config* config)
+{
+	unsigned int repeat = strtoul(piglit_cl_get_arg_value(argc, argv,
+	                                                      "parse-benchmark"),
+	                              NULL, 0);
+	const char* config_file;
+	int64_t total = 0;
+	int i;
+
+	for(i = 0; (config_file = piglit_cl_get_unnamed_arg(argc, argv, i)); i++) {
+		unsigned int config_str_size;
+		char* config_str = piglit_load_text_file(config_file,
+		                                         &config_str_size);
+		int64_t start;
+		unsigned r;
+
+		if(config_str == NULL) {
+			print_usage_and_warn(argc, argv, "%s does not exist.",
+			                     config_file);
+		}
+
+		start = piglit_time_get_nano();
+		for(r = 0; r < repeat; r++) {
+			struct piglit_cl_program_test_config c = *config;
+
+			parse_config(config_str, &c);
+			free_tests();
+		}
+		start = piglit_time_get_nano() - start;
+		total += start;
+
+		printf("%s: %.3f ms\n", config_file,
+		       start / 1e6 / MAX2(repeat, 1));
+		free(config_str);
+	}
+
+	printf("%d configs: %.3f ms per parse of all of them\n",
+	       i, total / 1e6 / MAX2(repeat, 1));
+	exit_report_result(PIGLIT_PASS);
+}
+
 /* Init */
 
 void
@@ -1886,6 +2270,12 @@ init(const int argc,
 
 	int program_count = 0;
 
+	if(piglit_cl_is_arg_defined(argc, argv, "parse-benchmark")) {
+		parse_benchmark(argc, argv, config);
+	}
+
+	verbose = getenv("PIGLIT_CL_VERBOSE") != NULL;
+
 	/* Check if arguments are valid */
 	// valid main argument
 	if(main_argument == NULL) {
@@ -2054,136 +2444,523 @@ free_sampler_args(cl_sampler** sampler_args, unsigned int* num_sampler_args)
 	*num_sampler_args = 0;
 }
 
+/*
+ * Probe a single value of an argument, by its index in the array without
+ * padding, printing what was expected if it doesn't match.
+ */
+bool
+probe_test_arg_element(const struct test_arg* test_arg,
+                       const void* value,
+                       size_t ra)
+{
+	// offset from the beginning of buffer
+	size_t rb = ra / test_arg->cl_size * test_arg->cl_mem_size
+	            + ra % test_arg->cl_size;
+
+#define CASEI(enum_type, cl_type)                                          \
+	case enum_type:                                                        \
+		return piglit_cl_probe_integer(((const cl_type*)value)[rb],        \
+		                               ((cl_type*)test_arg->value)[rb],    \
+		                               test_arg->toli);
+#define CASEU(enum_type, cl_type)                                          \
+	case enum_type:                                                        \
+		return piglit_cl_probe_uinteger(((const cl_type*)value)[rb],       \
+		                                ((cl_type*)test_arg->value)[rb],   \
+		                                test_arg->tolu);
+#define CASEF(enum_type, cl_type)                                          \
+	case enum_type:                                                        \
+		return piglit_cl_probe_floating(((const cl_type*)value)[rb],       \
+		                                ((cl_type*)test_arg->value)[rb],   \
+		                                test_arg->ulp);
+
+	switch(test_arg->cl_type) {
+		CASEI(TYPE_CHAR,   cl_char)
+		CASEU(TYPE_UCHAR,  cl_uchar)
+		CASEI(TYPE_SHORT,  cl_short)
+		CASEU(TYPE_USHORT, cl_ushort)
+		CASEI(TYPE_INT,    cl_int)
+		CASEU(TYPE_UINT,   cl_uint)
+		CASEI(TYPE_LONG,   cl_long)
+		CASEU(TYPE_ULONG,  cl_ulong)
+		CASEF(TYPE_FLOAT,  cl_float)
+		CASEF(TYPE_DOUBLE, cl_double)
+	}
+
+#undef CASEF
+#undef CASEU
+#undef CASEI
+
+	return true;
+}
+
+/*
+ * Check an argument's value against what the test expects.
+ *
+ * The whole array is compared at once, and only the first few mismatches
+ * are printed, followed by how many there were.  With PIGLIT_CL_VERBOSE
+ * set every mismatch is printed.
+ */
 bool
 check_test_arg_value(struct test_arg test_arg,
                      void* value)
 {
-	size_t i; // index in array
-	size_t c; // component in element
-	size_t ra; // offset from the beginning of parsed array
-	size_t rb; // offset from the beginning of buffer
-
-#define CASEI(enum_type, type, cl_type)                                     \
-	case enum_type:                                                         \
-		for(i = 0; i < test_arg.length; i++) {                              \
-			for(c = 0; c < test_arg.cl_size; c++) {                         \
-				rb = i*test_arg.cl_mem_size + c;                            \
-				if(!piglit_cl_probe_integer(((cl_type*)value)[rb],          \
-				                            ((cl_type*)test_arg.value)[rb], \
-				                            test_arg.toli)) {               \
-					ra = i*test_arg.cl_size + c;                            \
-					printf("Error at %s[%zu]\n", type, ra);                 \
-					return false;                                           \
-				}                                                           \
-			}                                                               \
-		}                                                                   \
-		return true;
-#define CASEU(enum_type, type, cl_type)                                      \
-	case enum_type:                                                          \
-		for(i = 0; i < test_arg.length; i++) {                               \
-			for(c = 0; c < test_arg.cl_size; c++) {                          \
-				rb = i*test_arg.cl_mem_size + c;                             \
-				if(!piglit_cl_probe_uinteger(((cl_type*)value)[rb],          \
-				                             ((cl_type*)test_arg.value)[rb], \
-				                             test_arg.tolu)) {               \
-					ra = i*test_arg.cl_size + c;                             \
-					printf("Error at %s[%zu]\n", type, ra);                  \
-					return false;                                            \
-				}                                                            \
-			}                                                                \
-		}                                                                    \
-		return true;
-#define CASEF(enum_type, type, cl_type)                                      \
-	case enum_type:                                                          \
-		for(i = 0; i < test_arg.length; i++) {                               \
-			for(c = 0; c < test_arg.cl_size; c++) {                          \
-				rb = i*test_arg.cl_mem_size + c;                             \
-				if(!piglit_cl_probe_floating(((cl_type*)value)[rb],          \
-				                             ((cl_type*)test_arg.value)[rb], \
-				                             test_arg.ulp)) {               \
-					ra = i*test_arg.cl_size + c;                             \
-					printf("Error at %s[%zu]\n", type, ra);                  \
-					return false;                                            \
-				}                                                            \
-			}                                                                \
-		}                                                                    \
-		return true;
+	struct piglit_cl_probe_summary summary;
+	const char* type = NULL;
+	size_t i;
+
+#define CASEI(enum_type, type_name, cl_type, func, tolerance)              \
+	case enum_type:                                                        \
+		type = type_name;                                                  \
+		func(value, test_arg.value, sizeof(cl_type), test_arg.length,      \
+		     test_arg.cl_size, test_arg.cl_mem_size, tolerance, &summary); \
+		break;
 
 	switch(test_arg.cl_type) {
-		CASEI(TYPE_CHAR,   "char",   cl_char)
-		CASEU(TYPE_UCHAR,  "uchar",  cl_uchar)
-		CASEI(TYPE_SHORT,  "short",  cl_short)
-		CASEU(TYPE_USHORT, "ushort", cl_ushort)
-		CASEI(TYPE_INT,    "int",    cl_int)
-		CASEU(TYPE_UINT,   "uint",   cl_uint)
-		CASEI(TYPE_LONG,   "long",   cl_long)
-		CASEU(TYPE_ULONG,  "ulong",  cl_ulong)
-		CASEF(TYPE_FLOAT,  "float",  cl_float)
-		CASEF(TYPE_DOUBLE,  "double",  cl_double)
+		CASEI(TYPE_CHAR,   "char",   cl_char,   piglit_cl_probe_integer_array,  test_arg.toli)
+		CASEI(TYPE_UCHAR,  "uchar",  cl_uchar,  piglit_cl_probe_uinteger_array, test_arg.tolu)
+		CASEI(TYPE_SHORT,  "short",  cl_short,  piglit_cl_probe_integer_array,  test_arg.toli)
+		CASEI(TYPE_USHORT, "ushort", cl_ushort, piglit_cl_probe_uinteger_array, test_arg.tolu)
+		CASEI(TYPE_INT,    "int",    cl_int,    piglit_cl_probe_integer_array,  test_arg.toli)
+		CASEI(TYPE_UINT,   "uint",   cl_uint,   piglit_cl_probe_uinteger_array, test_arg.tolu)
+		CASEI(TYPE_LONG,   "long",   cl_long,   piglit_cl_probe_integer_array,  test_arg.toli)
+		CASEI(TYPE_ULONG,  "ulong",  cl_ulong,  piglit_cl_probe_uinteger_array, test_arg.tolu)
+	case TYPE_FLOAT:
+		type = "float";
+		piglit_cl_probe_floating_array(value, test_arg.value,
+		                               test_arg.length,
+		                               test_arg.cl_size,
+		                               test_arg.cl_mem_size,
+		                               test_arg.ulp,
+		                               &summary);
+		break;
+	case TYPE_DOUBLE: {
+		/* Doubles are compared as floats, like piglit_cl_probe_floating() does */
+		size_t n = test_arg.length * test_arg.cl_mem_size;
+		float* value_f = malloc(n * sizeof(float));
+		float* expect_f = malloc(n * sizeof(float));
+
+		for(i = 0; i < n; i++) {
+			value_f[i] = ((cl_double*)value)[i];
+			expect_f[i] = ((cl_double*)test_arg.value)[i];
+		}
+
+		type = "double";
+		piglit_cl_probe_floating_array(value_f, expect_f,
+		                               test_arg.length,
+		                               test_arg.cl_size,
+		                               test_arg.cl_mem_size,
+		                               test_arg.ulp,
+		                               &summary);
+		free(value_f);
+		free(expect_f);
+		break;
+	}
 	}
 
-#undef CASEF
-#undef CASEU
 #undef CASEI
 
+	if(type == NULL || summary.num_mismatches == 0) {
+		return true;
+	}
+
+	if(verbose) {
+		for(i = 0; i < test_arg.length * test_arg.cl_size; i++) {
+			if(!probe_test_arg_element(&test_arg, value, i)) {
+				printf("Error at %s[%zu]\n", type, i);
+			}
+		}
+	} else {
+		for(i = 0; i < summary.num_reported; i++) {
+			probe_test_arg_element(&test_arg, value, summary.reported[i]);
+			printf("Error at %s[%zu]\n", type, summary.reported[i]);
+		}
+	}
+
+	printf("%zu of %zu values differ, the largest by %"PRIu64"%s\n",
+	       summary.num_mismatches,
+	       test_arg.length * test_arg.cl_size,
+	       summary.max_error,
+	       test_arg.cl_type == TYPE_FLOAT || test_arg.cl_type == TYPE_DOUBLE ?
+	           " ulps" : "");
+
+	return false;
+}
+
+/* Buffer pool */
+
+/*
+ * Buffer arguments are not created for every test.  Each argument index gets
+ * a single buffer, big enough for the largest test that uses it, and every
+ * test that has a buffer at that index uses it.  The command queue is in
+ * order, so the commands of one test never overlap with those of another.
+ */
+struct pool_buffer {
+	cl_uint index;
+	size_t size;
+	cl_mem mem;
+};
+
+static unsigned int num_pool_buffers = 0;
+static struct pool_buffer* pool_buffers = NULL;
+
+/*
+ * Written to output-only buffers before each test, so that a kernel that
+ * doesn't write them doesn't pass on what an earlier test left behind.
+ * Big enough for the largest pool buffer.
+ */
+#define POOL_POISON 0xa5
+static unsigned char* pool_poison = NULL;
+
+void
+add_pool_buffer(const struct test_arg* test_arg)
+{
+	unsigned i;
+	struct pool_buffer buffer;
+
+	if(test_arg->type != TEST_ARG_BUFFER || test_arg->value == NULL) {
+		return;
+	}
+
+	for(i = 0; i < num_pool_buffers; i++) {
+		if(pool_buffers[i].index == test_arg->index) {
+			pool_buffers[i].size = MAX2(pool_buffers[i].size,
+			                            test_arg->size);
+			return;
+		}
+	}
+
+	buffer.index = test_arg->index;
+	buffer.size = test_arg->size;
+	buffer.mem = NULL;
+	add_dynamic_array((void**)&pool_buffers,
+	                  &num_pool_buffers,
+	                  sizeof(struct pool_buffer),
+	                  &buffer);
+}
+
+/* Size the pool for all the tests, without creating any buffers yet */
+void
+init_buffer_pool()
+{
+	unsigned i, j;
+	size_t size = 1;
+
+	for(i = 0; i < num_tests; i++) {
+		for(j = 0; j < tests[i].num_args_in; j++) {
+			add_pool_buffer(&tests[i].args_in[j]);
+		}
+		for(j = 0; j < tests[i].num_args_out; j++) {
+			add_pool_buffer(&tests[i].args_out[j]);
+		}
+	}
+
+	for(i = 0; i < num_pool_buffers; i++) {
+		size = MAX2(size, pool_buffers[i].size);
+	}
+	pool_poison = malloc(size);
+	memset(pool_poison, POOL_POISON, size);
+}
+
+/* Get the buffer for an argument index, creating it on first use */
+cl_mem
+get_pool_buffer(const struct piglit_cl_program_test_env* env, cl_uint index)
+{
+	unsigned i;
+
+	for(i = 0; i < num_pool_buffers; i++) {
+		if(pool_buffers[i].index != index) {
+			continue;
+		}
+
+		if(pool_buffers[i].mem == NULL) {
+			pool_buffers[i].mem =
+				piglit_cl_create_buffer(env->context,
+				                        CL_MEM_READ_WRITE,
+				                        pool_buffers[i].size);
+		}
+		return pool_buffers[i].mem;
+	}
+
+	return NULL;
+}
+
+void
+free_buffer_pool()
+{
+	unsigned i;
+
+	for(i = 0; i < num_pool_buffers; i++) {
+		if(pool_buffers[i].mem != NULL) {
+			clReleaseMemObject(pool_buffers[i].mem);
+		}
+	}
+
+	free(pool_buffers); pool_buffers = NULL;
+	num_pool_buffers = 0;
+	free(pool_poison); pool_poison = NULL;
+}
+
+/* Kernel tests */
+
+/*
+ * A test that has been enqueued, with everything that has to be kept until
+ * it is validated.
+ */
+struct test_run {
+	/* Result of setting up the test, if it could not be enqueued */
+	enum piglit_result result;
+	bool enqueued;
+
+	cl_kernel kernel;
+
+	struct mem_arg* mem_args; // images, buffers are in the pool
+	unsigned int num_mem_args;
+
+	cl_sampler* sampler_args;
+	unsigned int num_sampler_args;
+
+	/* Every command enqueued for the test */
+	cl_event* events;
+	unsigned int num_events;
+
+	cl_event kernel_event;
+
+	/* Read back value and its read command, for each output argument */
+	void** read_values;
+	cl_event* read_events;
+};
+
+void
+free_test_run(struct test_run* run, unsigned int num_args_out)
+{
+	unsigned i;
+
+	if(run->kernel != NULL) {
+		clReleaseKernel(run->kernel);
+	}
+	free_mem_args(&run->mem_args, &run->num_mem_args);
+	free_sampler_args(&run->sampler_args, &run->num_sampler_args);
+
+	for(i = 0; i < run->num_events; i++) {
+		clReleaseEvent(run->events[i]);
+	}
+	free(run->events);
+
+	if(run->read_values != NULL) {
+		for(i = 0; i < num_args_out; i++) {
+			free(run->read_values[i]);
+		}
+	}
+	free(run->read_values);
+	free(run->read_events);
+
+	memset(run, 0, sizeof(*run));
+}
+
+void
+add_run_event(struct test_run* run, cl_event event)
+{
+	add_dynamic_array((void**)&run->events,
+	                  &run->num_events,
+	                  sizeof(cl_event),
+	                  &event);
+}
+
+/* The region of a whole image argument */
+void
+get_arg_image_region(const struct test_arg* test_arg, size_t* region)
+{
+	region[0] = test_arg->image_desc.image_width;
+	region[1] = MAX2(test_arg->image_desc.image_height, 1);
+	region[2] = MAX2(test_arg->image_desc.image_depth, 1);
+}
+
+/*
+ * Enqueue a non-blocking write of an input argument's value.
+ */
+bool
+enqueue_arg_write(cl_command_queue queue,
+                  const struct test_arg* test_arg,
+                  cl_mem mem,
+                  struct test_run* run)
+{
+	cl_int errNo;
+	cl_event event;
+
+	if(test_arg->type == TEST_ARG_IMAGE) {
+		size_t origin[3] = {0, 0, 0};
+		size_t region[3];
+
+		get_arg_image_region(test_arg, region);
+		errNo = clEnqueueWriteImage(queue, mem, CL_FALSE, origin, region,
+		                            0, 0, test_arg->value,
+		                            0, NULL, &event);
+	} else {
+		errNo = clEnqueueWriteBuffer(queue, mem, CL_FALSE, 0,
+		                             test_arg->size, test_arg->value,
+		                             0, NULL, &event);
+	}
+
+	if(!piglit_cl_check_error(errNo, CL_SUCCESS)) {
+		fprintf(stderr,
+		        "Could not enqueue argument write: %s\n",
+		        piglit_cl_get_error_name(errNo));
+		return false;
+	}
+
+	add_run_event(run, event);
 	return true;
 }
 
-/* Run the kernel test */
-enum piglit_result
-test_kernel(const struct piglit_cl_program_test_config* config,
-            const struct piglit_cl_program_test_env* env,
-            struct test test)
+/*
+ * Enqueue a non-blocking write of the poison pattern to the pool buffer of
+ * an output-only argument.
+ */
+bool
+enqueue_arg_poison(cl_command_queue queue,
+                   const struct test_arg* test_arg,
+                   cl_mem mem,
+                   struct test_run* run)
 {
-	enum piglit_result result = PIGLIT_PASS;
+	cl_int errNo;
+	cl_event event;
+
+	errNo = clEnqueueWriteBuffer(queue, mem, CL_FALSE, 0,
+	                             test_arg->size, pool_poison,
+	                             0, NULL, &event);
+	if(!piglit_cl_check_error(errNo, CL_SUCCESS)) {
+		fprintf(stderr,
+		        "Could not enqueue argument poison write: %s\n",
+		        piglit_cl_get_error_name(errNo));
+		return false;
+	}
+
+	add_run_event(run, event);
+	return true;
+}
+
+/*
+ * Enqueue a non-blocking read of an output argument, after the kernel.
+ */
+bool
+enqueue_arg_read(cl_command_queue queue,
+                 const struct test_arg* test_arg,
+                 cl_mem mem,
+                 struct test_run* run,
+                 unsigned int arg)
+{
+	cl_int errNo;
+	cl_event event;
+
+	run->read_values[arg] = malloc(test_arg->size);
+
+	if(test_arg->type == TEST_ARG_IMAGE) {
+		size_t origin[3] = {0, 0, 0};
+		size_t region[3];
+
+		get_arg_image_region(test_arg, region);
+		errNo = clEnqueueReadImage(queue, mem, CL_FALSE, origin, region,
+		                           0, 0, run->read_values[arg],
+		                           1, &run->kernel_event, &event);
+	} else {
+		errNo = clEnqueueReadBuffer(queue, mem, CL_FALSE, 0,
+		                            test_arg->size, run->read_values[arg],
+		                            1, &run->kernel_event, &event);
+	}
+
+	if(!piglit_cl_check_error(errNo, CL_SUCCESS)) {
+		fprintf(stderr,
+		        "Could not enqueue argument read: %s\n",
+		        piglit_cl_get_error_name(errNo));
+		return false;
+	}
+
+	add_run_event(run, event);
+	run->read_events[arg] = event;
+	return true;
+}
+
+/* Whether an enqueued command finished successfully */
+bool
+event_completed(cl_event event)
+{
+	cl_int* status;
+	bool completed;
+
+	status = piglit_cl_get_event_info(event,
+	                                  CL_EVENT_COMMAND_EXECUTION_STATUS);
+	completed = status != NULL && *status == CL_COMPLETE;
+	free(status);
+
+	return completed;
+}
+
+/*
+ * Set up a kernel test and enqueue its writes, kernel and reads, without
+ * waiting for any of them.  The kernel waits for the writes, and the reads
+ * for the kernel.
+ *
+ * Tests are only ordered by the queue, not by events, so that a kernel that
+ * fails doesn't take the tests after it down with it.  On failure
+ * run->result is set and the test is not validated.
+ */
+void
+enqueue_test(const struct piglit_cl_program_test_config* config,
+             const struct piglit_cl_program_test_env* env,
+             struct test* test,
+             struct test_run* run)
+{
+	cl_command_queue queue = env->context->command_queues[0];
 
 	// all
 	unsigned j;
 	char* kernel_name;
 	cl_kernel kernel;
+	cl_int errNo;
+	cl_event* wait_list;
+	unsigned int num_wait;
 
-	// setting/validating arguments
-	struct mem_arg* mem_args = NULL;
-	unsigned int  num_mem_args = 0;
-
-	cl_sampler *sampler_args = NULL;
-	unsigned int num_sampler_args = 0;
+	memset(run, 0, sizeof(*run));
+	run->result = PIGLIT_FAIL;
 
 	/* Check if this device supports the local work size. */
 	if (!piglit_cl_framework_check_local_work_size(env->device_id,
-						test.local_work_size)) {
-		return PIGLIT_SKIP;
+						test->local_work_size)) {
+		run->result = PIGLIT_SKIP;
+		return;
 	}
 
 	/* Create or use apropriate kernel */
-	if(test.kernel_name == NULL) {
+	if(test->kernel_name == NULL) {
 		kernel_name = config->kernel_name;
 		kernel = env->kernel;
 
 		if(config->kernel_name == NULL) {
 			printf("No kernel_name defined\n");
-			return PIGLIT_WARN;
+			run->result = PIGLIT_WARN;
+			return;
 		} else {
 			clRetainKernel(kernel);
 		}
 	} else {
-		kernel_name = test.kernel_name;
-		kernel = piglit_cl_create_kernel(env->program, test.kernel_name);
+		kernel_name = test->kernel_name;
+		kernel = piglit_cl_create_kernel(env->program, test->kernel_name);
 
 		if(kernel == NULL) {
 			printf("Could not create kernel %s\n", kernel_name);
-			return PIGLIT_FAIL;
+			return;
 		}
 	}
+	run->kernel = kernel;
 
 	printf("Using kernel %s\n", kernel_name);
 
 	/* Set kernel args */
 	printf("Setting kernel arguments...\n");
 
-	for(j = 0; j < test.num_args_in; j++) {
+	for(j = 0; j < test->num_args_in; j++) {
 		bool arg_set = false;
-		struct test_arg test_arg = test.args_in[j];
+		struct test_arg test_arg = test->args_in[j];
 
 		switch(test_arg.type) {
 		case TEST_ARG_VALUE:
@@ -2193,40 +2970,24 @@ test_kernel(const struct piglit_cl_program_test_config* config,
 			                                   test_arg.value);
 			break;
 		case TEST_ARG_BUFFER: {
-			struct mem_arg mem_arg;
-			mem_arg.index = test_arg.index;
-			mem_arg.type = CL_MEM_OBJECT_BUFFER;
+			cl_mem mem;
 
 			if(test_arg.value != NULL) {
-				mem_arg.mem = piglit_cl_create_buffer(env->context,
-				                                            CL_MEM_READ_WRITE,
-				                                            test_arg.size);
-				if(   mem_arg.mem != NULL
-				   && piglit_cl_write_buffer(env->context->command_queues[0],
-				                             mem_arg.mem,
-				                             0,
-				                             test_arg.size,
-				                             test_arg.value)
+				mem = get_pool_buffer(env, test_arg.index);
+				if(   mem != NULL
+				   && enqueue_arg_write(queue, &test_arg, mem, run)
 				   && piglit_cl_set_kernel_arg(kernel,
-				                               mem_arg.index,
+				                               test_arg.index,
 				                               sizeof(cl_mem),
-				                               &mem_arg.mem)) {
+				                               &mem)) {
 					arg_set = true;
 				}
 			} else {
-				mem_arg.mem = NULL;
 				arg_set = piglit_cl_set_kernel_arg(kernel,
-				                                   mem_arg.index,
+				                                   test_arg.index,
 				                                   sizeof(cl_mem),
 				                                   NULL);
 			}
-
-			if(arg_set) {
-				add_dynamic_array((void**)&mem_args,
-				                  &num_mem_args,
-				                  sizeof(struct mem_arg),
-				                  &mem_arg);
-			}
 			break;
 		}
 		case TEST_ARG_IMAGE: {
@@ -2244,23 +3005,21 @@ test_kernel(const struct piglit_cl_program_test_config* config,
 			                                     CL_MEM_READ_ONLY,
 			                                     &test_arg.image_format,
 			                                     &test_arg.image_desc);
-			if(   mem_arg.mem != NULL
-			   && piglit_cl_write_whole_image(env->context->command_queues[0],
-			                                  mem_arg.mem,
-			                                  test_arg.value)
+			if(mem_arg.mem == NULL) {
+				break;
+			}
+			add_dynamic_array((void**)&run->mem_args,
+			                  &run->num_mem_args,
+			                  sizeof(struct mem_arg),
+			                  &mem_arg);
+
+			if(   enqueue_arg_write(queue, &test_arg, mem_arg.mem, run)
 			   && piglit_cl_set_kernel_arg(kernel,
 			                               mem_arg.index,
 			                               sizeof(cl_mem),
 			                               &mem_arg.mem)) {
 				arg_set = true;
 			}
-
-			if(arg_set) {
-				add_dynamic_array((void**)&mem_args,
-				                  &num_mem_args,
-				                  sizeof(struct mem_arg),
-				                  &mem_arg);
-			}
 			break;
 		}
 		case TEST_ARG_SAMPLER: {
@@ -2275,33 +3034,28 @@ test_kernel(const struct piglit_cl_program_test_config* config,
 				break;
 			}
 
+			add_dynamic_array((void**)&run->sampler_args,
+			                  &run->num_sampler_args,
+			                  sizeof(cl_sampler),
+			                  &sampler);
+
 			arg_set = piglit_cl_set_kernel_arg(kernel,
 			                                   test_arg.index,
 			                                   test_arg.size,
 			                                   &sampler);
-
-			if(arg_set) {
-				add_dynamic_array((void**)&sampler_args,
-				                  &num_sampler_args,
-				                  sizeof(cl_sampler),
-				                  &sampler);
-			}
 			break;
 		}}
 
 		if(!arg_set) {
 			printf("Failed to set kernel argument with index %u\n",
 			       test_arg.index);
-			clReleaseKernel(kernel);
-			free_mem_args(&mem_args, &num_mem_args);
-			free_sampler_args(&sampler_args, &num_sampler_args);
-			return PIGLIT_FAIL;
+			return;
 		}
 	}
 
-	for(j = 0; j < test.num_args_out; j++) {
+	for(j = 0; j < test->num_args_out; j++) {
 		bool arg_set = false;
-		struct test_arg test_arg = test.args_out[j];
+		struct test_arg test_arg = test->args_out[j];
 
 		switch(test_arg.type) {
 		case TEST_ARG_VALUE:
@@ -2310,21 +3064,22 @@ test_kernel(const struct piglit_cl_program_test_config* config,
 		case TEST_ARG_BUFFER: {
 			unsigned k;
 			bool fail = false;
-			struct mem_arg mem_arg;
-			mem_arg.index = test_arg.index;
-			mem_arg.type = CL_MEM_OBJECT_BUFFER;
+			cl_mem mem;
+
+			for(k = 0; k < test->num_args_in; k++) {
+				const struct test_arg* arg_in = &test->args_in[k];
 
-			for(k = 0; k < num_mem_args; k++) {
-				if(mem_args[k].index != mem_arg.index)
+				if(   arg_in->index != test_arg.index
+				   || arg_in->type == TEST_ARG_VALUE
+				   || arg_in->type == TEST_ARG_SAMPLER)
 					continue;
 
-				if(mem_args[k].type != mem_arg.type) {
+				if(arg_in->type != TEST_ARG_BUFFER) {
 					printf("Inconsistent types specified for in-out"
 					       "argument %d: arg_in: %s, arg_out: %s.\n",
-					       mem_arg.index,
-					       piglit_cl_get_enum_name(mem_args[k].type),
-					       piglit_cl_get_enum_name(mem_arg.type));
-					arg_set = false;
+					       test_arg.index,
+					       piglit_cl_get_enum_name(arg_in->image_desc.image_type),
+					       piglit_cl_get_enum_name(CL_MEM_OBJECT_BUFFER));
 					fail = true;
 					break;
 				}
@@ -2335,30 +3090,21 @@ test_kernel(const struct piglit_cl_program_test_config* config,
 			}
 
 			if(test_arg.value != NULL) {
-				mem_arg.mem = piglit_cl_create_buffer(env->context,
-				                                            CL_MEM_READ_WRITE,
-				                                            test_arg.size);
-				if(   mem_arg.mem != NULL
+				mem = get_pool_buffer(env, test_arg.index);
+				if(   mem != NULL
+				   && enqueue_arg_poison(queue, &test_arg, mem, run)
 				   && piglit_cl_set_kernel_arg(kernel,
-				                               mem_arg.index,
+				                               test_arg.index,
 				                               sizeof(cl_mem),
-				                               &mem_arg.mem)) {
+				                               &mem)) {
 					arg_set = true;
 				}
 			} else {
-				mem_arg.mem = NULL;
 				arg_set = piglit_cl_set_kernel_arg(kernel,
-				                                   mem_arg.index,
+				                                   test_arg.index,
 				                                   sizeof(cl_mem),
 				                                   NULL);
 			}
-
-			if(arg_set) {
-				add_dynamic_array((void**)&mem_args,
-				                  &num_mem_args,
-				                  sizeof(struct mem_arg),
-				                  &mem_arg);
-			}
 			break;
 		}
 		case TEST_ARG_IMAGE: {
@@ -2368,11 +3114,14 @@ test_kernel(const struct piglit_cl_program_test_config* config,
 			mem_arg.index = test_arg.index;
 			mem_arg.type = test_arg.image_desc.image_type;
 
-			for(k = 0; k < num_mem_args; k++) {
-				if(mem_args[k].index == mem_arg.index) {
+			for(k = 0; k < test->num_args_in; k++) {
+				const struct test_arg* arg_in = &test->args_in[k];
+
+				if(   arg_in->index == mem_arg.index
+				   && (   arg_in->type == TEST_ARG_BUFFER
+				       || arg_in->type == TEST_ARG_IMAGE)) {
 					printf("Argument %d: images cannot be in-out arguments.",
 					       mem_arg.index);
-					arg_set = false;
 					fail = true;
 					break;
 				}
@@ -2391,20 +3140,18 @@ test_kernel(const struct piglit_cl_program_test_config* config,
 			                                     CL_MEM_WRITE_ONLY,
 			                                     &test_arg.image_format,
 			                                     &test_arg.image_desc);
-			if(   mem_arg.mem != NULL
-			   && piglit_cl_set_kernel_arg(kernel,
-			                               mem_arg.index,
-			                               sizeof(cl_mem),
-			                               &mem_arg.mem)) {
-				arg_set = true;
+			if(mem_arg.mem == NULL) {
+				break;
 			}
+			add_dynamic_array((void**)&run->mem_args,
+			                  &run->num_mem_args,
+			                  sizeof(struct mem_arg),
+			                  &mem_arg);
 
-			if(arg_set) {
-				add_dynamic_array((void**)&mem_args,
-				                  &num_mem_args,
-				                  sizeof(struct mem_arg),
-				                  &mem_arg);
-			}
+			arg_set = piglit_cl_set_kernel_arg(kernel,
+			                                   mem_arg.index,
+			                                   sizeof(cl_mem),
+			                                   &mem_arg.mem);
 			break;
 		}
 		case TEST_ARG_SAMPLER:
@@ -2415,121 +3162,125 @@ test_kernel(const struct piglit_cl_program_test_config* config,
 		if(!arg_set) {
 			printf("Failed to set kernel argument with index %u\n",
 			       test_arg.index);
-			clReleaseKernel(kernel);
-			free_mem_args(&mem_args, &num_mem_args);
-			free_sampler_args(&sampler_args, &num_sampler_args);
-			return PIGLIT_FAIL;
+			return;
 		}
 	}
 
-	/* Execute kernel */
+	/* Enqueue kernel, after the writes */
 	printf("Running the kernel...\n");
 
-	if(!piglit_cl_execute_ND_range_kernel(env->context->command_queues[0],
-	                                      kernel,
-	                                      test.work_dimensions,
-	                                      test.global_offset_null ? NULL : test.global_offset,
-	                                      test.global_work_size,
-	                                      test.local_work_size_null ? NULL : test.local_work_size)) {
+	num_wait = run->num_events;
+	wait_list = run->events;
+
+	errNo = clEnqueueNDRangeKernel(queue,
+	                               kernel,
+	                               test->work_dimensions,
+	                               test->global_offset_null ? NULL : test->global_offset,
+	                               test->global_work_size,
+	                               test->local_work_size_null ? NULL : test->local_work_size,
+	                               num_wait,
+	                               num_wait ? wait_list : NULL,
+	                               &run->kernel_event);
+	if(!piglit_cl_check_error(errNo, CL_SUCCESS)) {
 		printf("Failed to enqueue the kernel\n");
-		clReleaseKernel(kernel);
-		free_mem_args(&mem_args, &num_mem_args);
-		free_sampler_args(&sampler_args, &num_sampler_args);
-		return PIGLIT_FAIL;
+		run->kernel_event = NULL;
+		return;
 	}
+	add_run_event(run, run->kernel_event);
 
-	/* Check results */
-	printf("Validating results...\n");
+	/* Enqueue reads of the results */
+	run->read_values = calloc(MAX2(test->num_args_out, 1), sizeof(void*));
+	run->read_events = calloc(MAX2(test->num_args_out, 1), sizeof(cl_event));
 
-	for(j = 0; j < test.num_args_out; j++) {
+	for(j = 0; j < test->num_args_out; j++) {
 		unsigned k;
-		bool arg_valid = false;
-		struct test_arg test_arg = test.args_out[j];
+		struct test_arg test_arg = test->args_out[j];
+		cl_mem mem = NULL;
+
+		if(test_arg.value == NULL) {
+			// Reported when validating
+			continue;
+		}
 
 		switch(test_arg.type) {
 		case TEST_ARG_VALUE:
+		case TEST_ARG_SAMPLER:
 			// Not accepted by parser
+			continue;
+		case TEST_ARG_BUFFER:
+			mem = get_pool_buffer(env, test_arg.index);
 			break;
-		case TEST_ARG_BUFFER: {
-			struct mem_arg mem_arg;
-
-			/* Find the right buffer */
-			for(k = 0; k < num_mem_args; k++) {
-				if(mem_args[k].index == test_arg.index) {
-					mem_arg = mem_args[k];
+		case TEST_ARG_IMAGE:
+			/* Find the right image */
+			for(k = 0; k < run->num_mem_args; k++) {
+				if(run->mem_args[k].index == test_arg.index) {
+					mem = run->mem_args[k].mem;
 				}
 			}
+			break;
+		}
 
-			if(test_arg.value != NULL) {
-				void* read_value = malloc(test_arg.size);
-
-				if(piglit_cl_read_buffer(env->context->command_queues[0],
-					                     mem_arg.mem,
-					                     0,
-					                     test_arg.size,
-					                     read_value)) {
-					arg_valid = true;
-					if(check_test_arg_value(test_arg, read_value)) {
-						printf(" Argument %u: PASS%s\n",
-						                     test_arg.index,
-						                     !test.expect_test_fail ? "" : " (not expected)");
-						if(test.expect_test_fail) {
-							piglit_merge_result(&result, PIGLIT_FAIL);
-						}
-					} else {
-						printf(" Argument %u: FAIL%s\n",
-						                     test_arg.index,
-						                     !test.expect_test_fail ? "" : " (expected)");
-						if(!test.expect_test_fail) {
-							piglit_merge_result(&result, PIGLIT_FAIL);
-						}
-					}
-				}
+		if(!enqueue_arg_read(queue, &test_arg, mem, run, j)) {
+			printf("Failed to read kernel argument with index %u\n",
+			       test_arg.index);
+			return;
+		}
+	}
 
-				free(read_value);
-			}
+	run->enqueued = true;
+}
 
-			break;
-		}
-		case TEST_ARG_IMAGE: {
-			struct mem_arg mem_arg;
+/*
+ * Validate an enqueued kernel test, once the queue has been drained.
+ */
+enum piglit_result
+validate_test(const struct test* test, const struct test_run* run)
+{
+	enum piglit_result result = PIGLIT_PASS;
+	unsigned j;
 
-			/* Find the right buffer */
-			for(k = 0; k < num_mem_args; k++) {
-				if(mem_args[k].index == test_arg.index) {
-					mem_arg = mem_args[k];
-				}
-			}
+	if(!run->enqueued) {
+		return run->result;
+	}
 
-			if(test_arg.value != NULL) {
-				void* read_value = malloc(test_arg.size);
-
-				if(piglit_cl_read_whole_image(env->context->command_queues[0],
-					                          mem_arg.mem,
-					                          read_value)) {
-					arg_valid = true;
-					if(check_test_arg_value(test_arg, read_value)) {
-						printf(" Argument %u: PASS%s\n",
-						                     test_arg.index,
-						                     !test.expect_test_fail ? "" : " (not expected)");
-						if(test.expect_test_fail) {
-							piglit_merge_result(&result, PIGLIT_FAIL);
-						}
-					} else {
-						printf(" Argument %u: FAIL%s\n",
-						                     test_arg.index,
-						                     !test.expect_test_fail ? "" : " (expected)");
-						if(!test.expect_test_fail) {
-							piglit_merge_result(&result, PIGLIT_FAIL);
-						}
+	if(!event_completed(run->kernel_event)) {
+		printf("Failed to run the kernel\n");
+		return PIGLIT_FAIL;
+	}
+
+	/* Check results */
+	printf("Validating results...\n");
+
+	for(j = 0; j < test->num_args_out; j++) {
+		bool arg_valid = false;
+		struct test_arg test_arg = test->args_out[j];
+
+		switch(test_arg.type) {
+		case TEST_ARG_VALUE:
+			// Not accepted by parser
+			break;
+		case TEST_ARG_BUFFER:
+		case TEST_ARG_IMAGE:
+			if(   test_arg.value != NULL
+			   && event_completed(run->read_events[j])) {
+				arg_valid = true;
+				if(check_test_arg_value(test_arg, run->read_values[j])) {
+					printf(" Argument %u: PASS%s\n",
+					                     test_arg.index,
+					                     !test->expect_test_fail ? "" : " (not expected)");
+					if(test->expect_test_fail) {
+						piglit_merge_result(&result, PIGLIT_FAIL);
+					}
+				} else {
+					printf(" Argument %u: FAIL%s\n",
+					                     test_arg.index,
+					                     !test->expect_test_fail ? "" : " (expected)");
+					if(!test->expect_test_fail) {
+						piglit_merge_result(&result, PIGLIT_FAIL);
 					}
 				}
-
-				free(read_value);
 			}
-
 			break;
-		}
 		case TEST_ARG_SAMPLER:
 			// Not accepted by parser
 			break;
@@ -2538,17 +3289,10 @@ test_kernel(const struct piglit_cl_program_test_config* config,
 		if(!arg_valid) {
 			printf("Failed to validate kernel argument with index %u\n",
 			       test_arg.index);
-			clReleaseKernel(kernel);
-			free_mem_args(&mem_args, &num_mem_args);
-			free_sampler_args(&sampler_args, &num_sampler_args);
 			return PIGLIT_FAIL;
 		}
 	}
 
-	/* Clean memory used by test */
-	clReleaseKernel(kernel);
-	free_mem_args(&mem_args, &num_mem_args);
-	free_sampler_args(&sampler_args, &num_sampler_args);
 	return result;
 }
 
@@ -2563,6 +3307,8 @@ piglit_cl_test(const int argc,
 	enum piglit_result result = PIGLIT_SKIP;
 
 	unsigned i;
+	cl_int errNo;
+	struct test_run* runs;
 
 	/* Print building status */
 	if(!config->expect_build_fail) {
@@ -2579,19 +3325,47 @@ piglit_cl_test(const int argc,
 		result = PIGLIT_PASS;
 	}
 
-	/* Run the tests */
-	for(i = 0; i< num_tests; i++) {
+	/*
+	 * Enqueue all of the tests, then validate them once the device is
+	 * done with all of them, so it doesn't wait for the host between
+	 * tests.
+	 */
+	runs = calloc(MAX2(num_tests, 1), sizeof(struct test_run));
+	init_buffer_pool();
+
+	for(i = 0; i < num_tests; i++) {
+		char* test_name = tests[i].name != NULL ? tests[i].name : "";
+
+		printf("> Enqueuing kernel test: %s\n", test_name);
+
+		enqueue_test(config, env, &tests[i], &runs[i]);
+	}
+
+	errNo = clFinish(env->context->command_queues[0]);
+	if(!piglit_cl_check_error(errNo, CL_SUCCESS)) {
+		fprintf(stderr,
+		        "Could not wait for the tests to finish: %s\n",
+		        piglit_cl_get_error_name(errNo));
+	}
+
+	for(i = 0; i < num_tests; i++) {
 		enum piglit_result test_result;
 		char* test_name = tests[i].name != NULL ? tests[i].name : "";
 
-		printf("> Running kernel test: %s\n", test_name);
+		printf("> Validating kernel test: %s\n", test_name);
 
-		test_result = test_kernel(config, env, tests[i]);
+		test_result = validate_test(&tests[i], &runs[i]);
 		piglit_merge_result(&result, test_result);
 
 		piglit_report_subtest_result(test_result, "%s", tests[i].name);
 	}
 
+	for(i = 0; i < num_tests; i++) {
+		free_test_run(&runs[i], tests[i].num_args_out);
+	}
+	free(runs);
+	free_buffer_pool();
+
 	/* Print result */
 	if(num_tests > 0) {
 		switch(result) {
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) The Piglit project 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file packed-float-array-selftest.c
+ *
+ * Check the array converters of packed-float-array.c, which use SIMD
+ * instructions where the CPU has them, against the single value
+ * converters.  No GL is involved.  The checks are run for each of the
+ * instruction set levels of piglit_packed_float_array_set_level() that
+ * the CPU has, so that every path gets tested.
+ *
+ * Every half float, unsigned 11 and 10 bit float and shared exponent
+ * value is decoded and encoded again, and must come back unchanged, but
+ * for NaNs and the 11 and 10 bit denorms, which the encoders canonicalize
+ * and flush.
+ *
+ * Encoding floats is compared with the single value converters for every
+ * 1021st float bit pattern, or every one of them with -exhaustive, which
+ * takes a quarter of an hour per level.
+ */
+
+#include "piglit-util-gl.h"
+#include "r11g11b10f.h"
+#include "rgb9e5.h"
+
+/* Not a multiple of any SIMD width, so that the tails get tested too. */
+#define CHUNK 4099
+
+static uint32_t
+fui(float f)
+{
+	uint32_t u;
+
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+static float
+uif(uint32_t u)
+{
+	float f;
+
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+static bool
+is_nan_half(unsigned h)
+{
+	return (h & 0x7c00) == 0x7c00 && (h & 0x3ff);
+}
+
+static bool
+check_half_round_trip(void)
+{
+	static unsigned short half[65536], back[65536];
+	static float f[65536];
+	unsigned i;
+	bool pass = true;
+
+	for (i = 0; i < 65536; i++)
+		half[i] = i;
+
+	piglit_float_from_half_array(half, f, 65536);
+	piglit_half_from_float_array(f, back, 65536);
+
+	for (i = 0; i < 65536; i++) {
+		/* piglit_half_from_float() makes every NaN 0x7c01 */
+		unsigned expected = is_nan_half(i) ? (i & 0x8000) | 0x7c01 : i;
+
+		if (fui(f[i]) != fui(piglit_float_from_half(i)) ||
+		    back[i] != expected ||
+		    piglit_half_from_float(f[i]) != expected) {
+			printf("half 0x%04x: float 0x%08x (expected 0x%08x), "
+			       "back 0x%04x (expected 0x%04x)\n",
+			       i, fui(f[i]), fui(piglit_float_from_half(i)),
+			       back[i], expected);
+			pass = false;
+			break;
+		}
+	}
+
+	return pass;
+}
+
+static bool
+check_uf_round_trip(const char *name, unsigned bits, float (*decode)(unsigned),
+		    void (*encode_array)(const float *, uint16_t *, size_t))
+{
+	const unsigned count = 1 << bits;
+	const unsigned nan = 0x1f << (bits - 5) | 1;
+	float f[2048];
+	uint16_t back[2048];
+	unsigned i;
+
+	for (i = 0; i < count; i++)
+		f[i] = decode(i);
+	encode_array(f, back, count);
+
+	for (i = 0; i < count; i++) {
+		const unsigned e = i >> (bits - 5);
+		const unsigned m = i & ((1 << (bits - 5)) - 1);
+		unsigned expected = i;
+
+		/* Encoding makes every NaN the same and flushes denorms */
+		if (e == 0x1f && m)
+			expected = nan;
+		else if (e == 0)
+			expected = 0;
+
+		if (back[i] != expected) {
+			printf("%s 0x%03x: float 0x%08x, back 0x%03x\n",
+			       name, i, fui(f[i]), back[i]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Decode every stride'th shared exponent value, in bulk and one at a time,
+ * and check that encoding the result gives the same colors again.
+ */
+static bool
+check_rgb9e5_round_trip(uint32_t stride)
+{
+	static unsigned codes[CHUNK], back[CHUNK];
+	static float f[CHUNK * 3], ref[3], again[CHUNK * 3];
+	uint64_t code = 0;
+	unsigned i, n;
+
+	while (code < (1ull << 32)) {
+		for (n = 0; n < CHUNK && code < (1ull << 32); n++) {
+			codes[n] = code;
+			code += stride;
+		}
+
+		rgb9e5_to_float3_array(codes, f, n);
+		float3_to_rgb9e5_array(f, back, n);
+		rgb9e5_to_float3_array(back, again, n);
+
+		for (i = 0; i < n; i++) {
+			rgb9e5_to_float3(codes[i], ref);
+			if (memcmp(&f[i * 3], ref, sizeof(ref)) != 0 ||
+			    memcmp(&again[i * 3], ref, sizeof(ref)) != 0 ||
+			    back[i] != float3_to_rgb9e5(ref)) {
+				printf("rgb9e5 0x%08x: decoded to "
+				       "%g %g %g (expected %g %g %g), "
+				       "encoded to 0x%08x\n",
+				       codes[i], f[i * 3], f[i * 3 + 1],
+				       f[i * 3 + 2], ref[0], ref[1], ref[2],
+				       back[i]);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Encode every stride'th float with each array converter, and compare with
+ * the single value converters.  The texel converters get the float in red
+ * and other floats from the same sweep in green and blue.
+ */
+static bool
+check_encode(uint32_t stride)
+{
+	static float f[CHUNK], rgb[CHUNK * 3];
+	static unsigned short half[CHUNK];
+	static uint16_t uf11[CHUNK], uf10[CHUNK];
+	static unsigned packed[CHUNK], rgb9e5[CHUNK];
+	uint64_t bits = 0;
+	unsigned i, n;
+
+	while (bits < (1ull << 32)) {
+		for (n = 0; n < CHUNK && bits < (1ull << 32); n++) {
+			f[n] = uif(bits);
+			rgb[n * 3] = f[n];
+			rgb[n * 3 + 1] = uif((uint32_t) bits * 2654435761u);
+			rgb[n * 3 + 2] = uif((uint32_t) (bits >> 16 | bits << 16));
+			bits += stride;
+		}
+
+		piglit_half_from_float_array(f, half, n);
+		f32_to_uf11_array(f, uf11, n);
+		f32_to_uf10_array(f, uf10, n);
+		float3_to_r11g11b10f_array(rgb, packed, n);
+		float3_to_rgb9e5_array(rgb, rgb9e5, n);
+
+		for (i = 0; i < n; i++) {
+			const float *texel = &rgb[i * 3];
+
+			if (half[i] != piglit_half_from_float(f[i]) ||
+			    uf11[i] != f32_to_uf11(f[i]) ||
+			    uf10[i] != f32_to_uf10(f[i]) ||
+			    packed[i] != float3_to_r11g11b10f(texel) ||
+			    rgb9e5[i] != float3_to_rgb9e5(texel)) {
+				printf("float 0x%08x: half 0x%04x uf11 0x%03x "
+				       "uf10 0x%03x, expected 0x%04x 0x%03x "
+				       "0x%03x\n", fui(f[i]), half[i],
+				       uf11[i], uf10[i],
+				       piglit_half_from_float(f[i]),
+				       f32_to_uf11(f[i]), f32_to_uf10(f[i]));
+				printf("texel 0x%08x 0x%08x 0x%08x: "
+				       "r11g11b10f 0x%08x rgb9e5 0x%08x, "
+				       "expected 0x%08x 0x%08x\n",
+				       fui(texel[0]), fui(texel[1]),
+				       fui(texel[2]), packed[i], rgb9e5[i],
+				       float3_to_r11g11b10f(texel),
+				       float3_to_rgb9e5(texel));
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+int
+main(int argc, char **argv)
+{
+	uint32_t stride = 1021;
+	bool pass = true;
+	const char *level;
+	unsigned l;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-exhaustive") == 0)
+			stride = 1;
+	}
+
+	for (l = 0; (level = piglit_packed_float_array_set_level(l)); l++) {
+		printf("Checking the %s converters\n", level);
+
+		pass = check_half_round_trip() && pass;
+		pass = check_uf_round_trip("uf11", 11, uf11_to_f32,
+					   f32_to_uf11_array) && pass;
+		pass = check_uf_round_trip("uf10", 10, uf10_to_f32,
+					   f32_to_uf10_array) && pass;
+		pass = check_rgb9e5_round_trip(stride) && pass;
+		pass = check_encode(stride) && pass;
+	}
+
+	piglit_report_result(pass ? PIGLIT_PASS : PIGLIT_FAIL);
+}
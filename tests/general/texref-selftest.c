@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) The Piglit project 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file texref-selftest.c
+ *
+ * Check the CPU texturing reference of piglit-texref.c.  No GL is
+ * involved.
+ *
+ * The codes piglit_texref_encode() gives must come back unchanged from
+ * piglit_texref_decode() and encoding again, for a sweep of colors in a
+ * range of formats, and a few codes are checked against their known
+ * values.  The wrap modes and piglit_texref_select_level() are checked at
+ * the edges where they are easy to get wrong.
+ */
+
+#include "piglit-util-gl.h"
+#include "piglit-texref.h"
+
+#define NUM_COLORS 1024
+
+static const GLenum round_trip_formats[] = {
+	GL_R8, GL_RG16, GL_RGB565, GL_RGB5_A1, GL_RGBA4, GL_RGBA8,
+	GL_RGB10_A2, GL_RGBA16, GL_R8_SNORM, GL_RGBA8_SNORM, GL_RGBA16_SNORM,
+	GL_R16F, GL_RGBA16F, GL_RGBA32F, GL_R11F_G11F_B10F, GL_RGB9_E5,
+	GL_R8I, GL_RGBA8UI, GL_RGBA16I, GL_RGBA32UI, GL_RGB10_A2UI,
+	GL_ALPHA8, GL_LUMINANCE8, GL_LUMINANCE8_ALPHA8, GL_INTENSITY16,
+	GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT32F,
+};
+
+static bool
+check_round_trip(GLenum format)
+{
+	static float colors[NUM_COLORS * 4], decoded[NUM_COLORS * 4];
+	static uint32_t codes[NUM_COLORS * 4], again[NUM_COLORS * 4];
+	unsigned i;
+
+	/* Out of range on both sides, and integers for the integer
+	 * formats.
+	 */
+	for (i = 0; i < NUM_COLORS * 4; i++) {
+		float x = (float) i / (NUM_COLORS * 4 - 1) * 3.0f - 1.5f;
+
+		colors[i] = (i % 4 == 3) ? x * 300.0f : x;
+	}
+
+	if (!piglit_texref_encode(format, colors, codes, NUM_COLORS) ||
+	    !piglit_texref_decode(format, codes, decoded, NUM_COLORS) ||
+	    !piglit_texref_encode(format, decoded, again, NUM_COLORS)) {
+		printf("%s: not supported\n", piglit_get_gl_enum_name(format));
+		return false;
+	}
+
+	for (i = 0; i < NUM_COLORS * 4; i++) {
+		if (codes[i] != again[i]) {
+			printf("%s: code 0x%x of color %u channel %u decodes "
+			       "to %g, which encodes to 0x%x\n",
+			       piglit_get_gl_enum_name(format), codes[i],
+			       i / 4, i % 4, decoded[i], again[i]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool
+check_codes(GLenum format, const float *rgba, const uint32_t *expected)
+{
+	uint32_t codes[4];
+	int c;
+
+	piglit_texref_encode(format, rgba, codes, 1);
+	for (c = 0; c < 4; c++) {
+		if (codes[c] != expected[c]) {
+			printf("%s: (%g, %g, %g, %g) encodes to "
+			       "0x%x 0x%x 0x%x 0x%x, expected "
+			       "0x%x 0x%x 0x%x 0x%x\n",
+			       piglit_get_gl_enum_name(format),
+			       rgba[0], rgba[1], rgba[2], rgba[3],
+			       codes[0], codes[1], codes[2], codes[3],
+			       expected[0], expected[1], expected[2],
+			       expected[3]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool
+check_known_codes(void)
+{
+	static const float half[4] = { 0.5, 0.0, 1.0, -1.0 };
+	static const uint32_t rgba8[4] = { 128, 0, 255, 0 };
+	static const uint32_t rgb5_a1[4] = { 16, 0, 31, 0 };
+	static const uint32_t rgba8_snorm[4] = { 64, 0, 127, 0xffffff81 };
+	static const uint32_t rgba16f[4] = { 0x3800, 0, 0x3c00, 0xbc00 };
+	bool pass = true;
+
+	pass = check_codes(GL_RGBA8, half, rgba8) && pass;
+	pass = check_codes(GL_RGB5_A1, half, rgb5_a1) && pass;
+	pass = check_codes(GL_RGBA8_SNORM, half, rgba8_snorm) && pass;
+	pass = check_codes(GL_RGBA16F, half, rgba16f) && pass;
+
+	return pass;
+}
+
+static bool
+check_sample(GLenum wrap, GLenum filter, float s, float expected)
+{
+	static const float texels[4 * 4] = {
+		0, 0, 0, 1,
+		1, 0, 0, 1,
+		2, 0, 0, 1,
+		3, 0, 0, 1,
+	};
+	struct piglit_texref_texture tex;
+	const float coords[3] = { s, 0.0, 0.0 };
+	float rgba[4];
+
+	memset(&tex, 0, sizeof(tex));
+	tex.target = GL_TEXTURE_1D;
+	tex.width = 4;
+	tex.height = tex.depth = 1;
+	tex.texels = texels;
+	tex.wrap_s = tex.wrap_t = tex.wrap_r = wrap;
+	tex.filter = filter;
+	tex.border[0] = 10.0;
+	tex.border[3] = 1.0;
+
+	piglit_texref_sample(&tex, coords, rgba, 1);
+	if (rgba[0] != expected) {
+		printf("%s %s at s = %g: got %g, expected %g\n",
+		       piglit_get_gl_enum_name(wrap),
+		       piglit_get_gl_enum_name(filter), s, rgba[0], expected);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * A 4 texel wide 1D texture whose red is the texel's index, and 10 in
+ * the border.
+ */
+static bool
+check_wrap(void)
+{
+	bool pass = true;
+
+	pass = check_sample(GL_REPEAT, GL_NEAREST, -0.125, 3) && pass;
+	pass = check_sample(GL_REPEAT, GL_NEAREST, 1.125, 0) && pass;
+	pass = check_sample(GL_REPEAT, GL_LINEAR, 0.0, 1.5) && pass;
+	pass = check_sample(GL_MIRRORED_REPEAT, GL_NEAREST, -0.125, 0) && pass;
+	pass = check_sample(GL_MIRRORED_REPEAT, GL_NEAREST, 1.125, 3) && pass;
+	pass = check_sample(GL_MIRRORED_REPEAT, GL_NEAREST, 1.375, 2) && pass;
+	pass = check_sample(GL_CLAMP_TO_EDGE, GL_NEAREST, -0.5, 0) && pass;
+	pass = check_sample(GL_CLAMP_TO_EDGE, GL_NEAREST, 1.5, 3) && pass;
+	pass = check_sample(GL_CLAMP_TO_EDGE, GL_LINEAR, 0.0, 0) && pass;
+	pass = check_sample(GL_CLAMP_TO_BORDER, GL_NEAREST, -0.125, 10) && pass;
+	pass = check_sample(GL_CLAMP_TO_BORDER, GL_NEAREST, 1.125, 10) && pass;
+	pass = check_sample(GL_CLAMP_TO_BORDER, GL_LINEAR, 0.0, 5) && pass;
+	pass = check_sample(GL_CLAMP, GL_LINEAR, 0.0, 5) && pass;
+	pass = check_sample(GL_CLAMP, GL_LINEAR, -1.0, 5) && pass;
+	pass = check_sample(GL_CLAMP, GL_LINEAR, 2.0, 6.5) && pass;
+
+	return pass;
+}
+
+static bool
+check_level(float lambda, int base_level, int max_level, float min_lod,
+	    float max_lod, GLenum min_filter, int expected,
+	    float expected_frac)
+{
+	float frac;
+	int level = piglit_texref_select_level(lambda, base_level, max_level,
+					       min_lod, max_lod, min_filter,
+					       &frac);
+
+	if (level != expected || frac != expected_frac) {
+		printf("lambda %g, levels %d..%d, lod %g..%g, %s: got level "
+		       "%d + %g, expected %d + %g\n", lambda, base_level,
+		       max_level, min_lod, max_lod,
+		       piglit_get_gl_enum_name(min_filter), level, frac,
+		       expected, expected_frac);
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+check_select_level(void)
+{
+	const GLenum nearest = GL_NEAREST_MIPMAP_NEAREST;
+	const GLenum linear = GL_LINEAR_MIPMAP_LINEAR;
+	bool pass = true;
+
+	/* Magnification, and minification without mipmaps */
+	pass = check_level(-1.0, 2, 5, -1000, 1000, linear, 2, 0) && pass;
+	pass = check_level(3.0, 2, 5, -1000, 1000, GL_LINEAR, 2, 0) && pass;
+
+	/* Rounding to the nearest level */
+	pass = check_level(0.5, 0, 5, -1000, 1000, nearest, 0, 0) && pass;
+	pass = check_level(0.75, 0, 5, -1000, 1000, nearest, 1, 0) && pass;
+	pass = check_level(1.5, 0, 5, -1000, 1000, nearest, 1, 0) && pass;
+	pass = check_level(1.75, 1, 5, -1000, 1000, nearest, 3, 0) && pass;
+
+	/* Blending the two nearest levels */
+	pass = check_level(2.25, 1, 5, -1000, 1000, linear, 3, 0.25) && pass;
+
+	/* Clamping to the max level and to the lod range */
+	pass = check_level(10.0, 0, 5, -1000, 1000, nearest, 5, 0) && pass;
+	pass = check_level(10.0, 1, 5, -1000, 1000, linear, 5, 0) && pass;
+	pass = check_level(3.0, 0, 5, 0, 1, nearest, 1, 0) && pass;
+	pass = check_level(0.0, 1, 5, 2, 4, linear, 3, 0) && pass;
+
+	return pass;
+}
+
+int
+main(int argc, char **argv)
+{
+	bool pass = true;
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(round_trip_formats); i++)
+		pass = check_round_trip(round_trip_formats[i]) && pass;
+
+	pass = check_known_codes() && pass;
+	pass = check_wrap() && pass;
+	pass = check_select_level() && pass;
+
+	piglit_report_result(pass ? PIGLIT_PASS : PIGLIT_FAIL);
+}
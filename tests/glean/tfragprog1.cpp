@@ -44,6 +44,7 @@
 #include <cmath>
 #include <math.h>
 #include "tfragprog1.h"
+#include "piglit-util.h"
 
 
 namespace GLEAN {
@@ -1098,12 +1099,20 @@ FragmentProgramTest::runOne(MultiTestResult &r, Window &w)
 #if DEVEL_MODE
 			glViewport(0, i * 20, windowWidth, 20);
 #endif
-			if (!testProgram(Programs[i])) {
+			bool pass = testProgram(Programs[i]);
+
+			if (!pass) {
 				r.numFailed++;
 			}
 			else {
 				r.numPassed++;
 			}
+
+			// report each program when running all of them
+			if (!single)
+				piglit_report_subtest_result(
+					pass ? PIGLIT_PASS : PIGLIT_FAIL,
+					"%s", Programs[i].name);
 		}
 	}
 
@@ -37,3 +37,4 @@ with profile.group_manager(
 
 # These take too long
 profile.filter_tests(lambda n, _: '-explosion' not in n)
+profile.filter_tests(lambda n, _: not n.endswith('-selftest-exhaustive'))
@@ -24,6 +24,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <inttypes.h>
 
 #include "piglit-util.h"
 #include "piglit-util-gl.h"
@@ -41,17 +42,46 @@ decode_drawing_mode(const char *mode_str);
 static void
 get_uints(const char *line, unsigned *uints, unsigned count);
 
+static void
+default_config(struct piglit_gl_test_config *config);
+
+static void
+read_test_list(FILE *f);
+
+/**
+ * Scripts to run.  When more than one script is given, on the command
+ * line or as "-" followed by a list of file names on stdin, all of them
+ * are run in this process using the context created for the first one.
+ */
+static const char **test_scripts;
+static unsigned num_test_scripts;
+
+/** Context requirements the first script was run with. */
+static struct piglit_gl_test_config context_config;
+
+/** Print the compiled [test] section before running it. */
+static bool dump_commands;
+
 PIGLIT_GL_TEST_CONFIG_BEGIN
 
-	config.window_width = 250;
-	config.window_height = 250;
-	config.window_visual = PIGLIT_GL_VISUAL_RGBA | PIGLIT_GL_VISUAL_DOUBLE;
+	default_config(&config);
+
+	dump_commands = PIGLIT_STRIP_ARG("--dump-commands");
+	if (PIGLIT_STRIP_ARG("--no-program-cache"))
+		piglit_program_cache_bypass();
 
-	if (argc > 1)
+	if (argc > 1 && strcmp(argv[1], "-") == 0)
+		read_test_list(stdin);
+
+	if (num_test_scripts > 0)
+		get_required_config(test_scripts[0], &config);
+	else if (argc > 1)
 		get_required_config(argv[1], &config);
 	else
 		config.supports_gl_compat_version = 10;
 
+	context_config = config;
+
 PIGLIT_GL_TEST_CONFIG_END
 
 static const char passthrough_vertex_shader_source[] =
@@ -121,8 +151,20 @@ static GLuint *subuniform_locations[SHADER_TYPES];
 static int num_subuniform_locations[SHADER_TYPES];
 static char *shader_string;
 static GLint shader_string_size;
+
+/**
+ * GLSL shaders waiting to be compiled when the program is linked.  Only
+ * used with the program cache, so that cached programs aren't compiled.
+ */
+static struct deferred_shader {
+	GLenum target;
+	char *source;
+} *deferred_shaders;
+static unsigned num_deferred_shaders;
 static const char *vertex_data_start = NULL;
 static const char *vertex_data_end = NULL;
+static bool vertex_data_from_file = false;
+static const char *current_script;
 static GLuint prog;
 static GLuint sso_vertex_prog;
 static GLuint sso_tess_control_prog;
@@ -140,6 +182,8 @@ static GLchar *prog_err_info = NULL;
 static GLuint vao = 0;
 static GLuint fbo = 0;
 static GLint render_width, render_height;
+static char *test_text;
+static float default_tolerance[4];
 
 enum states {
 	none = 0,
@@ -359,72 +403,25 @@ target_to_short_name(GLenum target)
 }
 
 
+/**
+ * Compile a shader from an optional #version line followed by the source,
+ * and add it to the shaders of its stage.
+ */
 static void
-compile_glsl(GLenum target)
+compile_shader_strings(GLenum target, const char *version_string,
+		       const char *source, GLint source_size)
 {
 	GLuint shader = glCreateShader(target);
+	const GLchar *strings[2] = { version_string, source };
+	GLint sizes[2] = { strlen(version_string), source_size };
 	GLint ok;
 
-	switch (target) {
-	case GL_VERTEX_SHADER:
-		piglit_require_vertex_shader();
-		break;
-	case GL_FRAGMENT_SHADER:
-		piglit_require_fragment_shader();
-		break;
-	case GL_TESS_CONTROL_SHADER:
-	case GL_TESS_EVALUATION_SHADER:
-		if (gl_version.num < (gl_version.es ? 32 : 40))
-			piglit_require_extension(gl_version.es ?
-						 "GL_OES_tessellation_shader" :
-						 "GL_ARB_tessellation_shader");
-		break;
-	case GL_GEOMETRY_SHADER:
-		if (gl_version.num < 32)
-			piglit_require_extension(gl_version.es ?
-						 "GL_OES_geometry_shader" :
-						 "GL_ARB_geometry_shader4");
-		break;
-	case GL_COMPUTE_SHADER:
-		if (gl_version.num < (gl_version.es ? 31 : 43))
-			piglit_require_extension("GL_ARB_compute_shader");
-		break;
-	}
-
-	if (!glsl_req_version.num) {
-		printf("GLSL version requirement missing\n");
-		piglit_report_result(PIGLIT_FAIL);
-	}
-
-	if (!strstr(shader_string, "#version ")) {
-		char *shader_strings[2];
-		char version_string[100];
-		GLint shader_string_sizes[2];
-		
-		/* Add a #version directive based on the GLSL requirement. */
-		sprintf(version_string, "#version %d", glsl_req_version.num);
-		if (glsl_req_version.es && glsl_req_version.num != 100) {
-			strcat(version_string, " es");
-		}
-		strcat(version_string, "\n");
-		shader_strings[0] = version_string;
-		shader_string_sizes[0] = strlen(version_string);
-		shader_strings[1] = shader_string;
-		shader_string_sizes[1] = shader_string_size;
-		
-		glShaderSource(shader, 2,
-				    (const GLchar **) shader_strings,
-				    shader_string_sizes);
-
-	} else {
-		glShaderSource(shader, 1,
-				    (const GLchar **) &shader_string,
-				    &shader_string_size);
-	}
-
+	piglit_phase_push(PIGLIT_PHASE_COMPILE);
+	glShaderSource(shader, 2, strings, sizes);
 	glCompileShader(shader);
 
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+	piglit_phase_pop();
 
 	if (!ok) {
 		GLchar *info;
@@ -471,6 +468,108 @@ compile_glsl(GLenum target)
 	}
 }
 
+/**
+ * Put off compiling the current shader_string until the program is
+ * linked, the compile isn't needed if the program is in the cache.
+ */
+static void
+defer_shader(GLenum target, const char *version_string)
+{
+	struct deferred_shader *shader;
+	size_t version_len = strlen(version_string);
+
+	deferred_shaders = realloc(deferred_shaders,
+				   (num_deferred_shaders + 1) *
+				   sizeof(*deferred_shaders));
+	shader = &deferred_shaders[num_deferred_shaders++];
+
+	shader->target = target;
+	shader->source = malloc(version_len + shader_string_size + 1);
+	memcpy(shader->source, version_string, version_len);
+	memcpy(shader->source + version_len, shader_string, shader_string_size);
+	shader->source[version_len + shader_string_size] = '\0';
+}
+
+static void
+free_deferred_shaders(void)
+{
+	unsigned i;
+
+	for (i = 0; i < num_deferred_shaders; i++)
+		free(deferred_shaders[i].source);
+	free(deferred_shaders);
+	deferred_shaders = NULL;
+	num_deferred_shaders = 0;
+}
+
+static void
+compile_deferred_shaders(void)
+{
+	unsigned i;
+
+	for (i = 0; i < num_deferred_shaders; i++) {
+		compile_shader_strings(deferred_shaders[i].target, "",
+				       deferred_shaders[i].source,
+				       strlen(deferred_shaders[i].source));
+	}
+
+	free_deferred_shaders();
+}
+
+static void
+compile_glsl(GLenum target)
+{
+	char version_string[100] = "";
+
+	switch (target) {
+	case GL_VERTEX_SHADER:
+		piglit_require_vertex_shader();
+		break;
+	case GL_FRAGMENT_SHADER:
+		piglit_require_fragment_shader();
+		break;
+	case GL_TESS_CONTROL_SHADER:
+	case GL_TESS_EVALUATION_SHADER:
+		if (gl_version.num < (gl_version.es ? 32 : 40))
+			piglit_require_extension(gl_version.es ?
+						 "GL_OES_tessellation_shader" :
+						 "GL_ARB_tessellation_shader");
+		break;
+	case GL_GEOMETRY_SHADER:
+		if (gl_version.num < 32)
+			piglit_require_extension(gl_version.es ?
+						 "GL_OES_geometry_shader" :
+						 "GL_ARB_geometry_shader4");
+		break;
+	case GL_COMPUTE_SHADER:
+		if (gl_version.num < (gl_version.es ? 31 : 43))
+			piglit_require_extension("GL_ARB_compute_shader");
+		break;
+	}
+
+	if (!glsl_req_version.num) {
+		printf("GLSL version requirement missing\n");
+		piglit_report_result(PIGLIT_FAIL);
+	}
+
+	if (!strstr(shader_string, "#version ")) {
+		/* Add a #version directive based on the GLSL requirement. */
+		sprintf(version_string, "#version %d", glsl_req_version.num);
+		if (glsl_req_version.es && glsl_req_version.num != 100) {
+			strcat(version_string, " es");
+		}
+		strcat(version_string, "\n");
+	}
+
+	if (!sso_in_use && piglit_program_cache_enabled()) {
+		defer_shader(target, version_string);
+		return;
+	}
+
+	compile_shader_strings(target, version_string,
+			       shader_string, shader_string_size);
+}
+
 static void
 compile_and_bind_program(GLenum target, const char *start, int len)
 {
@@ -708,8 +807,11 @@ parse_version_comparison(const char *line, enum comparison *cmp,
 
 /**
  * Parse and check a line from the requirement section of the test
+ *
+ * Returns PIGLIT_SKIP if the requirement is not met so that a run of
+ * several scripts can carry on with the next one.
  */
-static void
+static enum piglit_result
 process_requirement(const char *line)
 {
 	char buffer[4096];
@@ -777,10 +879,10 @@ process_requirement(const char *line)
 			       comparison_string(cmp),
 			       comparison_value,
 			       gl_int_value);
-			piglit_report_result(PIGLIT_SKIP);
+			return PIGLIT_SKIP;
 		}
 
-		return;
+		return PIGLIT_PASS;
 	}
 
 	/* There are five types of requirements that a test can currently
@@ -816,9 +918,9 @@ process_requirement(const char *line)
 			       comparison_string(cmp),
 			       maxcomp,
 			       *getint_limits[i].val);
-			piglit_report_result(PIGLIT_SKIP);
+			return PIGLIT_SKIP;
 		}
-		return;
+		return PIGLIT_PASS;
 	}
 
 	/* Consume any leading whitespace before requirements. This is
@@ -828,10 +930,16 @@ process_requirement(const char *line)
 
 	if (string_match("GL_", line)) {
 		strcpy_to_space(buffer, line);
-		piglit_require_extension(buffer);
+		if (!piglit_is_extension_supported(buffer)) {
+			printf("Test requires %s\n", buffer);
+			return PIGLIT_SKIP;
+		}
 	} else if (string_match("!GL_", line)) {
 		strcpy_to_space(buffer, line + 1);
-		piglit_require_not_extension(buffer);
+		if (piglit_is_extension_supported(buffer)) {
+			printf("Test requires %s not be supported\n", buffer);
+			return PIGLIT_SKIP;
+		}
 	} else if (string_match("GLSL", line)) {
 		enum comparison cmp;
 
@@ -851,7 +959,7 @@ process_requirement(const char *line)
 			       comparison_string(cmp),
 			       version_string(&glsl_req_version),
 			       version_string(&glsl_version));
-			piglit_report_result(PIGLIT_SKIP);
+			return PIGLIT_SKIP;
 		}
 	} else if (string_match("GL", line)) {
 		enum comparison cmp;
@@ -866,7 +974,7 @@ process_requirement(const char *line)
 			       comparison_string(cmp),
 			       version_string(&gl_req_version),
 			       version_string(&gl_version));
-			piglit_report_result(PIGLIT_SKIP);
+			return PIGLIT_SKIP;
 		}
 	} else if (string_match("rlimit", line)) {
 		unsigned long lim;
@@ -884,10 +992,15 @@ process_requirement(const char *line)
 	}  else if (string_match("SSO", line)) {
 		line = eat_whitespace(line + 3);
 		if (string_match("ENABLED", line)) {
-			piglit_require_extension("GL_ARB_separate_shader_objects");
+			if (!piglit_is_extension_supported("GL_ARB_separate_shader_objects")) {
+				printf("Test requires GL_ARB_separate_shader_objects\n");
+				return PIGLIT_SKIP;
+			}
 			sso_in_use = true;
 		}
 	}
+
+	return PIGLIT_PASS;
 }
 
 
@@ -1032,13 +1145,52 @@ process_shader(GLenum target, unsigned num_shaders, GLuint *shaders)
 }
 
 
+/**
+ * The cache key of the program made of the deferred shaders.  It covers
+ * everything that is set on the program before it is linked.
+ */
+static void
+program_cache_key(struct piglit_program_cache_key *key)
+{
+	unsigned i;
+
+	piglit_program_cache_key_init(key);
+
+	for (i = 0; i < num_deferred_shaders; i++) {
+		piglit_program_cache_key_add_int(key,
+						 deferred_shaders[i].target);
+		piglit_program_cache_key_add_string(key,
+						    deferred_shaders[i].source);
+	}
+
+	piglit_program_cache_key_add_int(key, geometry_layout_input_type);
+	piglit_program_cache_key_add_int(key, geometry_layout_output_type);
+	piglit_program_cache_key_add_int(key, geometry_layout_vertices_out);
+}
+
 static void
 link_and_use_shaders(void)
 {
+	struct piglit_program_cache_key key;
+	const bool cache = num_deferred_shaders > 0;
 	unsigned i;
 	GLenum err;
 	GLint ok;
 
+	if (cache) {
+		prog = glCreateProgram();
+		program_cache_key(&key);
+
+		if (piglit_program_cache_load(prog, &key)) {
+			free_deferred_shaders();
+			link_ok = true;
+			glUseProgram(prog);
+			goto check_use;
+		}
+
+		compile_deferred_shaders();
+	}
+
 	if ((num_vertex_shaders == 0)
 	    && (num_fragment_shaders == 0)
 	    && (num_tess_ctrl_shaders == 0)
@@ -1047,7 +1199,7 @@ link_and_use_shaders(void)
 	    && (num_compute_shaders == 0))
 		return;
 
-	if (!sso_in_use)
+	if (!sso_in_use && !cache)
 		prog = glCreateProgram();
 
 	process_shader(GL_VERTEX_SHADER, num_vertex_shaders, vertex_shaders);
@@ -1099,9 +1251,13 @@ link_and_use_shaders(void)
 			return;
 		}
 
+		if (cache)
+			piglit_program_cache_store(prog, &key);
+
 		glUseProgram(prog);
 	}
 
+check_use:
 	err = glGetError();
 	if (!err) {
 		prog_in_use = true;
@@ -1116,13 +1272,15 @@ link_and_use_shaders(void)
 }
 
 
-static void
+static enum piglit_result
 process_test_script(const char *script_name)
 {
 	unsigned text_size;
-	char *text = piglit_load_text_file(script_name, &text_size);
 	enum states state = none;
-	const char *line = text;
+	const char *line;
+
+	test_text = piglit_load_text_file(script_name, &text_size);
+	line = test_text;
 
 	if (line == NULL) {
 		printf("could not read file \"%s\"\n", script_name);
@@ -1170,11 +1328,16 @@ process_test_script(const char *script_name)
 			} else if (string_match("[vertex data]", line)) {
 				state = vertex_data;
 				vertex_data_start = NULL;
+				vertex_data_from_file = false;
+			} else if (string_match("[vertex data file]", line)) {
+				state = vertex_data;
+				vertex_data_start = NULL;
+				vertex_data_from_file = true;
 			} else if (string_match("[test]", line)) {
 				test_start = strchrnul(line, '\n');
 				if (test_start[0] != '\0')
 					test_start++;
-				return;
+				return PIGLIT_PASS;
 			} else {
 				fprintf(stderr,
 					"Unknown section in test script.  "
@@ -1187,9 +1350,14 @@ process_test_script(const char *script_name)
 			case vertex_shader_passthrough:
 				break;
 
-			case requirements:
-				process_requirement(line);
+			case requirements: {
+				enum piglit_result result =
+					process_requirement(line);
+
+				if (result != PIGLIT_PASS)
+					return result;
 				break;
+			}
 
 			case geometry_layout:
 				process_geometry_layout(line);
@@ -1223,6 +1391,8 @@ process_test_script(const char *script_name)
 	}
 
 	leave_state(state, line);
+
+	return PIGLIT_PASS;
 }
 
 struct requirement_parse_results {
@@ -1386,6 +1556,67 @@ get_required_config(const char *script_name,
 	}
 }
 
+static void
+default_config(struct piglit_gl_test_config *config)
+{
+	config->window_width = 250;
+	config->window_height = 250;
+	config->window_visual = PIGLIT_GL_VISUAL_RGBA | PIGLIT_GL_VISUAL_DOUBLE;
+}
+
+/**
+ * Read the names of the scripts to run from \p f, one per line.
+ */
+static void
+read_test_list(FILE *f)
+{
+	unsigned capacity = 0;
+	char buf[4096];
+
+	while (fgets(buf, sizeof(buf), f) != NULL) {
+		size_t len = strlen(buf);
+
+		while (len > 0 && isspace((unsigned char) buf[len - 1]))
+			buf[--len] = '\0';
+
+		if (len == 0)
+			continue;
+
+		if (num_test_scripts == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			test_scripts = realloc(test_scripts,
+					       capacity * sizeof(char *));
+		}
+
+		test_scripts[num_test_scripts++] = strdup(buf);
+	}
+}
+
+/**
+ * Determine whether a script can run in the context that was created for
+ * the first script, i.e. whether it would have asked for the same GL
+ * version, profile, window size and visual.
+ */
+static bool
+config_is_compatible(const char *script_name)
+{
+	struct piglit_gl_test_config config;
+
+	piglit_gl_test_config_init(&config);
+	default_config(&config);
+	get_required_config(script_name, &config);
+
+	return config.supports_gl_compat_version ==
+		context_config.supports_gl_compat_version &&
+	       config.supports_gl_core_version ==
+		context_config.supports_gl_core_version &&
+	       config.supports_gl_es_version ==
+		context_config.supports_gl_es_version &&
+	       config.window_width == context_config.window_width &&
+	       config.window_height == context_config.window_height &&
+	       config.window_visual == context_config.window_visual;
+}
+
 static void
 get_floats(const char *line, float *f, unsigned count)
 {
@@ -1489,198 +1720,294 @@ check_shader_subroutine_support(void)
 		piglit_report_result(PIGLIT_SKIP);
 }
 
+enum uniform_base {
+	UNIFORM_FLOAT,
+	UNIFORM_DOUBLE,
+	UNIFORM_INT,
+	UNIFORM_UINT,
+	UNIFORM_INT64,
+	UNIFORM_UINT64,
+};
+
 /**
- * Handles uploads of UBO uniforms by mapping the buffer and storing
- * the data.  If the uniform is not in a uniform block, returns false.
+ * A "uniform" command of the [test] section, with its value already
+ * converted.  Scalars and vectors have a single column.
  */
-static bool
-set_ubo_uniform(char *name, const char *type, const char *line, int ubo_array_index)
-{
+struct uniform_command {
+	char name[512];
+	char type[32];
+	enum uniform_base base;
+	unsigned columns;
+	unsigned rows;
+	bool matrix;
+
+	/** Location in the current program, -1 until looked up. */
+	GLint loc;
+
+	/** Uniform block layout, looked up the first time it is set. */
+	bool ubo_resolved;
 	GLuint uniform_index;
 	GLint block_index;
 	GLint offset;
-	GLint array_index = 0;
-	char *data;
-	float f[16];
-	double d[16];
-	int ints[16];
-	unsigned uints[16];
-	uint64_t uint64s[16];
-	int64_t int64s[16];
-	int name_len = strlen(name);
-
-	if (!num_uniform_blocks)
-		return false;
-
-	/* if the uniform is an array, strip the index, as GL
-	   prevents non-zero indexes from matching a name */
-	if (name[name_len - 1] == ']') {
-		int i;
+	GLint matrix_stride;
+	GLint row_major;
+
+	union {
+		float f[16];
+		double d[16];
+		int i[16];
+		unsigned u[16];
+		int64_t i64[16];
+		uint64_t u64[16];
+	} values;
+};
 
-		for (i = name_len - 1; (i > 0) && isdigit(name[i-1]); --i)
-			/* empty */;
+/**
+ * Parse the type and value of a "uniform" command.  The location is
+ * looked up the first time the uniform is set, see set_uniform().
+ */
+static struct uniform_command *
+parse_uniform(const char *line)
+{
+	struct uniform_command *u = calloc(1, sizeof(*u));
+	const char *type;
+	bool vector = false;
+	unsigned count;
 
-		array_index = strtol(&name[i], NULL, 0);
+	type = eat_whitespace(line);
+	line = eat_text(type);
+	line = strcpy_to_space(u->name, eat_whitespace(line));
+	strcpy_to_space(u->type, type);
 
-		if (i) {
-			i--;
-			if (name[i] != '[') {
-				printf("cannot parse uniform \"%s\"\n", name);
-				piglit_report_result(PIGLIT_FAIL);
-			}
-			name[i] = 0;
-		}
+	u->columns = 1;
+	u->rows = 1;
 
+	if (string_match("float", type)) {
+		u->base = UNIFORM_FLOAT;
+	} else if (string_match("int64_t", type)) {
+		u->base = UNIFORM_INT64;
+	} else if (string_match("uint64_t", type)) {
+		u->base = UNIFORM_UINT64;
+	} else if (string_match("int", type)) {
+		u->base = UNIFORM_INT;
+	} else if (string_match("uint", type)) {
+		u->base = UNIFORM_UINT;
+	} else if (string_match("double", type)) {
+		u->base = UNIFORM_DOUBLE;
+	} else if (string_match("vec", type)) {
+		u->base = UNIFORM_FLOAT;
+		vector = true;
+		u->rows = type[3] - '0';
+	} else if (string_match("ivec", type)) {
+		u->base = UNIFORM_INT;
+		vector = true;
+		u->rows = type[4] - '0';
+	} else if (string_match("uvec", type)) {
+		u->base = UNIFORM_UINT;
+		vector = true;
+		u->rows = type[4] - '0';
+	} else if (string_match("dvec", type)) {
+		u->base = UNIFORM_DOUBLE;
+		vector = true;
+		u->rows = type[4] - '0';
+	} else if (string_match("i64vec", type)) {
+		u->base = UNIFORM_INT64;
+		vector = true;
+		u->rows = type[6] - '0';
+	} else if (string_match("u64vec", type)) {
+		u->base = UNIFORM_UINT64;
+		vector = true;
+		u->rows = type[6] - '0';
+	} else if (string_match("mat", type) && type[3] != '\0') {
+		u->base = UNIFORM_FLOAT;
+		u->columns = type[3] - '0';
+		u->rows = type[4] == 'x' ? type[5] - '0' : u->columns;
+		u->matrix = true;
+	} else if (string_match("dmat", type) && type[4] != '\0') {
+		u->base = UNIFORM_DOUBLE;
+		u->columns = type[4] - '0';
+		u->rows = type[5] == 'x' ? type[6] - '0' : u->columns;
+		u->matrix = true;
+	} else {
+		u->rows = 0;
 	}
 
-
-	glGetUniformIndices(prog, 1, (const char **)&name, &uniform_index);
-	if (uniform_index == GL_INVALID_INDEX) {
-		printf("cannot get index of uniform \"%s\"\n", name);
+	if (u->rows < 1 || u->rows > 4 || (vector && u->rows < 2) ||
+	    (u->matrix && (u->columns < 2 || u->columns > 4 || u->rows < 2))) {
+		printf("unknown uniform type \"%s\"\n", u->type);
 		piglit_report_result(PIGLIT_FAIL);
 	}
 
-	glGetActiveUniformsiv(prog, 1, &uniform_index,
-			      GL_UNIFORM_BLOCK_INDEX, &block_index);
+	count = u->columns * u->rows;
+	switch (u->base) {
+	case UNIFORM_FLOAT:
+		get_floats(line, u->values.f, count);
+		break;
+	case UNIFORM_DOUBLE:
+		get_doubles(line, u->values.d, count);
+		break;
+	case UNIFORM_INT:
+		get_ints(line, u->values.i, count);
+		break;
+	case UNIFORM_UINT:
+		get_uints(line, u->values.u, count);
+		break;
+	case UNIFORM_INT64:
+		get_int64s(line, u->values.i64, count);
+		break;
+	case UNIFORM_UINT64:
+		get_uint64s(line, u->values.u64, count);
+		break;
+	}
 
-	if (block_index == -1)
-		return false;
+	u->loc = -1;
+	return u;
+}
 
-	/* if the uniform block is an array, then GetActiveUniformsiv with
-	 * UNIFORM_BLOCK_INDEX will have given us the index of the first
-	 * element in the array.
-	 */
-	block_index += ubo_array_index;
+/**
+ * Size in bytes of one component of a uniform.
+ */
+static size_t
+uniform_component_size(const struct uniform_command *u)
+{
+	switch (u->base) {
+	case UNIFORM_FLOAT:
+	case UNIFORM_INT:
+	case UNIFORM_UINT:
+		return 4;
+	case UNIFORM_DOUBLE:
+	case UNIFORM_INT64:
+	case UNIFORM_UINT64:
+		return 8;
+	}
+
+	return 0;
+}
+
+/**
+ * Look up whether the uniform lives in a uniform block, and where.
+ * Only done the first time the uniform is set.
+ */
+static void
+resolve_ubo_uniform(struct uniform_command *u)
+{
+	char name[512];
+	const char *names[1] = { name };
+	GLint array_index = 0;
+	int name_len = strlen(u->name);
+
+	u->ubo_resolved = true;
+	u->block_index = -1;
 
-	glGetActiveUniformsiv(prog, 1, &uniform_index,
-			      GL_UNIFORM_OFFSET, &offset);
+	if (!num_uniform_blocks)
+		return;
 
+	strcpy(name, u->name);
+
+	/* if the uniform is an array, strip the index, as GL
+	   prevents non-zero indexes from matching a name */
 	if (name[name_len - 1] == ']') {
-		GLint stride;
+		int i;
+
+		for (i = name_len - 1; (i > 0) && isdigit(name[i-1]); --i)
+			/* empty */;
+
+		array_index = strtol(&name[i], NULL, 0);
+
+		if (i) {
+			i--;
+			if (name[i] != '[') {
+				printf("cannot parse uniform \"%s\"\n", name);
+				piglit_report_result(PIGLIT_FAIL);
+			}
+			name[i] = 0;
+		}
 
-		glGetActiveUniformsiv(prog, 1, &uniform_index,
-				      GL_UNIFORM_ARRAY_STRIDE, &stride);
-		offset += stride * array_index;
 	}
 
-	glBindBuffer(GL_UNIFORM_BUFFER,
-		     uniform_block_bos[block_index]);
-	data = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
-	data += offset;
+	glGetUniformIndices(prog, 1, names, &u->uniform_index);
+	if (u->uniform_index == GL_INVALID_INDEX) {
+		printf("cannot get index of uniform \"%s\"\n", name);
+		piglit_report_result(PIGLIT_FAIL);
+	}
 
-	if (string_match("float", type)) {
-		get_floats(line, f, 1);
-		memcpy(data, f, sizeof(float));
-	} else if (string_match("int64_t", type)) {
-		get_int64s(line, int64s, 1);
-		memcpy(data, int64s, sizeof(int64_t));
-	} else if (string_match("uint64_t", type)) {
-		get_uint64s(line, uint64s, 1);
-		memcpy(data, uint64s, sizeof(uint64_t));
-	} else if (string_match("int", type)) {
-		get_ints(line, ints, 1);
-		memcpy(data, ints, sizeof(int));
-	} else if (string_match("uint", type)) {
-		get_uints(line, uints, 1);
-		memcpy(data, uints, sizeof(int));
-	} else if (string_match("double", type)) {
-		get_doubles(line, d, 1);
-		memcpy(data, d, sizeof(double));
-	} else if (string_match("vec", type)) {
-		int elements = type[3] - '0';
-		get_floats(line, f, elements);
-		memcpy(data, f, elements * sizeof(float));
-	} else if (string_match("ivec", type)) {
-		int elements = type[4] - '0';
-		get_ints(line, ints, elements);
-		memcpy(data, ints, elements * sizeof(int));
-	} else if (string_match("uvec", type)) {
-		int elements = type[4] - '0';
-		get_uints(line, uints, elements);
-		memcpy(data, uints, elements * sizeof(unsigned));
-	} else if (string_match("i64vec", type)) {
-		int elements = type[6] - '0';
-		get_int64s(line, int64s, elements);
-		memcpy(data, int64s, elements * sizeof(int64_t));
-	} else if (string_match("u64vec", type)) {
-		int elements = type[6] - '0';
-		get_uint64s(line, uint64s, elements);
-		memcpy(data, uint64s, elements * sizeof(uint64_t));
-	} else if (string_match("dvec", type)) {
-		int elements = type[4] - '0';
-		get_doubles(line, d, elements);
-		memcpy(data, d, elements * sizeof(double));
-	} else if (string_match("mat", type)) {
-		GLint matrix_stride, row_major;
-		int cols = type[3] - '0';
-		int rows = type[4] == 'x' ? type[5] - '0' : cols;
-		int r, c;
-		float *matrixdata = (float *)data;
+	glGetActiveUniformsiv(prog, 1, &u->uniform_index,
+			      GL_UNIFORM_BLOCK_INDEX, &u->block_index);
 
-		assert(cols >= 2 && cols <= 4);
-		assert(rows >= 2 && rows <= 4);
+	if (u->block_index == -1)
+		return;
+
+	glGetActiveUniformsiv(prog, 1, &u->uniform_index,
+			      GL_UNIFORM_OFFSET, &u->offset);
+
+	if (name_len != strlen(name)) {
+		GLint stride;
 
-		get_floats(line, f, rows * cols);
+		glGetActiveUniformsiv(prog, 1, &u->uniform_index,
+				      GL_UNIFORM_ARRAY_STRIDE, &stride);
+		u->offset += stride * array_index;
+	}
 
-		glGetActiveUniformsiv(prog, 1, &uniform_index,
-				      GL_UNIFORM_MATRIX_STRIDE, &matrix_stride);
-		glGetActiveUniformsiv(prog, 1, &uniform_index,
-				      GL_UNIFORM_IS_ROW_MAJOR, &row_major);
+	if (u->matrix) {
+		glGetActiveUniformsiv(prog, 1, &u->uniform_index,
+				      GL_UNIFORM_MATRIX_STRIDE,
+				      &u->matrix_stride);
+		glGetActiveUniformsiv(prog, 1, &u->uniform_index,
+				      GL_UNIFORM_IS_ROW_MAJOR, &u->row_major);
+	}
+}
 
-		matrix_stride /= sizeof(float);
+/**
+ * Handles uploads of UBO uniforms by mapping the buffer and storing
+ * the data.  If the uniform is not in a uniform block, returns false.
+ */
+static bool
+set_ubo_uniform(struct uniform_command *u, int ubo_array_index)
+{
+	const size_t size = uniform_component_size(u);
+	const char *values = (const char *) &u->values;
+	char *data;
+	GLint block_index;
 
-		/* Expect the data in the .shader_test file to be listed in
-		 * column-major order no matter what the layout of the data in
-		 * the UBO will be.
-		 */
-		for (c = 0; c < cols; c++) {
-			for (r = 0; r < rows; r++) {
-				if (row_major) {
-					matrixdata[matrix_stride * r + c] =
-						f[c * rows + r];
-				} else {
-					matrixdata[matrix_stride * c + r] =
-						f[c * rows + r];
-				}
-			}
-		}
-	} else if (string_match("dmat", type)) {
-		GLint matrix_stride, row_major;
-		int cols = type[4] - '0';
-		int rows = type[5] == 'x' ? type[6] - '0' : cols;
-		int r, c;
-		double *matrixdata = (double *)data;
+	if (!u->ubo_resolved)
+		resolve_ubo_uniform(u);
 
-		assert(cols >= 2 && cols <= 4);
-		assert(rows >= 2 && rows <= 4);
+	if (u->block_index == -1)
+		return false;
 
-		get_doubles(line, d, rows * cols);
+	/* if the uniform block is an array, then GetActiveUniformsiv with
+	 * UNIFORM_BLOCK_INDEX will have given us the index of the first
+	 * element in the array.
+	 */
+	block_index = u->block_index + ubo_array_index;
 
-		glGetActiveUniformsiv(prog, 1, &uniform_index,
-				      GL_UNIFORM_MATRIX_STRIDE, &matrix_stride);
-		glGetActiveUniformsiv(prog, 1, &uniform_index,
-				      GL_UNIFORM_IS_ROW_MAJOR, &row_major);
+	glBindBuffer(GL_UNIFORM_BUFFER,
+		     uniform_block_bos[block_index]);
+	data = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
+	data += u->offset;
 
-		matrix_stride /= sizeof(double);
+	if (u->matrix) {
+		unsigned r, c;
 
 		/* Expect the data in the .shader_test file to be listed in
 		 * column-major order no matter what the layout of the data in
 		 * the UBO will be.
 		 */
-		for (c = 0; c < cols; c++) {
-			for (r = 0; r < rows; r++) {
-				if (row_major) {
-					matrixdata[matrix_stride * r + c] =
-						d[c * rows + r];
-				} else {
-					matrixdata[matrix_stride * c + r] =
-						d[c * rows + r];
-				}
+		for (c = 0; c < u->columns; c++) {
+			for (r = 0; r < u->rows; r++) {
+				const unsigned i = c * u->rows + r;
+				size_t offset;
+
+				if (u->row_major)
+					offset = u->matrix_stride * r + c * size;
+				else
+					offset = u->matrix_stride * c + r * size;
+
+				memcpy(data + offset, values + i * size, size);
 			}
 		}
 	} else {
-		printf("unknown uniform type \"%s\" for \"%s\"\n", type, name);
-		piglit_report_result(PIGLIT_FAIL);
+		memcpy(data, values, u->rows * size);
 	}
 
 	glUnmapBuffer(GL_UNIFORM_BUFFER);
@@ -1689,269 +2016,108 @@ set_ubo_uniform(char *name, const char *type, const char *line, int ubo_array_in
 }
 
 static void
-set_uniform(const char *line, int ubo_array_index)
+set_uniform(struct uniform_command *u, int ubo_array_index)
 {
-	char name[512];
-	float f[16];
-	double d[16];
-	int ints[16];
-	unsigned uints[16];
-	int64_t int64s[16];
-	uint64_t uint64s[16];
 	GLint loc;
-	const char *type;
-
-	type = eat_whitespace(line);
-	line = eat_text(type);
 
-	line = strcpy_to_space(name, eat_whitespace(line));
-
-	if (isdigit(name[0])) {
-		loc = strtol(name, NULL, 0);
+	if (isdigit(u->name[0])) {
+		loc = strtol(u->name, NULL, 0);
 	} else {
 		GLuint prog;
 
-		if (set_ubo_uniform(name, type, line, ubo_array_index))
+		if (set_ubo_uniform(u, ubo_array_index))
 			return;
 
-		glGetIntegerv(GL_CURRENT_PROGRAM, (GLint *) &prog);
-		loc = glGetUniformLocation(prog, name);
-		if (loc < 0) {
-			printf("cannot get location of uniform \"%s\"\n",
-			       name);
-			piglit_report_result(PIGLIT_FAIL);
+		/* The program doesn't change while the [test] section
+		 * runs, so the location only has to be looked up once.
+		 */
+		if (u->loc < 0) {
+			glGetIntegerv(GL_CURRENT_PROGRAM, (GLint *) &prog);
+			u->loc = glGetUniformLocation(prog, u->name);
+			if (u->loc < 0) {
+				printf("cannot get location of uniform \"%s\"\n",
+				       u->name);
+				piglit_report_result(PIGLIT_FAIL);
+			}
 		}
-        }
+		loc = u->loc;
+	}
 
-	if (string_match("float", type)) {
-		get_floats(line, f, 1);
-		glUniform1fv(loc, 1, f);
-		return;
-	} else if (string_match("int64_t", type)) {
-		check_int64_support();
-		get_int64s(line, int64s, 1);
-		glUniform1i64vARB(loc, 1, int64s);
-		return;
-	} else if (string_match("uint64_t", type)) {
-		check_int64_support();
-		get_uint64s(line, uint64s, 1);
-		glUniform1ui64vARB(loc, 1, uint64s);
-		return;
-	} else if (string_match("int", type)) {
-		get_ints(line, ints, 1);
-		glUniform1iv(loc, 1, ints);
-		return;
-	} else if (string_match("uint", type)) {
-		check_unsigned_support();
-		get_uints(line, uints, 1);
-		glUniform1uiv(loc, 1, uints);
-		return;
-	} else if (string_match("double", type)) {
+	switch (u->base) {
+	case UNIFORM_FLOAT:
+		switch (u->columns * 10 + u->rows) {
+		case 11: glUniform1fv(loc, 1, u->values.f); return;
+		case 12: glUniform2fv(loc, 1, u->values.f); return;
+		case 13: glUniform3fv(loc, 1, u->values.f); return;
+		case 14: glUniform4fv(loc, 1, u->values.f); return;
+		case 22: glUniformMatrix2fv(loc, 1, GL_FALSE, u->values.f); return;
+		case 23: glUniformMatrix2x3fv(loc, 1, GL_FALSE, u->values.f); return;
+		case 24: glUniformMatrix2x4fv(loc, 1, GL_FALSE, u->values.f); return;
+		case 32: glUniformMatrix3x2fv(loc, 1, GL_FALSE, u->values.f); return;
+		case 33: glUniformMatrix3fv(loc, 1, GL_FALSE, u->values.f); return;
+		case 34: glUniformMatrix3x4fv(loc, 1, GL_FALSE, u->values.f); return;
+		case 42: glUniformMatrix4x2fv(loc, 1, GL_FALSE, u->values.f); return;
+		case 43: glUniformMatrix4x3fv(loc, 1, GL_FALSE, u->values.f); return;
+		case 44: glUniformMatrix4fv(loc, 1, GL_FALSE, u->values.f); return;
+		}
+		break;
+	case UNIFORM_DOUBLE:
 		check_double_support();
-		get_doubles(line, d, 1);
-		glUniform1dv(loc, 1, d);
-		return;
-	} else if (string_match("vec", type)) {
-		switch (type[3]) {
-		case '2':
-			get_floats(line, f, 2);
-			glUniform2fv(loc, 1, f);
-			return;
-		case '3':
-			get_floats(line, f, 3);
-			glUniform3fv(loc, 1, f);
-			return;
-		case '4':
-			get_floats(line, f, 4);
-			glUniform4fv(loc, 1, f);
-			return;
+		switch (u->columns * 10 + u->rows) {
+		case 11: glUniform1dv(loc, 1, u->values.d); return;
+		case 12: glUniform2dv(loc, 1, u->values.d); return;
+		case 13: glUniform3dv(loc, 1, u->values.d); return;
+		case 14: glUniform4dv(loc, 1, u->values.d); return;
+		case 22: glUniformMatrix2dv(loc, 1, GL_FALSE, u->values.d); return;
+		case 23: glUniformMatrix2x3dv(loc, 1, GL_FALSE, u->values.d); return;
+		case 24: glUniformMatrix2x4dv(loc, 1, GL_FALSE, u->values.d); return;
+		case 32: glUniformMatrix3x2dv(loc, 1, GL_FALSE, u->values.d); return;
+		case 33: glUniformMatrix3dv(loc, 1, GL_FALSE, u->values.d); return;
+		case 34: glUniformMatrix3x4dv(loc, 1, GL_FALSE, u->values.d); return;
+		case 42: glUniformMatrix4x2dv(loc, 1, GL_FALSE, u->values.d); return;
+		case 43: glUniformMatrix4x3dv(loc, 1, GL_FALSE, u->values.d); return;
+		case 44: glUniformMatrix4dv(loc, 1, GL_FALSE, u->values.d); return;
 		}
-	} else if (string_match("ivec", type)) {
-		switch (type[4]) {
-		case '2':
-			get_ints(line, ints, 2);
-			glUniform2iv(loc, 1, ints);
-			return;
-		case '3':
-			get_ints(line, ints, 3);
-			glUniform3iv(loc, 1, ints);
-			return;
-		case '4':
-			get_ints(line, ints, 4);
-			glUniform4iv(loc, 1, ints);
-			return;
+		break;
+	case UNIFORM_INT:
+		switch (u->rows) {
+		case 1: glUniform1iv(loc, 1, u->values.i); return;
+		case 2: glUniform2iv(loc, 1, u->values.i); return;
+		case 3: glUniform3iv(loc, 1, u->values.i); return;
+		case 4: glUniform4iv(loc, 1, u->values.i); return;
 		}
-	} else if (string_match("uvec", type)) {
+		break;
+	case UNIFORM_UINT:
 		check_unsigned_support();
-		switch (type[4]) {
-		case '2':
-			get_uints(line, uints, 2);
-			glUniform2uiv(loc, 1, uints);
-			return;
-		case '3':
-			get_uints(line, uints, 3);
-			glUniform3uiv(loc, 1, uints);
-			return;
-		case '4':
-			get_uints(line, uints, 4);
-			glUniform4uiv(loc, 1, uints);
-			return;
-		}
-	} else if (string_match("dvec", type)) {
-		check_double_support();
-		switch (type[4]) {
-		case '2':
-			get_doubles(line, d, 2);
-			glUniform2dv(loc, 1, d);
-			return;
-		case '3':
-			get_doubles(line, d, 3);
-			glUniform3dv(loc, 1, d);
-			return;
-		case '4':
-			get_doubles(line, d, 4);
-			glUniform4dv(loc, 1, d);
-			return;
+		switch (u->rows) {
+		case 1: glUniform1uiv(loc, 1, u->values.u); return;
+		case 2: glUniform2uiv(loc, 1, u->values.u); return;
+		case 3: glUniform3uiv(loc, 1, u->values.u); return;
+		case 4: glUniform4uiv(loc, 1, u->values.u); return;
 		}
-	} else if (string_match("i64vec", type)) {
+		break;
+	case UNIFORM_INT64:
 		check_int64_support();
-		switch (type[6]) {
-		case '2':
-			get_int64s(line, int64s, 2);
-			glUniform2i64vARB(loc, 1, int64s);
-			return;
-		case '3':
-			get_int64s(line, int64s, 3);
-			glUniform3i64vARB(loc, 1, int64s);
-			return;
-		case '4':
-			get_int64s(line, int64s, 4);
-			glUniform4i64vARB(loc, 1, int64s);
-			return;
+		switch (u->rows) {
+		case 1: glUniform1i64vARB(loc, 1, u->values.i64); return;
+		case 2: glUniform2i64vARB(loc, 1, u->values.i64); return;
+		case 3: glUniform3i64vARB(loc, 1, u->values.i64); return;
+		case 4: glUniform4i64vARB(loc, 1, u->values.i64); return;
 		}
-	} else if (string_match("u64vec", type)) {
+		break;
+	case UNIFORM_UINT64:
 		check_int64_support();
-		switch (type[6]) {
-		case '2':
-			get_uint64s(line, uint64s, 2);
-			glUniform2ui64vARB(loc, 1, uint64s);
-			return;
-		case '3':
-			get_uint64s(line, uint64s, 3);
-			glUniform3ui64vARB(loc, 1, uint64s);
-			return;
-		case '4':
-			get_uint64s(line, uint64s, 4);
-			glUniform4ui64vARB(loc, 1, uint64s);
-			return;
-		}
-	} else if (string_match("mat", type) && type[3] != '\0') {
-		char cols = type[3];
-		char rows = type[4] == 'x' ? type[5] : cols;
-		switch (cols) {
-		case '2':
-			switch (rows) {
-			case '2':
-				get_floats(line, f, 4);
-				glUniformMatrix2fv(loc, 1, GL_FALSE, f);
-				return;
-			case '3':
-				get_floats(line, f, 6);
-				glUniformMatrix2x3fv(loc, 1, GL_FALSE, f);
-				return;
-			case '4':
-				get_floats(line, f, 8);
-				glUniformMatrix2x4fv(loc, 1, GL_FALSE, f);
-				return;
-			}
-		case '3':
-			switch (rows) {
-			case '2':
-				get_floats(line, f, 6);
-				glUniformMatrix3x2fv(loc, 1, GL_FALSE, f);
-				return;
-			case '3':
-				get_floats(line, f, 9);
-				glUniformMatrix3fv(loc, 1, GL_FALSE, f);
-				return;
-			case '4':
-				get_floats(line, f, 12);
-				glUniformMatrix3x4fv(loc, 1, GL_FALSE, f);
-				return;
-			}
-		case '4':
-			switch (rows) {
-			case '2':
-				get_floats(line, f, 8);
-				glUniformMatrix4x2fv(loc, 1, GL_FALSE, f);
-				return;
-			case '3':
-				get_floats(line, f, 12);
-				glUniformMatrix4x3fv(loc, 1, GL_FALSE, f);
-				return;
-			case '4':
-				get_floats(line, f, 16);
-				glUniformMatrix4fv(loc, 1, GL_FALSE, f);
-				return;
-			}
-		}
-	} else if (string_match("dmat", type) && type[4] != '\0') {
-		char cols = type[4];
-		char rows = type[5] == 'x' ? type[6] : cols;
-		switch (cols) {
-		case '2':
-			switch (rows) {
-			case '2':
-				get_doubles(line, d, 4);
-				glUniformMatrix2dv(loc, 1, GL_FALSE, d);
-				return;
-			case '3':
-				get_doubles(line, d, 6);
-				glUniformMatrix2x3dv(loc, 1, GL_FALSE, d);
-				return;
-			case '4':
-				get_doubles(line, d, 8);
-				glUniformMatrix2x4dv(loc, 1, GL_FALSE, d);
-				return;
-			}
-		case '3':
-			switch (rows) {
-			case '2':
-				get_doubles(line, d, 6);
-				glUniformMatrix3x2dv(loc, 1, GL_FALSE, d);
-				return;
-			case '3':
-				get_doubles(line, d, 9);
-				glUniformMatrix3dv(loc, 1, GL_FALSE, d);
-				return;
-			case '4':
-				get_doubles(line, d, 12);
-				glUniformMatrix3x4dv(loc, 1, GL_FALSE, d);
-				return;
-			}
-		case '4':
-			switch (rows) {
-			case '2':
-				get_doubles(line, d, 8);
-				glUniformMatrix4x2dv(loc, 1, GL_FALSE, d);
-				return;
-			case '3':
-				get_doubles(line, d, 12);
-				glUniformMatrix4x3dv(loc, 1, GL_FALSE, d);
-				return;
-			case '4':
-				get_doubles(line, d, 16);
-				glUniformMatrix4dv(loc, 1, GL_FALSE, d);
-				return;
-			}
+		switch (u->rows) {
+		case 1: glUniform1ui64vARB(loc, 1, u->values.u64); return;
+		case 2: glUniform2ui64vARB(loc, 1, u->values.u64); return;
+		case 3: glUniform3ui64vARB(loc, 1, u->values.u64); return;
+		case 4: glUniform4ui64vARB(loc, 1, u->values.u64); return;
 		}
+		break;
 	}
 
-	strcpy_to_space(name, type);
-	printf("unknown uniform type \"%s\"\n", name);
+	printf("unknown uniform type \"%s\"\n", u->type);
 	piglit_report_result(PIGLIT_FAIL);
-
-	return;
 }
 
 static GLenum lookup_shader_type(GLuint idx)
@@ -2489,17 +2655,6 @@ static const struct string_to_enum enable_table[] = {
 	{ NULL, 0 }
 };
 
-static void
-do_enable_disable(const char *line, bool enable_flag)
-{
-	GLenum value = lookup_enum_string(enable_table, &line,
-					  "enable/disable enum");
-	if (enable_flag)
-		glEnable(value);
-	else
-		glDisable(value);
-}
-
 static const struct string_to_enum hint_target_table[] = {
 	ENUM_STRING(GL_LINE_SMOOTH_HINT),
 	ENUM_STRING(GL_POLYGON_SMOOTH_HINT),
@@ -2515,15 +2670,6 @@ static const struct string_to_enum hint_param_table[] = {
 	{ NULL, 0 }
 };
 
-static void do_hint(const char *line)
-{
-	GLenum target = lookup_enum_string(hint_target_table, &line,
-					   "hint target");
-	GLenum param = lookup_enum_string(hint_param_table, &line,
-					  "hint param");
-	glHint(target, param);
-}
-
 static void
 draw_instanced_rect(int primcount, float x, float y, float w, float h)
 {
@@ -2750,15 +2896,12 @@ bind_vao_if_supported()
 }
 
 static bool
-probe_atomic_counter(GLint counter_num, const char *op, uint32_t value)
+probe_atomic_counter(GLint counter_num, enum comparison cmp, uint32_t value)
 {
         uint32_t *p;
 	uint32_t observed;
-	enum comparison cmp;
 	bool result;
 
-	process_comparison(op, &cmp);
-
 	glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, atomics_bo);
 	p = glMapBufferRange(GL_ATOMIC_COUNTER_BUFFER, counter_num * sizeof(uint32_t),
 			     sizeof(uint32_t), GL_MAP_READ_BIT);
@@ -2785,15 +2928,12 @@ probe_atomic_counter(GLint counter_num, const char *op, uint32_t value)
 }
 
 static bool
-probe_ssbo_uint(GLint ssbo_index, GLint ssbo_offset, const char *op, uint32_t value)
+probe_ssbo_uint(GLint ssbo_index, GLint ssbo_offset, enum comparison cmp, uint32_t value)
 {
 	uint32_t *p;
 	uint32_t observed;
-	enum comparison cmp;
 	bool result;
 
-	process_comparison(op, &cmp);
-
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ssbo[ssbo_index]);
 	p = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, ssbo_offset,
 			     sizeof(uint32_t), GL_MAP_READ_BIT);
@@ -2819,44 +2959,741 @@ probe_ssbo_uint(GLint ssbo_index, GLint ssbo_offset, const char *op, uint32_t va
 	return true;
 }
 
-enum piglit_result
-piglit_display(void)
+/**
+ * Commands of the [test] section.  compile_test_section() turns each
+ * line into one of these, with its arguments already parsed, so that
+ * run_test_commands() only has to execute them.
+ */
+enum command_op {
+	CMD_ACTIVE_SHADER_PROGRAM,
+	CMD_ATOMIC_COUNTERS,
+	CMD_CLEAR_COLOR,
+	CMD_CLEAR_DEPTH,
+	CMD_CLEAR,
+	CMD_CLIP_PLANE,
+	CMD_COMPUTE,
+	CMD_DRAW_RECT_TEX,
+	CMD_DRAW_RECT_ORTHO_PATCH,
+	CMD_DRAW_RECT_ORTHO,
+	CMD_DRAW_RECT_PATCH,
+	CMD_DRAW_RECT,
+	CMD_DRAW_INSTANCED_RECT,
+	CMD_DRAW_ARRAYS,
+	CMD_DISABLE,
+	CMD_ENABLE,
+	CMD_DEPTHFUNC,
+	CMD_FB_TEX_2D,
+	CMD_FB_TEX_LAYERED_2D_ARRAY,
+	CMD_FRUSTUM,
+	CMD_HINT,
+	CMD_IMAGE_TEXTURE,
+	CMD_MEMORY_BARRIER,
+	CMD_ORTHO,
+	CMD_ORTHO_WINDOW,
+	CMD_PROBE_RGBA,
+	CMD_PROBE_DEPTH,
+	CMD_PROBE_ATOMIC_COUNTER,
+	CMD_PROBE_SSBO_UINT,
+	CMD_RELATIVE_PROBE_RGBA,
+	CMD_PROBE_RGB,
+	CMD_RELATIVE_PROBE_RGB,
+	CMD_PROBE_RECT_RGBA,
+	CMD_RELATIVE_PROBE_RECT_RGB,
+	CMD_PROBE_ALL_RGBA,
+	CMD_PROBE_WARN_ALL_RGBA,
+	CMD_PROBE_ALL_RGB,
+	CMD_TOLERANCE,
+	CMD_SHADE_MODEL,
+	CMD_SSBO,
+	CMD_SSBO_SUBDATA_FLOAT,
+	CMD_TEXTURE_RGBW,
+	CMD_TEXTURE_INTEGER,
+	CMD_TEXTURE_MIPTREE,
+	CMD_TEXTURE_CHECKERBOARD,
+	CMD_TEXTURE_JUNK_2D_ARRAY,
+	CMD_TEXTURE_RGBW_ARRAY,
+	CMD_TEXTURE_SHADOW,
+	CMD_TEXCOORD,
+	CMD_TEXPARAMETER,
+	CMD_UNIFORM,
+	CMD_SUBUNIFORM,
+	CMD_PARAMETER,
+	CMD_PATCH_PARAMETER,
+	CMD_PROVOKING_VERTEX,
+	CMD_LINK_ERROR,
+	CMD_LINK_SUCCESS,
+	CMD_UBO_ARRAY_INDEX,
+	CMD_ACTIVE_UNIFORM,
+	CMD_VERIFY_PROGRAM_INTERFACE_QUERY,
+};
+
+/**
+ * Name of each command and how many of each kind of argument it uses,
+ * for --dump-commands.  Indexed by enum command_op.
+ */
+static const struct command_info {
+	const char *name;
+	unsigned num_enums;
+	unsigned num_ints;
+	unsigned num_floats;
+	unsigned num_doubles;
+} command_info[] = {
+	{ "active shader program",		1, 0, 0, 0 },
+	{ "atomic counters",			0, 1, 0, 0 },
+	{ "clear color",			0, 0, 4, 0 },
+	{ "clear depth",			0, 0, 1, 0 },
+	{ "clear",				0, 0, 0, 0 },
+	{ "clip plane",				0, 1, 0, 4 },
+	{ "compute",				0, 3, 0, 0 },
+	{ "draw rect tex",			0, 0, 8, 0 },
+	{ "draw rect ortho patch",		0, 0, 4, 0 },
+	{ "draw rect ortho",			0, 0, 4, 0 },
+	{ "draw rect patch",			0, 0, 4, 0 },
+	{ "draw rect",				0, 0, 4, 0 },
+	{ "draw instanced rect",		0, 1, 4, 0 },
+	{ "draw arrays",			1, 2, 0, 0 },
+	{ "disable",				1, 0, 0, 0 },
+	{ "enable",				1, 0, 0, 0 },
+	{ "depthfunc",				1, 0, 0, 0 },
+	{ "fb tex 2d",				0, 1, 0, 0 },
+	{ "fb tex layered 2DArray",		0, 1, 0, 0 },
+	{ "frustum",				0, 0, 6, 0 },
+	{ "hint",				2, 0, 0, 0 },
+	{ "image texture",			1, 1, 0, 0 },
+	{ "memory barrier",			1, 0, 0, 0 },
+	{ "ortho",				0, 0, 4, 0 },
+	{ "ortho window",			0, 0, 0, 0 },
+	{ "probe rgba",				0, 0, 6, 0 },
+	{ "probe depth",			0, 0, 3, 0 },
+	{ "probe atomic counter",		0, 2, 0, 0 },
+	{ "probe ssbo uint",			0, 3, 0, 0 },
+	{ "relative probe rgba",		0, 0, 6, 0 },
+	{ "probe rgb",				0, 0, 5, 0 },
+	{ "relative probe rgb",			0, 0, 5, 0 },
+	{ "probe rect rgba",			0, 4, 4, 0 },
+	{ "relative probe rect rgb",		0, 0, 7, 0 },
+	{ "probe all rgba",			0, 0, 4, 0 },
+	{ "probe warn all rgba",		0, 0, 4, 0 },
+	{ "probe all rgb",			0, 0, 3, 0 },
+	{ "tolerance",				0, 0, 4, 0 },
+	{ "shade model",			1, 0, 0, 0 },
+	{ "ssbo",				0, 2, 0, 0 },
+	{ "ssbo subdata float",			0, 2, 1, 0 },
+	{ "texture rgbw",			1, 3, 0, 0 },
+	{ "texture integer",			1, 5, 0, 0 },
+	{ "texture miptree",			0, 1, 0, 0 },
+	{ "texture checkerboard",		0, 4, 8, 0 },
+	{ "texture junk 2DArray",		0, 4, 0, 0 },
+	{ "texture rgbw array",			1, 4, 0, 0 },
+	{ "texture shadow",			1, 4, 0, 0 },
+	{ "texcoord",				0, 1, 4, 0 },
+	{ "texparameter",			0, 0, 0, 0 },
+	{ "uniform",				0, 0, 0, 0 },
+	{ "subuniform",				0, 0, 0, 0 },
+	{ "parameter",				0, 0, 0, 0 },
+	{ "patch parameter",			0, 0, 0, 0 },
+	{ "provoking vertex",			0, 0, 0, 0 },
+	{ "link error",				0, 0, 0, 0 },
+	{ "link success",			0, 0, 0, 0 },
+	{ "ubo array index",			0, 1, 0, 0 },
+	{ "active uniform",			0, 0, 0, 0 },
+	{ "verify program_interface_query",	0, 0, 0, 0 },
+};
+
+struct test_command {
+	enum command_op op;
+	unsigned line_num;
+
+	/** The line of the script, null terminated. */
+	char *text;
+
+	/**
+	 * Arguments of commands that are still parsed by their helper
+	 * function when executed, pointing into text.
+	 */
+	const char *arg;
+
+	GLenum e[2];
+	int i[6];
+	float f[12];
+	double d[4];
+	enum comparison cmp;
+	struct uniform_command *uniform;
+};
+
+static struct test_command *test_commands;
+static unsigned num_test_commands;
+
+/**
+ * Compile one line of the [test] section.  Returns false for lines that
+ * don't contain a command.
+ */
+static bool
+compile_command(char *line, struct test_command *cmd)
+{
+	const char *rest;
+	float *c = cmd->f;
+	int *i = cmd->i;
+	unsigned ux, uy;
+	char s[32];
+
+	cmd->text = line;
+
+	if (line[0] == '\0') {
+		return false;
+	} else if (sscanf(line, "active shader program %s", s) == 1) {
+		int idx;
+
+		cmd->op = CMD_ACTIVE_SHADER_PROGRAM;
+		cmd->e[0] = get_shader_from_string(s, &idx);
+	} else if (sscanf(line, "atomic counters %d", &i[0]) == 1) {
+		cmd->op = CMD_ATOMIC_COUNTERS;
+	} else if (string_match("clear color", line)) {
+		cmd->op = CMD_CLEAR_COLOR;
+		get_floats(line + 11, c, 4);
+	} else if (string_match("clear depth", line)) {
+		cmd->op = CMD_CLEAR_DEPTH;
+		get_floats(line + 11, c, 1);
+	} else if (string_match("clear", line)) {
+		cmd->op = CMD_CLEAR;
+	} else if (sscanf(line,
+			  "clip plane %d %lf %lf %lf %lf",
+			  &i[0], &cmd->d[0], &cmd->d[1],
+			  &cmd->d[2], &cmd->d[3]) == 5) {
+		cmd->op = CMD_CLIP_PLANE;
+	} else if (sscanf(line,
+			  "compute %d %d %d",
+			  &i[0], &i[1], &i[2]) == 3) {
+		cmd->op = CMD_COMPUTE;
+	} else if (string_match("draw rect tex", line)) {
+		cmd->op = CMD_DRAW_RECT_TEX;
+		get_floats(line + 13, c, 8);
+	} else if (string_match("draw rect ortho patch", line)) {
+		cmd->op = CMD_DRAW_RECT_ORTHO_PATCH;
+		get_floats(line + 21, c, 4);
+	} else if (string_match("draw rect ortho", line)) {
+		cmd->op = CMD_DRAW_RECT_ORTHO;
+		get_floats(line + 15, c, 4);
+	} else if (string_match("draw rect patch", line)) {
+		cmd->op = CMD_DRAW_RECT_PATCH;
+		get_floats(line + 15, c, 4);
+	} else if (string_match("draw rect", line)) {
+		cmd->op = CMD_DRAW_RECT;
+		get_floats(line + 9, c, 4);
+	} else if (string_match("draw instanced rect", line)) {
+		cmd->op = CMD_DRAW_INSTANCED_RECT;
+		sscanf(line + 19, "%d %f %f %f %f",
+		       &i[0], c + 0, c + 1, c + 2, c + 3);
+	} else if (sscanf(line, "draw arrays %31s %d %d",
+			  s, &i[0], &i[1]) == 3) {
+		cmd->op = CMD_DRAW_ARRAYS;
+		cmd->e[0] = decode_drawing_mode(s);
+	} else if (string_match("disable", line)) {
+		cmd->op = CMD_DISABLE;
+		rest = line + 7;
+		cmd->e[0] = lookup_enum_string(enable_table, &rest,
+					       "enable/disable enum");
+	} else if (string_match("enable", line)) {
+		cmd->op = CMD_ENABLE;
+		rest = line + 6;
+		cmd->e[0] = lookup_enum_string(enable_table, &rest,
+					       "enable/disable enum");
+	} else if (sscanf(line, "depthfunc %31s", s) == 1) {
+		cmd->op = CMD_DEPTHFUNC;
+		cmd->e[0] = piglit_get_gl_enum_from_name(s);
+	} else if (sscanf(line, "fb tex 2d %d", &i[0]) == 1) {
+		cmd->op = CMD_FB_TEX_2D;
+	} else if (sscanf(line, "fb tex layered 2DArray %d", &i[0]) == 1) {
+		cmd->op = CMD_FB_TEX_LAYERED_2D_ARRAY;
+	} else if (string_match("frustum", line)) {
+		cmd->op = CMD_FRUSTUM;
+		get_floats(line + 7, c, 6);
+	} else if (string_match("hint", line)) {
+		cmd->op = CMD_HINT;
+		rest = line + 4;
+		cmd->e[0] = lookup_enum_string(hint_target_table, &rest,
+					       "hint target");
+		cmd->e[1] = lookup_enum_string(hint_param_table, &rest,
+					       "hint param");
+	} else if (sscanf(line,
+			  "image texture %d %31s",
+			  &i[0], s) == 2) {
+		cmd->op = CMD_IMAGE_TEXTURE;
+		cmd->e[0] = piglit_get_gl_enum_from_name(s);
+	} else if (sscanf(line, "memory barrier %s", s) == 1) {
+		cmd->op = CMD_MEMORY_BARRIER;
+		cmd->e[0] = piglit_get_gl_memory_barrier_enum_from_name(s);
+	} else if (sscanf(line, "ortho %f %f %f %f",
+			  c + 0, c + 1, c + 2, c + 3) == 4) {
+		cmd->op = CMD_ORTHO;
+	} else if (string_match("ortho", line)) {
+		cmd->op = CMD_ORTHO_WINDOW;
+	} else if (string_match("probe rgba", line)) {
+		cmd->op = CMD_PROBE_RGBA;
+		get_floats(line + 10, c, 6);
+	} else if (string_match("probe depth", line)) {
+		cmd->op = CMD_PROBE_DEPTH;
+		get_floats(line + 11, c, 3);
+	} else if (sscanf(line,
+			  "probe atomic counter %u %s %u",
+			  &ux, s, &uy) == 3) {
+		cmd->op = CMD_PROBE_ATOMIC_COUNTER;
+		i[0] = ux;
+		i[1] = uy;
+		process_comparison(s, &cmd->cmp);
+	} else if (sscanf(line, "probe ssbo uint %d %d %s 0x%x",
+			  &i[0], &i[1], s, &i[2]) == 4 ||
+		   sscanf(line, "probe ssbo uint %d %d %s %d",
+			  &i[0], &i[1], s, &i[2]) == 4) {
+		cmd->op = CMD_PROBE_SSBO_UINT;
+		process_comparison(s, &cmd->cmp);
+	} else if (sscanf(line,
+			  "relative probe rgba ( %f , %f ) "
+			  "( %f , %f , %f , %f )",
+			  c + 0, c + 1,
+			  c + 2, c + 3, c + 4, c + 5) == 6) {
+		cmd->op = CMD_RELATIVE_PROBE_RGBA;
+	} else if (string_match("probe rgb", line)) {
+		cmd->op = CMD_PROBE_RGB;
+		get_floats(line + 9, c, 5);
+	} else if (sscanf(line,
+			  "relative probe rgb ( %f , %f ) "
+			  "( %f , %f , %f )",
+			  c + 0, c + 1,
+			  c + 2, c + 3, c + 4) == 5) {
+		cmd->op = CMD_RELATIVE_PROBE_RGB;
+	} else if (sscanf(line, "probe rect rgba "
+			  "( %d , %d , %d , %d ) "
+			  "( %f , %f , %f , %f )",
+			  &i[0], &i[1], &i[2], &i[3],
+			  c + 0, c + 1, c + 2, c + 3) == 8) {
+		cmd->op = CMD_PROBE_RECT_RGBA;
+	} else if (sscanf(line, "relative probe rect rgb "
+			  "( %f , %f , %f , %f ) "
+			  "( %f , %f , %f )",
+			  c + 0, c + 1, c + 2, c + 3,
+			  c + 4, c + 5, c + 6) == 7) {
+		cmd->op = CMD_RELATIVE_PROBE_RECT_RGB;
+	} else if (string_match("probe all rgba", line)) {
+		cmd->op = CMD_PROBE_ALL_RGBA;
+		get_floats(line + 14, c, 4);
+	} else if (string_match("probe warn all rgba", line)) {
+		cmd->op = CMD_PROBE_WARN_ALL_RGBA;
+		get_floats(line + 19, c, 4);
+	} else if (string_match("probe all rgb", line)) {
+		cmd->op = CMD_PROBE_ALL_RGB;
+		get_floats(line + 13, c, 3);
+	} else if (string_match("tolerance", line)) {
+		cmd->op = CMD_TOLERANCE;
+		get_floats(line + strlen("tolerance"), c, 4);
+	} else if (string_match("shade model smooth", line)) {
+		cmd->op = CMD_SHADE_MODEL;
+		cmd->e[0] = GL_SMOOTH;
+	} else if (string_match("shade model flat", line)) {
+		cmd->op = CMD_SHADE_MODEL;
+		cmd->e[0] = GL_FLAT;
+	} else if (sscanf(line, "ssbo %d %d", &i[0], &i[1]) == 2) {
+		cmd->op = CMD_SSBO;
+	} else if (sscanf(line, "ssbo %d subdata float %d %f",
+			  &i[0], &i[1], &c[0]) == 3) {
+		cmd->op = CMD_SSBO_SUBDATA_FLOAT;
+	} else if (sscanf(line, "texture rgbw %d ( %d", &i[0], &i[1]) == 2) {
+		int num_scanned =
+			sscanf(line,
+			       "texture rgbw %d ( %d , %d ) %31s",
+			       &i[0], &i[1], &i[2], s);
+		if (num_scanned < 3) {
+			fprintf(stderr,
+				"invalid texture rgbw command!\n");
+			piglit_report_result(PIGLIT_FAIL);
+		}
+
+		cmd->op = CMD_TEXTURE_RGBW;
+		cmd->e[0] = GL_RGBA;
+		if (num_scanned >= 4) {
+			cmd->e[0] = piglit_get_gl_enum_from_name(s);
+		}
+	} else if (sscanf(line, "texture integer %d ( %d", &i[0], &i[1]) == 2) {
+		int num_scanned =
+			sscanf(line,
+			       "texture integer %d ( %d , %d ) ( %d, %d ) %31s",
+			       &i[0], &i[1], &i[2], &i[3], &i[4], s);
+		if (num_scanned < 6) {
+			fprintf(stderr,
+				"invalid texture integer command!\n");
+			piglit_report_result(PIGLIT_FAIL);
+		}
+
+		cmd->op = CMD_TEXTURE_INTEGER;
+		cmd->e[0] = piglit_get_gl_enum_from_name(s);
+	} else if (sscanf(line, "texture miptree %d", &i[0]) == 1) {
+		cmd->op = CMD_TEXTURE_MIPTREE;
+	} else if (sscanf(line,
+			  "texture checkerboard %d %d ( %d , %d ) "
+			  "( %f , %f , %f , %f ) "
+			  "( %f , %f , %f , %f )",
+			  &i[0], &i[1], &i[2], &i[3],
+			  c + 0, c + 1, c + 2, c + 3,
+			  c + 4, c + 5, c + 6, c + 7) == 12) {
+		cmd->op = CMD_TEXTURE_CHECKERBOARD;
+	} else if (sscanf(line,
+			  "texture junk 2DArray %d ( %d , %d , %d )",
+			  &i[0], &i[1], &i[2], &i[3]) == 4) {
+		cmd->op = CMD_TEXTURE_JUNK_2D_ARRAY;
+	} else if (sscanf(line,
+			  "texture rgbw 2DArray %d ( %d , %d , %d )",
+			  &i[0], &i[1], &i[2], &i[3]) == 4) {
+		cmd->op = CMD_TEXTURE_RGBW_ARRAY;
+		cmd->e[0] = GL_TEXTURE_2D_ARRAY;
+	} else if (sscanf(line,
+			  "texture rgbw 1DArray %d ( %d , %d )",
+			  &i[0], &i[1], &i[3]) == 3) {
+		cmd->op = CMD_TEXTURE_RGBW_ARRAY;
+		cmd->e[0] = GL_TEXTURE_1D_ARRAY;
+		i[2] = 1;
+	} else if (sscanf(line,
+			  "texture shadow2D %d ( %d , %d )",
+			  &i[0], &i[1], &i[2]) == 3) {
+		cmd->op = CMD_TEXTURE_SHADOW;
+		cmd->e[0] = GL_TEXTURE_2D;
+		i[3] = 1;
+	} else if (sscanf(line,
+			  "texture shadowRect %d ( %d , %d )",
+			  &i[0], &i[1], &i[2]) == 3) {
+		cmd->op = CMD_TEXTURE_SHADOW;
+		cmd->e[0] = GL_TEXTURE_RECTANGLE;
+		i[3] = 1;
+	} else if (sscanf(line,
+			  "texture shadow1D %d ( %d )",
+			  &i[0], &i[1]) == 2) {
+		cmd->op = CMD_TEXTURE_SHADOW;
+		cmd->e[0] = GL_TEXTURE_1D;
+		i[2] = 1;
+		i[3] = 1;
+	} else if (sscanf(line,
+			  "texture shadow1DArray %d ( %d , %d )",
+			  &i[0], &i[1], &i[2]) == 3) {
+		cmd->op = CMD_TEXTURE_SHADOW;
+		cmd->e[0] = GL_TEXTURE_1D_ARRAY;
+		i[3] = 1;
+	} else if (sscanf(line,
+			  "texture shadow2DArray %d ( %d , %d , %d )",
+			  &i[0], &i[1], &i[2], &i[3]) == 4) {
+		cmd->op = CMD_TEXTURE_SHADOW;
+		cmd->e[0] = GL_TEXTURE_2D_ARRAY;
+	} else if (sscanf(line, "texcoord %d ( %f , %f , %f , %f )",
+			  &i[0], c + 0, c + 1, c + 2, c + 3) == 5) {
+		cmd->op = CMD_TEXCOORD;
+	} else if (string_match("texparameter ", line)) {
+		cmd->op = CMD_TEXPARAMETER;
+		cmd->arg = line + strlen("texparameter ");
+	} else if (string_match("uniform", line)) {
+		cmd->op = CMD_UNIFORM;
+		cmd->uniform = parse_uniform(line + 7);
+	} else if (string_match("subuniform", line)) {
+		cmd->op = CMD_SUBUNIFORM;
+		cmd->arg = line + 10;
+	} else if (string_match("parameter ", line)) {
+		cmd->op = CMD_PARAMETER;
+		cmd->arg = line + strlen("parameter ");
+	} else if (string_match("patch parameter ", line)) {
+		cmd->op = CMD_PATCH_PARAMETER;
+		cmd->arg = line + strlen("patch parameter ");
+	} else if (string_match("provoking vertex ", line)) {
+		cmd->op = CMD_PROVOKING_VERTEX;
+		cmd->arg = line + strlen("provoking vertex ");
+	} else if (string_match("link error", line)) {
+		cmd->op = CMD_LINK_ERROR;
+	} else if (string_match("link success", line)) {
+		cmd->op = CMD_LINK_SUCCESS;
+	} else if (string_match("ubo array index ", line)) {
+		cmd->op = CMD_UBO_ARRAY_INDEX;
+		get_ints(line + strlen("ubo array index "), &i[0], 1);
+	} else if (string_match("active uniform ", line)) {
+		cmd->op = CMD_ACTIVE_UNIFORM;
+		cmd->arg = line + strlen("active uniform ");
+	} else if (string_match("verify program_interface_query ", line)) {
+		cmd->op = CMD_VERIFY_PROGRAM_INTERFACE_QUERY;
+		cmd->arg = line + strlen("verify program_interface_query ");
+	} else if (line[0] == '#') {
+		return false;
+	} else {
+		printf("unknown command \"%s\"\n", line);
+		piglit_report_result(PIGLIT_FAIL);
+	}
+
+	return true;
+}
+
+static void
+dump_command(const struct test_command *cmd)
+{
+	const struct command_info *info = &command_info[cmd->op];
+	unsigned j;
+
+	printf("%4u  %-32s", cmd->line_num, info->name);
+
+	for (j = 0; j < info->num_enums; j++)
+		printf(" %s", piglit_get_gl_enum_name(cmd->e[j]));
+	for (j = 0; j < info->num_ints; j++)
+		printf(" %d", cmd->i[j]);
+	for (j = 0; j < info->num_floats; j++)
+		printf(" %g", cmd->f[j]);
+	for (j = 0; j < info->num_doubles; j++)
+		printf(" %g", cmd->d[j]);
+
+	if (cmd->op == CMD_PROBE_ATOMIC_COUNTER ||
+	    cmd->op == CMD_PROBE_SSBO_UINT)
+		printf(" %s", comparison_string(cmd->cmp));
+
+	if (cmd->uniform) {
+		const struct uniform_command *u = cmd->uniform;
+
+		printf(" %s %s", u->type, u->name);
+		for (j = 0; j < u->columns * u->rows; j++) {
+			switch (u->base) {
+			case UNIFORM_FLOAT:
+				printf(" %g", u->values.f[j]);
+				break;
+			case UNIFORM_DOUBLE:
+				printf(" %g", u->values.d[j]);
+				break;
+			case UNIFORM_INT:
+				printf(" %d", u->values.i[j]);
+				break;
+			case UNIFORM_UINT:
+				printf(" %u", u->values.u[j]);
+				break;
+			case UNIFORM_INT64:
+				printf(" %" PRId64, u->values.i64[j]);
+				break;
+			case UNIFORM_UINT64:
+				printf(" %" PRIu64, u->values.u64[j]);
+				break;
+			}
+		}
+	}
+
+	if (cmd->arg)
+		printf(" \"%s\"", cmd->arg);
+
+	printf("\n");
+}
+
+/**
+ * Compile the [test] section into test_commands.  This is done once
+ * per script, so redrawing the window doesn't parse the script again.
+ */
+static void
+compile_test_section(void)
 {
 	const char *line, *next_line;
-	enum piglit_result result = PIGLIT_PASS;
-	GLbitfield clear_bits = 0;
-	bool link_error_expected = false;
-	int ubo_array_index = 0;
+	unsigned line_num = 1;
+	unsigned max_commands = 1;
 
-	if (test_start == NULL)
-		return PIGLIT_PASS;
+	for (line = test_text; line != test_start; line++) {
+		if (*line == '\n')
+			line_num++;
+	}
 
-	next_line = test_start;
-	while (next_line[0] != '\0') {
-		float c[32];
-		double d[4];
-		int x, y, z, w, h, l, tex, level;
-		unsigned ux, uy;
-		char s[32];
+	for (line = test_start; *line != '\0'; line++) {
+		if (*line == '\n')
+			max_commands++;
+	}
+
+	test_commands = calloc(max_commands, sizeof(*test_commands));
+	num_test_commands = 0;
 
+	next_line = test_start;
+	for (; next_line[0] != '\0'; line_num++) {
+		struct test_command *cmd = &test_commands[num_test_commands];
+		char *text;
 
 		line = eat_whitespace(next_line);
 
 		next_line = strchrnul(next_line, '\n');
 
 		/* Duplicate the line to make it null terminated */
-		line = strndup(line, next_line - line);
+		text = strndup(line, next_line - line);
 
 		/* If strchrnul found a newline, then skip it */
 		if (next_line[0] != '\0')
 			next_line++;
 
-		if (line[0] == '\0') {
-		} else if (sscanf(line, "active shader program %s", s) == 1) {
-			switch (get_shader_from_string(s, &x)) {
-			case GL_VERTEX_SHADER:
-				glActiveShaderProgram(pipeline, sso_vertex_prog);
-			break;
+		cmd->line_num = line_num;
+		if (compile_command(text, cmd)) {
+			num_test_commands++;
+		} else {
+			free(text);
+			memset(cmd, 0, sizeof(*cmd));
+		}
+	}
+
+	if (dump_commands) {
+		unsigned j;
+
+		printf("[test] section compiled to %u commands:\n",
+		       num_test_commands);
+		for (j = 0; j < num_test_commands; j++)
+			dump_command(&test_commands[j]);
+	}
+}
+
+static void
+free_test_commands(void)
+{
+	unsigned j;
+
+	for (j = 0; j < num_test_commands; j++) {
+		free(test_commands[j].text);
+		free(test_commands[j].uniform);
+	}
+
+	free(test_commands);
+	test_commands = NULL;
+	num_test_commands = 0;
+}
+
+static void
+bind_fb_texture(int tex, GLenum target, GLenum binding)
+{
+	GLenum status;
+	GLint tex_num;
+
+	glActiveTexture(GL_TEXTURE0 + tex);
+	glGetIntegerv(binding, &tex_num);
+
+	if (fbo == 0) {
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	}
+
+	if (target == GL_TEXTURE_2D) {
+		glFramebufferTexture2D(GL_FRAMEBUFFER,
+				       GL_COLOR_ATTACHMENT0,
+				       GL_TEXTURE_2D, tex_num, 0);
+		if (!piglit_check_gl_error(GL_NO_ERROR)) {
+			fprintf(stderr, "glFramebufferTexture2D error\n");
+			piglit_report_result(PIGLIT_FAIL);
+		}
+	} else {
+		glFramebufferTexture(GL_FRAMEBUFFER,
+				     GL_COLOR_ATTACHMENT0,
+				     tex_num, 0);
+		if (!piglit_check_gl_error(GL_NO_ERROR)) {
+			fprintf(stderr, "glFramebufferTexture error\n");
+			piglit_report_result(PIGLIT_FAIL);
+		}
+	}
+
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "incomplete fbo (status 0x%x)\n", status);
+		piglit_report_result(PIGLIT_FAIL);
+	}
+
+	glGetTexLevelParameteriv(target, 0, GL_TEXTURE_WIDTH, &render_width);
+	glGetTexLevelParameteriv(target, 0, GL_TEXTURE_HEIGHT, &render_height);
+}
+
+static bool
+is_batched_probe(enum command_op op)
+{
+	switch (op) {
+	case CMD_PROBE_RGBA:
+	case CMD_PROBE_RGB:
+	case CMD_RELATIVE_PROBE_RGBA:
+	case CMD_RELATIVE_PROBE_RGB:
+	case CMD_PROBE_RECT_RGBA:
+	case CMD_RELATIVE_PROBE_RECT_RGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Probe the whole window for "probe all rgb[a]".  With golden hashes,
+ * the readback is hashed along with the expected color and tolerance,
+ * and a hash that matches the one recorded for this line of the script
+ * passes without comparing the pixels.
+ */
+static bool
+probe_all(const struct test_command *cmd, int components)
+{
+	GLenum format = components == 4 ? GL_RGBA : GL_RGB;
+	char *key;
+	uint64_t hash;
+	bool pass;
+
+	if (piglit_golden_hash_mode() == PIGLIT_GOLDEN_HASH_OFF) {
+		if (components == 4)
+			return piglit_probe_rect_rgba(0, 0, render_width,
+						      render_height, cmd->f);
+		return piglit_probe_rect_rgb(0, 0, render_width,
+					     render_height, cmd->f);
+	}
+
+	hash = piglit_hash_data(cmd->f, components * sizeof(float), 0);
+	hash = piglit_hash_data(piglit_tolerance, sizeof(piglit_tolerance),
+				hash);
+	hash = piglit_hash_rect(0, 0, render_width, render_height,
+				format, hash);
+
+	asprintf(&key, "%s:%u", current_script, cmd->line_num);
+	if (piglit_golden_hash_check(key, hash)) {
+		free(key);
+		return true;
+	}
+
+	if (components == 4)
+		pass = piglit_probe_rect_rgba(0, 0, render_width,
+					      render_height, cmd->f);
+	else
+		pass = piglit_probe_rect_rgb(0, 0, render_width,
+					     render_height, cmd->f);
+
+	piglit_golden_hash_update(key, hash, pass);
+	free(key);
+	return pass;
+}
+
+/**
+ * Run the [test] section of the current script.
+ */
+static enum piglit_result
+run_test_commands(void)
+{
+	enum piglit_result result = PIGLIT_PASS;
+	GLbitfield clear_bits = 0;
+	bool link_error_expected = false;
+	int ubo_array_index = 0;
+	unsigned j;
+
+	if (test_start == NULL)
+		return PIGLIT_PASS;
+
+	if (test_commands == NULL)
+		compile_test_section();
+
+	for (j = 0; j < num_test_commands; j++) {
+		const struct test_command *cmd = &test_commands[j];
+		const float *c = cmd->f;
+		const int *i = cmd->i;
+		int x, y, w, h;
+
+		/* Consecutive probe lines are queued and checked with a
+		 * single readback once something else comes up.
+		 */
+		if (!is_batched_probe(cmd->op) && !piglit_probe_batch_flush())
+			result = PIGLIT_FAIL;
+
+		switch (cmd->op) {
+		case CMD_ACTIVE_SHADER_PROGRAM:
+			switch (cmd->e[0]) {
+			case GL_VERTEX_SHADER:
+				glActiveShaderProgram(pipeline, sso_vertex_prog);
+			break;
 			case GL_TESS_CONTROL_SHADER:
 				glActiveShaderProgram(pipeline, sso_tess_control_prog);
 			break;
@@ -2873,84 +3710,81 @@ piglit_display(void)
 				glActiveShaderProgram(pipeline, sso_compute_prog);
 			break;
 			}
-		} else if (sscanf(line, "atomic counters %d", &x) == 1) {
-			GLuint *atomics_buf = calloc(x, sizeof(GLuint));
+			break;
+		case CMD_ATOMIC_COUNTERS: {
+			GLuint *atomics_buf = calloc(i[0], sizeof(GLuint));
 			glGenBuffers(1, &atomics_bo);
 			glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, atomics_bo);
 			glBufferData(GL_ATOMIC_COUNTER_BUFFER,
-				     sizeof(GLuint) * x,
+				     sizeof(GLuint) * i[0],
 				     atomics_buf, GL_STATIC_DRAW);
 			free(atomics_buf);
-		} else if (string_match("clear color", line)) {
-			get_floats(line + 11, c, 4);
+			break;
+		}
+		case CMD_CLEAR_COLOR:
 			glClearColor(c[0], c[1], c[2], c[3]);
 			clear_bits |= GL_COLOR_BUFFER_BIT;
-		} else if (string_match("clear depth", line)) {
-			get_floats(line + 11, c, 1);
+			break;
+		case CMD_CLEAR_DEPTH:
 			glClearDepth(c[0]);
 			clear_bits |= GL_DEPTH_BUFFER_BIT;
-		} else if (string_match("clear", line)) {
+			break;
+		case CMD_CLEAR:
 			glClear(clear_bits);
-		} else if (sscanf(line,
-				  "clip plane %d %lf %lf %lf %lf",
-				  &x, &d[0], &d[1], &d[2], &d[3]) == 5) {
-			if (x < 0 || x >= gl_max_clip_planes) {
-				printf("clip plane id %d out of range\n", x);
+			break;
+		case CMD_CLIP_PLANE:
+			if (i[0] < 0 || i[0] >= gl_max_clip_planes) {
+				printf("clip plane id %d out of range\n", i[0]);
 				piglit_report_result(PIGLIT_FAIL);
 			}
-			glClipPlane(GL_CLIP_PLANE0 + x, d);
-		} else if (sscanf(line,
-				  "compute %d %d %d",
-				  &x, &y, &z) == 3) {
+			glClipPlane(GL_CLIP_PLANE0 + i[0], cmd->d);
+			break;
+		case CMD_COMPUTE:
 			program_must_be_in_use();
 			glMemoryBarrier(GL_ALL_BARRIER_BITS);
-			glDispatchCompute(x, y, z);
+			glDispatchCompute(i[0], i[1], i[2]);
 			glMemoryBarrier(GL_ALL_BARRIER_BITS);
-		} else if (string_match("draw rect tex", line)) {
+			break;
+		case CMD_DRAW_RECT_TEX:
 			program_must_be_in_use();
 			program_subroutine_uniforms();
-			get_floats(line + 13, c, 8);
 			piglit_draw_rect_tex(c[0], c[1], c[2], c[3],
 					     c[4], c[5], c[6], c[7]);
-		} else if (string_match("draw rect ortho patch", line)) {
+			break;
+		case CMD_DRAW_RECT_ORTHO_PATCH:
 			program_must_be_in_use();
 			program_subroutine_uniforms();
-			get_floats(line + 21, c, 4);
 
 			piglit_draw_rect_custom(-1.0 + 2.0 * (c[0] / piglit_width),
 						-1.0 + 2.0 * (c[1] / piglit_height),
 						2.0 * (c[2] / piglit_width),
 						2.0 * (c[3] / piglit_height), true);
-		} else if (string_match("draw rect ortho", line)) {
+			break;
+		case CMD_DRAW_RECT_ORTHO:
 			program_must_be_in_use();
 			program_subroutine_uniforms();
-			get_floats(line + 15, c, 4);
 
 			piglit_draw_rect(-1.0 + 2.0 * (c[0] / piglit_width),
 					 -1.0 + 2.0 * (c[1] / piglit_height),
 					 2.0 * (c[2] / piglit_width),
 					 2.0 * (c[3] / piglit_height));
-		} else if (string_match("draw rect patch", line)) {
+			break;
+		case CMD_DRAW_RECT_PATCH:
 			program_must_be_in_use();
-			get_floats(line + 15, c, 4);
 			piglit_draw_rect_custom(c[0], c[1], c[2], c[3], true);
-		} else if (string_match("draw rect", line)) {
+			break;
+		case CMD_DRAW_RECT:
 			program_must_be_in_use();
 			program_subroutine_uniforms();
-			get_floats(line + 9, c, 4);
 			piglit_draw_rect(c[0], c[1], c[2], c[3]);
-		} else if (string_match("draw instanced rect", line)) {
-			int primcount;
-
+			break;
+		case CMD_DRAW_INSTANCED_RECT:
 			program_must_be_in_use();
-			sscanf(line + 19, "%d %f %f %f %f",
-			       &primcount,
-			       c + 0, c + 1, c + 2, c + 3);
-			draw_instanced_rect(primcount, c[0], c[1], c[2], c[3]);
-		} else if (sscanf(line, "draw arrays %31s %d %d", s, &x, &y) == 3) {
-			GLenum mode = decode_drawing_mode(s);
-			int first = x;
-			size_t count = (size_t) y;
+			draw_instanced_rect(i[0], c[0], c[1], c[2], c[3]);
+			break;
+		case CMD_DRAW_ARRAYS: {
+			int first = i[0];
+			size_t count = (size_t) i[1];
 			program_must_be_in_use();
 			if (first < 0) {
 				printf("draw arrays 'first' must be >= 0\n");
@@ -2971,125 +3805,73 @@ piglit_display(void)
 				piglit_report_result(PIGLIT_FAIL);
 			}
 			bind_vao_if_supported();
-			glDrawArrays(mode, first, count);
-		} else if (string_match("disable", line)) {
-			do_enable_disable(line + 7, false);
-		} else if (string_match("enable", line)) {
-			do_enable_disable(line + 6, true);
-		} else if (sscanf(line, "depthfunc %31s", s) == 1) {
-			glDepthFunc(piglit_get_gl_enum_from_name(s));
-		} else if (sscanf(line, "fb tex 2d %d", &tex) == 1) {
-			GLenum status;
-			GLint tex_num;
-
-			glActiveTexture(GL_TEXTURE0 + tex);
-			glGetIntegerv(GL_TEXTURE_BINDING_2D, &tex_num);
-
-			if (fbo == 0) {
-				glGenFramebuffers(1, &fbo);
-				glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-			}
-
-			glFramebufferTexture2D(GL_FRAMEBUFFER,
-					       GL_COLOR_ATTACHMENT0,
-					       GL_TEXTURE_2D, tex_num, 0);
-			if (!piglit_check_gl_error(GL_NO_ERROR)) {
-				fprintf(stderr, "glFramebufferTexture2D error\n");
-				piglit_report_result(PIGLIT_FAIL);
-			}
-
-			status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-			if (status != GL_FRAMEBUFFER_COMPLETE) {
-				fprintf(stderr, "incomplete fbo (status 0x%x)\n", status);
-				piglit_report_result(PIGLIT_FAIL);
-			}
-
-			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &render_width);
-			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &render_height);
-		} else if (sscanf(line, "fb tex layered 2DArray %d", &tex) == 1) {
-			GLenum status;
-			GLint tex_num;
-
-			glActiveTexture(GL_TEXTURE0 + tex);
-			glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &tex_num);
-
-			if (fbo == 0) {
-				glGenFramebuffers(1, &fbo);
-				glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-			}
-
-			glFramebufferTexture(GL_FRAMEBUFFER,
-					     GL_COLOR_ATTACHMENT0,
-					     tex_num, 0);
-			if (!piglit_check_gl_error(GL_NO_ERROR)) {
-				fprintf(stderr, "glFramebufferTexture error\n");
-				piglit_report_result(PIGLIT_FAIL);
-			}
-
-			status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-			if (status != GL_FRAMEBUFFER_COMPLETE) {
-				fprintf(stderr, "incomplete fbo (status 0x%x)\n", status);
-				piglit_report_result(PIGLIT_FAIL);
-			}
-
-			glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_WIDTH, &render_width);
-			glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_HEIGHT, &render_height);
-		} else if (string_match("frustum", line)) {
-			get_floats(line + 7, c, 6);
+			glDrawArrays(cmd->e[0], first, count);
+			break;
+		}
+		case CMD_DISABLE:
+			glDisable(cmd->e[0]);
+			break;
+		case CMD_ENABLE:
+			glEnable(cmd->e[0]);
+			break;
+		case CMD_DEPTHFUNC:
+			glDepthFunc(cmd->e[0]);
+			break;
+		case CMD_FB_TEX_2D:
+			bind_fb_texture(i[0], GL_TEXTURE_2D,
+					GL_TEXTURE_BINDING_2D);
+			break;
+		case CMD_FB_TEX_LAYERED_2D_ARRAY:
+			bind_fb_texture(i[0], GL_TEXTURE_2D_ARRAY,
+					GL_TEXTURE_BINDING_2D_ARRAY);
+			break;
+		case CMD_FRUSTUM:
 			piglit_frustum_projection(false, c[0], c[1], c[2],
 						  c[3], c[4], c[5]);
-		} else if (string_match("hint", line)) {
-			do_hint(line + 4);
-		} else if (sscanf(line,
-				  "image texture %d %31s",
-				  &tex, s) == 2) {
-			const GLenum img_fmt = piglit_get_gl_enum_from_name(s);
+			break;
+		case CMD_HINT:
+			glHint(cmd->e[0], cmd->e[1]);
+			break;
+		case CMD_IMAGE_TEXTURE: {
 			GLint tex_num;
 
-			glActiveTexture(GL_TEXTURE0 + tex);
+			glActiveTexture(GL_TEXTURE0 + i[0]);
 			glGetIntegerv(GL_TEXTURE_BINDING_2D, &tex_num);
-			glBindImageTexture(tex, tex_num, 0, GL_FALSE, 0,
-					   GL_READ_WRITE, img_fmt);
-		} else if (sscanf(line, "memory barrier %s", s) == 1) {
-			glMemoryBarrier(piglit_get_gl_memory_barrier_enum_from_name(s));
-		} else if (sscanf(line, "ortho %f %f %f %f",
-				  c + 0, c + 1, c + 2, c + 3) == 4) {
+			glBindImageTexture(i[0], tex_num, 0, GL_FALSE, 0,
+					   GL_READ_WRITE, cmd->e[0]);
+			break;
+		}
+		case CMD_MEMORY_BARRIER:
+			glMemoryBarrier(cmd->e[0]);
+			break;
+		case CMD_ORTHO:
 			piglit_gen_ortho_projection(c[0], c[1], c[2], c[3],
 						    -1, 1, GL_FALSE);
-		} else if (string_match("ortho", line)) {
+			break;
+		case CMD_ORTHO_WINDOW:
 			piglit_ortho_projection(render_width, render_height,
 						GL_FALSE);
-		} else if (string_match("probe rgba", line)) {
-			get_floats(line + 10, c, 6);
-			if (!piglit_probe_pixel_rgba((int) c[0], (int) c[1],
-						    & c[2])) {
-				result = PIGLIT_FAIL;
-			}
-		} else if (string_match("probe depth", line)) {
-			get_floats(line + 11, c, 3);
+			break;
+		case CMD_PROBE_RGBA:
+			piglit_probe_batch_pixel_rgba((int) c[0], (int) c[1],
+						      &c[2]);
+			break;
+		case CMD_PROBE_DEPTH:
 			if (!piglit_probe_pixel_depth((int) c[0], (int) c[1],
 						      c[2])) {
 				result = PIGLIT_FAIL;
 			}
-		} else if (sscanf(line,
-				  "probe atomic counter %u %s %u",
-				  &ux, s, &uy) == 3) {
-			if (!probe_atomic_counter(ux, s, uy)) {
+			break;
+		case CMD_PROBE_ATOMIC_COUNTER:
+			if (!probe_atomic_counter(i[0], cmd->cmp, i[1])) {
 				piglit_report_result(PIGLIT_FAIL);
 			}
-		} else if (sscanf(line, "probe ssbo uint %d %d %s 0x%x",
-				  &x, &y, s, &z) == 4) {
-			if (!probe_ssbo_uint(x, y, s, z))
-				result = PIGLIT_FAIL;
-		} else if (sscanf(line, "probe ssbo uint %d %d %s %d",
-				  &x, &y, s, &z) == 4) {
-			if (!probe_ssbo_uint(x, y, s, z))
+			break;
+		case CMD_PROBE_SSBO_UINT:
+			if (!probe_ssbo_uint(i[0], i[1], cmd->cmp, i[2]))
 				result = PIGLIT_FAIL;
-		} else if (sscanf(line,
-				  "relative probe rgba ( %f , %f ) "
-				  "( %f , %f , %f , %f )",
-				  c + 0, c + 1,
-				  c + 2, c + 3, c + 4, c + 5) == 6) {
+			break;
+		case CMD_RELATIVE_PROBE_RGBA:
 			x = c[0] * render_width;
 			y = c[1] * render_height;
 			if (x >= render_width)
@@ -3097,20 +3879,13 @@ piglit_display(void)
 			if (y >= render_height)
 				y = render_height - 1;
 
-			if (!piglit_probe_pixel_rgba(x, y, &c[2])) {
-				result = PIGLIT_FAIL;
-			}
-		} else if (string_match("probe rgb", line)) {
-			get_floats(line + 9, c, 5);
-			if (!piglit_probe_pixel_rgb((int) c[0], (int) c[1],
-						    & c[2])) {
-				result = PIGLIT_FAIL;
-			}
-		} else if (sscanf(line,
-				  "relative probe rgb ( %f , %f ) "
-				  "( %f , %f , %f )",
-				  c + 0, c + 1,
-				  c + 2, c + 3, c + 4) == 5) {
+			piglit_probe_batch_pixel_rgba(x, y, &c[2]);
+			break;
+		case CMD_PROBE_RGB:
+			piglit_probe_batch_pixel_rgb((int) c[0], (int) c[1],
+						     &c[2]);
+			break;
+		case CMD_RELATIVE_PROBE_RGB:
 			x = c[0] * render_width;
 			y = c[1] * render_height;
 			if (x >= render_width)
@@ -3118,225 +3893,131 @@ piglit_display(void)
 			if (y >= render_height)
 				y = render_height - 1;
 
-			if (!piglit_probe_pixel_rgb(x, y, &c[2])) {
-				result = PIGLIT_FAIL;
-			}
-		} else if (sscanf(line, "probe rect rgba "
-				  "( %d , %d , %d , %d ) "
-				  "( %f , %f , %f , %f )",
-				  &x, &y, &w, &h,
-				  c + 0, c + 1, c + 2, c + 3) == 8) {
-			if (!piglit_probe_rect_rgba(x, y, w, h, c)) {
-				result = PIGLIT_FAIL;
-			}
-		} else if (sscanf(line, "relative probe rect rgb "
-				  "( %f , %f , %f , %f ) "
-				  "( %f , %f , %f )",
-				  c + 0, c + 1, c + 2, c + 3,
-				  c + 4, c + 5, c + 6) == 7) {
+			piglit_probe_batch_pixel_rgb(x, y, &c[2]);
+			break;
+		case CMD_PROBE_RECT_RGBA:
+			piglit_probe_batch_rect_rgba(i[0], i[1], i[2], i[3], c);
+			break;
+		case CMD_RELATIVE_PROBE_RECT_RGB:
 			x = c[0] * render_width;
 			y = c[1] * render_height;
 			w = c[2] * render_width;
 			h = c[3] * render_height;
 
-			if (!piglit_probe_rect_rgb(x, y, w, h, &c[4])) {
-				result = PIGLIT_FAIL;
-			}
-		} else if (string_match("probe all rgba", line)) {
-			get_floats(line + 14, c, 4);
-			if (result != PIGLIT_FAIL &&
-			    !piglit_probe_rect_rgba(0, 0, render_width,
-						    render_height, c))
+			piglit_probe_batch_rect_rgb(x, y, w, h, &c[4]);
+			break;
+		case CMD_PROBE_ALL_RGBA:
+			if (result != PIGLIT_FAIL && !probe_all(cmd, 4))
 				result = PIGLIT_FAIL;
-		} else if (string_match("probe warn all rgba", line)) {
-			get_floats(line + 19, c, 4);
-			if (result == PIGLIT_PASS &&
-			    !piglit_probe_rect_rgba(0, 0, render_width,
-						    render_height, c))
+			break;
+		case CMD_PROBE_WARN_ALL_RGBA:
+			if (result == PIGLIT_PASS && !probe_all(cmd, 4))
 				result = PIGLIT_WARN;
-		} else if (string_match("probe all rgb", line)) {
-			get_floats(line + 13, c, 3);
-			if (result != PIGLIT_FAIL &&
-			    !piglit_probe_rect_rgb(0, 0, render_width,
-						   render_height, c))
+			break;
+		case CMD_PROBE_ALL_RGB:
+			if (result != PIGLIT_FAIL && !probe_all(cmd, 3))
 				result = PIGLIT_FAIL;
-		} else if (string_match("tolerance", line)) {
-			get_floats(line + strlen("tolerance"), piglit_tolerance, 4);
-		} else if (string_match("shade model smooth", line)) {
-			glShadeModel(GL_SMOOTH);
-		} else if (string_match("shade model flat", line)) {
-			glShadeModel(GL_FLAT);
-		} else if (sscanf(line, "ssbo %d %d", &x, &y) == 2) {
-			GLuint *ssbo_init = calloc(y, 1);
-			glGenBuffers(1, &ssbo[x]);
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, x, ssbo[x]);
-			glBufferData(GL_SHADER_STORAGE_BUFFER, y,
+			break;
+		case CMD_TOLERANCE:
+			memcpy(piglit_tolerance, c, sizeof(piglit_tolerance));
+			break;
+		case CMD_SHADE_MODEL:
+			glShadeModel(cmd->e[0]);
+			break;
+		case CMD_SSBO: {
+			GLuint *ssbo_init = calloc(i[1], 1);
+			glGenBuffers(1, &ssbo[i[0]]);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i[0], ssbo[i[0]]);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, i[1],
 				     ssbo_init, GL_DYNAMIC_DRAW);
 			free(ssbo_init);
-		} else if (sscanf(line, "ssbo %d subdata float %d %f", &x, &y, &c[0]) == 3) {
-			glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo[x]);
-			glBufferSubData(GL_SHADER_STORAGE_BUFFER, y, 4, &c[0]);
-		} else if (sscanf(line, "texture rgbw %d ( %d", &tex, &w) == 2) {
-			GLenum int_fmt = GL_RGBA;
-			int num_scanned =
-				sscanf(line,
-				       "texture rgbw %d ( %d , %d ) %31s",
-				       &tex, &w, &h, s);
-			if (num_scanned < 3) {
-				fprintf(stderr,
-					"invalid texture rgbw command!\n");
-				piglit_report_result(PIGLIT_FAIL);
-			}
-
-			if (num_scanned >= 4) {
-				int_fmt = piglit_get_gl_enum_from_name(s);
-			}
-
-			glActiveTexture(GL_TEXTURE0 + tex);
-			piglit_rgbw_texture(int_fmt, w, h, GL_FALSE, GL_FALSE,
+			break;
+		}
+		case CMD_SSBO_SUBDATA_FLOAT:
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo[i[0]]);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, i[1], 4, &c[0]);
+			break;
+		case CMD_TEXTURE_RGBW:
+			glActiveTexture(GL_TEXTURE0 + i[0]);
+			piglit_rgbw_texture(cmd->e[0], i[1], i[2], GL_FALSE, GL_FALSE,
 					    GL_UNSIGNED_NORMALIZED);
 			if (!piglit_is_core_profile)
 				glEnable(GL_TEXTURE_2D);
-		} else if (sscanf(line, "texture integer %d ( %d", &tex, &w) == 2) {
-			GLenum int_fmt;
-			int b, a;
-			int num_scanned =
-				sscanf(line,
-				       "texture integer %d ( %d , %d ) ( %d, %d ) %31s",
-				       &tex, &w, &h, &b, &a, s);
-			if (num_scanned < 6) {
-				fprintf(stderr,
-					"invalid texture integer command!\n");
-				piglit_report_result(PIGLIT_FAIL);
-			}
-
-			int_fmt = piglit_get_gl_enum_from_name(s);
-
-			glActiveTexture(GL_TEXTURE0 + tex);
-			(void)piglit_integer_texture(int_fmt, w, h, b, a);
-		} else if (sscanf(line, "texture miptree %d", &tex) == 1) {
-			glActiveTexture(GL_TEXTURE0 + tex);
+			break;
+		case CMD_TEXTURE_INTEGER:
+			glActiveTexture(GL_TEXTURE0 + i[0]);
+			(void)piglit_integer_texture(cmd->e[0], i[1], i[2],
+						     i[3], i[4]);
+			break;
+		case CMD_TEXTURE_MIPTREE:
+			glActiveTexture(GL_TEXTURE0 + i[0]);
 			piglit_miptree_texture();
 			if (!piglit_is_core_profile)
 				glEnable(GL_TEXTURE_2D);
-		} else if (sscanf(line,
-				  "texture checkerboard %d %d ( %d , %d ) "
-				  "( %f , %f , %f , %f ) "
-				  "( %f , %f , %f , %f )",
-				  &tex, &level, &w, &h,
-				  c + 0, c + 1, c + 2, c + 3,
-				  c + 4, c + 5, c + 6, c + 7) == 12) {
-			glActiveTexture(GL_TEXTURE0 + tex);
-			piglit_checkerboard_texture(0, level,
-						    w, h,
-						    w / 2, h / 2,
+			break;
+		case CMD_TEXTURE_CHECKERBOARD:
+			glActiveTexture(GL_TEXTURE0 + i[0]);
+			piglit_checkerboard_texture(0, i[1],
+						    i[2], i[3],
+						    i[2] / 2, i[3] / 2,
 						    c + 0, c + 4);
 			if (!piglit_is_core_profile)
 				glEnable(GL_TEXTURE_2D);
-		} else if (sscanf(line,
-				  "texture junk 2DArray %d ( %d , %d , %d )",
-				  &tex, &w, &h, &l) == 4) {
+			break;
+		case CMD_TEXTURE_JUNK_2D_ARRAY: {
 			GLuint texobj;
-			glActiveTexture(GL_TEXTURE0 + tex);
+			glActiveTexture(GL_TEXTURE0 + i[0]);
 			glGenTextures(1, &texobj);
 			glBindTexture(GL_TEXTURE_2D_ARRAY, texobj);
 			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA,
-				     w, h, l, 0, GL_RGBA, GL_FLOAT, 0);
-		} else if (sscanf(line,
-				  "texture rgbw 2DArray %d ( %d , %d , %d )",
-				  &tex, &w, &h, &l) == 4) {
-			glActiveTexture(GL_TEXTURE0 + tex);
-			piglit_array_texture(GL_TEXTURE_2D_ARRAY, GL_RGBA,
-                                             w, h, l, GL_FALSE);
-		} else if (sscanf(line,
-				  "texture rgbw 1DArray %d ( %d , %d )",
-				  &tex, &w, &l) == 3) {
-			glActiveTexture(GL_TEXTURE0 + tex);
-                        h = 1;
-			piglit_array_texture(GL_TEXTURE_1D_ARRAY, GL_RGBA,
-                                             w, h, l, GL_FALSE);
-		} else if (sscanf(line,
-				  "texture shadow2D %d ( %d , %d )",
-				  &tex, &w, &h) == 3) {
-			glActiveTexture(GL_TEXTURE0 + tex);
-			piglit_depth_texture(GL_TEXTURE_2D, GL_DEPTH_COMPONENT,
-					     w, h, 1, GL_FALSE);
-			glTexParameteri(GL_TEXTURE_2D,
+				     i[1], i[2], i[3], 0, GL_RGBA, GL_FLOAT, 0);
+			break;
+		}
+		case CMD_TEXTURE_RGBW_ARRAY:
+			glActiveTexture(GL_TEXTURE0 + i[0]);
+			piglit_array_texture(cmd->e[0], GL_RGBA,
+					     i[1], i[2], i[3], GL_FALSE);
+			break;
+		case CMD_TEXTURE_SHADOW:
+			glActiveTexture(GL_TEXTURE0 + i[0]);
+			piglit_depth_texture(cmd->e[0], GL_DEPTH_COMPONENT,
+					     i[1], i[2], i[3], GL_FALSE);
+			glTexParameteri(cmd->e[0],
 					GL_TEXTURE_COMPARE_MODE,
 					GL_COMPARE_R_TO_TEXTURE);
-			glTexParameteri(GL_TEXTURE_2D,
+			glTexParameteri(cmd->e[0],
 					GL_TEXTURE_COMPARE_FUNC,
 					GL_GREATER);
 
-			if (!piglit_is_core_profile)
+			if (cmd->e[0] == GL_TEXTURE_2D &&
+			    !piglit_is_core_profile)
 				glEnable(GL_TEXTURE_2D);
-		} else if (sscanf(line,
-				  "texture shadowRect %d ( %d , %d )",
-				  &tex, &w, &h) == 3) {
-			glActiveTexture(GL_TEXTURE0 + tex);
-			piglit_depth_texture(GL_TEXTURE_RECTANGLE, GL_DEPTH_COMPONENT,
-					     w, h, 1, GL_FALSE);
-			glTexParameteri(GL_TEXTURE_RECTANGLE,
-					GL_TEXTURE_COMPARE_MODE,
-					GL_COMPARE_R_TO_TEXTURE);
-			glTexParameteri(GL_TEXTURE_RECTANGLE,
-					GL_TEXTURE_COMPARE_FUNC,
-					GL_GREATER);
-		} else if (sscanf(line,
-				  "texture shadow1D %d ( %d )",
-				  &tex, &w) == 2) {
-			glActiveTexture(GL_TEXTURE0 + tex);
-			piglit_depth_texture(GL_TEXTURE_1D, GL_DEPTH_COMPONENT,
-					     w, 1, 1, GL_FALSE);
-			glTexParameteri(GL_TEXTURE_1D,
-					GL_TEXTURE_COMPARE_MODE,
-					GL_COMPARE_R_TO_TEXTURE);
-			glTexParameteri(GL_TEXTURE_1D,
-					GL_TEXTURE_COMPARE_FUNC,
-					GL_GREATER);
-		} else if (sscanf(line,
-				  "texture shadow1DArray %d ( %d , %d )",
-				  &tex, &w, &l) == 3) {
-			glActiveTexture(GL_TEXTURE0 + tex);
-			piglit_depth_texture(GL_TEXTURE_1D_ARRAY, GL_DEPTH_COMPONENT,
-					     w, l, 1, GL_FALSE);
-			glTexParameteri(GL_TEXTURE_1D_ARRAY,
-					GL_TEXTURE_COMPARE_MODE,
-					GL_COMPARE_R_TO_TEXTURE);
-			glTexParameteri(GL_TEXTURE_1D_ARRAY,
-					GL_TEXTURE_COMPARE_FUNC,
-					GL_GREATER);
-		} else if (sscanf(line,
-				  "texture shadow2DArray %d ( %d , %d , %d )",
-				  &tex, &w, &h, &l) == 4) {
-			glActiveTexture(GL_TEXTURE0 + tex);
-			piglit_depth_texture(GL_TEXTURE_2D_ARRAY, GL_DEPTH_COMPONENT,
-					     w, h, l, GL_FALSE);
-			glTexParameteri(GL_TEXTURE_2D_ARRAY,
-					GL_TEXTURE_COMPARE_MODE,
-					GL_COMPARE_R_TO_TEXTURE);
-			glTexParameteri(GL_TEXTURE_2D_ARRAY,
-					GL_TEXTURE_COMPARE_FUNC,
-					GL_GREATER);
-		} else if (sscanf(line, "texcoord %d ( %f , %f , %f , %f )",
-		                  &x, c + 0, c + 1, c + 2, c + 3) == 5) {
-			glMultiTexCoord4fv(GL_TEXTURE0 + x, c);
-		} else if (string_match("texparameter ", line)) {
-			handle_texparameter(line + strlen("texparameter "));
-		} else if (string_match("uniform", line)) {
+			break;
+		case CMD_TEXCOORD:
+			glMultiTexCoord4fv(GL_TEXTURE0 + i[0], c);
+			break;
+		case CMD_TEXPARAMETER:
+			handle_texparameter(cmd->arg);
+			break;
+		case CMD_UNIFORM:
 			program_must_be_in_use();
-			set_uniform(line + 7, ubo_array_index);
-		} else if (string_match("subuniform", line)) {
+			set_uniform(cmd->uniform, ubo_array_index);
+			break;
+		case CMD_SUBUNIFORM:
 			program_must_be_in_use();
 			check_shader_subroutine_support();
-			set_subroutine_uniform(line + 10);
-		} else if (string_match("parameter ", line)) {
-			set_parameter(line + strlen("parameter "));
-		} else if (string_match("patch parameter ", line)) {
-			set_patch_parameter(line + strlen("patch parameter "));
-		} else if (string_match("provoking vertex ", line)) {
-			set_provoking_vertex(line + strlen("provoking vertex "));
-		} else if (string_match("link error", line)) {
+			set_subroutine_uniform(cmd->arg);
+			break;
+		case CMD_PARAMETER:
+			set_parameter(cmd->arg);
+			break;
+		case CMD_PATCH_PARAMETER:
+			set_patch_parameter(cmd->arg);
+			break;
+		case CMD_PROVOKING_VERTEX:
+			set_provoking_vertex(cmd->arg);
+			break;
+		case CMD_LINK_ERROR:
 			link_error_expected = true;
 			if (link_ok) {
 				printf("shader link error expected, but it was successful!\n");
@@ -3344,30 +4025,32 @@ piglit_display(void)
 			} else {
 				fprintf(stderr, "Failed to link:\n%s\n", prog_err_info);
 			}
-		} else if (string_match("link success", line)) {
+			break;
+		case CMD_LINK_SUCCESS:
 			program_must_be_in_use();
-		} else if (string_match("ubo array index ", line)) {
-			get_ints(line + strlen("ubo array index "), &ubo_array_index, 1);
-		} else if (string_match("active uniform ", line)) {
-			active_uniform(line + strlen("active uniform "));
-		} else if (string_match("verify program_interface_query ", line)) {
-			active_program_interface(line + strlen("verify program_interface_query "));
-		} else if ((line[0] != '\n') && (line[0] != '\0')
-			   && (line[0] != '#')) {
-			printf("unknown command \"%s\"\n", line);
-			piglit_report_result(PIGLIT_FAIL);
+			break;
+		case CMD_UBO_ARRAY_INDEX:
+			ubo_array_index = i[0];
+			break;
+		case CMD_ACTIVE_UNIFORM:
+			active_uniform(cmd->arg);
+			break;
+		case CMD_VERIFY_PROGRAM_INTERFACE_QUERY:
+			active_program_interface(cmd->arg);
+			break;
 		}
-
-		free((void*) line);
 	}
 
+	if (!piglit_probe_batch_flush())
+		result = PIGLIT_FAIL;
+
 	if (!link_ok && !link_error_expected) {
 		program_must_be_in_use();
 	}
 
 	piglit_present_results();
 
-	if (piglit_automatic) {
+	if (piglit_automatic && num_test_scripts <= 1) {
 	        free_subroutine_uniforms();
 		/* Free our resources, useful for valgrinding. */
 		if (prog != 0) {
@@ -3387,6 +4070,353 @@ piglit_display(void)
 }
 
 
+static enum piglit_result
+init_test(const char *file)
+{
+	enum piglit_result result;
+
+	current_script = file;
+	result = process_test_script(file);
+	if (result != PIGLIT_PASS)
+		return result;
+
+	piglit_phase_push(PIGLIT_PHASE_COMPILE);
+	link_and_use_shaders();
+	piglit_phase_pop();
+
+	if (sso_in_use)
+		glBindProgramPipeline(pipeline);
+
+	if (link_ok && vertex_data_start != NULL) {
+		program_must_be_in_use();
+		bind_vao_if_supported();
+
+		if (vertex_data_from_file)
+			num_vbo_rows = setup_vbo_from_file(prog,
+							   vertex_data_start,
+							   vertex_data_end,
+							   file);
+		else
+			num_vbo_rows = setup_vbo_from_text(prog,
+							   vertex_data_start,
+							   vertex_data_end);
+		vbo_present = true;
+	}
+	setup_ubos();
+
+	render_width = piglit_width;
+	render_height = piglit_height;
+
+	return PIGLIT_PASS;
+}
+
+/**
+ * Undo everything a script may have done to the context, so that the next
+ * script starts out with the state of a freshly created context.
+ */
+static void
+reset_state(void)
+{
+	static const GLenum texture_targets[] = {
+#ifdef PIGLIT_USE_OPENGL
+		GL_TEXTURE_1D,
+		GL_TEXTURE_1D_ARRAY,
+		GL_TEXTURE_RECTANGLE,
+#endif
+		GL_TEXTURE_2D,
+		GL_TEXTURE_3D,
+		GL_TEXTURE_CUBE_MAP,
+		GL_TEXTURE_2D_ARRAY,
+	};
+	static const GLenum texture_bindings[] = {
+#ifdef PIGLIT_USE_OPENGL
+		GL_TEXTURE_BINDING_1D,
+		GL_TEXTURE_BINDING_1D_ARRAY,
+		GL_TEXTURE_BINDING_RECTANGLE,
+#endif
+		GL_TEXTURE_BINDING_2D,
+		GL_TEXTURE_BINDING_3D,
+		GL_TEXTURE_BINDING_CUBE_MAP,
+		GL_TEXTURE_BINDING_2D_ARRAY,
+	};
+	GLint num_units = 0;
+	int i;
+	unsigned j;
+
+	/* Programs and pipelines. */
+	free_subroutine_uniforms();
+	memset(subuniform_locations, 0, sizeof(subuniform_locations));
+	memset(num_subuniform_locations, 0, sizeof(num_subuniform_locations));
+
+	glUseProgram(0);
+	if (sso_in_use) {
+		glBindProgramPipeline(0);
+		glDeleteProgram(sso_vertex_prog);
+		glDeleteProgram(sso_tess_control_prog);
+		glDeleteProgram(sso_tess_eval_prog);
+		glDeleteProgram(sso_geometry_prog);
+		glDeleteProgram(sso_fragment_prog);
+		glDeleteProgram(sso_compute_prog);
+	} else if (prog != 0) {
+		glDeleteProgram(prog);
+	}
+	prog = 0;
+	sso_vertex_prog = 0;
+	sso_tess_control_prog = 0;
+	sso_tess_eval_prog = 0;
+	sso_geometry_prog = 0;
+	sso_fragment_prog = 0;
+	sso_compute_prog = 0;
+
+	if (pipeline != 0) {
+		glDeleteProgramPipelines(1, &pipeline);
+		glGenProgramPipelines(1, &pipeline);
+	}
+
+#ifdef PIGLIT_USE_OPENGL
+	if (!piglit_is_core_profile) {
+		if (piglit_is_extension_supported("GL_ARB_vertex_program")) {
+			glDisable(GL_VERTEX_PROGRAM_ARB);
+			glBindProgramARB(GL_VERTEX_PROGRAM_ARB, 0);
+		}
+		if (piglit_is_extension_supported("GL_ARB_fragment_program")) {
+			glDisable(GL_FRAGMENT_PROGRAM_ARB);
+			glBindProgramARB(GL_FRAGMENT_PROGRAM_ARB, 0);
+		}
+	}
+#endif
+
+	/* Buffers, vertex arrays and framebuffers. */
+	if (num_uniform_blocks > 0) {
+		glDeleteBuffers(num_uniform_blocks, uniform_block_bos);
+		free(uniform_block_bos);
+		uniform_block_bos = NULL;
+		num_uniform_blocks = 0;
+	}
+	if (atomics_bo != 0) {
+		glDeleteBuffers(1, &atomics_bo);
+		atomics_bo = 0;
+	}
+	glDeleteBuffers(ARRAY_SIZE(ssbo), ssbo);
+	memset(ssbo, 0, sizeof(ssbo));
+
+	for (i = 0; i < gl_max_vertex_attribs; i++) {
+		GLint buffer = 0;
+
+		glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING,
+				    &buffer);
+		if (buffer != 0) {
+			GLuint name = buffer;
+			glDeleteBuffers(1, &name);
+		}
+		glDisableVertexAttribArray(i);
+	}
+	if (vao != 0) {
+		glBindVertexArray(0);
+		glDeleteVertexArrays(1, &vao);
+		vao = 0;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (fbo != 0) {
+		glBindFramebuffer(GL_FRAMEBUFFER, piglit_winsys_fbo);
+		glDeleteFramebuffers(1, &fbo);
+		fbo = 0;
+	}
+
+	/* Textures. */
+	glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &num_units);
+	for (i = 0; i < num_units; i++) {
+		glActiveTexture(GL_TEXTURE0 + i);
+		for (j = 0; j < ARRAY_SIZE(texture_targets); j++) {
+			GLint tex = 0;
+
+			glGetIntegerv(texture_bindings[j], &tex);
+			if (tex != 0) {
+				GLuint name = tex;
+				glBindTexture(texture_targets[j], 0);
+				glDeleteTextures(1, &name);
+			}
+		}
+#ifdef PIGLIT_USE_OPENGL
+		if (!piglit_is_core_profile) {
+			glDisable(GL_TEXTURE_2D);
+			glMultiTexCoord4f(GL_TEXTURE0 + i, 0.0, 0.0, 0.0, 1.0);
+		}
+#endif
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	if (gl_version.num >= (gl_version.es ? 31 : 42) ||
+	    piglit_is_extension_supported("GL_ARB_shader_image_load_store")) {
+		glGetIntegerv(GL_MAX_IMAGE_UNITS, &num_units);
+		for (i = 0; i < num_units; i++)
+			glBindImageTexture(i, 0, 0, GL_FALSE, 0,
+					   GL_READ_ONLY, GL_R8);
+	}
+
+	/* Fixed function state touched by [test] commands.  Some of the
+	 * enums are not valid in every context, the errors that generates
+	 * are cleared below.
+	 */
+	for (j = 0; enable_table[j].name != NULL; j++)
+		glDisable(enable_table[j].token);
+	for (j = 0; hint_target_table[j].name != NULL; j++)
+		glHint(hint_target_table[j].token, GL_DONT_CARE);
+
+	glClearColor(0.0, 0.0, 0.0, 0.0);
+	glClearDepth(1.0);
+	glDepthFunc(GL_LESS);
+	glViewport(0, 0, piglit_width, piglit_height);
+
+#ifdef PIGLIT_USE_OPENGL
+	if (!piglit_is_core_profile) {
+		glShadeModel(GL_SMOOTH);
+		glMatrixMode(GL_PROJECTION);
+		glLoadIdentity();
+		glMatrixMode(GL_MODELVIEW);
+		glLoadIdentity();
+	}
+
+	if (gl_version.num >= 32 ||
+	    piglit_is_extension_supported("GL_EXT_provoking_vertex"))
+		glProvokingVertexEXT(GL_LAST_VERTEX_CONVENTION_EXT);
+
+	if (gl_version.num >= 40 ||
+	    piglit_is_extension_supported("GL_ARB_tessellation_shader")) {
+		static const float outer[4] = { 1.0, 1.0, 1.0, 1.0 };
+		static const float inner[2] = { 1.0, 1.0 };
+
+		glPatchParameteri(GL_PATCH_VERTICES, 3);
+		glPatchParameterfv(GL_PATCH_DEFAULT_OUTER_LEVEL, outer);
+		glPatchParameterfv(GL_PATCH_DEFAULT_INNER_LEVEL, inner);
+	}
+#endif
+
+	memcpy(piglit_tolerance, default_tolerance, sizeof(piglit_tolerance));
+
+	while (glGetError() != GL_NO_ERROR)
+		;
+
+	/* shader_runner's own state. */
+	num_vertex_shaders = 0;
+	num_tess_ctrl_shaders = 0;
+	num_tess_eval_shaders = 0;
+	num_geometry_shaders = 0;
+	num_fragment_shaders = 0;
+	num_compute_shaders = 0;
+	geometry_layout_input_type = GL_TRIANGLES;
+	geometry_layout_output_type = GL_TRIANGLE_STRIP;
+	geometry_layout_vertices_out = 0;
+	memset(&glsl_req_version, 0, sizeof(glsl_req_version));
+	shader_string = NULL;
+	vertex_data_start = NULL;
+	vertex_data_end = NULL;
+	vertex_data_from_file = false;
+	free_test_commands();
+	free_deferred_shaders();
+	test_start = NULL;
+	num_vbo_rows = 0;
+	vbo_present = false;
+	link_ok = false;
+	prog_in_use = false;
+	sso_in_use = false;
+	free(prog_err_info);
+	prog_err_info = NULL;
+	free(test_text);
+	test_text = NULL;
+}
+
+/**
+ * In a batch, PIGLIT_GOLDEN_HASH_FILES names the golden hash file of each
+ * script, in order and separated like PATH, since the scripts are
+ * separate tests.  Switch to the one of script \p index.
+ */
+static void
+select_golden_hash_file(unsigned index)
+{
+#if defined(_WIN32)
+	static const char separator[] = ";";
+#else
+	static const char separator[] = ":";
+#endif
+	const char *files = getenv("PIGLIT_GOLDEN_HASH_FILES");
+	size_t len;
+	char *file;
+
+	if (files == NULL)
+		return;
+
+	for (; index > 0 && files != NULL; index--) {
+		files = strpbrk(files, separator);
+		if (files != NULL)
+			files++;
+	}
+
+	if (files == NULL) {
+		piglit_golden_hash_set_file(NULL);
+		return;
+	}
+
+	len = strcspn(files, separator);
+	file = malloc(len + 1);
+	memcpy(file, files, len);
+	file[len] = '\0';
+	piglit_golden_hash_set_file(file);
+	free(file);
+}
+
+/**
+ * Run every script in test_scripts in the current context, from
+ * piglit_display() so that the window is shown.
+ *
+ * Each script's output starts with a "PIGLIT TEST: <index> - <file>" line
+ * (on both stdout and stderr) and ends with its result line, so that the
+ * framework can split the output back into one result per script.  A
+ * script that ends the process, with a failure or a crash, is reported by
+ * the absence of further markers; the framework restarts shader_runner
+ * with the remaining scripts.  The same happens when a script needs a
+ * different context than the one created for the first script.
+ */
+static void
+run_tests(void)
+{
+	enum piglit_result all = PIGLIT_SKIP;
+	unsigned i;
+
+	for (i = 0; i < num_test_scripts; i++) {
+		enum piglit_result result;
+
+		if (i > 0 && !config_is_compatible(test_scripts[i])) {
+			fprintf(stderr,
+				"%s requires a different context, "
+				"not running it or any later script\n",
+				test_scripts[i]);
+			break;
+		}
+
+		printf("PIGLIT TEST: %u - %s\n", i, test_scripts[i]);
+		fflush(stdout);
+		fprintf(stderr, "PIGLIT TEST: %u - %s\n", i, test_scripts[i]);
+		fflush(stderr);
+
+		select_golden_hash_file(i);
+		result = init_test(test_scripts[i]);
+		if (result == PIGLIT_PASS)
+			result = run_test_commands();
+
+		fflush(stderr);
+		printf("PIGLIT: {\"result\": \"%s\" }\n",
+		       piglit_result_to_string(result));
+		fflush(stdout);
+
+		piglit_merge_result(&all, result);
+		reset_state();
+	}
+
+	exit(all == PIGLIT_FAIL ? 1 : 0);
+}
+
 void
 piglit_init(int argc, char **argv)
 {
@@ -3394,6 +4424,7 @@ piglit_init(int argc, char **argv)
 	int minor;
 	bool core = piglit_is_core_profile;
 	bool es;
+	enum piglit_result result;
 
 	piglit_require_GLSL();
 
@@ -3447,26 +4478,36 @@ piglit_init(int argc, char **argv)
 		gl_max_vertex_attribs = 16;
 
 	if (argc < 2) {
-		printf("usage: shader_runner <test.shader_test>\n");
+		printf("usage: shader_runner [--dump-commands] [--no-program-cache]\n"
+		       "                     <test.shader_test>...\n"
+		       "       shader_runner [--dump-commands] [--no-program-cache]\n"
+		       "                     - < <list of test files>\n");
 		exit(1);
 	}
 
-	process_test_script(argv[1]);
-	link_and_use_shaders();
+	if (num_test_scripts == 0) {
+		test_scripts = (const char **) argv + 1;
+		num_test_scripts = argc - 1;
+	}
 
-	if (sso_in_use)
-		glBindProgramPipeline(pipeline);
+	memcpy(default_tolerance, piglit_tolerance, sizeof(piglit_tolerance));
 
-	if (link_ok && vertex_data_start != NULL) {
-		program_must_be_in_use();
-		bind_vao_if_supported();
+	/* A batch is run from piglit_display(), once the window is shown
+	 * and its pixels can be probed.
+	 */
+	if (num_test_scripts > 1)
+		return;
 
-		num_vbo_rows = setup_vbo_from_text(prog, vertex_data_start,
-						   vertex_data_end);
-		vbo_present = true;
-	}
-	setup_ubos();
+	result = init_test(test_scripts[0]);
+	if (result != PIGLIT_PASS)
+		piglit_report_result(result);
+}
 
-	render_width = piglit_width;
-	render_height = piglit_height;
+enum piglit_result
+piglit_display(void)
+{
+	if (num_test_scripts > 1)
+		run_tests();
+
+	return run_test_commands();
 }
@@ -503,6 +503,33 @@ Test::measure_accuracy()
 	glReadPixels(0, 0, pattern_width, pattern_height, GL_RGBA,
 		     GL_FLOAT, test_data);
 
+	/* With golden hashes, images that hash the same as the last
+	 * time they passed needn't be measured again.  The thresholds
+	 * depend on the sample count and the kind of test, which are
+	 * hashed too.  Each call gets its own key, so that a test that
+	 * measures several times keeps a hash for each.
+	 */
+	static unsigned call_count = 0;
+	const size_t data_size = pattern_width * pattern_height * 4 *
+		sizeof(float);
+	const int params[] = { num_samples, test_resolve, srgb };
+	char key[64];
+	uint64_t hash = 0;
+
+	snprintf(key, sizeof(key), "measure_accuracy:%d:%d:%d:%u",
+		 num_samples, (int) test_resolve, (int) srgb, call_count++);
+	if (piglit_golden_hash_mode() != PIGLIT_GOLDEN_HASH_OFF) {
+		hash = piglit_hash_data(params, sizeof(params), 0);
+		hash = piglit_hash_data(reference_data, data_size, hash);
+		hash = piglit_hash_data(test_data, data_size, hash);
+		if (piglit_golden_hash_check(key, hash)) {
+			printf("Images match their golden hash\n");
+			delete [] reference_data;
+			delete [] test_data;
+			return true;
+		}
+	}
+
 	Stats unlit_stats;
 	Stats partially_lit_stats;
 	Stats totally_lit_stats;
@@ -584,6 +611,10 @@ Test::measure_accuracy()
                error_threshold);
 	pass = partially_lit_stats.is_better_than(error_threshold) && pass;
 	// TODO: deal with sRGB.
+
+	piglit_golden_hash_update(key, hash, pass);
+	delete [] reference_data;
+	delete [] test_data;
 	return pass;
 }
 
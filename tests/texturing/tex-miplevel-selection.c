@@ -55,6 +55,7 @@
  */
 
 #include "piglit-util-gl.h"
+#include "piglit-texref.h"
 
 PIGLIT_GL_TEST_CONFIG_BEGIN
 
@@ -1362,25 +1363,23 @@ check_result(const unsigned char *probed, int expected_level,
 	return true;
 }
 
+/**
+ * The quads are drawn with a lod of fetch_level - baselevel, before the
+ * bias, see draw_quad().
+ */
 static int
 calc_expected_level(int fetch_level, int baselevel, int maxlevel, int minlod,
 		    int maxlod, int bias, int mipfilter)
 {
-	int expected_level;
-
-	if (mipfilter) {
-		if (no_lod_clamp) {
-			expected_level = CLAMP(fetch_level + bias,
-					       baselevel,
-					       maxlevel);
-		} else {
-			expected_level = CLAMP(fetch_level + bias,
-					       MIN2(baselevel + minlod, maxlevel),
-					       MIN2(baselevel + maxlod, maxlevel));
-		}
-	} else {
-		expected_level = baselevel;
-	}
+	int expected_level =
+		piglit_texref_select_level(fetch_level - baselevel + bias,
+					   baselevel, maxlevel,
+					   no_lod_clamp ? -1000 : minlod,
+					   no_lod_clamp ? 1000 : maxlod,
+					   mipfilter ? GL_NEAREST_MIPMAP_NEAREST
+						     : GL_NEAREST,
+					   NULL);
+
 	assert(expected_level >= 0 && expected_level <= last_level);
 	return expected_level;
 }
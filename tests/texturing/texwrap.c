@@ -63,6 +63,7 @@
  */
 
 #include "piglit-util-gl.h"
+#include "piglit-texref.h"
 #include <limits.h>
 
 /* Only *_ARB versions of these exist. I am lazy to add the suffix. */
@@ -611,147 +612,73 @@ static int get_int_format_bits(const struct format_desc *format)
 	       maxbits >= 10 ? 10 : 8;
 }
 
-static void sample_nearest(int x, int y, int z,
+/* The texture for the expected results, made of the one in image. */
+static struct piglit_texref_texture ref_texture;
+static float ref_texels[SIZEMAX * SIZEMAX * SIZEMAX * 4];
+
+static void init_ref_texture(const struct format_desc *format)
+{
+	int i, n = size_x * size_y * size_z;
+
+	for (i = 0; i < n; i++) {
+		float *texel = &ref_texels[i * 4];
+
+		if (format->depth) {
+			texel[0] = texel[1] = texel[2] = image[i];
+			texel[3] = 1;
+		} else if (format->stencil) {
+			texel[0] = texel[1] = texel[2] = texel[3] = image[i];
+		} else {
+			memcpy(texel, &image[i * 4], 4 * sizeof(float));
+		}
+
+		if (format->srgb) {
+			texel[0] = piglit_srgb_to_linear(texel[0]);
+			texel[1] = piglit_srgb_to_linear(texel[1]);
+			texel[2] = piglit_srgb_to_linear(texel[2]);
+		}
+	}
+
+	ref_texture.target = texture_target;
+	ref_texture.width = size_x;
+	ref_texture.height = size_y;
+	ref_texture.depth = size_z;
+	ref_texture.texels = ref_texels;
+	memcpy(ref_texture.border, border_real, sizeof(border_real));
+}
+
+/* Sample the center of texel (x, y) of the first slice. */
+static void sample_nearest(int x, int y,
 			   GLenum wrap_mode, GLenum filter,
 			   unsigned char pixel[4],
 			   const struct format_desc *format,
-			   GLboolean npot, GLboolean texswizzle,
-			   int bits)
+			   GLboolean texswizzle, int bits)
 {
-	unsigned sample_border = 0;
-	float border_factor = 0;
-	int coords[3] = {x, y, z};
+	float coords[3];
 	unsigned i;
 	float result[4];
 	int *iresult = (int*)result;
 	unsigned *uiresult = (unsigned*)result;
 
-	/* Zero coords according to the texture target. */
-	switch (texture_target) {
-	case GL_TEXTURE_1D:
-		coords[1] = 0;
-		/* Fall through. */
-
-	case GL_TEXTURE_2D:
-	case GL_TEXTURE_RECTANGLE:
-		coords[2] = 0;
-	}
-
 	if (texture_offset) {
-		coords[0] -= 3;
+		x -= 3;
 		if (texture_target != GL_TEXTURE_1D)
-			coords[1] += 3;
-	}
-	/* Handle clamp mirroring. */
-	switch (wrap_mode) {
-	case GL_MIRROR_CLAMP_EXT:
-	case GL_MIRROR_CLAMP_TO_EDGE_EXT:
-	case GL_MIRROR_CLAMP_TO_BORDER_EXT:
-		for (i = 0; i < 3; i++) {
-			if (coords[i] < 0) {
-				coords[i] = -coords[i] - 1;
-			}
-		}
-	}
-
-	/* Handle border sampling. */
-	switch (wrap_mode) {
-	case GL_CLAMP:
-	case GL_MIRROR_CLAMP_EXT:
-		if (filter != GL_LINEAR) {
-			break;
-		}
-
-	case GL_CLAMP_TO_BORDER:
-	case GL_MIRROR_CLAMP_TO_BORDER_EXT:
-		sample_border = 0;
-		for (i = 0; i < 3; i++) {
-			if (coords[i] >= TEXTURE_SIZE(npot) || coords[i] < 0) {
-				sample_border++;
-			}
-		}
-	}
-
-	/* Figure out what the border factor is. */
-	switch (wrap_mode) {
-	case GL_CLAMP:
-	case GL_MIRROR_CLAMP_EXT:
-		if (filter == GL_LINEAR) {
-			const double factor[] = {0, 0.5, 0.75, 0.875};
-			border_factor = factor[sample_border];
-		}
-		break;
-	case GL_CLAMP_TO_BORDER:
-	case GL_MIRROR_CLAMP_TO_BORDER_EXT:
-		if (sample_border) {
-			border_factor = 1;
-		}
-		break;
-	}
-
-	/* Handle wrapping. */
-	switch (wrap_mode) {
-	case GL_REPEAT:
-		for (i = 0; i < 3; i++) {
-			coords[i] = (coords[i] + TEXTURE_SIZE(npot)*10) % TEXTURE_SIZE(npot);
-		}
-		break;
-
-	case GL_CLAMP:
-	case GL_MIRROR_CLAMP_EXT:
-	case GL_CLAMP_TO_BORDER:
-	case GL_MIRROR_CLAMP_TO_BORDER_EXT:
-	case GL_CLAMP_TO_EDGE:
-	case GL_MIRROR_CLAMP_TO_EDGE_EXT:
-		for (i = 0; i < 3; i++) {
-			coords[i] = coords[i] >= TEXTURE_SIZE(npot) ? TEXTURE_SIZE(npot)-1 :
-								coords[i] < 0 ? 0 : coords[i];
-		}
-		break;
-
-	case GL_MIRRORED_REPEAT:
-		for (i = 0; i < 3; i++) {
-			coords[i] = (coords[i] + TEXTURE_SIZE(npot)*10) % (TEXTURE_SIZE(npot) * 2);
-			if (coords[i] >= TEXTURE_SIZE(npot))
-				coords[i] = 2*TEXTURE_SIZE(npot) - coords[i] - 1;
-		}
-		break;
-	}
-
-	/* Sample the pixel. */
-	if (format->depth) {
-		result[0] = result[1] = result[2] =
-				image[(coords[2]*size_y*size_x +
-				       coords[1]*size_x + coords[0])];
-		result[3] = 1;
-	} else if (format->stencil) {
-		result[0] = result[1] = result[2] = result[3] =
-				image[(coords[2]*size_y*size_x +
-				       coords[1]*size_x + coords[0])];
-	} else {
-		memcpy(result,
-		       &image[(coords[2]*size_y*size_x +
-			       coords[1]*size_x + coords[0])*4],
-		       sizeof(result));
+			y += 3;
 	}
 
-	if (format->srgb) {
-		for (i = 0; i < 3; i++) {
-			result[i] = piglit_srgb_to_linear(result[i]);
-		}
+	coords[0] = x + 0.5;
+	coords[1] = y + 0.5;
+	coords[2] = 0.5;
+	if (texture_target != GL_TEXTURE_RECTANGLE) {
+		coords[0] /= size_x;
+		coords[1] /= size_y;
+		coords[2] /= size_z;
 	}
 
-	/* Sample the border.
-	 * This is actually the only place we care about linear filtering,
-	 * for CLAMP. Pixels are expected to be sampled at their center,
-	 * so we don't have to take 4 samples. */
-	if (border_factor == 1) {
-		memcpy(result, border_real, 16);
-	} else if (border_factor) {
-		for (i = 0; i < 4; i++)
-			result[i] = border_real[i] * border_factor +
-				    result[i] * (1 - border_factor);
-	}
+	ref_texture.wrap_s = ref_texture.wrap_t = ref_texture.wrap_r =
+		wrap_mode;
+	ref_texture.filter = filter;
+	piglit_texref_sample(&ref_texture, coords, result, 1);
 
 	/* Texture swizzle. */
 	if (texswizzle) {
@@ -1005,11 +932,30 @@ static GLboolean probe_pixels(const struct format_desc *format, GLboolean npot,
 	GLboolean pass = GL_TRUE;
 	int num_filters = format->type == FLOAT_TYPE ? 2 : 1;
 	int bits = get_int_format_bits(format);
+	uint64_t hash = 0;
+	char *key = NULL;
 
 	pixels = malloc(piglit_width * piglit_height * 4);
 	glReadPixels(0, 0, piglit_width, piglit_height,
 		     GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 
+	/* Computing the expected texels is the slow part, skip it if the
+	 * window looks the same as the last time it passed.
+	 */
+	if (piglit_golden_hash_mode() != PIGLIT_GOLDEN_HASH_OFF) {
+		hash = piglit_hash_data(pixels, piglit_width * piglit_height * 4,
+					0);
+		asprintf(&key, "%s%s%s", format->name, npot ? ", NPOT" : "",
+			 texswizzle ? ", swizzled" : "");
+		if (piglit_golden_hash_check(key, hash)) {
+			free(key);
+			free(pixels);
+			return GL_TRUE;
+		}
+	}
+
+	init_ref_texture(format);
+
 	/* make slices different for 3D textures */
 
 	/* Loop over min/mag filters. */
@@ -1079,9 +1025,8 @@ static GLboolean probe_pixels(const struct format_desc *format, GLboolean npot,
 					double y = y0 + TEXEL_SIZE*(b+0.5);
 
 					sample_nearest(a - BIAS_INT(npot), b - BIAS_INT(npot),
-						       0, /* the slices are the same */
 						       wrap_modes[j].mode, filter, expected,
-						       format, npot, texswizzle, bits);
+						       format, texswizzle, bits);
 
 					if (!probe_pixel_rgba(pixels, piglit_width, deltamax_swizzled,
 							      x, y, expected, a, b,
@@ -1097,6 +1042,10 @@ tile_done:
 		}
 	}
 
+	if (key != NULL) {
+		piglit_golden_hash_update(key, hash, pass);
+		free(key);
+	}
 	free(pixels);
 	return pass;
 }
@@ -70,6 +70,93 @@ def main():
     EnumCode.emit(args.out_dir, gl_registry)
 
 
+def name_hash(seed, name):
+    """32 bit FNV-1a of name, started from the FNV offset basis xor seed.
+
+    This must match hash_name() in piglit-dispatch.c.
+    """
+    h = 2166136261 ^ seed
+    for c in bytearray(name.encode('ascii')):
+        h = ((h ^ c) * 16777619) & 0xffffffff
+    return h
+
+
+class PerfectHash(object):
+    """A minimal perfect hash of a set of names.
+
+    This uses "hash, displace, and compress": names are sorted into one
+    bucket per name by name_hash(0, name), and each bucket with more than
+    one name gets the first seed that sends its names to unused slots.
+    Buckets with one name take any free slot, stored as -(slot + 1).
+
+    The slot of a name is then found with at most two hashes:
+
+        seed = seeds[name_hash(0, name) % len(seeds)]
+        slot = -seed - 1 if seed < 0 else name_hash(seed, name) % len(seeds)
+
+    A name that isn't in the set also lands in some slot, so the name in
+    that slot has to be compared to it.
+
+    Attributes:
+    names -- the names, in slot order
+    seeds -- the seed table
+
+    """
+    MAX_SEED = 1 << 24
+
+    def __init__(self, names):
+        names = sorted(set(names))
+        size = len(names)
+        buckets = [[] for _ in range(size)]
+        for name in names:
+            buckets[name_hash(0, name) % size].append(name)
+
+        self.seeds = [0] * size
+        slots = [None] * size
+
+        # Place the biggest buckets first, while there are free slots
+        order = sorted(range(size), key=lambda b: len(buckets[b]),
+                       reverse=True)
+        for b in order:
+            bucket = buckets[b]
+            if len(bucket) <= 1:
+                break
+
+            for seed in range(1, self.MAX_SEED):
+                used = set()
+                for name in bucket:
+                    slot = name_hash(seed, name) % size
+                    if slots[slot] is not None or slot in used:
+                        break
+                    used.add(slot)
+                else:
+                    break
+            else:
+                raise Exception('No perfect hash seed for {}'.format(bucket))
+
+            self.seeds[b] = seed
+            for name in bucket:
+                slots[name_hash(seed, name) % size] = name
+
+        free = (i for i, n in enumerate(slots) if n is None)
+        for b in order:
+            if len(buckets[b]) == 1:
+                slot = next(free)
+                self.seeds[b] = -slot - 1
+                slots[slot] = buckets[b][0]
+
+        self.names = slots
+
+    def lookup(self, name):
+        """Return the slot of name, or None if it isn't in the set."""
+        seed = self.seeds[name_hash(0, name) % len(self.seeds)]
+        if seed < 0:
+            slot = -seed - 1
+        else:
+            slot = name_hash(seed, name) % len(self.seeds)
+        return slot if self.names[slot] == name else None
+
+
 class DispatchCode(object):
 
     H_TEMPLATE = 'piglit-dispatch-gen.h.mako'
@@ -90,7 +177,12 @@ class DispatchCode(object):
     @classmethod
     def emit(cls, out_dir, gl_registry):
         assert isinstance(gl_registry, registry.gl.Registry)
-        context_vars = dict(dispatch=cls, gl_registry=gl_registry)
+        context_vars = dict(
+            dispatch=cls,
+            gl_registry=gl_registry,
+            function_hash=PerfectHash(c.name for c in gl_registry.commands),
+            extension_hash=PerfectHash(
+                e.name for e in gl_registry.extensions))
         render_template(cls.H_TEMPLATE, out_dir, **context_vars)
         render_template(cls.C_TEMPLATE, out_dir, **context_vars)
 
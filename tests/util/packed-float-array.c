@@ -0,0 +1,528 @@
+/*
+ * Copyright (c) The Piglit project 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file packed-float-array.c
+ *
+ * Array versions of the half float, 11/10 bit float and shared exponent
+ * converters, for tests that set up whole images in those formats.
+ *
+ * They give exactly the results of calling the single value functions for
+ * each element, which packed-float-array-selftest checks.  On x86
+ * built with GCC or clang they use F16C, AVX2 or SSE4.1 if the CPU has them,
+ * picked on each call, and loop over the single value functions otherwise.
+ */
+
+#include "piglit-util-gl.h"
+#include "r11g11b10f.h"
+#include "rgb9e5.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define USE_X86_SIMD
+#include <cpuid.h>
+#include <immintrin.h>
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#ifdef USE_X86_SIMD
+enum cpu_feature {
+	CPU_SSE41 = 1 << 0,
+	CPU_AVX2 = 1 << 1,
+	CPU_F16C = 1 << 2,
+};
+
+/* What the converters may use, see piglit_packed_float_array_set_level() */
+static unsigned feature_mask = ~0u;
+
+static unsigned
+detect_cpu_features(void)
+{
+	static int features = -1;
+
+	if (features < 0) {
+		unsigned eax, ebx, ecx, edx;
+		int f = 0;
+
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("sse4.1"))
+			f |= CPU_SSE41;
+		if (__builtin_cpu_supports("avx2"))
+			f |= CPU_AVX2;
+		/* Not every compiler knows F16C by name.  Checking AVX too
+		 * makes sure the OS saves the YMM registers.
+		 */
+		if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+		    (ecx & bit_F16C) && __builtin_cpu_supports("avx"))
+			f |= CPU_F16C;
+		features = f;
+	}
+
+	return features;
+}
+
+static unsigned
+cpu_features(void)
+{
+	return detect_cpu_features() & feature_mask;
+}
+
+/* Split four texels of three floats into four reds, greens and blues. */
+TARGET("sse4.1") static inline void
+load_rgb4(const float *rgb, __m128 *r, __m128 *g, __m128 *b)
+{
+	const __m128 v0 = _mm_loadu_ps(&rgb[0]);	/* r0 g0 b0 r1 */
+	const __m128 v1 = _mm_loadu_ps(&rgb[4]);	/* g1 b1 r2 g2 */
+	const __m128 v2 = _mm_loadu_ps(&rgb[8]);	/* b2 r3 g3 b3 */
+
+	*r = _mm_shuffle_ps(v0, _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1, 1, 2, 2)),
+			    _MM_SHUFFLE(2, 0, 3, 0));
+	*g = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(0, 0, 1, 1)),
+			    _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(2, 2, 3, 3)),
+			    _MM_SHUFFLE(2, 0, 2, 0));
+	*b = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 1, 2, 2)),
+			    _mm_shuffle_ps(v2, v2, _MM_SHUFFLE(3, 3, 0, 0)),
+			    _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/* The reverse of load_rgb4(). */
+TARGET("sse4.1") static inline void
+store_rgb4(float *rgb, __m128 r, __m128 g, __m128 b)
+{
+	_mm_storeu_ps(&rgb[0],
+		      _mm_shuffle_ps(_mm_shuffle_ps(r, g, _MM_SHUFFLE(0, 0, 0, 0)),
+				     _mm_shuffle_ps(b, r, _MM_SHUFFLE(1, 1, 0, 0)),
+				     _MM_SHUFFLE(2, 0, 2, 0)));
+	_mm_storeu_ps(&rgb[4],
+		      _mm_shuffle_ps(_mm_shuffle_ps(g, b, _MM_SHUFFLE(1, 1, 1, 1)),
+				     _mm_shuffle_ps(r, g, _MM_SHUFFLE(2, 2, 2, 2)),
+				     _MM_SHUFFLE(2, 0, 2, 0)));
+	_mm_storeu_ps(&rgb[8],
+		      _mm_shuffle_ps(_mm_shuffle_ps(b, r, _MM_SHUFFLE(3, 3, 2, 2)),
+				     _mm_shuffle_ps(g, b, _MM_SHUFFLE(3, 3, 3, 3)),
+				     _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+/*
+ * Unsigned 11 or 10 bit floats, with mantissas of 23 - shift bits, from
+ * floats, as f32_to_uf11() and f32_to_uf10() do: truncated, with negative
+ * values and too small ones going to 0 and large ones to the largest
+ * finite value.
+ */
+TARGET("sse4.1") static inline __m128i
+uf_from_f32_sse41(__m128 val, int shift, int max_finite)
+{
+	const __m128i bits = _mm_castps_si128(val);
+	const __m128i abs = _mm_and_si128(bits, _mm_set1_epi32(0x7fffffff));
+	const __m128i inf = _mm_set1_epi32(0x7f800000);
+	const __m128i inf_code = _mm_set1_epi32(max_finite + 1);
+	__m128i code;
+
+	code = _mm_sub_epi32(_mm_srai_epi32(bits, shift),
+			     _mm_set1_epi32(112 << (23 - shift)));
+	/* Negative as an integer too */
+	code = _mm_and_si128(code,
+			     _mm_cmpgt_epi32(bits,
+					     _mm_set1_epi32((113 << 23) - 1)));
+	code = _mm_min_epi32(code, _mm_set1_epi32(max_finite));
+	code = _mm_blendv_epi8(code, inf_code, _mm_cmpeq_epi32(bits, inf));
+	return _mm_blendv_epi8(code, _mm_add_epi32(inf_code, _mm_set1_epi32(1)),
+			       _mm_cmpgt_epi32(abs, inf));
+}
+
+TARGET("avx2") static inline __m256i
+uf_from_f32_avx2(__m256 val, int shift, int max_finite)
+{
+	const __m256i bits = _mm256_castps_si256(val);
+	const __m256i abs = _mm256_and_si256(bits,
+					     _mm256_set1_epi32(0x7fffffff));
+	const __m256i inf = _mm256_set1_epi32(0x7f800000);
+	const __m256i inf_code = _mm256_set1_epi32(max_finite + 1);
+	__m256i code;
+
+	code = _mm256_sub_epi32(_mm256_srai_epi32(bits, shift),
+				_mm256_set1_epi32(112 << (23 - shift)));
+	code = _mm256_and_si256(code,
+				_mm256_cmpgt_epi32(bits,
+						   _mm256_set1_epi32((113 << 23) - 1)));
+	code = _mm256_min_epi32(code, _mm256_set1_epi32(max_finite));
+	code = _mm256_blendv_epi8(code, inf_code,
+				  _mm256_cmpeq_epi32(bits, inf));
+	return _mm256_blendv_epi8(code,
+				  _mm256_add_epi32(inf_code,
+						   _mm256_set1_epi32(1)),
+				  _mm256_cmpgt_epi32(abs, inf));
+}
+
+TARGET("sse4.1") static size_t
+uf_from_f32_array_sse41(const float *val, uint16_t *retval, size_t count,
+			int shift, int max_finite)
+{
+	size_t i;
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		__m128i lo = uf_from_f32_sse41(_mm_loadu_ps(&val[i]),
+					       shift, max_finite);
+		__m128i hi = uf_from_f32_sse41(_mm_loadu_ps(&val[i + 4]),
+					       shift, max_finite);
+
+		_mm_storeu_si128((__m128i *) &retval[i],
+				 _mm_packus_epi32(lo, hi));
+	}
+
+	return i;
+}
+
+TARGET("avx2") static size_t
+uf_from_f32_array_avx2(const float *val, uint16_t *retval, size_t count,
+		       int shift, int max_finite)
+{
+	size_t i;
+
+	for (i = 0; i + 16 <= count; i += 16) {
+		__m256i lo = uf_from_f32_avx2(_mm256_loadu_ps(&val[i]),
+					      shift, max_finite);
+		__m256i hi = uf_from_f32_avx2(_mm256_loadu_ps(&val[i + 8]),
+					      shift, max_finite);
+
+		/* packus works within 128-bit lanes */
+		_mm256_storeu_si256((__m256i *) &retval[i],
+				    _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi),
+							     _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+
+	return i;
+}
+
+static size_t
+uf_from_f32_array_simd(const float *val, uint16_t *retval, size_t count,
+		       int shift, int max_finite)
+{
+	if (cpu_features() & CPU_AVX2)
+		return uf_from_f32_array_avx2(val, retval, count, shift,
+					      max_finite);
+	if (cpu_features() & CPU_SSE41)
+		return uf_from_f32_array_sse41(val, retval, count, shift,
+					       max_finite);
+	return 0;
+}
+
+TARGET("sse4.1") static size_t
+float3_to_r11g11b10f_array_sse41(const float *rgb, unsigned *retval,
+				 size_t count)
+{
+	size_t i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		__m128 r, g, b;
+		__m128i packed;
+
+		load_rgb4(&rgb[i * 3], &r, &g, &b);
+		packed = _mm_or_si128(uf_from_f32_sse41(r, 17, 0x7bf),
+				      _mm_slli_epi32(uf_from_f32_sse41(g, 17, 0x7bf), 11));
+		packed = _mm_or_si128(packed,
+				      _mm_slli_epi32(uf_from_f32_sse41(b, 18, 0x3df), 22));
+		_mm_storeu_si128((__m128i *) &retval[i], packed);
+	}
+
+	return i;
+}
+
+/*
+ * Round x, which is positive and small enough to be converted exactly, to
+ * the nearest integer with halfway cases rounded up, as floor(x + 0.5) does
+ * in double precision.  x + 0.5 isn't exact in single precision.
+ */
+TARGET("sse4.1") static inline __m128i
+round_half_up_sse41(__m128 x)
+{
+	const __m128i i = _mm_cvttps_epi32(x);
+	const __m128 frac = _mm_sub_ps(x, _mm_cvtepi32_ps(i));
+
+	/* The comparison is ~0, -1, for the values to round up. */
+	return _mm_sub_epi32(i, _mm_castps_si128(_mm_cmpge_ps(frac,
+							       _mm_set1_ps(0.5f))));
+}
+
+/* A power of two from its exponent, which must give a normal float. */
+TARGET("sse4.1") static inline __m128
+exp2i_sse41(__m128i e)
+{
+	return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e,
+							     _mm_set1_epi32(127)),
+					       23));
+}
+
+/*
+ * float3_to_rgb9e5() for four texels.  The division by denom there is a
+ * multiplication by a power of two here, which is just as exact.
+ */
+TARGET("sse4.1") static size_t
+float3_to_rgb9e5_array_sse41(const float *rgb, unsigned *retval, size_t count)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 max_rgb9e5 = _mm_set1_ps(65408.0f);
+	size_t i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		__m128 r, g, b, maxrgb, scale;
+		__m128i exp_shared, maxm, packed;
+
+		load_rgb4(&rgb[i * 3], &r, &g, &b);
+
+		/* ClampRange_for_rgb9e5(), NaN goes to 0 */
+		r = _mm_and_ps(_mm_cmpgt_ps(r, zero), _mm_min_ps(r, max_rgb9e5));
+		g = _mm_and_ps(_mm_cmpgt_ps(g, zero), _mm_min_ps(g, max_rgb9e5));
+		b = _mm_and_ps(_mm_cmpgt_ps(b, zero), _mm_min_ps(b, max_rgb9e5));
+		maxrgb = _mm_max_ps(r, _mm_max_ps(g, b));
+
+		/* MAX2(-16, FloorLog2(maxrgb)) + 1 + 15 */
+		exp_shared = _mm_max_epi32(_mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(maxrgb), 23),
+							 _mm_set1_epi32(111)),
+					   _mm_setzero_si128());
+
+		/* 1 / denom is 2^(24 - exp_shared) */
+		scale = exp2i_sse41(_mm_sub_epi32(_mm_set1_epi32(24), exp_shared));
+		maxm = round_half_up_sse41(_mm_mul_ps(maxrgb, scale));
+		exp_shared = _mm_sub_epi32(exp_shared,
+					   _mm_cmpeq_epi32(maxm, _mm_set1_epi32(512)));
+		scale = exp2i_sse41(_mm_sub_epi32(_mm_set1_epi32(24), exp_shared));
+
+		packed = _mm_or_si128(round_half_up_sse41(_mm_mul_ps(r, scale)),
+				      _mm_slli_epi32(round_half_up_sse41(_mm_mul_ps(g, scale)), 9));
+		packed = _mm_or_si128(packed,
+				      _mm_slli_epi32(round_half_up_sse41(_mm_mul_ps(b, scale)), 18));
+		packed = _mm_or_si128(packed, _mm_slli_epi32(exp_shared, 27));
+		_mm_storeu_si128((__m128i *) &retval[i], packed);
+	}
+
+	return i;
+}
+
+TARGET("sse4.1") static size_t
+rgb9e5_to_float3_array_sse41(const unsigned *rgb, float *retval, size_t count)
+{
+	const __m128i mask = _mm_set1_epi32(0x1ff);
+	size_t i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		const __m128i v = _mm_loadu_si128((const __m128i *) &rgb[i]);
+		const __m128 scale =
+			exp2i_sse41(_mm_sub_epi32(_mm_srli_epi32(v, 27),
+						  _mm_set1_epi32(24)));
+
+		store_rgb4(&retval[i * 3],
+			   _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(v, mask)),
+				      scale),
+			   _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 9), mask)),
+				      scale),
+			   _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 18), mask)),
+				      scale));
+	}
+
+	return i;
+}
+
+/*
+ * piglit_half_from_float() truncates, which the conversion instruction can
+ * do too, but overflows to infinity instead of the largest finite half and
+ * turns every NaN into 0x7c01 with the NaN's sign.
+ */
+TARGET("avx,f16c") static size_t
+half_from_float_array_f16c(const float *val, unsigned short *retval,
+			   size_t count)
+{
+	const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+	const __m256 inf = _mm256_castsi256_ps(_mm256_set1_epi32(0x7f800000));
+	const __m256 overflow = _mm256_set1_ps(65536.0f);
+	const __m128i half_sign = _mm_set1_epi16((short) 0x8000);
+	const __m128i half_nan = _mm_set1_epi16(0x7c01);
+	size_t i;
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		__m256 x = _mm256_loadu_ps(&val[i]);
+		__m256 big = _mm256_cmp_ps(_mm256_and_ps(x, abs_mask),
+					   overflow, _CMP_GE_OQ);
+		__m256i nan = _mm256_castps_si256(_mm256_cmp_ps(x, x,
+								_CMP_UNORD_Q));
+		__m128i h, nan16;
+
+		x = _mm256_blendv_ps(x, _mm256_or_ps(_mm256_and_ps(x, sign_mask),
+						     inf), big);
+		h = _mm256_cvtps_ph(x, _MM_FROUND_TO_ZERO);
+
+		nan16 = _mm_packs_epi32(_mm256_castsi256_si128(nan),
+					_mm256_extractf128_si256(nan, 1));
+		h = _mm_or_si128(_mm_andnot_si128(nan16, h),
+				 _mm_and_si128(nan16,
+					       _mm_or_si128(_mm_and_si128(h, half_sign),
+							    half_nan)));
+		_mm_storeu_si128((__m128i *) &retval[i], h);
+	}
+
+	return i;
+}
+
+TARGET("avx,f16c") static size_t
+float_from_half_array_f16c(const unsigned short *val, float *retval,
+			   size_t count)
+{
+	size_t i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(&retval[i],
+				 _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) &val[i])));
+
+	return i;
+}
+#endif /* USE_X86_SIMD */
+
+/**
+ * Limit the converters to the instruction sets of \p level, so that the
+ * packed-float-array-selftest can check each path the CPU has.  Level 0
+ * is the loops over the single value converters, and each level adds to
+ * the one before.  Returns the name of the level, or NULL if the CPU
+ * doesn't have it, and so has none of the higher ones either.
+ */
+const char *
+piglit_packed_float_array_set_level(unsigned level)
+{
+#ifdef USE_X86_SIMD
+	static const struct {
+		const char *name;
+		unsigned features;
+	} levels[] = {
+		{ "C", 0 },
+		{ "SSE4.1", CPU_SSE41 },
+		{ "SSE4.1 and F16C", CPU_SSE41 | CPU_F16C },
+		{ "AVX2 and F16C", CPU_SSE41 | CPU_F16C | CPU_AVX2 },
+	};
+
+	if (level >= ARRAY_SIZE(levels) ||
+	    (levels[level].features & ~detect_cpu_features()))
+		return NULL;
+
+	feature_mask = levels[level].features;
+	return levels[level].name;
+#else
+	return level == 0 ? "C" : NULL;
+#endif
+}
+
+void
+piglit_half_from_float_array(const float *val, unsigned short *retval,
+			     size_t count)
+{
+	size_t i = 0;
+
+#ifdef USE_X86_SIMD
+	if (cpu_features() & CPU_F16C)
+		i = half_from_float_array_f16c(val, retval, count);
+#endif
+
+	for (; i < count; i++)
+		retval[i] = piglit_half_from_float(val[i]);
+}
+
+void
+piglit_float_from_half_array(const unsigned short *val, float *retval,
+			     size_t count)
+{
+	size_t i = 0;
+
+#ifdef USE_X86_SIMD
+	if (cpu_features() & CPU_F16C)
+		i = float_from_half_array_f16c(val, retval, count);
+#endif
+
+	for (; i < count; i++)
+		retval[i] = piglit_float_from_half(val[i]);
+}
+
+void
+f32_to_uf11_array(const float *val, uint16_t *retval, size_t count)
+{
+	size_t i = 0;
+
+#ifdef USE_X86_SIMD
+	i = uf_from_f32_array_simd(val, retval, count, 17, 0x7bf);
+#endif
+
+	for (; i < count; i++)
+		retval[i] = f32_to_uf11(val[i]);
+}
+
+void
+f32_to_uf10_array(const float *val, uint16_t *retval, size_t count)
+{
+	size_t i = 0;
+
+#ifdef USE_X86_SIMD
+	i = uf_from_f32_array_simd(val, retval, count, 18, 0x3df);
+#endif
+
+	for (; i < count; i++)
+		retval[i] = f32_to_uf10(val[i]);
+}
+
+void
+float3_to_r11g11b10f_array(const float *rgb, unsigned *retval, size_t count)
+{
+	size_t i = 0;
+
+#ifdef USE_X86_SIMD
+	if (cpu_features() & CPU_SSE41)
+		i = float3_to_r11g11b10f_array_sse41(rgb, retval, count);
+#endif
+
+	for (; i < count; i++)
+		retval[i] = float3_to_r11g11b10f(&rgb[i * 3]);
+}
+
+void
+float3_to_rgb9e5_array(const float *rgb, unsigned *retval, size_t count)
+{
+	size_t i = 0;
+
+#ifdef USE_X86_SIMD
+	if (cpu_features() & CPU_SSE41)
+		i = float3_to_rgb9e5_array_sse41(rgb, retval, count);
+#endif
+
+	for (; i < count; i++)
+		retval[i] = float3_to_rgb9e5(&rgb[i * 3]);
+}
+
+void
+rgb9e5_to_float3_array(const unsigned *rgb, float *retval, size_t count)
+{
+	size_t i = 0;
+
+#ifdef USE_X86_SIMD
+	if (cpu_features() & CPU_SSE41)
+		i = rgb9e5_to_float3_array_sse41(rgb, retval, count);
+#endif
+
+	for (; i < count; i++)
+		rgb9e5_to_float3(rgb[i], &retval[i * 3]);
+}
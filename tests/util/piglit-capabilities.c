@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) The Piglit project 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-capabilities.c
+ *
+ * Print what the platform in PIGLIT_PLATFORM supports, for every API and
+ * profile, as a single json object:
+ *
+ *	{"platform": "glx",
+ *	 "contexts": {"gl core": {"vendor": ..., "renderer": ...,
+ *	                          "version": ..., "glsl": ...,
+ *	                          "extensions": [...]},
+ *	              "gl compat": ..., "gl none": ...,
+ *	              "gles1": ..., "gles2": ..., "gles3": ...},
+ *	 "libraries": ["/usr/lib/libGL.so.1", ...]}
+ *
+ * Contexts that can't be created are left out.  "libraries" lists the
+ * shared objects that were loaded, so that the framework can tell when a
+ * cached copy of this output is out of date.
+ *
+ * This replaces a dozen wflinfo runs, each creating one context, with a
+ * single process.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "piglit-util-gl.h"
+#include "piglit-framework-gl/piglit_wfl_framework.h"
+
+typedef const GLubyte *(APIENTRY *get_string_func)(GLenum name);
+typedef const GLubyte *(APIENTRY *get_stringi_func)(GLenum name, GLuint index);
+typedef void (APIENTRY *get_integerv_func)(GLenum pname, GLint *params);
+
+struct flavor {
+	const char *name;
+	int32_t api;
+	int32_t dl;
+	int32_t profile;
+	/* Try versions from 4.6 down to this one, or 0 for no version. */
+	int min_version;
+};
+
+static const struct flavor flavors[] = {
+	{ "gl core", WAFFLE_CONTEXT_OPENGL, WAFFLE_DL_OPENGL,
+	  WAFFLE_CONTEXT_CORE_PROFILE, 32 },
+	{ "gl compat", WAFFLE_CONTEXT_OPENGL, WAFFLE_DL_OPENGL,
+	  WAFFLE_CONTEXT_COMPATIBILITY_PROFILE, 32 },
+	{ "gl none", WAFFLE_CONTEXT_OPENGL, WAFFLE_DL_OPENGL, 0, 0 },
+	{ "gles1", WAFFLE_CONTEXT_OPENGL_ES1, WAFFLE_DL_OPENGL_ES1, 0, 0 },
+	{ "gles2", WAFFLE_CONTEXT_OPENGL_ES2, WAFFLE_DL_OPENGL_ES2, 0, 0 },
+	{ "gles3", WAFFLE_CONTEXT_OPENGL_ES3, WAFFLE_DL_OPENGL_ES3, 0, 0 },
+};
+
+static const int gl_versions[] = {
+	46, 45, 44, 43, 42, 41, 40, 33, 32,
+};
+
+static void
+print_json_string(const char *s)
+{
+	putchar('"');
+	for (; s != NULL && *s; s++) {
+		if (*s == '"' || *s == '\\')
+			printf("\\%c", *s);
+		else if ((unsigned char) *s < 0x20)
+			printf("\\u%04x", (unsigned char) *s);
+		else
+			putchar(*s);
+	}
+	putchar('"');
+}
+
+static void
+print_extension_list(const char *list)
+{
+	const char *s = list, *end;
+	bool first = true;
+
+	while (s != NULL && *s) {
+		while (*s == ' ')
+			s++;
+		end = strchr(s, ' ');
+		if (end == NULL)
+			end = s + strlen(s);
+		if (end != s) {
+			printf("%s\"%.*s\"", first ? "" : ", ",
+			       (int) (end - s), s);
+			first = false;
+		}
+		s = end;
+	}
+}
+
+static struct waffle_context *
+create_context(struct waffle_display *dpy, const struct flavor *f,
+	       int version, struct waffle_config **config)
+{
+	int32_t attribs[16];
+	struct waffle_context *ctx;
+	int i = 0;
+
+	attribs[i++] = WAFFLE_CONTEXT_API;
+	attribs[i++] = f->api;
+	if (version) {
+		attribs[i++] = WAFFLE_CONTEXT_MAJOR_VERSION;
+		attribs[i++] = version / 10;
+		attribs[i++] = WAFFLE_CONTEXT_MINOR_VERSION;
+		attribs[i++] = version % 10;
+	}
+	if (f->profile) {
+		attribs[i++] = WAFFLE_CONTEXT_PROFILE;
+		attribs[i++] = f->profile;
+	}
+	attribs[i++] = WAFFLE_RED_SIZE;
+	attribs[i++] = 8;
+	attribs[i++] = WAFFLE_GREEN_SIZE;
+	attribs[i++] = 8;
+	attribs[i++] = WAFFLE_BLUE_SIZE;
+	attribs[i++] = 8;
+	attribs[i++] = 0;
+
+	*config = waffle_config_choose(dpy, attribs);
+	if (*config == NULL)
+		return NULL;
+
+	ctx = waffle_context_create(*config, NULL);
+	if (ctx == NULL) {
+		waffle_config_destroy(*config);
+		*config = NULL;
+	}
+	return ctx;
+}
+
+/**
+ * Print the "name": {...} member for one flavor, or nothing if no context
+ * of that flavor can be made current.  Returns whether anything was printed.
+ */
+static bool
+print_flavor(struct waffle_display *dpy, const struct flavor *f, bool comma)
+{
+	struct waffle_config *config = NULL;
+	struct waffle_context *ctx = NULL;
+	struct waffle_window *window;
+	get_string_func get_string;
+	get_stringi_func get_stringi;
+	get_integerv_func get_integerv;
+	unsigned i;
+
+	if (!waffle_dl_can_open(f->dl))
+		return false;
+
+	if (f->min_version) {
+		for (i = 0; i < ARRAY_SIZE(gl_versions) && ctx == NULL; i++) {
+			if (gl_versions[i] >= f->min_version)
+				ctx = create_context(dpy, f, gl_versions[i],
+						     &config);
+		}
+	} else {
+		ctx = create_context(dpy, f, 0, &config);
+	}
+	if (ctx == NULL)
+		return false;
+
+	window = waffle_window_create(config, 32, 32);
+	if (window == NULL || !waffle_make_current(dpy, window, ctx)) {
+		if (window)
+			waffle_window_destroy(window);
+		waffle_context_destroy(ctx);
+		waffle_config_destroy(config);
+		return false;
+	}
+
+	get_string = (get_string_func) waffle_dl_sym(f->dl, "glGetString");
+	get_integerv = (get_integerv_func) waffle_dl_sym(f->dl,
+							 "glGetIntegerv");
+	get_stringi = (get_stringi_func)
+		waffle_get_proc_address("glGetStringi");
+
+	printf("%s\n  ", comma ? "," : "");
+	print_json_string(f->name);
+	printf(": {\"vendor\": ");
+	print_json_string((const char *) get_string(GL_VENDOR));
+	printf(", \"renderer\": ");
+	print_json_string((const char *) get_string(GL_RENDERER));
+	printf(", \"version\": ");
+	print_json_string((const char *) get_string(GL_VERSION));
+	printf(", \"glsl\": ");
+	if (f->api == WAFFLE_CONTEXT_OPENGL_ES1)
+		print_json_string(NULL);
+	else
+		print_json_string((const char *)
+				  get_string(GL_SHADING_LANGUAGE_VERSION));
+
+	printf(", \"extensions\": [");
+	if (f->profile == WAFFLE_CONTEXT_CORE_PROFILE && get_stringi) {
+		GLint n = 0;
+
+		get_integerv(GL_NUM_EXTENSIONS, &n);
+		for (i = 0; i < (unsigned) n; i++) {
+			printf("%s", i ? ", " : "");
+			print_json_string((const char *)
+					  get_stringi(GL_EXTENSIONS, i));
+		}
+	} else {
+		print_extension_list((const char *) get_string(GL_EXTENSIONS));
+	}
+	printf("]}");
+
+	waffle_make_current(dpy, NULL, NULL);
+	waffle_window_destroy(window);
+	waffle_context_destroy(ctx);
+	waffle_config_destroy(config);
+	return true;
+}
+
+/**
+ * Print the shared objects mapped into this process.
+ */
+static void
+print_libraries(void)
+{
+#if defined(__linux__)
+	FILE *maps = fopen("/proc/self/maps", "r");
+	char line[4096], last[4096] = "";
+	bool first = true;
+
+	if (maps == NULL)
+		return;
+
+	while (fgets(line, sizeof(line), maps)) {
+		char *path = strchr(line, '/');
+
+		if (path == NULL || strstr(path, ".so") == NULL)
+			continue;
+		path[strcspn(path, "\n")] = '\0';
+		if (strcmp(path, last) == 0)
+			continue;
+
+		printf("%s\n  ", first ? "" : ",");
+		print_json_string(path);
+		first = false;
+		snprintf(last, sizeof(last), "%s", path);
+	}
+
+	fclose(maps);
+#endif
+}
+
+int
+main(int argc, char **argv)
+{
+	struct piglit_gl_test_config config;
+	struct waffle_display *dpy;
+	int32_t platform;
+	int32_t init_attribs[3];
+	bool comma = false;
+	unsigned i;
+
+	piglit_gl_test_config_init(&config);
+	config.supports_gl_compat_version = 10;
+	platform = piglit_wfl_framework_choose_platform(&config);
+
+	init_attribs[0] = WAFFLE_PLATFORM;
+	init_attribs[1] = platform;
+	init_attribs[2] = 0;
+	if (!waffle_init(init_attribs)) {
+		fprintf(stderr, "piglit-capabilities: waffle_init failed\n");
+		return 1;
+	}
+
+	dpy = waffle_display_connect(NULL);
+	if (dpy == NULL) {
+		fprintf(stderr, "piglit-capabilities: "
+			"waffle_display_connect failed\n");
+		return 1;
+	}
+
+	printf("{\"platform\": ");
+	print_json_string(waffle_enum_to_string(platform));
+	printf(",\n \"contexts\": {");
+	for (i = 0; i < ARRAY_SIZE(flavors); i++) {
+		if (print_flavor(dpy, &flavors[i], comma))
+			comma = true;
+	}
+	printf("},\n \"libraries\": [");
+	print_libraries();
+	printf("]}\n");
+
+	waffle_display_disconnect(dpy);
+	return 0;
+}
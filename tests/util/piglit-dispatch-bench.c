@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) The Piglit project 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-dispatch-bench.c
+ *
+ * Measure the extension queries and function lookups that tests do at
+ * startup, against a fake GL implementation, so no context or display is
+ * needed:
+ *
+ *	piglit-dispatch-bench [iterations]
+ *
+ * Extension queries are timed both through piglit_is_extension_supported()
+ * and through the linear piglit_is_extension_in_array() scan it replaces.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "piglit-util-gl.h"
+
+/* A realistically sized extension list: these plus padding */
+static const char *const real_extensions[] = {
+	"GL_ARB_multisample", "GL_EXT_abgr", "GL_EXT_bgra",
+	"GL_EXT_blend_color", "GL_EXT_blend_minmax", "GL_EXT_blend_subtract",
+	"GL_EXT_copy_texture", "GL_EXT_polygon_offset", "GL_EXT_subtexture",
+	"GL_EXT_texture_object", "GL_EXT_vertex_array", "GL_EXT_compiled_vertex_array",
+	"GL_EXT_texture", "GL_EXT_texture3D", "GL_IBM_rasterpos_clip",
+	"GL_ARB_point_parameters", "GL_EXT_draw_range_elements",
+	"GL_EXT_packed_pixels", "GL_EXT_point_parameters",
+	"GL_EXT_rescale_normal", "GL_EXT_separate_specular_color",
+	"GL_EXT_texture_edge_clamp", "GL_SGIS_generate_mipmap",
+	"GL_SGIS_texture_border_clamp", "GL_SGIS_texture_edge_clamp",
+	"GL_SGIS_texture_lod", "GL_ARB_framebuffer_sRGB",
+	"GL_ARB_multitexture", "GL_EXT_framebuffer_sRGB",
+	"GL_ARB_texture_cube_map", "GL_ARB_texture_env_add",
+	"GL_ARB_vertex_buffer_object", "GL_ARB_framebuffer_object",
+	"GL_ARB_uniform_buffer_object", "GL_ARB_shader_storage_buffer_object",
+	"GL_ARB_compute_shader", "GL_ARB_tessellation_shader",
+	"GL_ARB_gpu_shader5", "GL_ARB_gpu_shader_fp64",
+	"GL_ARB_texture_multisample", "GL_ARB_sample_shading",
+	"GL_ARB_shader_image_load_store", "GL_ARB_direct_state_access",
+};
+
+#define NUM_PADDING 300
+
+/* What tests typically ask for, present or not */
+static const char *const queries[] = {
+	"GL_ARB_framebuffer_object", "GL_ARB_direct_state_access",
+	"GL_ARB_texture_multisample", "GL_NV_fence", "GL_AMD_performance_monitor",
+	"GL_ARB_bindless_texture", "GL_EXT_abgr", "GL_ARB_multitexture",
+	"GL_ARB_compute_shader", "GL_INTEL_performance_query",
+};
+
+static const char *const functions[] = {
+	"glBindFramebuffer", "glBindFramebufferEXT", "glGenTextures",
+	"glTexImage2D", "glDispatchCompute", "glNamedBufferData",
+	"glGetProgramResourceIndex", "glFenceSync", "glBogusFunction",
+	"glMultiTexCoord2fARB",
+};
+
+static char *extension_names[ARRAY_SIZE(real_extensions) + NUM_PADDING];
+
+static const GLubyte * APIENTRY
+fake_get_string(GLenum name)
+{
+	return (const GLubyte *) (name == GL_VERSION ? "4.5 fake" : "fake");
+}
+
+static const GLubyte * APIENTRY
+fake_get_stringi(GLenum name, GLuint index)
+{
+	return (const GLubyte *) extension_names[index];
+}
+
+static void APIENTRY
+fake_get_integerv(GLenum pname, GLint *params)
+{
+	*params = pname == GL_NUM_EXTENSIONS ? ARRAY_SIZE(extension_names) : 0;
+}
+
+static void APIENTRY
+fake_function(void)
+{
+}
+
+static piglit_dispatch_function_ptr
+get_ext_proc(const char *name)
+{
+	if (strcmp(name, "glGetString") == 0)
+		return (piglit_dispatch_function_ptr) fake_get_string;
+	if (strcmp(name, "glGetStringi") == 0)
+		return (piglit_dispatch_function_ptr) fake_get_stringi;
+	if (strcmp(name, "glGetIntegerv") == 0)
+		return (piglit_dispatch_function_ptr) fake_get_integerv;
+	return fake_function;
+}
+
+static piglit_dispatch_function_ptr
+get_core_proc(const char *name, int gl_version)
+{
+	return get_ext_proc(name);
+}
+
+static void
+ignore_error(const char *name)
+{
+}
+
+static void
+report(const char *what, int64_t start, unsigned count)
+{
+	printf("%-40s %8.1f ns\n", what,
+	       (double) (piglit_time_get_nano() - start) / count);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char **array;
+	unsigned iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+	unsigned i, j, found = 0;
+	int64_t start;
+
+	for (i = 0; i < ARRAY_SIZE(real_extensions); i++) {
+		extension_names[i] = strdup(real_extensions[i]);
+		if (extension_names[i] == NULL) {
+			printf("out of memory\n");
+			return 1;
+		}
+	}
+	for (; i < ARRAY_SIZE(extension_names); i++) {
+		if (asprintf(&extension_names[i],
+			     "GL_FAKE_padding_extension_%u", i) < 0) {
+			printf("out of memory\n");
+			return 1;
+		}
+	}
+
+	start = piglit_time_get_nano();
+	piglit_dispatch_init(PIGLIT_DISPATCH_GL, get_core_proc, get_ext_proc,
+			     ignore_error, ignore_error);
+	piglit_is_extension_supported("GL_ARB_multisample");
+	report("init and parse extensions", start, 1);
+
+	array = malloc(sizeof(char *) * (ARRAY_SIZE(extension_names) + 1));
+	if (array == NULL) {
+		printf("out of memory\n");
+		return 1;
+	}
+	memcpy(array, extension_names, sizeof(extension_names));
+	array[ARRAY_SIZE(extension_names)] = NULL;
+
+	start = piglit_time_get_nano();
+	for (i = 0; i < iterations; i++)
+		for (j = 0; j < ARRAY_SIZE(queries); j++)
+			found += piglit_is_extension_in_array(array, queries[j]);
+	report("piglit_is_extension_in_array", start,
+	       iterations * ARRAY_SIZE(queries));
+
+	start = piglit_time_get_nano();
+	for (i = 0; i < iterations; i++)
+		for (j = 0; j < ARRAY_SIZE(queries); j++)
+			found -= piglit_is_extension_supported(queries[j]);
+	report("piglit_is_extension_supported", start,
+	       iterations * ARRAY_SIZE(queries));
+
+	start = piglit_time_get_nano();
+	for (i = 0; i < iterations; i++)
+		found += piglit_is_extension_id_supported(
+			PIGLIT_EXT_GL_ARB_framebuffer_object);
+	report("piglit_is_extension_id_supported", start, iterations);
+	found -= iterations;
+
+	start = piglit_time_get_nano();
+	for (i = 0; i < iterations; i++)
+		for (j = 0; j < ARRAY_SIZE(functions); j++)
+			piglit_dispatch_resolve_function(functions[j]);
+	report("piglit_dispatch_resolve_function", start,
+	       iterations * ARRAY_SIZE(functions));
+
+	/* The two ways of querying must agree */
+	if (found != 0) {
+		printf("piglit_is_extension_supported() disagrees with "
+		       "piglit_is_extension_in_array()\n");
+		return 1;
+	}
+	return 0;
+}
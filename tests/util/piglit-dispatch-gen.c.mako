@@ -56,7 +56,7 @@ resolve_${f0.name}(void)
 % if apis:
 % if req.has_extension:
 ....................................................................................................)
->-------    && check_extension("${req.extension.name}")
+>-------    && check_extension(PIGLIT_EXT_${req.extension.name})
 % endif
 ...............................................................) {
 % if req.has_feature:
@@ -95,16 +95,32 @@ static void reset_dispatch_pointers(void)
 % endfor
 }
 
-static const char * function_names[] = {
-% for command in gl_registry.commands:
->-------"${command.name}",
+##
+## The function and extension names, in the slots of their perfect hashes.
+## See PerfectHash in gen_dispatch.py and lookup_name() in
+## piglit-dispatch.c.
+##
+static const struct function_entry function_table[] = {
+% for name in function_hash.names:
+>-------{ "${name}", resolve_${gl_registry.command_alias_map.get(name, None).primary_command.name} },
 % endfor
 };
 
-static void* (*const function_resolvers[])(void) = {
-% for alias_set in gl_registry.command_alias_map:
-<% f0 = alias_set.primary_command %>\
->-------resolve_${f0.name},
+static const int32_t function_hash_seeds[] = {
+% for i in range(0, len(function_hash.seeds), 8):
+>-------${', '.join(str(x) for x in function_hash.seeds[i:i + 8])},
+% endfor
+};
+
+static const char *const extension_names[] = {
+% for name in extension_hash.names:
+>-------"${name}",
+% endfor
+};
+
+static const int32_t extension_hash_seeds[] = {
+% for i in range(0, len(extension_hash.seeds), 8):
+>-------${', '.join(str(x) for x in extension_hash.seeds[i:i + 8])},
 % endfor
 };
 </%block>\
@@ -73,6 +73,14 @@ extern PFN${f0.name.upper()}PROC piglit_dispatch_${f0.name};
 #define ${extension.name} 1
 % endfor
 
+/* Extension IDs, see piglit_is_extension_id_supported() */
+enum piglit_extension_id {
+% for name in extension_hash.names:
+>-------PIGLIT_EXT_${name},
+% endfor
+>-------PIGLIT_NUM_EXTENSIONS
+};
+
 /* Versions */
 % for feature in gl_registry.features:
 #define ${feature.name} 1
@@ -121,13 +121,62 @@ check_version(int required_version)
  * extension is supported.
  */
 static inline bool
-check_extension(const char *name)
+check_extension(enum piglit_extension_id id)
 {
-	return piglit_is_extension_supported(name);
+	return piglit_is_extension_id_supported(id);
 }
 
+struct function_entry {
+	const char *name;
+	void *(*resolve)(void);
+};
+
 #include "piglit-dispatch-gen.c"
 
+/**
+ * 32 bit FNV-1a of name, started from the offset basis xor seed.
+ *
+ * This must match name_hash() in gen_dispatch.py.
+ */
+static inline uint32_t
+hash_name(uint32_t seed, const char *name)
+{
+	uint32_t h = 2166136261u ^ seed;
+
+	for (; *name; name++) {
+		h ^= (unsigned char) *name;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/**
+ * Find the slot of name in one of the generated perfect hashes.  The
+ * caller still has to check that the name in that slot is name.
+ */
+static unsigned
+lookup_name(const int32_t *seeds, unsigned size, const char *name)
+{
+	int32_t seed = seeds[hash_name(0, name) % size];
+
+	if (seed < 0)
+		return -seed - 1;
+	return hash_name(seed, name) % size;
+}
+
+/**
+ * Return the piglit_extension_id of a GL extension, or -1 if it isn't
+ * in the registry.
+ */
+int
+piglit_dispatch_extension_id(const char *name)
+{
+	unsigned slot = lookup_name(extension_hash_seeds,
+				    ARRAY_SIZE(extension_hash_seeds), name);
+
+	return strcmp(extension_names[slot], name) == 0 ? (int) slot : -1;
+}
+
 /**
  * Initialize the dispatch mechanism.
  *
@@ -190,16 +239,6 @@ piglit_dispatch_init(piglit_dispatch_api api,
 	gl_version = piglit_get_gl_version();
 }
 
-/**
- * Compare two strings in the function_names table.
- */
-static int compare_function_names(const void *x, const void *y)
-{
-	const char *x_str = *(const char * const *) x;
-	const char *y_str = *(const char * const *) y;
-	return strcmp(x_str, y_str);
-}
-
 /**
  * Retrieve a GL function pointer given the function name.
  *
@@ -222,17 +261,15 @@ static int compare_function_names(const void *x, const void *y)
 piglit_dispatch_function_ptr
 piglit_dispatch_resolve_function(const char *name)
 {
-	size_t item_size = sizeof(function_names[0]);
-	size_t num_items = ARRAY_SIZE(function_names);
-	const char * const *item = (const char * const *)
-		bsearch(&name, function_names, num_items, item_size,
-			compare_function_names);
+	const struct function_entry *entry =
+		&function_table[lookup_name(function_hash_seeds,
+					    ARRAY_SIZE(function_hash_seeds),
+					    name)];
 	check_initialized();
-	if (!item) {
+	if (strcmp(entry->name, name) != 0) {
 		unsupported(name);
 		return NULL;
 	} else {
-		size_t item_index = item - function_names;
-		return function_resolvers[item_index]();
+		return (piglit_dispatch_function_ptr) entry->resolve();
 	}
 }
@@ -159,6 +159,8 @@ piglit_dispatch_resolve_function(const char *name);
 
 void piglit_dispatch_default_init(piglit_dispatch_api api);
 
+int piglit_dispatch_extension_id(const char *name);
+
 /* Prevent gl.h from being included, since it will attempt to define
  * the functions we've already defined.
  */
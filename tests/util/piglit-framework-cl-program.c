@@ -234,13 +234,13 @@ piglit_cl_program_test_run(const int argc,
 
 	printf("#   Build options: %s\n", build_options);
 
-	/* Create and build program */
+	/* Create and build program, from the binary cache unless it should fail */
 	if(config->program_source != NULL) {
 		if(!config->expect_build_fail) {
-			env.program = piglit_cl_build_program_with_source(env.context,
-			                                                  1,
-			                                                  &config->program_source,
-			                                                  build_options);
+			env.program = piglit_cl_build_program_with_source_cached(env.context,
+			                                                         1,
+			                                                         &config->program_source,
+			                                                         build_options);
 		} else {
 			env.program = piglit_cl_fail_build_program_with_source(env.context,
 			                                                       1,
@@ -254,10 +254,10 @@ piglit_cl_program_test_run(const int argc,
 		program_source = piglit_load_text_file(config->program_source_file, &size);
 		if(program_source != NULL && size > 0) {
 			if(!config->expect_build_fail) {
-				env.program = piglit_cl_build_program_with_source(env.context,
-				                                                  1,
-				                                                  &program_source,
-				                                                  build_options);
+				env.program = piglit_cl_build_program_with_source_cached(env.context,
+				                                                         1,
+				                                                         &program_source,
+				                                                         build_options);
 			} else {
 				env.program = piglit_cl_fail_build_program_with_source(env.context,
 				                                                       1,
@@ -181,10 +181,43 @@ destroy(void)
 		gl_fw->destroy(gl_fw);
 }
 
+/* The test's own init and display, which the framework calls through
+ * timed_init() and timed_display() to time the phases.
+ */
+static void (*test_init)(int argc, char *argv[]);
+static enum piglit_result (*test_display)(void);
+
+static void
+timed_init(int argc, char *argv[])
+{
+	piglit_phase_set(PIGLIT_PHASE_INIT);
+	test_init(argc, argv);
+}
+
+static enum piglit_result
+timed_display(void)
+{
+	piglit_phase_set(PIGLIT_PHASE_DISPLAY);
+	return test_display();
+}
+
 void
 piglit_gl_test_run(int argc, char *argv[],
 		   const struct piglit_gl_test_config *config)
 {
+	static struct piglit_gl_test_config timed_config;
+
+	piglit_phase_set(PIGLIT_PHASE_CONTEXT);
+
+	timed_config = *config;
+	test_init = config->init;
+	test_display = config->display;
+	if (config->init)
+		timed_config.init = timed_init;
+	if (config->display)
+		timed_config.display = timed_display;
+	config = &timed_config;
+
 	piglit_width = config->window_width;
 	piglit_height = config->window_height;
 
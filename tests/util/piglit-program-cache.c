@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) The Piglit project 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-program-cache.c
+ *
+ * Programs are stored in PIGLIT_PROGRAM_CACHE_DIR, one file per key named
+ * after the key's hash.  A file holds a struct cache_header followed by
+ * the program binary.  Files are written to a temporary name and renamed,
+ * so that concurrent tests never see a partial binary.
+ */
+
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include "piglit-util-gl.h"
+
+#define CACHE_MAGIC "PIGLITPB"
+
+struct cache_header {
+	char magic[8];
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+enum cache_state {
+	CACHE_UNKNOWN,
+	CACHE_DISABLED,
+	CACHE_ENABLED,
+};
+
+static enum cache_state state = CACHE_UNKNOWN;
+static const char *cache_dir;
+static GLint *binary_formats;
+static GLint num_binary_formats;
+static unsigned hits, misses;
+
+static void
+print_stats(void)
+{
+	fprintf(stderr, "piglit program cache: %u hits, %u misses\n",
+		hits, misses);
+}
+
+static bool
+context_supports_program_binary(void)
+{
+	if (piglit_is_gles()) {
+		if (piglit_get_gl_version() < 30)
+			return false;
+	} else if (piglit_get_gl_version() < 41 &&
+		   !piglit_is_extension_supported("GL_ARB_get_program_binary")) {
+		return false;
+	}
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_binary_formats);
+	if (num_binary_formats <= 0)
+		return false;
+
+	binary_formats = malloc(num_binary_formats * sizeof(GLint));
+	glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, binary_formats);
+	return true;
+}
+
+bool
+piglit_program_cache_enabled(void)
+{
+	if (state != CACHE_UNKNOWN)
+		return state == CACHE_ENABLED;
+
+	state = CACHE_DISABLED;
+
+	cache_dir = getenv("PIGLIT_PROGRAM_CACHE_DIR");
+	if (cache_dir == NULL || cache_dir[0] == '\0' ||
+	    getenv("PIGLIT_NO_PROGRAM_CACHE"))
+		return false;
+
+	if (!context_supports_program_binary())
+		return false;
+
+#if defined(_WIN32)
+	_mkdir(cache_dir);
+#else
+	mkdir(cache_dir, 0777);
+#endif
+
+	if (getenv("PIGLIT_PROGRAM_CACHE_VERBOSE"))
+		atexit(print_stats);
+
+	state = CACHE_ENABLED;
+	return true;
+}
+
+void
+piglit_program_cache_bypass(void)
+{
+	state = CACHE_DISABLED;
+}
+
+/**
+ * 64-bit FNV-1a.
+ */
+void
+piglit_program_cache_key_add(struct piglit_program_cache_key *key,
+			     const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+	uint64_t hash = key->hash;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= UINT64_C(0x100000001b3);
+	}
+
+	key->hash = hash;
+}
+
+void
+piglit_program_cache_key_add_string(struct piglit_program_cache_key *key,
+				    const char *str)
+{
+	/* Include the terminator so that "ab" "c" and "a" "bc" differ. */
+	if (str == NULL)
+		str = "";
+	piglit_program_cache_key_add(key, str, strlen(str) + 1);
+}
+
+void
+piglit_program_cache_key_add_int(struct piglit_program_cache_key *key,
+				 int value)
+{
+	piglit_program_cache_key_add(key, &value, sizeof(value));
+}
+
+void
+piglit_program_cache_key_init(struct piglit_program_cache_key *key)
+{
+	static const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	GLint flags = 0;
+	unsigned i;
+
+	key->hash = UINT64_C(0xcbf29ce484222325);
+
+	piglit_program_cache_key_add(key, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	for (i = 0; i < ARRAY_SIZE(strings); i++) {
+		piglit_program_cache_key_add_string(key,
+			(const char *) glGetString(strings[i]));
+	}
+
+	if (piglit_get_gl_version() >= 30)
+		glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+
+	piglit_program_cache_key_add_int(key, piglit_is_gles());
+	piglit_program_cache_key_add_int(key, piglit_is_core_profile);
+	piglit_program_cache_key_add_int(key, piglit_get_gl_version());
+	piglit_program_cache_key_add_int(key, flags);
+}
+
+static char *
+cache_path(const struct piglit_program_cache_key *key)
+{
+	char *path;
+
+	asprintf(&path, "%s/%016" PRIx64 ".bin", cache_dir, key->hash);
+	return path;
+}
+
+static bool
+is_binary_format_supported(GLenum format)
+{
+	GLint i;
+
+	for (i = 0; i < num_binary_formats; i++) {
+		if ((GLenum) binary_formats[i] == format)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Return the number of bytes in f, leaving it positioned at the start, or
+ * -1 if that can't be told.
+ */
+static long
+file_size(FILE *f)
+{
+	long size;
+
+	if (fseek(f, 0, SEEK_END) != 0)
+		return -1;
+	size = ftell(f);
+	rewind(f);
+	return size;
+}
+
+bool
+piglit_program_cache_load(GLuint prog,
+			  const struct piglit_program_cache_key *key)
+{
+	struct cache_header header;
+	char *path = cache_path(key);
+	FILE *f = fopen(path, "rb");
+	GLint ok = GL_FALSE;
+
+	free(path);
+
+	if (f != NULL) {
+		/* The binary must be exactly the rest of the file, so that a
+		 * truncated or corrupt entry never gets to malloc() or the
+		 * driver with a bogus length.
+		 */
+		const long size = file_size(f);
+
+		if (size >= (long) sizeof(header) &&
+		    fread(&header, sizeof(header), 1, f) == 1 &&
+		    memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+		    header.key == key->hash &&
+		    header.length != 0 &&
+		    header.length == (unsigned long) size - sizeof(header) &&
+		    is_binary_format_supported(header.format)) {
+			void *data = malloc(header.length);
+
+			if (data != NULL &&
+			    fread(data, 1, header.length, f) == header.length) {
+				/* A binary the driver no longer accepts
+				 * just leaves the program unlinked.
+				 */
+				piglit_phase_push(PIGLIT_PHASE_COMPILE);
+				glProgramBinary(prog, header.format, data,
+						header.length);
+				glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+				piglit_phase_pop();
+			}
+
+			free(data);
+		}
+
+		fclose(f);
+	}
+
+	if (ok) {
+		hits++;
+		return true;
+	}
+
+	misses++;
+	glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	return false;
+}
+
+void
+piglit_program_cache_store(GLuint prog,
+			   const struct piglit_program_cache_key *key)
+{
+	struct cache_header header;
+	GLint ok, length;
+	GLenum format;
+	char *path, *tmp_path;
+	void *data;
+	FILE *f;
+
+	glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+	if (!ok)
+		return;
+
+	glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	data = malloc(length);
+	glGetProgramBinary(prog, length, &length, &format, data);
+
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.key = key->hash;
+	header.format = format;
+	header.length = length;
+
+	path = cache_path(key);
+	asprintf(&tmp_path, "%s.%d.tmp", path, (int) getpid());
+
+	f = fopen(tmp_path, "wb");
+	if (f != NULL) {
+		bool written =
+			fwrite(&header, sizeof(header), 1, f) == 1 &&
+			fwrite(data, 1, length, f) == (size_t) length;
+
+		if (fclose(f) != 0 || !written || rename(tmp_path, path) != 0)
+			remove(tmp_path);
+	}
+
+	free(tmp_path);
+	free(path);
+	free(data);
+}
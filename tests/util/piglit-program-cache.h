@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) The Piglit project 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-program-cache.h
+ *
+ * On-disk cache of linked programs, stored with glGetProgramBinary.
+ *
+ * The cache is off unless PIGLIT_PROGRAM_CACHE_DIR names a directory to
+ * keep the binaries in.  Setting PIGLIT_NO_PROGRAM_CACHE, or calling
+ * piglit_program_cache_bypass(), turns it off again, which tests of the
+ * compiler or linker need.  When PIGLIT_PROGRAM_CACHE_VERBOSE is set the
+ * number of hits and misses is printed when the test exits.
+ *
+ * Typical use:
+ *
+ *	if (piglit_program_cache_enabled()) {
+ *		piglit_program_cache_key_init(&key);
+ *		piglit_program_cache_key_add_string(&key, vs_source);
+ *		if (piglit_program_cache_load(prog, &key))
+ *			return prog;
+ *	}
+ *	... compile, attach and link ...
+ *	piglit_program_cache_store(prog, &key);
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct piglit_program_cache_key {
+	uint64_t hash;
+};
+
+/**
+ * Whether programs should be looked up in the cache.  False when the
+ * cache isn't configured, is bypassed, or the context can't return
+ * program binaries.
+ */
+bool
+piglit_program_cache_enabled(void);
+
+/**
+ * Don't use the cache in this process.  For tests that are meant to
+ * exercise the compiler or linker.
+ */
+void
+piglit_program_cache_bypass(void);
+
+/**
+ * Start a key.  The key already covers the driver (renderer, vendor and
+ * version strings) and the context flags, so a context must be current.
+ */
+void
+piglit_program_cache_key_init(struct piglit_program_cache_key *key);
+
+void
+piglit_program_cache_key_add(struct piglit_program_cache_key *key,
+			     const void *data, size_t size);
+
+void
+piglit_program_cache_key_add_string(struct piglit_program_cache_key *key,
+				    const char *str);
+
+void
+piglit_program_cache_key_add_int(struct piglit_program_cache_key *key,
+				 int value);
+
+/**
+ * Load the program binary stored for \p key into \p prog.
+ *
+ * Returns true if \p prog is now linked.  Otherwise \p prog is left
+ * unlinked, ready to have shaders attached and be stored after linking.
+ */
+bool
+piglit_program_cache_load(GLuint prog,
+			  const struct piglit_program_cache_key *key);
+
+/**
+ * Store the binary of the linked program \p prog for \p key.  Errors are
+ * ignored, the cache is only an optimization.
+ */
+void
+piglit_program_cache_store(GLuint prog,
+			   const struct piglit_program_cache_key *key);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
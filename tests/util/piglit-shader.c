@@ -130,11 +130,13 @@ piglit_compile_shader_text_nothrow(GLenum target, const char *text)
 
 	piglit_require_GLSL();
 
+	piglit_phase_push(PIGLIT_PHASE_COMPILE);
 	prog = glCreateShader(target);
 	glShaderSource(prog, 1, (const GLchar **) &text, NULL);
 	glCompileShader(prog);
 
 	glGetShaderiv(prog, GL_COMPILE_STATUS, &ok);
+	piglit_phase_pop();
 
 	{
 		GLchar *info;
@@ -181,6 +183,14 @@ piglit_compile_shader_text(GLenum target, const char *text)
         return shader;
 }
 
+static void
+link_program(GLuint prog)
+{
+	piglit_phase_push(PIGLIT_PHASE_COMPILE);
+	glLinkProgram(prog);
+	piglit_phase_pop();
+}
+
 static GLboolean
 link_check_status(GLint prog, FILE *output)
 {
@@ -190,7 +200,10 @@ link_check_status(GLint prog, FILE *output)
 
 	piglit_require_GLSL();
 
+	/* Drivers that link in a thread wait for it here. */
+	piglit_phase_push(PIGLIT_PHASE_COMPILE);
 	glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+	piglit_phase_pop();
 
 	/* Some drivers return a size of 1 for an empty log.  This is the size
 	 * of a log that contains only a terminating NUL character.
@@ -259,7 +272,7 @@ GLint piglit_link_simple_program(GLint vs, GLint fs)
 	glBindAttribLocation(prog, PIGLIT_ATTRIB_POS, "piglit_vertex");
 	glBindAttribLocation(prog, PIGLIT_ATTRIB_TEX, "piglit_texcoord");
 
-	glLinkProgram(prog);
+	link_program(prog);
 
 	if (!piglit_link_check_status(prog)) {
 		glDeleteProgram(prog);
@@ -299,31 +312,129 @@ piglit_build_simple_program_unlinked(const char *vs_source,
 
 
 /**
- * Builds and links a program from optional VS and FS sources,
- * throwing PIGLIT_FAIL on error.
+ * Collects the (target, source) pairs of a 0 terminated argument list,
+ * starting with target1 and source1, into arrays that the caller frees.
+ * Returns the number of pairs.
  */
-GLint
-piglit_build_simple_program(const char *vs_source, const char *fs_source)
+static unsigned
+collect_shader_args(GLenum target1, const char *source1, va_list ap,
+		    GLenum **targets, const char ***sources)
 {
-	GLuint vs = 0, fs = 0, prog;
+	unsigned count = 0, size = 0;
+	GLenum target = target1;
+	const char *source = source1;
 
-	if (vs_source) {
-		vs = piglit_compile_shader_text(GL_VERTEX_SHADER, vs_source);
+	*targets = NULL;
+	*sources = NULL;
+
+	while (target != 0) {
+		if (count == size) {
+			size = size ? size * 2 : 8;
+			*targets = realloc(*targets, size * sizeof(**targets));
+			*sources = realloc(*sources, size * sizeof(**sources));
+		}
+		(*targets)[count] = target;
+		(*sources)[count] = source;
+		count++;
+
+		target = va_arg(ap, GLenum);
+		if (target != 0)
+			source = va_arg(ap, char*);
 	}
 
-	if (fs_source) {
-		fs = piglit_compile_shader_text(GL_FRAGMENT_SHADER, fs_source);
+	return count;
+}
+
+/**
+ * Compiles the given shaders and attaches them to prog, skipping NULL
+ * sources.  A compile failure terminates the test.
+ */
+static void
+attach_shaders(GLuint prog, unsigned count, const GLenum *targets,
+	       const char *const *sources)
+{
+	unsigned i;
+
+	for (i = 0; i < count; i++) {
+		GLuint shader;
+
+		/* do not compile/attach a NULL shader */
+		if (!sources[i])
+			continue;
+
+		shader = piglit_compile_shader_text(targets[i], sources[i]);
+		glAttachShader(prog, shader);
+		glDeleteShader(shader);
+	}
+}
+
+/**
+ * Compiles the given shaders and links them into a program, using the
+ * program cache when it is enabled.  NULL sources are skipped.  Returns 0
+ * if linking fails; a compile failure terminates the test.
+ */
+static GLuint
+build_and_link_program(unsigned count, const GLenum *targets,
+		       const char *const *sources)
+{
+	struct piglit_program_cache_key key;
+	bool cache = piglit_program_cache_enabled();
+	GLuint prog;
+	unsigned i;
+
+	piglit_require_GLSL();
+	prog = glCreateProgram();
+
+	if (cache) {
+		piglit_program_cache_key_init(&key);
+		for (i = 0; i < count; i++) {
+			if (!sources[i])
+				continue;
+			piglit_program_cache_key_add_int(&key, targets[i]);
+			piglit_program_cache_key_add_string(&key, sources[i]);
+		}
+
+		if (piglit_program_cache_load(prog, &key))
+			return prog;
 	}
 
-	prog = piglit_link_simple_program(vs, fs);
+	attach_shaders(prog, count, targets, sources);
+
+	/* If the shaders reference piglit_vertex or piglit_tex, bind
+	 * them to some fixed attribute locations so they can be used
+	 * with piglit_draw_rect_tex() in GLES.
+	 */
+	glBindAttribLocation(prog, PIGLIT_ATTRIB_POS, "piglit_vertex");
+	glBindAttribLocation(prog, PIGLIT_ATTRIB_TEX, "piglit_texcoord");
+
+	link_program(prog);
+
+	if (!piglit_link_check_status(prog)) {
+		glDeleteProgram(prog);
+		return 0;
+	}
+
+	if (cache)
+		piglit_program_cache_store(prog, &key);
+
+	return prog;
+}
+
+/**
+ * Builds and links a program from optional VS and FS sources,
+ * throwing PIGLIT_FAIL on error.
+ */
+GLint
+piglit_build_simple_program(const char *vs_source, const char *fs_source)
+{
+	const GLenum targets[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	const char *sources[] = { vs_source, fs_source };
+	GLuint prog;
+
+	prog = build_and_link_program(2, targets, sources);
 	if (!prog)
 		piglit_report_result(PIGLIT_FAIL);
 
-	if (fs)
-		glDeleteShader(fs);
-	if (vs)
-		glDeleteShader(vs);
-
 	return prog;
 }
 
@@ -353,7 +464,7 @@ GLint piglit_link_simple_program_multiple_shaders(GLint shader1, ...)
 	glBindAttribLocation(prog, PIGLIT_ATTRIB_POS, "piglit_vertex");
 	glBindAttribLocation(prog, PIGLIT_ATTRIB_TEX, "piglit_texcoord");
 
-	glLinkProgram(prog);
+	link_program(prog);
 
 	if (!piglit_link_check_status(prog)) {
 		glDeleteProgram(prog);
@@ -368,31 +479,19 @@ piglit_build_simple_program_unlinked_multiple_shaders_v(GLenum target1,
 						        const char *source1,
 						        va_list ap)
 {
+	GLenum *targets;
+	const char **sources;
+	unsigned count;
 	GLuint prog;
-	GLenum target;
-	const char *source;
+
+	count = collect_shader_args(target1, source1, ap, &targets, &sources);
 
 	piglit_require_GLSL();
 	prog = glCreateProgram();
+	attach_shaders(prog, count, targets, sources);
 
-	source = source1;
-	target = target1;
-
-	while (target != 0) {
-		/* do not compile/attach a NULL shader */
-		if (source) {
-			GLuint shader = piglit_compile_shader_text(target,
-								   source);
-
-			glAttachShader(prog, shader);
-			glDeleteShader(shader);
-		}
-
-		target  = va_arg(ap, GLenum);
-		if (target != 0)
-			source = va_arg(ap, char*);
-	}
-
+	free(targets);
+	free(sources);
 	return prog;
 }
 
@@ -435,31 +534,21 @@ piglit_build_simple_program_multiple_shaders(GLenum target1,
 					    const char *source1,
 					    ...)
 {
+	GLenum *targets;
+	const char **sources;
+	unsigned count;
 	va_list ap;
 	GLuint prog;
 
 	va_start(ap, source1);
-
-	prog = piglit_build_simple_program_unlinked_multiple_shaders_v(target1,
-								       source1,
-								       ap);
-
+	count = collect_shader_args(target1, source1, ap, &targets, &sources);
 	va_end(ap);
 
-	/* If the shaders reference piglit_vertex or piglit_tex, bind
-	 * them to some fixed attribute locations so they can be used
-	 * with piglit_draw_rect_tex() in GLES.
-	 */
-	glBindAttribLocation(prog, PIGLIT_ATTRIB_POS, "piglit_vertex");
-	glBindAttribLocation(prog, PIGLIT_ATTRIB_TEX, "piglit_texcoord");
-
-	glLinkProgram(prog);
-
-	if (!piglit_link_check_status(prog)) {
-		glDeleteProgram(prog);
-		prog = 0;
+	prog = build_and_link_program(count, targets, sources);
+	free(targets);
+	free(sources);
+	if (!prog)
 		piglit_report_result(PIGLIT_FAIL);
-	}
 
 	return prog;
 }
@@ -0,0 +1,703 @@
+/*
+ * Copyright (c) The Piglit project 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-texref.c
+ *
+ * Reference texture codec and sampler, see piglit-texref.h.
+ *
+ * The codec looks the format up in the sized internalformat table once per
+ * call and then converts the whole array.  Formats whose channels are all
+ * normalized and at most 16 bits wide, which are most of the ones tests
+ * render with, convert a texel per SSE2 operation; the scalar path does the
+ * same float operations in the same order, so both give the same codes.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "piglit-texref.h"
+#include "r11g11b10f.h"
+#include "rgb9e5.h"
+#include "sized-internalformats.h"
+
+/** Texels converted at a time by piglit_texref_quantize(). */
+#define QUANTIZE_CHUNK 256
+
+enum layout {
+	LAYOUT_COLOR,
+	LAYOUT_LUMINANCE,
+	LAYOUT_INTENSITY,
+	LAYOUT_DEPTH,
+};
+
+/**
+ * How a format stores its four codes.  lo, hi and max are only used for
+ * normalized channels: the clamp range and the largest code.
+ */
+struct texref_format {
+	enum layout layout;
+	bool srgb;
+	bool rgb9e5;
+	bool normalized;
+	bool alpha;
+	GLenum type[4];
+	int size[4];
+	float lo[4], hi[4], max[4];
+};
+
+static bool
+is_srgb(GLenum internalformat)
+{
+	switch (internalformat) {
+	case GL_SRGB:
+	case GL_SRGB8:
+	case GL_SRGB_ALPHA:
+	case GL_SRGB8_ALPHA8:
+	case GL_SLUMINANCE:
+	case GL_SLUMINANCE8:
+	case GL_SLUMINANCE_ALPHA:
+	case GL_SLUMINANCE8_ALPHA8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool
+describe_format(GLenum internalformat, struct texref_format *fmt)
+{
+	const struct sized_internalformat *f =
+		get_sized_internalformat(internalformat);
+	/* The channel each code is stored from. */
+	int source[4] = { R, G, B, A };
+	int c;
+
+	if (f == NULL)
+		return false;
+
+	for (c = 0; c < CHANNELS; c++) {
+		if (f->bits[c] == UCMP || f->bits[c] == SCMP)
+			return false;
+	}
+
+	memset(fmt, 0, sizeof(*fmt));
+	fmt->srgb = is_srgb(internalformat);
+	fmt->rgb9e5 = f->bits[R] == F9;
+	fmt->alpha = f->bits[A] != NONE;
+
+	if (f->bits[L] != NONE) {
+		fmt->layout = LAYOUT_LUMINANCE;
+		source[R] = L;
+	} else if (f->bits[I] != NONE) {
+		fmt->layout = LAYOUT_INTENSITY;
+		source[R] = I;
+	} else if (f->bits[D] != NONE) {
+		fmt->layout = LAYOUT_DEPTH;
+		source[R] = D;
+		source[G] = S;
+	} else {
+		fmt->layout = LAYOUT_COLOR;
+	}
+
+	fmt->normalized = !fmt->rgb9e5;
+	for (c = 0; c < 4; c++) {
+		enum channel ch = source[c];
+
+		fmt->type[c] = get_channel_type(f, ch);
+		fmt->size[c] = get_channel_size(f, ch);
+
+		/* Stencil is an integer whatever the table says. */
+		if (ch == S && fmt->type[c] != GL_NONE)
+			fmt->type[c] = GL_UNSIGNED_INT;
+
+		switch (fmt->type[c]) {
+		case GL_NONE:
+			fmt->max[c] = 1.0;
+			break;
+		case GL_UNSIGNED_NORMALIZED:
+			fmt->hi[c] = 1.0;
+			fmt->max[c] = ldexp(1.0, fmt->size[c]) - 1.0;
+			if (fmt->size[c] > 16)
+				fmt->normalized = false;
+			break;
+		case GL_SIGNED_NORMALIZED:
+			fmt->lo[c] = -1.0;
+			fmt->hi[c] = 1.0;
+			fmt->max[c] = ldexp(1.0, fmt->size[c] - 1) - 1.0;
+			break;
+		default:
+			fmt->normalized = false;
+			break;
+		}
+	}
+
+	return true;
+}
+
+static float
+uif(uint32_t u)
+{
+	float f;
+
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+static uint32_t
+fui(float f)
+{
+	uint32_t u;
+
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+/**
+ * Round x and clamp it to [lo, hi].  NaN goes to 0.
+ */
+static double
+round_clamp(double x, double lo, double hi)
+{
+	if (!(x == x))
+		return 0.0;
+	return CLAMP(floor(x + 0.5), lo, hi);
+}
+
+static uint32_t
+encode_normalized(const struct texref_format *fmt, int c, float x)
+{
+	float y = MIN2(MAX2(x, fmt->lo[c]), fmt->hi[c]) * fmt->max[c];
+
+	return (uint32_t) (int32_t) (y + copysignf(0.5f, y));
+}
+
+static float
+decode_normalized(const struct texref_format *fmt, int c, uint32_t code)
+{
+	return MAX2((float) (int32_t) code / fmt->max[c], fmt->lo[c]);
+}
+
+static uint32_t
+encode_channel(const struct texref_format *fmt, int c, float x)
+{
+	const int size = fmt->size[c];
+
+	switch (fmt->type[c]) {
+	case GL_UNSIGNED_NORMALIZED:
+		if (size <= 16)
+			return encode_normalized(fmt, c, x);
+		return (uint32_t) round_clamp(CLAMP((double) x, 0.0, 1.0) *
+					      (double) (~0u >> (32 - size)),
+					      0.0, 4294967295.0);
+	case GL_SIGNED_NORMALIZED:
+		return encode_normalized(fmt, c, x);
+	case GL_FLOAT:
+		switch (size) {
+		case 32:
+			return fui(x);
+		case 16:
+			return piglit_half_from_float(x);
+		case 11:
+			return f32_to_uf11(x);
+		case 10:
+			return f32_to_uf10(x);
+		}
+		break;
+	case GL_INT:
+		return (uint32_t) (int32_t)
+			round_clamp(x, -ldexp(1.0, size - 1),
+				    ldexp(1.0, size - 1) - 1.0);
+	case GL_UNSIGNED_INT:
+		return (uint32_t) round_clamp(x, 0.0, ldexp(1.0, size) - 1.0);
+	}
+
+	return 0;
+}
+
+static float
+decode_channel(const struct texref_format *fmt, int c, uint32_t code)
+{
+	const int size = fmt->size[c];
+
+	switch (fmt->type[c]) {
+	case GL_UNSIGNED_NORMALIZED:
+		if (size <= 16)
+			return decode_normalized(fmt, c, code);
+		return (float) (code / (double) (~0u >> (32 - size)));
+	case GL_SIGNED_NORMALIZED:
+		return decode_normalized(fmt, c, code);
+	case GL_FLOAT:
+		switch (size) {
+		case 32:
+			return uif(code);
+		case 16:
+			return piglit_float_from_half(code);
+		case 11:
+			return uf11_to_f32(code);
+		case 10:
+			return uf10_to_f32(code);
+		}
+		break;
+	case GL_INT:
+		return (float) (int32_t) code;
+	case GL_UNSIGNED_INT:
+		return (float) code;
+	}
+
+	return 0.0;
+}
+
+#ifdef __SSE2__
+static void
+encode_normalized_sse2(const struct texref_format *fmt, const float *rgba,
+		       uint32_t *codes, size_t count)
+{
+	const __m128 lo = _mm_loadu_ps(fmt->lo);
+	const __m128 hi = _mm_loadu_ps(fmt->hi);
+	const __m128 max = _mm_loadu_ps(fmt->max);
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		__m128 y = _mm_loadu_ps(&rgba[i * 4]);
+
+		/* max() before min() so that NaN ends up at lo. */
+		y = _mm_min_ps(_mm_max_ps(y, lo), hi);
+		y = _mm_mul_ps(y, max);
+		y = _mm_add_ps(y, _mm_or_ps(_mm_and_ps(y, sign), half));
+		_mm_storeu_si128((__m128i *) &codes[i * 4],
+				 _mm_cvttps_epi32(y));
+	}
+}
+
+static void
+decode_normalized_sse2(const struct texref_format *fmt, const uint32_t *codes,
+		       float *rgba, size_t count)
+{
+	const __m128 lo = _mm_loadu_ps(fmt->lo);
+	const __m128 max = _mm_loadu_ps(fmt->max);
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		__m128i code = _mm_loadu_si128((const __m128i *) &codes[i * 4]);
+		__m128 x = _mm_div_ps(_mm_cvtepi32_ps(code), max);
+
+		_mm_storeu_ps(&rgba[i * 4], _mm_max_ps(x, lo));
+	}
+}
+#endif
+
+/**
+ * Turn the four decoded codes of a texel into the color sampling returns.
+ */
+static void
+expand_texel(const struct texref_format *fmt, float *v)
+{
+	int c;
+
+	switch (fmt->layout) {
+	case LAYOUT_COLOR:
+		break;
+	case LAYOUT_LUMINANCE:
+		v[1] = v[2] = v[0];
+		break;
+	case LAYOUT_INTENSITY:
+		v[1] = v[2] = v[3] = v[0];
+		break;
+	case LAYOUT_DEPTH:
+		v[1] = v[2] = v[0];
+		v[3] = 1.0;
+		break;
+	}
+
+	if (!fmt->alpha && fmt->layout != LAYOUT_INTENSITY)
+		v[3] = 1.0;
+
+	if (fmt->srgb) {
+		for (c = 0; c < 3; c++)
+			v[c] = piglit_srgb_to_linear(v[c]);
+	}
+}
+
+bool
+piglit_texref_encode(GLenum internalformat, const float *rgba,
+		     uint32_t *codes, size_t count)
+{
+	struct texref_format fmt;
+	size_t i;
+	int c;
+
+	if (!describe_format(internalformat, &fmt))
+		return false;
+
+#ifdef __SSE2__
+	if (fmt.normalized) {
+		encode_normalized_sse2(&fmt, rgba, codes, count);
+		return true;
+	}
+#endif
+
+	for (i = 0; i < count; i++) {
+		const float *in = &rgba[i * 4];
+		uint32_t *out = &codes[i * 4];
+
+		if (fmt.rgb9e5) {
+			out[0] = float3_to_rgb9e5(in);
+			out[1] = out[2] = out[3] = 0;
+			continue;
+		}
+
+		for (c = 0; c < 4; c++)
+			out[c] = encode_channel(&fmt, c, in[c]);
+	}
+
+	return true;
+}
+
+bool
+piglit_texref_decode(GLenum internalformat, const uint32_t *codes,
+		     float *rgba, size_t count)
+{
+	struct texref_format fmt;
+	size_t i;
+	int c;
+
+	if (!describe_format(internalformat, &fmt))
+		return false;
+
+#ifdef __SSE2__
+	if (fmt.normalized) {
+		decode_normalized_sse2(&fmt, codes, rgba, count);
+		for (i = 0; i < count; i++)
+			expand_texel(&fmt, &rgba[i * 4]);
+		return true;
+	}
+#endif
+
+	for (i = 0; i < count; i++) {
+		const uint32_t *in = &codes[i * 4];
+		float *out = &rgba[i * 4];
+
+		if (fmt.rgb9e5) {
+			rgb9e5_to_float3(in[0], out);
+			out[3] = 1.0;
+		} else {
+			for (c = 0; c < 4; c++)
+				out[c] = decode_channel(&fmt, c, in[c]);
+		}
+		expand_texel(&fmt, out);
+	}
+
+	return true;
+}
+
+bool
+piglit_texref_quantize(GLenum internalformat, const float *in, float *out,
+		       size_t count)
+{
+	uint32_t codes[QUANTIZE_CHUNK * 4];
+	size_t i, n;
+
+	for (i = 0; i < count; i += n) {
+		n = MIN2(count - i, QUANTIZE_CHUNK);
+		if (!piglit_texref_encode(internalformat, &in[i * 4], codes, n) ||
+		    !piglit_texref_decode(internalformat, codes, &out[i * 4], n))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * The texels of one dimension a sample reads: i1 is only used by linear
+ * filtering, with weight w.  Indices outside [0, size) select the border.
+ */
+struct texel_span {
+	int i0, i1;
+	float w;
+};
+
+static int
+floor_to_int(float x)
+{
+	if (!(x == x))
+		return 0;
+	/* Far enough outside any texture to wrap the same way. */
+	return (int) floor(CLAMP(x, -(float) (1 << 28), (float) (1 << 28)));
+}
+
+static int
+mirror(int a)
+{
+	return a >= 0 ? a : -(1 + a);
+}
+
+static int
+wrap_index(GLenum wrap, GLenum filter, int i, int size)
+{
+	int m;
+
+	switch (wrap) {
+	case GL_REPEAT:
+		return ((i % size) + size) % size;
+	case GL_MIRRORED_REPEAT:
+		m = ((i % (2 * size)) + 2 * size) % (2 * size);
+		return (size - 1) - mirror(m - size);
+	case GL_CLAMP:
+	case GL_MIRROR_CLAMP_EXT:
+		if (filter == GL_NEAREST)
+			return CLAMP(i, 0, size - 1);
+		return CLAMP(i, -1, size);
+	case GL_CLAMP_TO_BORDER:
+	case GL_MIRROR_CLAMP_TO_BORDER_EXT:
+		return CLAMP(i, -1, size);
+	case GL_CLAMP_TO_EDGE:
+	case GL_MIRROR_CLAMP_TO_EDGE:
+	default:
+		return CLAMP(i, 0, size - 1);
+	}
+}
+
+static void
+wrap_coord(GLenum wrap, GLenum filter, float u, int size,
+	   struct texel_span *span)
+{
+	int i;
+
+	switch (wrap) {
+	case GL_CLAMP:
+		u = CLAMP(u, 0.0f, (float) size);
+		break;
+	case GL_MIRROR_CLAMP_EXT:
+		u = MIN2(fabsf(u), (float) size);
+		break;
+	case GL_MIRROR_CLAMP_TO_EDGE:
+	case GL_MIRROR_CLAMP_TO_BORDER_EXT:
+		u = fabsf(u);
+		break;
+	}
+
+	if (filter == GL_NEAREST) {
+		span->i0 = span->i1 = wrap_index(wrap, filter,
+						 floor_to_int(u), size);
+		span->w = 0.0;
+		return;
+	}
+
+	u -= 0.5f;
+	i = floor_to_int(u);
+	span->i0 = wrap_index(wrap, filter, i, size);
+	span->i1 = wrap_index(wrap, filter, i + 1, size);
+	span->w = u - floorf(u);
+}
+
+/**
+ * The texel for the first dimension of a 1D array, or the third of a 2D
+ * array or cube map.
+ */
+static void
+layer_span(float r, int layers, struct texel_span *span)
+{
+	span->i0 = span->i1 = CLAMP(floor_to_int(r + 0.5f), 0, layers - 1);
+	span->w = 0.0;
+}
+
+static void
+fetch(const struct piglit_texref_texture *tex, int x, int y, int z,
+      float *rgba)
+{
+	if (x < 0 || x >= tex->width || y < 0 || y >= tex->height ||
+	    z < 0 || z >= tex->depth)
+		memcpy(rgba, tex->border, 4 * sizeof(float));
+	else
+		memcpy(rgba, &tex->texels[(((size_t) z * tex->height + y) *
+					   tex->width + x) * 4],
+		       4 * sizeof(float));
+}
+
+static void
+filter(const struct piglit_texref_texture *tex, const struct texel_span *s,
+       float *rgba)
+{
+	float texel[4];
+	int corner, c;
+
+	if (tex->filter == GL_NEAREST) {
+		fetch(tex, s[0].i0, s[1].i0, s[2].i0, rgba);
+		return;
+	}
+
+	memset(rgba, 0, 4 * sizeof(float));
+	for (corner = 0; corner < 8; corner++) {
+		const bool hi_x = corner & 1, hi_y = corner & 2,
+			hi_z = corner & 4;
+		const float w = (hi_x ? s[0].w : 1.0f - s[0].w) *
+			(hi_y ? s[1].w : 1.0f - s[1].w) *
+			(hi_z ? s[2].w : 1.0f - s[2].w);
+
+		if (w == 0.0f)
+			continue;
+
+		fetch(tex, hi_x ? s[0].i1 : s[0].i0,
+		      hi_y ? s[1].i1 : s[1].i0,
+		      hi_z ? s[2].i1 : s[2].i0, texel);
+		for (c = 0; c < 4; c++)
+			rgba[c] += w * texel[c];
+	}
+}
+
+/**
+ * Pick the cube face for direction (rx, ry, rz), as in the table of the
+ * "Cube Map Texture Selection" section of the spec, and return the face
+ * coordinates in s and t.  Ties go to x, then y.
+ */
+static int
+cube_face(float rx, float ry, float rz, float *s, float *t)
+{
+	const float ax = fabsf(rx), ay = fabsf(ry), az = fabsf(rz);
+	float sc, tc, ma;
+	int face;
+
+	if (ax >= ay && ax >= az) {
+		face = rx >= 0 ? 0 : 1;
+		sc = rx >= 0 ? -rz : rz;
+		tc = -ry;
+		ma = ax;
+	} else if (ay >= az) {
+		face = ry >= 0 ? 2 : 3;
+		sc = rx;
+		tc = ry >= 0 ? rz : -rz;
+		ma = ay;
+	} else {
+		face = rz >= 0 ? 4 : 5;
+		sc = rz >= 0 ? rx : -rx;
+		tc = -ry;
+		ma = az;
+	}
+
+	*s = 0.5f * (sc / ma + 1.0f);
+	*t = 0.5f * (tc / ma + 1.0f);
+	return face;
+}
+
+void
+piglit_texref_sample(const struct piglit_texref_texture *tex,
+		     const float *coords, float *rgba, size_t count)
+{
+	const float w = tex->width, h = tex->height, d = tex->depth;
+	const GLenum f = tex->filter;
+	struct texel_span span[3];
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		const float s = coords[i * 3], t = coords[i * 3 + 1],
+			r = coords[i * 3 + 2];
+		float fs, ft;
+
+		span[1].i0 = span[1].i1 = 0;
+		span[2].i0 = span[2].i1 = 0;
+		span[1].w = span[2].w = 0.0;
+
+		switch (tex->target) {
+		case GL_TEXTURE_1D:
+			wrap_coord(tex->wrap_s, f, s * w, tex->width, &span[0]);
+			break;
+		case GL_TEXTURE_1D_ARRAY:
+			wrap_coord(tex->wrap_s, f, s * w, tex->width, &span[0]);
+			layer_span(t, tex->height, &span[1]);
+			break;
+		case GL_TEXTURE_RECTANGLE:
+			wrap_coord(tex->wrap_s, f, s, tex->width, &span[0]);
+			wrap_coord(tex->wrap_t, f, t, tex->height, &span[1]);
+			break;
+		case GL_TEXTURE_2D_ARRAY:
+			wrap_coord(tex->wrap_s, f, s * w, tex->width, &span[0]);
+			wrap_coord(tex->wrap_t, f, t * h, tex->height, &span[1]);
+			layer_span(r, tex->depth, &span[2]);
+			break;
+		case GL_TEXTURE_3D:
+			wrap_coord(tex->wrap_s, f, s * w, tex->width, &span[0]);
+			wrap_coord(tex->wrap_t, f, t * h, tex->height, &span[1]);
+			wrap_coord(tex->wrap_r, f, r * d, tex->depth, &span[2]);
+			break;
+		case GL_TEXTURE_CUBE_MAP:
+			span[2].i0 = span[2].i1 = cube_face(s, t, r, &fs, &ft);
+			wrap_coord(GL_CLAMP_TO_EDGE, f, fs * w, tex->width,
+				   &span[0]);
+			wrap_coord(GL_CLAMP_TO_EDGE, f, ft * h, tex->height,
+				   &span[1]);
+			break;
+		case GL_TEXTURE_2D:
+		default:
+			wrap_coord(tex->wrap_s, f, s * w, tex->width, &span[0]);
+			wrap_coord(tex->wrap_t, f, t * h, tex->height, &span[1]);
+			break;
+		}
+
+		filter(tex, span, &rgba[i * 4]);
+	}
+}
+
+int
+piglit_texref_select_level(float lambda, int base_level, int max_level,
+			   float min_lod, float max_lod, GLenum min_filter,
+			   float *frac)
+{
+	float level;
+	int d;
+
+	if (frac)
+		*frac = 0.0;
+
+	lambda = CLAMP(lambda, min_lod, max_lod);
+
+	/* Magnification, or no mipmapping. */
+	if (lambda <= 0.0f || min_filter == GL_NEAREST ||
+	    min_filter == GL_LINEAR)
+		return base_level;
+
+	level = base_level + lambda;
+
+	switch (min_filter) {
+	case GL_NEAREST_MIPMAP_NEAREST:
+	case GL_LINEAR_MIPMAP_NEAREST:
+		if (lambda <= 0.5f)
+			return base_level;
+		if (level > max_level + 0.5f)
+			return max_level;
+		return (int) ceilf(level + 0.5f) - 1;
+	default:
+		if (level >= max_level)
+			return max_level;
+		d = (int) floorf(level);
+		if (frac)
+			*frac = level - d;
+		return d;
+	}
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) The Piglit project 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-texref.h
+ *
+ * CPU reference for texturing, for tests that compute whole expected
+ * images: a codec for the sized internal formats described in
+ * sized-internalformats.h, and a sampler for the standard texture targets
+ * with every wrap mode and nearest or linear filtering.
+ *
+ * Everything works on arrays.  Colors are RGBA floats, four per texel or
+ * sample.  The unorm and snorm paths of the codec use SSE2 when it's
+ * available.
+ *
+ * Typical use, for the expected result of drawing with a texture:
+ *
+ *	piglit_texref_quantize(GL_RGB5_A1, image, texels, w * h);
+ *	tex.target = GL_TEXTURE_2D;
+ *	tex.width = w; tex.height = h; tex.depth = 1;
+ *	tex.texels = texels;
+ *	tex.wrap_s = tex.wrap_t = tex.wrap_r = GL_REPEAT;
+ *	tex.filter = GL_LINEAR;
+ *	piglit_texref_sample(&tex, coords, expected, num_samples);
+ */
+
+#pragma once
+
+#include "piglit-util-gl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * One level of a texture, for piglit_texref_sample().
+ */
+struct piglit_texref_texture {
+	/**
+	 * GL_TEXTURE_1D, GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_RECTANGLE,
+	 * GL_TEXTURE_1D_ARRAY, GL_TEXTURE_2D_ARRAY or GL_TEXTURE_CUBE_MAP.
+	 */
+	GLenum target;
+
+	/**
+	 * For 1D array textures height is the number of layers, for 2D
+	 * arrays depth is.  Cube maps have six square faces, in the order of
+	 * the GL_TEXTURE_CUBE_MAP_POSITIVE_X... targets, and a depth of 6.
+	 */
+	int width, height, depth;
+
+	/**
+	 * The texels as they are sampled, as piglit_texref_decode() returns
+	 * them, width * height * depth RGBA colors with x varying fastest.
+	 */
+	const float *texels;
+
+	GLenum wrap_s, wrap_t, wrap_r;
+
+	/** GL_NEAREST or GL_LINEAR, for both minification and magnification */
+	GLenum filter;
+
+	float border[4];
+};
+
+/**
+ * Encode count RGBA colors in internalformat.  Each texel is stored as four
+ * codes, one for each channel the format stores:
+ *
+ *  - red, green, blue and alpha for color formats, luminance or intensity
+ *    in the red code, depth in the red code and stencil in the green one;
+ *  - unorm and snorm channels store the integer value (snorm in two's
+ *    complement), float channels their float, half, or unsigned 11 or 10
+ *    bit float bits, GL_RGB9_E5 the packed value in the red code;
+ *  - integer channels, and stencil, store the color rounded and clamped to
+ *    the range of the channel.
+ *
+ * Luminance and intensity are taken from red, stencil from green.  Codes
+ * for channels the format doesn't store are 0.
+ *
+ * Returns false for formats the codec can't handle: unknown and compressed
+ * ones.
+ */
+bool
+piglit_texref_encode(GLenum internalformat, const float *rgba,
+		     uint32_t *codes, size_t count);
+
+/**
+ * Decode count texels encoded by piglit_texref_encode() into the RGBA
+ * colors that sampling them returns: luminance is replicated to red, green
+ * and blue, intensity to all four channels, missing colors are 0 and
+ * missing alpha is 1.  Depth is returned as luminance, as with the
+ * default GL_DEPTH_TEXTURE_MODE, and stencil is dropped.  sRGB colors are
+ * converted to linear.
+ */
+bool
+piglit_texref_decode(GLenum internalformat, const uint32_t *codes,
+		     float *rgba, size_t count);
+
+/**
+ * piglit_texref_encode() followed by piglit_texref_decode(): the colors
+ * sampling a texture returns when the given colors were uploaded to it.
+ * in and out may be the same array.
+ */
+bool
+piglit_texref_quantize(GLenum internalformat, const float *in, float *out,
+		       size_t count);
+
+/**
+ * Sample count texture coordinates, three floats (s, t, r) each, into
+ * RGBA colors.  Coordinates are normalized except for rectangle textures
+ * and the layer of array textures; cube maps take a direction.
+ *
+ * Cube map faces aren't seamless, each is sampled as if clamped to its
+ * edges.
+ */
+void
+piglit_texref_sample(const struct piglit_texref_texture *tex,
+		     const float *coords, float *rgba, size_t count);
+
+/**
+ * Return the mipmap level a lod of lambda (including any bias) selects,
+ * with the given base and max levels, lod clamp and minification filter.
+ * For the *_MIPMAP_LINEAR filters this is the lower of the two levels
+ * that are blended, and *frac the weight of the next one; otherwise
+ * *frac is 0.  frac may be NULL.
+ */
+int
+piglit_texref_select_level(float lambda, int base_level, int max_level,
+			   float min_lod, float max_lod, GLenum min_filter,
+			   float *frac);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
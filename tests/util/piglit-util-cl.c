@@ -22,9 +22,28 @@
  */
 
 #include <inttypes.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
 
 #include "piglit-util-cl.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PROBE_USE_SSE2
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PROBE_USE_AVX2
+#endif
+
 bool
 piglit_cl_probe_integer(int64_t value, int64_t expect, uint64_t tolerance)
 {
@@ -118,6 +137,276 @@ piglit_cl_probe_double(double value, double expect, uint64_t ulp)
 
 }
 
+/*
+ * The array probes skip over the values that are identical to the expected
+ * ones, which always match, with SSE2 or AVX2 compares when they are
+ * available.  The rest are checked one at a time like the probes above.
+ */
+
+static void
+add_mismatch(struct piglit_cl_probe_summary *summary, size_t index,
+             uint64_t error)
+{
+	if(summary->num_reported < PIGLIT_CL_PROBE_MAX_REPORTED) {
+		summary->reported[summary->num_reported++] = index;
+	}
+	summary->num_mismatches++;
+	summary->max_error = MAX2(summary->max_error, error);
+}
+
+/*
+ * Return the offset of the first of the n bytes that differs between a and
+ * b, or n if there is none.
+ */
+static size_t
+find_byte_mismatch(const uint8_t *a, const uint8_t *b, size_t n)
+{
+	size_t i = 0;
+
+#if defined(PROBE_USE_AVX2)
+	for(; i + 32 <= n; i += 32) {
+		__m256i c = _mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const __m256i *)(a + i)),
+			_mm256_loadu_si256((const __m256i *)(b + i)));
+		uint32_t bits = ~(uint32_t)_mm256_movemask_epi8(c);
+
+		if(bits) {
+			return i + ffs(bits) - 1;
+		}
+	}
+#endif
+
+#if defined(PROBE_USE_SSE2)
+	for(; i + 16 <= n; i += 16) {
+		__m128i c = _mm_cmpeq_epi8(
+			_mm_loadu_si128((const __m128i *)(a + i)),
+			_mm_loadu_si128((const __m128i *)(b + i)));
+		unsigned bits = ~(unsigned)_mm_movemask_epi8(c) & 0xffff;
+
+		if(bits) {
+			return i + ffs(bits) - 1;
+		}
+	}
+#endif
+
+	for(; i < n; i++) {
+		if(a[i] != b[i]) {
+			return i;
+		}
+	}
+
+	return n;
+}
+
+/*
+ * Array probe for one integer type.  Values are at i*stride + c, for
+ * element i and component c, and are reported by their index in the
+ * array without padding, i*components + c.
+ */
+#define PROBE_INTEGER_ARRAY(name, type, wide)                                 \
+static void                                                                   \
+name(const type *value, const type *expect, size_t count, size_t components,  \
+     size_t stride, uint64_t tolerance,                                       \
+     struct piglit_cl_probe_summary *summary)                                 \
+{                                                                             \
+	size_t n = count * stride;                                                \
+	size_t p = 0;                                                             \
+                                                                              \
+	while((p += find_byte_mismatch((const uint8_t *)(value + p),              \
+	                               (const uint8_t *)(expect + p),             \
+	                               (n - p) * sizeof(type)) / sizeof(type)) < n) { \
+		wide v = value[p], e = expect[p];                                     \
+		uint64_t diff = v > e ? (uint64_t)v - (uint64_t)e                     \
+		                      : (uint64_t)e - (uint64_t)v;                    \
+                                                                              \
+		if(p % stride < components && diff > tolerance) {                     \
+			add_mismatch(summary,                                             \
+			             p / stride * components + p % stride, diff);         \
+		}                                                                     \
+		p++;                                                                  \
+	}                                                                         \
+}
+
+PROBE_INTEGER_ARRAY(probe_int8_array,   int8_t,   int64_t)
+PROBE_INTEGER_ARRAY(probe_int16_array,  int16_t,  int64_t)
+PROBE_INTEGER_ARRAY(probe_int32_array,  int32_t,  int64_t)
+PROBE_INTEGER_ARRAY(probe_int64_array,  int64_t,  int64_t)
+PROBE_INTEGER_ARRAY(probe_uint8_array,  uint8_t,  uint64_t)
+PROBE_INTEGER_ARRAY(probe_uint16_array, uint16_t, uint64_t)
+PROBE_INTEGER_ARRAY(probe_uint32_array, uint32_t, uint64_t)
+PROBE_INTEGER_ARRAY(probe_uint64_array, uint64_t, uint64_t)
+
+#undef PROBE_INTEGER_ARRAY
+
+bool
+piglit_cl_probe_integer_array(const void *value, const void *expect,
+                              size_t size, size_t count, size_t components,
+                              size_t stride, uint64_t tolerance,
+                              struct piglit_cl_probe_summary *summary)
+{
+	memset(summary, 0, sizeof(*summary));
+
+	switch(size) {
+	case 1:
+		probe_int8_array(value, expect, count, components, stride,
+		                 tolerance, summary);
+		break;
+	case 2:
+		probe_int16_array(value, expect, count, components, stride,
+		                  tolerance, summary);
+		break;
+	case 4:
+		probe_int32_array(value, expect, count, components, stride,
+		                  tolerance, summary);
+		break;
+	case 8:
+		probe_int64_array(value, expect, count, components, stride,
+		                  tolerance, summary);
+		break;
+	default:
+		assert(!"Invalid integer size");
+	}
+
+	return summary->num_mismatches == 0;
+}
+
+bool
+piglit_cl_probe_uinteger_array(const void *value, const void *expect,
+                               size_t size, size_t count, size_t components,
+                               size_t stride, uint64_t tolerance,
+                               struct piglit_cl_probe_summary *summary)
+{
+	memset(summary, 0, sizeof(*summary));
+
+	switch(size) {
+	case 1:
+		probe_uint8_array(value, expect, count, components, stride,
+		                  tolerance, summary);
+		break;
+	case 2:
+		probe_uint16_array(value, expect, count, components, stride,
+		                   tolerance, summary);
+		break;
+	case 4:
+		probe_uint32_array(value, expect, count, components, stride,
+		                   tolerance, summary);
+		break;
+	case 8:
+		probe_uint64_array(value, expect, count, components, stride,
+		                   tolerance, summary);
+		break;
+	default:
+		assert(!"Invalid integer size");
+	}
+
+	return summary->num_mismatches == 0;
+}
+
+/*
+ * Return the index of the first of the n floats that is NaN or differs
+ * from the expected value by more than tolerance, or n.  These are the
+ * values piglit_cl_probe_floating() can fail, before it lets NaN and
+ * infinities through.
+ */
+static size_t
+find_float_mismatch(const float *value, const float *expect, size_t n,
+                    float tolerance)
+{
+	size_t i = 0;
+
+#if defined(PROBE_USE_AVX2)
+	{
+		const __m256 t = _mm256_set1_ps(tolerance);
+		const __m256 abs_mask =
+			_mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+		for(; i + 8 <= n; i += 8) {
+			__m256 v = _mm256_loadu_ps(value + i);
+			__m256 d = _mm256_and_ps(abs_mask,
+				_mm256_sub_ps(v, _mm256_loadu_ps(expect + i)));
+			__m256 c = _mm256_or_ps(_mm256_cmp_ps(d, t, _CMP_GT_OQ),
+			                        _mm256_cmp_ps(v, v, _CMP_UNORD_Q));
+			unsigned bits = _mm256_movemask_ps(c);
+
+			if(bits) {
+				return i + ffs(bits) - 1;
+			}
+		}
+	}
+#endif
+
+#if defined(PROBE_USE_SSE2)
+	{
+		const __m128 t = _mm_set1_ps(tolerance);
+		const __m128 abs_mask =
+			_mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+		for(; i + 4 <= n; i += 4) {
+			__m128 v = _mm_loadu_ps(value + i);
+			__m128 d = _mm_and_ps(abs_mask,
+				_mm_sub_ps(v, _mm_loadu_ps(expect + i)));
+			__m128 c = _mm_or_ps(_mm_cmpgt_ps(d, t),
+			                     _mm_cmpunord_ps(v, v));
+			unsigned bits = _mm_movemask_ps(c);
+
+			if(bits) {
+				return i + ffs(bits) - 1;
+			}
+		}
+	}
+#endif
+
+	for(; i < n; i++) {
+		if(fabsf(value[i] - expect[i]) > tolerance || isnan(value[i])) {
+			return i;
+		}
+	}
+
+	return n;
+}
+
+/* Distance between two floats in ulps, counting across zero */
+static uint64_t
+float_ulp_distance(float a, float b)
+{
+	union {
+		float f;
+		int32_t i;
+	} ua, ub;
+	int64_t ia, ib;
+
+	ua.f = a;
+	ub.f = b;
+	ia = ua.i < 0 ? (int64_t)INT32_MIN - ua.i : ua.i;
+	ib = ub.i < 0 ? (int64_t)INT32_MIN - ub.i : ub.i;
+
+	return ia > ib ? ia - ib : ib - ia;
+}
+
+bool
+piglit_cl_probe_floating_array(const float *value, const float *expect,
+                               size_t count, size_t components, size_t stride,
+                               uint32_t ulp,
+                               struct piglit_cl_probe_summary *summary)
+{
+	size_t n = count * stride;
+	size_t p = 0;
+
+	memset(summary, 0, sizeof(*summary));
+
+	while((p += find_float_mismatch(value + p, expect + p, n - p, ulp)) < n) {
+		if(   p % stride < components
+		   && !probe_float_check_nan_inf(value[p], expect[p])) {
+			add_mismatch(summary,
+			             p / stride * components + p % stride,
+			             float_ulp_distance(value[p], expect[p]));
+		}
+		p++;
+	}
+
+	return summary->num_mismatches == 0;
+}
+
 bool
 piglit_cl_check_error(cl_int error, cl_int expected_error)
 {
@@ -921,6 +1210,344 @@ piglit_cl_fail_build_program_with_binary(piglit_cl_context context,
 	                                                    true);
 }
 
+/*
+ * Program binary cache.  Shares its environment variables with the GL one in
+ * piglit-program-cache.c.  A file holds a struct program_cache_header, then
+ * for each device of the context a uint64_t length followed by that many
+ * bytes of binary.
+ */
+
+#define PROGRAM_CACHE_MAGIC "PIGLITCL"
+
+struct program_cache_header {
+	char magic[8];
+	uint64_t key;
+	uint64_t num_devices;
+};
+
+static const char* program_cache_dir = NULL;
+static bool program_cache_initialized = false;
+static unsigned program_cache_hits = 0;
+static unsigned program_cache_misses = 0;
+
+static void
+program_cache_print_stats(void)
+{
+	fprintf(stderr, "piglit program cache: %u hits, %u misses\n",
+	        program_cache_hits, program_cache_misses);
+}
+
+static bool
+program_cache_enabled(void)
+{
+	if(!program_cache_initialized) {
+		program_cache_initialized = true;
+
+		program_cache_dir = getenv("PIGLIT_PROGRAM_CACHE_DIR");
+		if(   program_cache_dir == NULL || program_cache_dir[0] == '\0'
+		   || getenv("PIGLIT_NO_PROGRAM_CACHE")) {
+			program_cache_dir = NULL;
+			return false;
+		}
+
+#if defined(_WIN32)
+		_mkdir(program_cache_dir);
+#else
+		mkdir(program_cache_dir, 0777);
+#endif
+
+		if(getenv("PIGLIT_PROGRAM_CACHE_VERBOSE")) {
+			atexit(program_cache_print_stats);
+		}
+	}
+
+	return program_cache_dir != NULL;
+}
+
+/* 64-bit FNV-1a */
+static void
+program_cache_key_add(uint64_t* key, const void* data, size_t size)
+{
+	const uint8_t* bytes = data;
+	size_t i;
+
+	for(i = 0; i < size; i++) {
+		*key ^= bytes[i];
+		*key *= UINT64_C(0x100000001b3);
+	}
+}
+
+static void
+program_cache_key_add_string(uint64_t* key, const char* str)
+{
+	/* Include the terminator so that "ab" "c" and "a" "bc" differ. */
+	if(str == NULL) {
+		str = "";
+	}
+	program_cache_key_add(key, str, strlen(str) + 1);
+}
+
+/*
+ * The key covers the sources, the build options, and the platform, device
+ * and driver of every device in the context.
+ */
+static uint64_t
+program_cache_key(piglit_cl_context context, cl_uint count, char** strings,
+                  const char* options)
+{
+	static const cl_platform_info platform_params[] = {
+		CL_PLATFORM_NAME, CL_PLATFORM_VERSION,
+	};
+	static const cl_device_info device_params[] = {
+		CL_DEVICE_NAME, CL_DEVICE_VENDOR, CL_DEVICE_VERSION,
+		CL_DRIVER_VERSION,
+	};
+	uint64_t key = UINT64_C(0xcbf29ce484222325);
+	unsigned i, j;
+
+	program_cache_key_add(&key, PROGRAM_CACHE_MAGIC,
+	                      sizeof(PROGRAM_CACHE_MAGIC));
+
+	for(i = 0; i < context->num_devices; i++) {
+		cl_platform_id* platform =
+			piglit_cl_get_device_info(context->device_ids[i],
+			                          CL_DEVICE_PLATFORM);
+
+		for(j = 0; j < ARRAY_SIZE(platform_params); j++) {
+			char* str = piglit_cl_get_platform_info(*platform,
+			                                        platform_params[j]);
+			program_cache_key_add_string(&key, str);
+			free(str);
+		}
+		for(j = 0; j < ARRAY_SIZE(device_params); j++) {
+			char* str = piglit_cl_get_device_info(context->device_ids[i],
+			                                      device_params[j]);
+			program_cache_key_add_string(&key, str);
+			free(str);
+		}
+
+		free(platform);
+	}
+
+	program_cache_key_add_string(&key, options);
+	program_cache_key_add(&key, &count, sizeof(count));
+	for(i = 0; i < count; i++) {
+		program_cache_key_add_string(&key, strings[i]);
+	}
+
+	return key;
+}
+
+static char*
+program_cache_path(uint64_t key)
+{
+	char* path;
+
+	asprintf(&path, "%s/%016" PRIx64 ".clbin", program_cache_dir, key);
+	return path;
+}
+
+/*
+ * Like piglit_cl_build_program_with_binary(), but silent: a cached binary
+ * the driver rejects is a cache miss, not a build error for the test's
+ * output.
+ */
+static cl_program
+program_cache_build(piglit_cl_context context, size_t* lengths,
+                    unsigned char** binaries, const char* options)
+{
+	cl_int errNo;
+	cl_program program;
+
+	program = clCreateProgramWithBinary(context->cl_ctx,
+	                                    context->num_devices,
+	                                    context->device_ids,
+	                                    lengths,
+	                                    (const unsigned char**)binaries,
+	                                    NULL,
+	                                    &errNo);
+	if(errNo != CL_SUCCESS) {
+		return NULL;
+	}
+
+	errNo = clBuildProgram(program,
+	                       context->num_devices,
+	                       context->device_ids,
+	                       options,
+	                       NULL,
+	                       NULL);
+	if(errNo != CL_SUCCESS) {
+		clReleaseProgram(program);
+		return NULL;
+	}
+
+	return program;
+}
+
+static cl_program
+program_cache_load(piglit_cl_context context, uint64_t key,
+                   const char* options)
+{
+	struct program_cache_header header;
+	size_t* lengths = calloc(context->num_devices, sizeof(size_t));
+	unsigned char** binaries = calloc(context->num_devices,
+	                                  sizeof(unsigned char*));
+	cl_program program = NULL;
+	char* path = program_cache_path(key);
+	FILE* f = fopen(path, "rb");
+	unsigned i = 0;
+	long left = -1;
+
+	free(path);
+
+	if(f != NULL && fseek(f, 0, SEEK_END) == 0) {
+		left = ftell(f);
+		rewind(f);
+	}
+
+	if(f != NULL) {
+		if(   left >= (long)sizeof(header)
+		   && fread(&header, sizeof(header), 1, f) == 1
+		   && !memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic))
+		   && header.key == key
+		   && header.num_devices == context->num_devices) {
+			left -= sizeof(header);
+			for(i = 0; i < context->num_devices; i++) {
+				uint64_t length;
+
+				/* A length past the end of the file means a
+				 * truncated or corrupt entry.
+				 */
+				if(   left < (long)sizeof(length)
+				   || fread(&length, sizeof(length), 1, f) != 1
+				   || length == 0
+				   || length > (uint64_t)(left - sizeof(length))) {
+					break;
+				}
+				left -= sizeof(length) + length;
+				lengths[i] = length;
+				binaries[i] = malloc(length);
+				if(   binaries[i] == NULL
+				   || fread(binaries[i], 1, length, f) != length) {
+					break;
+				}
+			}
+		}
+
+		fclose(f);
+	}
+
+	/* A binary the driver no longer accepts is just a miss */
+	if(i == context->num_devices && i > 0) {
+		program = program_cache_build(context, lengths, binaries,
+		                              options);
+	}
+
+	for(i = 0; i < context->num_devices; i++) {
+		free(binaries[i]);
+	}
+	free(binaries);
+	free(lengths);
+
+	return program;
+}
+
+static void
+program_cache_store(piglit_cl_context context, cl_program program,
+                    uint64_t key)
+{
+	struct program_cache_header header;
+	size_t* lengths = piglit_cl_get_program_info(program,
+	                                             CL_PROGRAM_BINARY_SIZES);
+	unsigned char** binaries = calloc(context->num_devices,
+	                                  sizeof(unsigned char*));
+	char* path;
+	char* tmp_path;
+	bool written = true;
+	unsigned i;
+	FILE* f;
+
+	if(lengths == NULL) {
+		free(binaries);
+		return;
+	}
+
+	for(i = 0; i < context->num_devices; i++) {
+		if(lengths[i] == 0) {
+			written = false;
+		}
+		binaries[i] = malloc(lengths[i]);
+	}
+	if(   !written
+	   || clGetProgramInfo(program, CL_PROGRAM_BINARIES,
+	                       context->num_devices * sizeof(unsigned char*),
+	                       binaries, NULL) != CL_SUCCESS) {
+		goto out;
+	}
+
+	memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+	header.key = key;
+	header.num_devices = context->num_devices;
+
+	path = program_cache_path(key);
+	asprintf(&tmp_path, "%s.%d.tmp", path, (int) getpid());
+
+	f = fopen(tmp_path, "wb");
+	if(f != NULL) {
+		written = fwrite(&header, sizeof(header), 1, f) == 1;
+		for(i = 0; i < context->num_devices && written; i++) {
+			uint64_t length = lengths[i];
+
+			written =    fwrite(&length, sizeof(length), 1, f) == 1
+			          && fwrite(binaries[i], 1, lengths[i], f) == lengths[i];
+		}
+
+		if(fclose(f) != 0 || !written || rename(tmp_path, path) != 0) {
+			remove(tmp_path);
+		}
+	}
+
+	free(tmp_path);
+	free(path);
+
+out:
+	for(i = 0; i < context->num_devices; i++) {
+		free(binaries[i]);
+	}
+	free(binaries);
+	free(lengths);
+}
+
+cl_program
+piglit_cl_build_program_with_source_cached(piglit_cl_context context,
+                                           cl_uint count, char** strings,
+                                           const char* options)
+{
+	cl_program program;
+	uint64_t key;
+
+	if(!program_cache_enabled()) {
+		return piglit_cl_build_program_with_source(context, count, strings,
+		                                           options);
+	}
+
+	key = program_cache_key(context, count, strings, options);
+	program = program_cache_load(context, key, options);
+	if(program != NULL) {
+		program_cache_hits++;
+		return program;
+	}
+
+	program_cache_misses++;
+	program = piglit_cl_build_program_with_source(context, count, strings,
+	                                              options);
+	if(program != NULL) {
+		program_cache_store(context, program, key);
+	}
+
+	return program;
+}
+
 cl_mem
 piglit_cl_create_buffer(piglit_cl_context context, cl_mem_flags flags,
                                                    size_t size)
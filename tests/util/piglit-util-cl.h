@@ -73,6 +73,53 @@ bool piglit_cl_probe_floating(float value, float expect, uint32_t ulp);
  */
 bool piglit_cl_probe_double(double value, double expect, uint64_t ulp);
 
+#define PIGLIT_CL_PROBE_MAX_REPORTED 8
+
+/**
+ * \brief What the array probes found.
+ */
+struct piglit_cl_probe_summary {
+	/** Number of values that didn't match. */
+	size_t num_mismatches;
+	/** Indices of the first of them, at most PIGLIT_CL_PROBE_MAX_REPORTED. */
+	size_t num_reported;
+	size_t reported[PIGLIT_CL_PROBE_MAX_REPORTED];
+	/** Largest difference of a mismatch, in ulps for floating-point. */
+	uint64_t max_error;
+};
+
+/**
+ * \brief Probe an array of \c count elements of \c components integers of
+ *        \c size bytes, like piglit_cl_probe_integer(), without printing.
+ *
+ * Elements are \c stride values apart, to allow for the padding of 3
+ * component vectors.  Mismatches are reported by their index in the array
+ * without padding.
+ */
+bool piglit_cl_probe_integer_array(const void *value, const void *expect,
+                                   size_t size, size_t count,
+                                   size_t components, size_t stride,
+                                   uint64_t tolerance,
+                                   struct piglit_cl_probe_summary *summary);
+
+/**
+ * \brief Unsigned version of piglit_cl_probe_integer_array().
+ */
+bool piglit_cl_probe_uinteger_array(const void *value, const void *expect,
+                                    size_t size, size_t count,
+                                    size_t components, size_t stride,
+                                    uint64_t tolerance,
+                                    struct piglit_cl_probe_summary *summary);
+
+/**
+ * \brief Probe an array of floats like piglit_cl_probe_floating(), without
+ *        printing.  See piglit_cl_probe_integer_array().
+ */
+bool piglit_cl_probe_floating_array(const float *value, const float *expect,
+                                    size_t count, size_t components,
+                                    size_t stride, uint32_t ulp,
+                                    struct piglit_cl_probe_summary *summary);
+
 /**
  * \brief Check for unexpected GL error and report it.
  *
@@ -449,6 +496,32 @@ piglit_cl_fail_build_program_with_binary(piglit_cl_context context,
                                          unsigned char** binaries,
                                          const char* options);
 
+/**
+ * \brief Create and build a program with source, through the binary cache.
+ *
+ * Like \c piglit_cl_build_program_with_source, but if the program was built
+ * before with the same sources and options, on the same devices and driver,
+ * its binaries are loaded with \c piglit_cl_build_program_with_binary
+ * instead.
+ *
+ * The cache is off unless PIGLIT_PROGRAM_CACHE_DIR names a directory to keep
+ * the binaries in, and PIGLIT_NO_PROGRAM_CACHE turns it off again.  When
+ * PIGLIT_PROGRAM_CACHE_VERBOSE is set the number of hits and misses is
+ * printed when the test exits.  Tests that exercise the compiler should use
+ * \c piglit_cl_build_program_with_source.
+ *
+ * @param context      Context on which to create and build program.
+ * @param count        Number of strings in \c strings.
+ * @param string       Array of pointers to NULL-terminated source strings.
+ * @param options      NULL-terminated string that describes build options.
+ * @return             Built program or NULL on fail.
+ */
+cl_program
+piglit_cl_build_program_with_source_cached(piglit_cl_context context,
+                                           cl_uint count,
+                                           char** strings,
+                                           const char* options);
+
 /**
  * \brief Create a buffer.
  *
@@ -24,6 +24,16 @@
 #include "piglit-util-gl.h"
 #include <ctype.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PROBE_USE_SSE2
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PROBE_USE_AVX2
+#endif
+
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
 /**
@@ -35,6 +45,12 @@
  */
 static const char **gl_extensions = NULL;
 
+/**
+ * Bit piglit_extension_id of this is set if the extension is in
+ * gl_extensions.  Only valid while gl_extensions isn't NULL.
+ */
+static uint32_t gl_extension_bits[(PIGLIT_NUM_EXTENSIONS + 31) / 32];
+
 static const float color_wheel[4][4] = {
 	{1, 0, 0, 1}, /* red */
 	{0, 1, 0, 1}, /* green */
@@ -44,6 +60,27 @@ static const float color_wheel[4][4] = {
 
 bool piglit_is_core_profile;
 
+/**
+ * glReadPixels() and glGetTexImage(), timed as the readback phase.
+ */
+static void
+read_pixels(GLint x, GLint y, GLsizei w, GLsizei h, GLenum format,
+	    GLenum type, void *pixels)
+{
+	piglit_phase_push(PIGLIT_PHASE_READBACK);
+	glReadPixels(x, y, w, h, format, type, pixels);
+	piglit_phase_pop();
+}
+
+static void
+get_tex_image(GLenum target, GLint level, GLenum format, GLenum type,
+	      void *pixels)
+{
+	piglit_phase_push(PIGLIT_PHASE_READBACK);
+	glGetTexImage(target, level, format, type, pixels);
+	piglit_phase_pop();
+}
+
 bool piglit_is_gles(void)
 {
 	const char *version_string = (const char *) glGetString(GL_VERSION);
@@ -104,6 +141,8 @@ static const char** gl_extension_array_from_getstringi()
 
 static void initialize_piglit_extension_support(void)
 {
+	const char **ext;
+
 	if (gl_extensions != NULL) {
 		return;
 	}
@@ -113,6 +152,14 @@ static void initialize_piglit_extension_support(void)
 	} else {
 		gl_extensions = gl_extension_array_from_getstringi();
 	}
+
+	memset(gl_extension_bits, 0, sizeof(gl_extension_bits));
+	for (ext = gl_extensions; *ext != NULL; ext++) {
+		int id = piglit_dispatch_extension_id(*ext);
+
+		if (id >= 0)
+			gl_extension_bits[id / 32] |= 1u << (id % 32);
+	}
 }
 
 void piglit_gl_reinitialize_extensions()
@@ -123,10 +170,23 @@ void piglit_gl_reinitialize_extensions()
 	}
 }
 
-bool piglit_is_extension_supported(const char *name)
+bool piglit_is_extension_id_supported(enum piglit_extension_id id)
 {
 	initialize_piglit_extension_support();
-	return piglit_is_extension_in_array(gl_extensions, name);
+	return (gl_extension_bits[id / 32] >> (id % 32)) & 1;
+}
+
+bool piglit_is_extension_supported(const char *name)
+{
+	int id = piglit_dispatch_extension_id(name);
+
+	/* Names that aren't in the registry can still be in the list */
+	if (id < 0) {
+		initialize_piglit_extension_support();
+		return piglit_is_extension_in_array(gl_extensions, name);
+	}
+
+	return piglit_is_extension_id_supported(id);
 }
 
 void piglit_require_gl_version(int required_version_times_10)
@@ -385,6 +445,32 @@ piglit_half_from_float(float val)
 	return result;
 }
 
+/**
+ * Convert a 2-byte half float to a 4-byte float.  This is exact, NaNs keep
+ * their payload and become quiet, as with the F16C instructions.
+ */
+float
+piglit_float_from_half(unsigned short val)
+{
+	const unsigned s = (val & 0x8000) << 16;
+	const unsigned e = (val >> 10) & 0x1f;
+	const unsigned m = val & 0x3ff;
+	fi_type fi;
+
+	if (e == 0) {
+		/* zero or denorm, both normal floats: m * 2^-24 */
+		fi.f = m * (1.0f / 16777216.0f);
+		fi.i |= s;
+	} else if (e == 31) {
+		/* infinity or NaN */
+		fi.i = s | 0x7f800000 | (m << 13) | (m ? 0x400000 : 0);
+	} else {
+		fi.i = s | ((e + 112) << 23) | (m << 13);
+	}
+
+	return fi.f;
+}
+
 int
 piglit_probe_rect_halves_equal_rgba(int x, int y, int w, int h)
 {
@@ -393,7 +479,7 @@ piglit_probe_rect_halves_equal_rgba(int x, int y, int w, int h)
 	GLfloat probe2[4];
 	GLubyte *pixels = malloc(w*h*4*sizeof(GLubyte));
 
-	glReadPixels(x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	read_pixels(x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 
 	for (j = 0; j < h; j++) {
 		for (i = 0; i < w / 2; i++) {
@@ -1035,6 +1121,33 @@ piglit_get_luminance_intensity_bits(GLenum internalformat, int *bits)
 	return false;
 }
 
+enum scratch_slot {
+	SCRATCH_READBACK,
+	SCRATCH_PROBE_FLOAT,
+	SCRATCH_PROBE_UBYTE,
+	SCRATCH_COUNT
+};
+
+/**
+ * Return a buffer of at least \p size bytes that is kept between calls, so
+ * that probes don't allocate a new readback buffer every time.  The contents
+ * are only good until the next call for the same slot.
+ */
+static void *
+scratch_buffer(enum scratch_slot slot, size_t size)
+{
+	static void *buffers[SCRATCH_COUNT];
+	static size_t sizes[SCRATCH_COUNT];
+
+	if (size > sizes[slot]) {
+		free(buffers[slot]);
+		buffers[slot] = malloc(size);
+		sizes[slot] = size;
+	}
+
+	return buffers[slot];
+}
+
 /* Wrapper around glReadPixels that always returns floats; reads and converts
  * GL_UNSIGNED_BYTE on GLES.  If pixels == NULL, malloc a float array of the
  * appropriate size, otherwise use the one provided. */
@@ -1050,20 +1163,180 @@ piglit_read_pixels_float(GLint x, GLint y, GLsizei width, GLsizei height,
 		pixels = malloc(ncomponents * sizeof(GLfloat));
 
 	if (!piglit_is_gles()) {
-		glReadPixels(x, y, width, height, format, GL_FLOAT, pixels);
+		read_pixels(x, y, width, height, format, GL_FLOAT, pixels);
 		return pixels;
 	}
 
-	pixels_b = malloc(ncomponents * sizeof(GLubyte));
-	glReadPixels(x, y, width, height, format, GL_UNSIGNED_BYTE, pixels_b);
+	pixels_b = scratch_buffer(SCRATCH_READBACK,
+				  ncomponents * sizeof(GLubyte));
+	read_pixels(x, y, width, height, format, GL_UNSIGNED_BYTE, pixels_b);
 	for (i = 0; i < ncomponents; i++)
 		pixels[i] = pixels_b[i] / 255.0;
-	free(pixels_b);
 	return pixels;
 }
 
-static bool
-piglit_can_probe_ubyte()
+/**
+ * Return the index of the first of the \p n RGBA float pixels that has a
+ * component selected by \p mask (bit i for component i) differing from
+ * \p expected by more than \p tolerance, or by at least \p tolerance when
+ * \p inclusive is set.  Returns \p n if every pixel matches.
+ *
+ * This is where rect probes spend their time, so there are SSE2 and AVX2
+ * versions of the loop.  Like fabs(), they compare NaN as matching.
+ */
+static int
+find_float_mismatch(const float *pixels, int n, const float expected[4],
+		    const float tolerance[4], unsigned mask, bool inclusive)
+{
+	int i = 0, p;
+
+#if defined(PROBE_USE_AVX2)
+	{
+		const __m256 e = _mm256_setr_ps(expected[0], expected[1],
+						expected[2], expected[3],
+						expected[0], expected[1],
+						expected[2], expected[3]);
+		const __m256 t = _mm256_setr_ps(tolerance[0], tolerance[1],
+						tolerance[2], tolerance[3],
+						tolerance[0], tolerance[1],
+						tolerance[2], tolerance[3]);
+		const __m256 abs_mask =
+			_mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+		const unsigned mask2 = mask | mask << 4;
+
+		for (; i + 2 <= n; i += 2) {
+			__m256 d = _mm256_and_ps(abs_mask,
+				_mm256_sub_ps(_mm256_loadu_ps(pixels + i * 4), e));
+			__m256 c = inclusive ?
+				_mm256_cmp_ps(d, t, _CMP_GE_OQ) :
+				_mm256_cmp_ps(d, t, _CMP_GT_OQ);
+			unsigned bits = _mm256_movemask_ps(c) & mask2;
+
+			if (bits)
+				return (bits & mask) ? i : i + 1;
+		}
+	}
+#endif
+
+#if defined(PROBE_USE_SSE2)
+	{
+		const __m128 e = _mm_loadu_ps(expected);
+		const __m128 t = _mm_loadu_ps(tolerance);
+		const __m128 abs_mask =
+			_mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+		for (; i < n; i++) {
+			__m128 d = _mm_and_ps(abs_mask,
+				_mm_sub_ps(_mm_loadu_ps(pixels + i * 4), e));
+			__m128 c = inclusive ? _mm_cmpge_ps(d, t) :
+					       _mm_cmpgt_ps(d, t);
+
+			if (_mm_movemask_ps(c) & mask)
+				return i;
+		}
+	}
+#endif
+
+	for (; i < n; i++) {
+		for (p = 0; p < 4; p++) {
+			double d;
+
+			if (!(mask & (1 << p)))
+				continue;
+
+			d = fabs(pixels[i * 4 + p] - expected[p]);
+			if (inclusive ? d >= tolerance[p] : d > tolerance[p])
+				return i;
+		}
+	}
+
+	return n;
+}
+
+/**
+ * Like find_float_mismatch(), for RGBA ubyte pixels.  Components match when
+ * they differ by less than \p tolerance.
+ */
+static int
+find_ubyte_mismatch(const GLubyte *pixels, int n, const GLubyte expected[4],
+		    const GLubyte tolerance[4], unsigned mask)
+{
+	int i = 0, p;
+
+#if defined(PROBE_USE_SSE2) || defined(PROBE_USE_AVX2)
+	uint32_t e32, t32;
+
+	memcpy(&e32, expected, 4);
+	memcpy(&t32, tolerance, 4);
+#endif
+
+#if defined(PROBE_USE_AVX2)
+	{
+		const __m256i e = _mm256_set1_epi32(e32);
+		const __m256i t = _mm256_set1_epi32(t32);
+		const uint32_t lanes = mask * 0x11111111u;
+
+		for (; i + 8 <= n; i += 8) {
+			__m256i v = _mm256_loadu_si256(
+				(const __m256i *) (pixels + i * 4));
+			__m256i d = _mm256_or_si256(_mm256_subs_epu8(v, e),
+						    _mm256_subs_epu8(e, v));
+			/* d >= t, as bytes are unsigned */
+			__m256i c = _mm256_cmpeq_epi8(_mm256_max_epu8(d, t), d);
+			uint32_t bits = (uint32_t) _mm256_movemask_epi8(c) & lanes;
+
+			if (bits) {
+				while (!(bits & 0xf)) {
+					bits >>= 4;
+					i++;
+				}
+				return i;
+			}
+		}
+	}
+#endif
+
+#if defined(PROBE_USE_SSE2)
+	{
+		const __m128i e = _mm_set1_epi32(e32);
+		const __m128i t = _mm_set1_epi32(t32);
+		const unsigned lanes = mask * 0x1111u;
+
+		for (; i + 4 <= n; i += 4) {
+			__m128i v = _mm_loadu_si128(
+				(const __m128i *) (pixels + i * 4));
+			__m128i d = _mm_or_si128(_mm_subs_epu8(v, e),
+						 _mm_subs_epu8(e, v));
+			__m128i c = _mm_cmpeq_epi8(_mm_max_epu8(d, t), d);
+			unsigned bits = _mm_movemask_epi8(c) & lanes;
+
+			if (bits) {
+				while (!(bits & 0xf)) {
+					bits >>= 4;
+					i++;
+				}
+				return i;
+			}
+		}
+	}
+#endif
+
+	for (; i < n; i++) {
+		for (p = 0; p < 4; p++) {
+			if (!(mask & (1 << p)))
+				continue;
+
+			if (abs((int)pixels[i * 4 + p] - (int)expected[p]) >=
+			    tolerance[p])
+				return i;
+		}
+	}
+
+	return n;
+}
+
+bool
+piglit_can_probe_ubyte(void)
 {
 	int r,g,b,a,read;
 
@@ -1208,83 +1481,504 @@ piglit_array_float_to_ubyte_roundup(int n, const float *f, GLubyte *b)
 		b[i] = ceil(f[i] * 255);
 }
 
-static bool
-piglit_probe_rect_ubyte(int x, int y, int w, int h, int num_components,
-			const float *fexpected, bool silent)
+static void
+print_probe_float(int x, int y, int num_components, const float *expected,
+		  const float *probe)
 {
-	int i, j, p;
-	GLubyte *probe;
-	GLubyte *pixels;
-	GLubyte tolerance[4];
-	GLubyte expected[4];
+	printf("Probe color at (%i,%i)\n", x, y);
+	if (num_components == 4) {
+		printf("  Expected: %f %f %f %f\n",
+		       expected[0], expected[1], expected[2], expected[3]);
+		printf("  Observed: %f %f %f %f\n",
+		       probe[0], probe[1], probe[2], probe[3]);
+	} else {
+		printf("  Expected: %f %f %f\n",
+		       expected[0], expected[1], expected[2]);
+		printf("  Observed: %f %f %f\n",
+		       probe[0], probe[1], probe[2]);
+	}
+}
 
-	piglit_array_float_to_ubyte_roundup(num_components, piglit_tolerance, tolerance);
-	piglit_array_float_to_ubyte(num_components, fexpected, expected);
+/**
+ * Compare a w x h rectangle of RGBA float pixels, whose rows are \p stride
+ * pixels apart, against \p expected.  The first mismatch is reported as
+ * being at (x + i, y + j) unless \p silent, and stored in \p fail_x and
+ * \p fail_y if they aren't NULL.
+ */
+static bool
+compare_rect_float(const float *pixels, int stride, int x, int y, int w, int h,
+		   int num_components, const float *expected,
+		   const float *tolerance, bool inclusive, bool silent,
+		   int *fail_x, int *fail_y)
+{
+	float e[4] = { 0 }, t[4] = { 0 };
+	const unsigned mask = (1 << num_components) - 1;
+	int i, j;
 
-	/* RGBA readbacks are likely to be faster */
-	pixels = malloc(w*h*4);
-	glReadPixels(x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	memcpy(e, expected, num_components * sizeof(float));
+	memcpy(t, tolerance, num_components * sizeof(float));
 
 	for (j = 0; j < h; j++) {
-		for (i = 0; i < w; i++) {
-			probe = &pixels[(j*w+i)*4];
+		const float *row = &pixels[j * stride * 4];
+
+		i = find_float_mismatch(row, w, e, t, mask, inclusive);
+		if (i < w) {
+			if (!silent)
+				print_probe_float(x + i, y + j, num_components,
+						  expected, &row[i * 4]);
+			if (fail_x && fail_y) {
+				*fail_x = x + i;
+				*fail_y = y + j;
+			}
+			return false;
+		}
+	}
 
-			for (p = 0; p < num_components; ++p) {
-				if (abs((int)probe[p] - (int)expected[p]) >= tolerance[p]) {
-					if (!silent) {
-						printf("Probe color at (%i,%i)\n", x+i, y+j);
-						if (num_components == 4) {
-							printf("  Expected: %u %u %u %u\n",
-							       expected[0], expected[1],
-							       expected[2], expected[3]);
-							printf("  Observed: %u %u %u %u\n",
-							       probe[0], probe[1], probe[2], probe[3]);
-						} else {
-							printf("  Expected: %u %u %u\n",
-							       expected[0], expected[1],
-							       expected[2]);
-							printf("  Observed: %u %u %u\n",
-							       probe[0], probe[1], probe[2]);
-						}
-					}
-					free(pixels);
-					return false;
-				}
+	return true;
+}
+
+/**
+ * Like compare_rect_float(), for RGBA ubyte pixels.  \p fexpected and
+ * \p ftolerance are converted the same way piglit_probe_rect_ubyte() always
+ * has.
+ */
+static bool
+compare_rect_ubyte(const GLubyte *pixels, int stride, int x, int y, int w,
+		   int h, int num_components, const float *fexpected,
+		   const float *ftolerance, bool silent, int *fail_x, int *fail_y)
+{
+	GLubyte expected[4] = { 0 }, tolerance[4] = { 0 };
+	const unsigned mask = (1 << num_components) - 1;
+	const GLubyte *probe;
+	int i, j;
+
+	piglit_array_float_to_ubyte_roundup(num_components, ftolerance, tolerance);
+	piglit_array_float_to_ubyte(num_components, fexpected, expected);
+
+	for (j = 0; j < h; j++) {
+		i = find_ubyte_mismatch(&pixels[j * stride * 4], w, expected,
+					tolerance, mask);
+		if (i == w)
+			continue;
+
+		if (fail_x && fail_y) {
+			*fail_x = x + i;
+			*fail_y = y + j;
+		}
+		if (!silent) {
+			probe = &pixels[(j * stride + i) * 4];
+			printf("Probe color at (%i,%i)\n", x+i, y+j);
+			if (num_components == 4) {
+				printf("  Expected: %u %u %u %u\n",
+				       expected[0], expected[1],
+				       expected[2], expected[3]);
+				printf("  Observed: %u %u %u %u\n",
+				       probe[0], probe[1], probe[2], probe[3]);
+			} else {
+				printf("  Expected: %u %u %u\n",
+				       expected[0], expected[1],
+				       expected[2]);
+				printf("  Observed: %u %u %u\n",
+				       probe[0], probe[1], probe[2]);
 			}
 		}
+		return false;
 	}
 
-	free(pixels);
 	return true;
 }
 
-int
-piglit_probe_rect_rgb_silent(int x, int y, int w, int h, const float *expected)
+static bool
+cpu_probe_rect(int x, int y, int w, int h, int num_components,
+	       const float *expected, bool ubyte, bool silent,
+	       int *fail_x, int *fail_y)
 {
-	int i, j, p;
-	GLfloat *probe;
-	GLfloat *pixels;
+	if (ubyte) {
+		GLubyte *pixels = scratch_buffer(SCRATCH_PROBE_UBYTE,
+						 w * h * 4);
 
-	if (piglit_can_probe_ubyte())
-		return piglit_probe_rect_ubyte(x, y, w, h, 3, expected, true);
+		/* RGBA readbacks are likely to be faster */
+		read_pixels(x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 
-	pixels = piglit_read_pixels_float(x, y, w, h, GL_RGB, NULL);
+		return compare_rect_ubyte(pixels, w, x, y, w, h,
+					  num_components, expected,
+					  piglit_tolerance, silent,
+					  fail_x, fail_y);
+	} else {
+		GLfloat *pixels = scratch_buffer(SCRATCH_PROBE_FLOAT,
+						 w * h * 4 * sizeof(GLfloat));
 
-	for (j = 0; j < h; j++) {
-		for (i = 0; i < w; i++) {
-			probe = &pixels[(j*w+i)*3];
+		piglit_read_pixels_float(x, y, w, h, GL_RGBA, pixels);
 
-			for (p = 0; p < 3; ++p) {
-				if (fabs(probe[p] - expected[p]) >= piglit_tolerance[p]) {
-					free(pixels);
-					return 0;
-				}
-			}
+		return compare_rect_float(pixels, w, x, y, w, h,
+					  num_components, expected,
+					  piglit_tolerance, true, silent,
+					  fail_x, fail_y);
+	}
+}
+
+/**
+ * \name GPU rect probes
+ *
+ * With the GPU probe backend, large rect probes blit the region into a
+ * float texture and compare it in a compute shader, which counts the
+ * mismatches and finds the first one in the order the CPU probes scan.
+ * Only those eight bytes, and the failing pixel, are read back.
+ */
+/*@{*/
+
+/* Smaller probes are cheaper to read back than to dispatch. */
+#define GPU_PROBE_MIN_PIXELS 4096
+
+static const char gpu_probe_source[] =
+	"#version 430\n"
+	"layout(local_size_x = 16, local_size_y = 16) in;\n"
+	"layout(rgba32f, binding = 0) readonly uniform image2D image;\n"
+	"layout(std430, binding = 0) buffer result {\n"
+	"	uint mismatches;\n"
+	"	uint first;\n"
+	"};\n"
+	"uniform ivec2 size;\n"
+	"uniform vec4 expected;\n"
+	"uniform vec4 tolerance;\n"
+	"uniform bvec4 mask;\n"
+	"uniform bool ubyte;\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"	ivec2 p = ivec2(gl_GlobalInvocationID.xy);\n"
+	"	if (any(greaterThanEqual(p, size)))\n"
+	"		return;\n"
+	"\n"
+	"	vec4 v = imageLoad(image, p);\n"
+	"	if (ubyte)\n"
+	"		v = round(clamp(v, 0.0, 1.0) * 255.0);\n"
+	"\n"
+	"	/* NaN matches, as it does for the CPU probes */\n"
+	"	bvec4 fail = greaterThanEqual(abs(v - expected), tolerance);\n"
+	"	if ((fail.r && mask.r) || (fail.g && mask.g) ||\n"
+	"	    (fail.b && mask.b) || (fail.a && mask.a)) {\n"
+	"		atomicAdd(mismatches, 1u);\n"
+	"		atomicMin(first, uint(p.y * size.x + p.x));\n"
+	"	}\n"
+	"}\n";
+
+/* -1 until the PIGLIT_PROBE_BACKEND environment variable is read */
+static int probe_backend = -1;
+
+static struct {
+	bool initialized;
+	bool available;
+	GLuint prog;
+	GLuint result_buffer;
+	GLuint tex;
+	GLuint fbo;
+	int tex_w, tex_h;
+	GLint size_loc, expected_loc, tolerance_loc, mask_loc, ubyte_loc;
+} gpu_probe;
+
+/**
+ * Choose how piglit_probe_rect_rgb() and piglit_probe_rect_rgba() compare
+ * pixels:
+ *
+ *  - PIGLIT_PROBE_BACKEND_CPU reads every pixel back, as always.
+ *  - PIGLIT_PROBE_BACKEND_GPU compares large rects in a compute shader,
+ *    and falls back to the CPU where compute shaders aren't available or
+ *    the read buffer is sRGB or integer.
+ *  - PIGLIT_PROBE_BACKEND_CHECK does both for every rect, and fails the
+ *    probe if they disagree about whether or where it fails.
+ *
+ * The default comes from the PIGLIT_PROBE_BACKEND environment variable,
+ * "cpu", "gpu" or "check".
+ */
+void
+piglit_set_probe_backend(enum piglit_probe_backend backend)
+{
+	probe_backend = backend;
+}
+
+static enum piglit_probe_backend
+get_probe_backend(void)
+{
+	if (probe_backend == -1) {
+		const char *env = getenv("PIGLIT_PROBE_BACKEND");
+
+		if (env != NULL && strcmp(env, "gpu") == 0)
+			probe_backend = PIGLIT_PROBE_BACKEND_GPU;
+		else if (env != NULL && strcmp(env, "check") == 0)
+			probe_backend = PIGLIT_PROBE_BACKEND_CHECK;
+		else
+			probe_backend = PIGLIT_PROBE_BACKEND_CPU;
+	}
+
+	return probe_backend;
+}
+
+static bool
+gpu_probe_init(void)
+{
+	static const GLuint no_result[2] = { 0, ~0u };
+	GLuint cs;
+	GLint buffer;
+
+	gpu_probe.initialized = true;
+
+	if (piglit_is_gles() || piglit_get_gl_version() < 43)
+		return false;
+
+	cs = piglit_compile_shader_text_nothrow(GL_COMPUTE_SHADER,
+						gpu_probe_source);
+	if (cs == 0)
+		return false;
+
+	gpu_probe.prog = glCreateProgram();
+	glAttachShader(gpu_probe.prog, cs);
+	glLinkProgram(gpu_probe.prog);
+	glDeleteShader(cs);
+	if (!piglit_link_check_status_quiet(gpu_probe.prog)) {
+		glDeleteProgram(gpu_probe.prog);
+		return false;
+	}
+
+	gpu_probe.size_loc = glGetUniformLocation(gpu_probe.prog, "size");
+	gpu_probe.expected_loc = glGetUniformLocation(gpu_probe.prog,
+						      "expected");
+	gpu_probe.tolerance_loc = glGetUniformLocation(gpu_probe.prog,
+						       "tolerance");
+	gpu_probe.mask_loc = glGetUniformLocation(gpu_probe.prog, "mask");
+	gpu_probe.ubyte_loc = glGetUniformLocation(gpu_probe.prog, "ubyte");
+
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_BINDING, &buffer);
+	glGenBuffers(1, &gpu_probe.result_buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gpu_probe.result_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(no_result), no_result,
+		     GL_DYNAMIC_READ);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+
+	glGenTextures(1, &gpu_probe.tex);
+	glGenFramebuffers(1, &gpu_probe.fbo);
+
+	return true;
+}
+
+/**
+ * Whether the GPU can compare the read buffer exactly as the CPU reads it
+ * back: not sRGB, which blits would decode, and not integer.
+ */
+static bool
+gpu_probe_can_read(void)
+{
+	GLint read, fb, encoding, type;
+
+	glGetIntegerv(GL_READ_BUFFER, &read);
+	if (read == GL_NONE)
+		return false;
+
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &fb);
+	if (fb == 0) {
+		if (read == GL_FRONT)
+			read = GL_FRONT_LEFT;
+		if (read == GL_BACK)
+			read = GL_BACK_LEFT;
+	}
+
+	glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, read,
+		GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING, &encoding);
+	glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, read,
+		GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE, &type);
+
+	return encoding == GL_LINEAR && type != GL_INT &&
+		type != GL_UNSIGNED_INT;
+}
+
+/**
+ * Compare the w x h rect at (x, y) of the read buffer against \p expected
+ * on the GPU.  Returns false if that isn't possible.  Otherwise stores the
+ * number of mismatching pixels and, if there are any, the first of them.
+ * GL state is left as it was.
+ */
+static bool
+gpu_probe_rect(int x, int y, int w, int h, int num_components,
+	       const float *expected, bool ubyte,
+	       unsigned *mismatches, int *fail_x, int *fail_y)
+{
+	static const GLuint no_result[2] = { 0, ~0u };
+	GLint draw_fb, prog, buffer, indexed_buffer, tex;
+	GLint64 indexed_start, indexed_size;
+	GLint image_name, image_level, image_layer, image_access, image_format;
+	GLboolean image_layered, scissor;
+	float e[4] = { 0 }, t[4] = { 0 };
+	GLuint result[2];
+	int i;
+
+	if (!gpu_probe.initialized)
+		gpu_probe.available = gpu_probe_init();
+	if (!gpu_probe.available || w <= 0 || h <= 0 || !gpu_probe_can_read())
+		return false;
+
+	if (ubyte) {
+		GLubyte eb[4], tb[4];
+
+		piglit_array_float_to_ubyte(num_components, expected, eb);
+		piglit_array_float_to_ubyte_roundup(num_components,
+						    piglit_tolerance, tb);
+		for (i = 0; i < num_components; i++) {
+			e[i] = eb[i];
+			t[i] = tb[i];
 		}
+	} else {
+		memcpy(e, expected, num_components * sizeof(float));
+		memcpy(t, piglit_tolerance, num_components * sizeof(float));
 	}
 
-	free(pixels);
-	return 1;
+	/* Save what is about to be rebound. */
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw_fb);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &prog);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_BINDING, &buffer);
+	glGetIntegeri_v(GL_SHADER_STORAGE_BUFFER_BINDING, 0, &indexed_buffer);
+	glGetInteger64i_v(GL_SHADER_STORAGE_BUFFER_START, 0, &indexed_start);
+	glGetInteger64i_v(GL_SHADER_STORAGE_BUFFER_SIZE, 0, &indexed_size);
+	glGetIntegeri_v(GL_IMAGE_BINDING_NAME, 0, &image_name);
+	glGetIntegeri_v(GL_IMAGE_BINDING_LEVEL, 0, &image_level);
+	glGetBooleani_v(GL_IMAGE_BINDING_LAYERED, 0, &image_layered);
+	glGetIntegeri_v(GL_IMAGE_BINDING_LAYER, 0, &image_layer);
+	glGetIntegeri_v(GL_IMAGE_BINDING_ACCESS, 0, &image_access);
+	glGetIntegeri_v(GL_IMAGE_BINDING_FORMAT, 0, &image_format);
+	scissor = glIsEnabled(GL_SCISSOR_TEST);
+
+	if (w > gpu_probe.tex_w || h > gpu_probe.tex_h) {
+		gpu_probe.tex_w = MAX2(w, gpu_probe.tex_w);
+		gpu_probe.tex_h = MAX2(h, gpu_probe.tex_h);
+
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &tex);
+		glBindTexture(GL_TEXTURE_2D, gpu_probe.tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, gpu_probe.tex_w,
+			     gpu_probe.tex_h, 0, GL_RGBA, GL_FLOAT, NULL);
+		glBindTexture(GL_TEXTURE_2D, tex);
+
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, gpu_probe.fbo);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER,
+				       GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+				       gpu_probe.tex, 0);
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, gpu_probe.fbo);
+	if (scissor)
+		glDisable(GL_SCISSOR_TEST);
+	glBlitFramebuffer(x, y, x + w, y + h, 0, 0, w, h,
+			  GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	if (scissor)
+		glEnable(GL_SCISSOR_TEST);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_fb);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0,
+			 gpu_probe.result_buffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(no_result),
+			no_result);
+	glBindImageTexture(0, gpu_probe.tex, 0, GL_FALSE, 0, GL_READ_ONLY,
+			   GL_RGBA32F);
+
+	glUseProgram(gpu_probe.prog);
+	glUniform2i(gpu_probe.size_loc, w, h);
+	glUniform4fv(gpu_probe.expected_loc, 1, e);
+	glUniform4fv(gpu_probe.tolerance_loc, 1, t);
+	glUniform4i(gpu_probe.mask_loc, num_components > 0,
+		    num_components > 1, num_components > 2,
+		    num_components > 3);
+	glUniform1i(gpu_probe.ubyte_loc, ubyte);
+	glDispatchCompute((w + 15) / 16, (h + 15) / 16, 1);
+	glUseProgram(prog);
+
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	piglit_phase_push(PIGLIT_PHASE_READBACK);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(result),
+			   result);
+	piglit_phase_pop();
+
+	/* Restore the bindings. */
+	glBindImageTexture(0, image_name, image_level, image_layered,
+			   image_layer, image_access, image_format);
+	if (indexed_size == 0)
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, indexed_buffer);
+	else
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, indexed_buffer,
+				  indexed_start, indexed_size);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+
+	*mismatches = result[0];
+	if (result[0] != 0) {
+		*fail_x = x + result[1] % w;
+		*fail_y = y + result[1] / w;
+	}
+	return true;
+}
+
+/*@}*/
+
+/**
+ * Probe a rect the way the chosen probe backend does.  \p ubyte says
+ * whether to compare ubytes, as piglit_can_probe_ubyte() decides.
+ */
+static bool
+probe_rect(int x, int y, int w, int h, int num_components,
+	   const float *expected, bool ubyte, bool silent)
+{
+	const enum piglit_probe_backend backend = get_probe_backend();
+	int gpu_x = 0, gpu_y = 0, cpu_x = 0, cpu_y = 0;
+	unsigned mismatches;
+	bool pass;
+
+	if (backend == PIGLIT_PROBE_BACKEND_CPU ||
+	    (backend == PIGLIT_PROBE_BACKEND_GPU &&
+	     (double) w * h < GPU_PROBE_MIN_PIXELS) ||
+	    !gpu_probe_rect(x, y, w, h, num_components, expected, ubyte,
+			    &mismatches, &gpu_x, &gpu_y))
+		return cpu_probe_rect(x, y, w, h, num_components, expected,
+				      ubyte, silent, NULL, NULL);
+
+	if (backend == PIGLIT_PROBE_BACKEND_GPU) {
+		if (mismatches == 0)
+			return true;
+
+		/* Report the failing pixel as the CPU probe would.  If it
+		 * disagrees, the CPU probe of the whole rect decides.
+		 */
+		if (!cpu_probe_rect(gpu_x, gpu_y, 1, 1, num_components,
+				    expected, ubyte, silent, NULL, NULL))
+			return false;
+		return cpu_probe_rect(x, y, w, h, num_components, expected,
+				      ubyte, silent, NULL, NULL);
+	}
+
+	pass = cpu_probe_rect(x, y, w, h, num_components, expected, ubyte,
+			      silent, &cpu_x, &cpu_y);
+	if (pass != (mismatches == 0) ||
+	    (!pass && (cpu_x != gpu_x || cpu_y != gpu_y))) {
+		printf("GPU probe of %dx%d at (%d,%d) disagrees with CPU "
+		       "probe\n", w, h, x, y);
+		if (pass)
+			printf("  GPU: %u mismatches, first at (%d,%d)\n"
+			       "  CPU: no mismatches\n",
+			       mismatches, gpu_x, gpu_y);
+		else if (mismatches == 0)
+			printf("  GPU: no mismatches\n"
+			       "  CPU: first mismatch at (%d,%d)\n",
+			       cpu_x, cpu_y);
+		else
+			printf("  GPU: %u mismatches, first at (%d,%d)\n"
+			       "  CPU: first mismatch at (%d,%d)\n",
+			       mismatches, gpu_x, gpu_y, cpu_x, cpu_y);
+		return false;
+	}
+
+	return pass;
+}
+
+int
+piglit_probe_rect_rgb_silent(int x, int y, int w, int h, const float *expected)
+{
+	return probe_rect(x, y, w, h, 3, expected, piglit_can_probe_ubyte(),
+			  true);
 }
 
 /* More efficient variant if you don't know need floats and GBA channels. */
@@ -1298,7 +1992,7 @@ piglit_probe_rect_r_ubyte(int x, int y, int w, int h, GLubyte expected)
 	w_aligned = ALIGN(w, 4);
 	pixels = malloc(w_aligned * h);
 
-	glReadPixels(x, y, w, h, GL_RED, GL_UNSIGNED_BYTE, pixels);
+	read_pixels(x, y, w, h, GL_RED, GL_UNSIGNED_BYTE, pixels);
 
 	for (j = 0; j < h; j++) {
 		for (i = 0; i < w; i++) {
@@ -1322,50 +2016,22 @@ piglit_probe_rect_r_ubyte(int x, int y, int w, int h, GLubyte expected)
 int
 piglit_probe_rect_rgb(int x, int y, int w, int h, const float *expected)
 {
-	int i, j, p;
-	GLfloat *probe;
-	GLfloat *pixels;
-
-	if (piglit_can_probe_ubyte())
-		return piglit_probe_rect_ubyte(x, y, w, h, 3, expected, false);
+	return probe_rect(x, y, w, h, 3, expected, piglit_can_probe_ubyte(),
+			  false);
+}
 
-	pixels = piglit_read_pixels_float(x, y, w, h, GL_RGBA, NULL);
+int
+piglit_probe_rects_equal(int x1, int y1, int x2, int y2,
+			int w, int h, GLenum format)
+{
+	int retval;
+	GLfloat *pixels;
+	int ncomponents, rect_size;
 
-	for (j = 0; j < h; j++) {
-		for (i = 0; i < w; i++) {
-			probe = &pixels[(j*w+i)*4];
-
-			for (p = 0; p < 3; ++p) {
-				if (fabs(probe[p] - expected[p]) >= piglit_tolerance[p]) {
-					printf("Probe color at (%i,%i)\n", x+i, y+j);
-					printf("  Expected: %f %f %f\n",
-					       expected[0], expected[1], expected[2]);
-					printf("  Observed: %f %f %f\n",
-					       probe[0], probe[1], probe[2]);
-
-					free(pixels);
-					return 0;
-				}
-			}
-		}
-	}
-
-	free(pixels);
-	return 1;
-}
-
-int
-piglit_probe_rects_equal(int x1, int y1, int x2, int y2,
-			int w, int h, GLenum format)
-{
-	int retval;
-	GLfloat *pixels;
-	int ncomponents, rect_size;
-
-	/* Allocate buffer large enough for two rectangles */
-	ncomponents = piglit_num_components(format);
-	rect_size = w * h * ncomponents;
-	pixels = malloc(2 * rect_size * sizeof(GLfloat));
+	/* Allocate buffer large enough for two rectangles */
+	ncomponents = piglit_num_components(format);
+	rect_size = w * h * ncomponents;
+	pixels = malloc(2 * rect_size * sizeof(GLfloat));
 
 	/* Load the pixels into the buffer and compare */
 	/* We only need to do one glReadPixels if the images are adjacent */
@@ -1392,36 +2058,196 @@ piglit_probe_rects_equal(int x1, int y1, int x2, int y2,
 int
 piglit_probe_rect_rgba(int x, int y, int w, int h, const float *expected)
 {
-	int i, j, p;
-	GLfloat *probe;
-	GLfloat *pixels;
+	return probe_rect(x, y, w, h, 4, expected, piglit_can_probe_ubyte(),
+			  false);
+}
 
-	if (piglit_can_probe_ubyte())
-		return piglit_probe_rect_ubyte(x, y, w, h, 4, expected, false);
+struct probe_batch_entry {
+	int x, y, w, h;
+	int num_components;
+	/* Rect probes compare with >= and may be done in ubytes, pixel
+	 * probes compare with >.
+	 */
+	bool rect;
+	float expected[4];
+	float tolerance[4];
+};
 
-	pixels = piglit_read_pixels_float(x, y, w, h, GL_RGBA, NULL);
+static struct probe_batch_entry *probe_batch;
+static unsigned probe_batch_count, probe_batch_size;
 
-	for (j = 0; j < h; j++) {
-		for (i = 0; i < w; i++) {
-			probe = &pixels[(j*w+i)*4];
+/**
+ * Above this many pixels in the bounding box of a batch, the probes are read
+ * back one by one instead, so that a few probes spread over a large
+ * framebuffer don't read all of it.
+ */
+#define PROBE_BATCH_MAX_PIXELS (1024 * 1024)
 
-			for (p = 0; p < 4; ++p) {
-				if (fabs(probe[p] - expected[p]) >= piglit_tolerance[p]) {
-					printf("Probe color at (%i,%i)\n", x+i, y+j);
-					printf("  Expected: %f %f %f %f\n",
-					       expected[0], expected[1], expected[2], expected[3]);
-					printf("  Observed: %f %f %f %f\n",
-					       probe[0], probe[1], probe[2], probe[3]);
+static void
+probe_batch_add(int x, int y, int w, int h, int num_components, bool rect,
+		const float *expected)
+{
+	struct probe_batch_entry *p;
 
-					free(pixels);
-					return 0;
-				}
-			}
+	if (probe_batch_count == probe_batch_size) {
+		probe_batch_size = MAX2(16, probe_batch_size * 2);
+		probe_batch = realloc(probe_batch,
+				      probe_batch_size * sizeof(*probe_batch));
+	}
+
+	p = &probe_batch[probe_batch_count++];
+	p->x = x;
+	p->y = y;
+	p->w = w;
+	p->h = h;
+	p->num_components = num_components;
+	p->rect = rect;
+	memset(p->expected, 0, sizeof(p->expected));
+	memcpy(p->expected, expected, num_components * sizeof(float));
+	memcpy(p->tolerance, piglit_tolerance, sizeof(p->tolerance));
+}
+
+void
+piglit_probe_batch_pixel_rgb(int x, int y, const float *expected)
+{
+	probe_batch_add(x, y, 1, 1, 3, false, expected);
+}
+
+void
+piglit_probe_batch_pixel_rgba(int x, int y, const float *expected)
+{
+	probe_batch_add(x, y, 1, 1, 4, false, expected);
+}
+
+void
+piglit_probe_batch_rect_rgb(int x, int y, int w, int h, const float *expected)
+{
+	probe_batch_add(x, y, w, h, 3, true, expected);
+}
+
+void
+piglit_probe_batch_rect_rgba(int x, int y, int w, int h,
+			     const float *expected)
+{
+	probe_batch_add(x, y, w, h, 4, true, expected);
+}
+
+/**
+ * Check \p count queued probes with a single readback of their bounding box
+ * per format needed.  Returns false if any of them failed.
+ */
+static bool
+probe_batch_run(const struct probe_batch_entry *probes, unsigned count,
+		bool ubyte_rects)
+{
+	int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+	bool need_float = false, need_ubyte = false, pass = true;
+	GLfloat *fpixels = NULL;
+	GLubyte *bpixels = NULL;
+	unsigned i;
+	int w, h;
+
+	for (i = 0; i < count; i++) {
+		const struct probe_batch_entry *p = &probes[i];
+
+		if (p->w <= 0 || p->h <= 0)
+			continue;
+
+		x0 = MIN2(x0, p->x);
+		y0 = MIN2(y0, p->y);
+		x1 = MAX2(x1, p->x + p->w);
+		y1 = MAX2(y1, p->y + p->h);
+
+		if (p->rect && ubyte_rects)
+			need_ubyte = true;
+		else
+			need_float = true;
+	}
+
+	if (!need_float && !need_ubyte)
+		return true;
+
+	w = x1 - x0;
+	h = y1 - y0;
+
+	if (need_float) {
+		fpixels = scratch_buffer(SCRATCH_PROBE_FLOAT,
+					 (size_t) w * h * 4 * sizeof(GLfloat));
+		piglit_read_pixels_float(x0, y0, w, h, GL_RGBA, fpixels);
+	}
+
+	if (need_ubyte) {
+		bpixels = scratch_buffer(SCRATCH_PROBE_UBYTE,
+					 (size_t) w * h * 4);
+		read_pixels(x0, y0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, bpixels);
+	}
+
+	for (i = 0; i < count; i++) {
+		const struct probe_batch_entry *p = &probes[i];
+		size_t offset = ((size_t) (p->y - y0) * w + (p->x - x0)) * 4;
+		bool ok;
+
+		if (p->w <= 0 || p->h <= 0)
+			continue;
+
+		if (p->rect && ubyte_rects) {
+			ok = compare_rect_ubyte(bpixels + offset, w,
+						p->x, p->y, p->w, p->h,
+						p->num_components,
+						p->expected, p->tolerance,
+						false, NULL, NULL);
+		} else {
+			ok = compare_rect_float(fpixels + offset, w,
+						p->x, p->y, p->w, p->h,
+						p->num_components,
+						p->expected, p->tolerance,
+						p->rect, false, NULL, NULL);
 		}
+
+		pass = pass && ok;
 	}
 
-	free(pixels);
-	return 1;
+	return pass;
+}
+
+bool
+piglit_probe_batch_flush(void)
+{
+	int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+	bool ubyte_rects = false, pass = true;
+	unsigned i;
+
+	if (probe_batch_count == 0)
+		return true;
+
+	for (i = 0; i < probe_batch_count; i++) {
+		const struct probe_batch_entry *p = &probe_batch[i];
+
+		x0 = MIN2(x0, p->x);
+		y0 = MIN2(y0, p->y);
+		x1 = MAX2(x1, p->x + p->w);
+		y1 = MAX2(y1, p->y + p->h);
+		if (p->rect)
+			ubyte_rects = true;
+	}
+
+	/* The same choice each rect probe would make on its own. */
+	if (ubyte_rects)
+		ubyte_rects = piglit_can_probe_ubyte();
+
+	if ((double) (x1 - x0) * (y1 - y0) <= PROBE_BATCH_MAX_PIXELS) {
+		pass = probe_batch_run(probe_batch, probe_batch_count,
+				       ubyte_rects);
+	} else {
+		for (i = 0; i < probe_batch_count; i++) {
+			bool ok = probe_batch_run(&probe_batch[i], 1,
+						  ubyte_rects);
+			pass = pass && ok;
+		}
+	}
+
+	probe_batch_count = 0;
+	return pass;
 }
 
 int
@@ -1431,7 +2257,7 @@ piglit_probe_rect_rgba_int(int x, int y, int w, int h, const int *expected)
 	GLint *probe;
 	GLint *pixels = malloc(w*h*4*sizeof(int));
 
-	glReadPixels(x, y, w, h, GL_RGBA_INTEGER, GL_INT, pixels);
+	read_pixels(x, y, w, h, GL_RGBA_INTEGER, GL_INT, pixels);
 
 	for (j = 0; j < h; j++) {
 		for (i = 0; i < w; i++) {
@@ -1464,7 +2290,7 @@ piglit_probe_rect_rgba_uint(int x, int y, int w, int h,
 	GLuint *probe;
 	GLuint *pixels = malloc(w*h*4*sizeof(unsigned int));
 
-	glReadPixels(x, y, w, h, GL_RGBA_INTEGER, GL_UNSIGNED_INT, pixels);
+	read_pixels(x, y, w, h, GL_RGBA_INTEGER, GL_UNSIGNED_INT, pixels);
 
 	for (j = 0; j < h; j++) {
 		for (i = 0; i < w; i++) {
@@ -1615,6 +2441,39 @@ piglit_compare_images_color(int x, int y, int w, int h, int num_components,
  * Compare the contents of the current read framebuffer with the given
  * in-memory floating-point image.
  */
+/**
+ * With golden hashes, hash an image comparison: the expected and the
+ * observed image, and the tolerance.  The key counts the comparisons
+ * made so far, which is the same on every run of a test.
+ *
+ * Returns true if the comparison can be skipped.  Otherwise, if \p *key
+ * is set, pass the outcome to piglit_golden_hash_update() and free it.
+ */
+static bool
+golden_hash_probe_image(const char *what, const void *expected,
+			const void *observed, size_t size,
+			const float *tolerance, char **key, uint64_t *hash)
+{
+	static unsigned count;
+
+	*key = NULL;
+	if (piglit_golden_hash_mode() == PIGLIT_GOLDEN_HASH_OFF)
+		return false;
+
+	*hash = piglit_hash_data(tolerance, 4 * sizeof(float), 0);
+	*hash = piglit_hash_data(expected, size, *hash);
+	*hash = piglit_hash_data(observed, size, *hash);
+
+	asprintf(key, "%s:%u", what, count++);
+	if (piglit_golden_hash_check(*key, *hash)) {
+		free(*key);
+		*key = NULL;
+		return true;
+	}
+
+	return false;
+}
+
 int
 piglit_probe_image_color(int x, int y, int w, int h, GLenum format,
 			 const float *image)
@@ -1622,6 +2481,8 @@ piglit_probe_image_color(int x, int y, int w, int h, GLenum format,
 	int c = piglit_num_components(format);
 	GLfloat *pixels;
 	float tolerance[4];
+	uint64_t hash;
+	char *key;
 	int result;
 
 	piglit_compute_probe_tolerance(format, tolerance);
@@ -1635,9 +2496,20 @@ piglit_probe_image_color(int x, int y, int w, int h, GLenum format,
 
 	pixels = piglit_read_pixels_float(x, y, w, h, format, NULL);
 
+	if (golden_hash_probe_image("probe_image_color", image, pixels,
+				    w * h * c * sizeof(float), tolerance,
+				    &key, &hash)) {
+		free(pixels);
+		return 1;
+	}
+
 	result = piglit_compare_images_color(x, y, w, h, c, tolerance, image,
 					     pixels);
 
+	if (key != NULL) {
+		piglit_golden_hash_update(key, hash, result);
+		free(key);
+	}
 	free(pixels);
 	return result;
 }
@@ -1759,7 +2631,7 @@ piglit_probe_image_stencil(int x, int y, int w, int h,
 	glGetIntegerv(GL_PACK_ALIGNMENT, &old_pack_alignment);
 	glPixelStorei(GL_PACK_ALIGNMENT, 1);
 
-	glReadPixels(x, y, w, h, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, pixels);
+	read_pixels(x, y, w, h, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, pixels);
 
 	glPixelStorei(GL_PACK_ALIGNMENT, old_pack_alignment);
 
@@ -1775,9 +2647,18 @@ piglit_probe_image_ubyte(int x, int y, int w, int h, GLenum format,
 {
 	const int c = piglit_num_components(format);
 	GLubyte *pixels = malloc(w * h * 4 * sizeof(GLubyte));
+	uint64_t hash;
+	char *key;
 	int i, j, p;
 
-	glReadPixels(x, y, w, h, format, GL_UNSIGNED_BYTE, pixels);
+	read_pixels(x, y, w, h, format, GL_UNSIGNED_BYTE, pixels);
+
+	if (golden_hash_probe_image("probe_image_ubyte", image, pixels,
+				    w * h * c, piglit_tolerance,
+				    &key, &hash)) {
+		free(pixels);
+		return 1;
+	}
 
 	for (j = 0; j < h; j++) {
 		for (i = 0; i < w; i++) {
@@ -1797,12 +2678,21 @@ piglit_probe_image_ubyte(int x, int y, int w, int h, GLenum format,
 				print_pixel_ubyte(probe, c);
 				printf("\n");
 
+				if (key != NULL) {
+					piglit_golden_hash_update(key, hash,
+								  false);
+					free(key);
+				}
 				free(pixels);
 				return 0;
 			}
 		}
 	}
 
+	if (key != NULL) {
+		piglit_golden_hash_update(key, hash, true);
+		free(key);
+	}
 	free(pixels);
 	return 1;
 }
@@ -1827,7 +2717,7 @@ int piglit_probe_texel_rect_rgb(int target, int level, int x, int y,
 	glGetTexLevelParameteriv(target, level, GL_TEXTURE_HEIGHT, &height);
 	buffer = malloc(width * height * 3 * sizeof(GLfloat));
 
-	glGetTexImage(target, level, GL_RGB, GL_FLOAT, buffer);
+	get_tex_image(target, level, GL_RGB, GL_FLOAT, buffer);
 
 	assert(x >= 0);
 	assert(y >= 0);
@@ -1890,7 +2780,7 @@ int piglit_probe_texel_rect_rgba(int target, int level, int x, int y,
 	glGetTexLevelParameteriv(target, level, GL_TEXTURE_HEIGHT, &height);
 	buffer = malloc(width * height * 4 * sizeof(GLfloat));
 
-	glGetTexImage(target, level, GL_RGBA, GL_FLOAT, buffer);
+	get_tex_image(target, level, GL_RGBA, GL_FLOAT, buffer);
 
 	assert(x >= 0);
 	assert(y >= 0);
@@ -1956,7 +2846,7 @@ int piglit_probe_texel_volume_rgba(int target, int level, int x, int y, int z,
 	glGetTexLevelParameteriv(target, level, GL_TEXTURE_DEPTH, &depth);
 	buffer = malloc(width * height * depth * 4 * sizeof(GLfloat));
 
-	glGetTexImage(target, level, GL_RGBA, GL_FLOAT, buffer);
+	get_tex_image(target, level, GL_RGBA, GL_FLOAT, buffer);
 
 	assert(x >= 0);
 	assert(y >= 0);
@@ -2002,7 +2892,7 @@ int piglit_probe_pixel_depth(int x, int y, float expected)
 	GLfloat probe;
 	GLfloat delta;
 
-	glReadPixels(x, y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &probe);
+	read_pixels(x, y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &probe);
 
 	delta = probe - expected;
 	if (fabs(delta) < 0.01)
@@ -2021,7 +2911,7 @@ int piglit_probe_rect_depth(int x, int y, int w, int h, float expected)
 	GLfloat *probe;
 	GLfloat *pixels = malloc(w*h*sizeof(float));
 
-	glReadPixels(x, y, w, h, GL_DEPTH_COMPONENT, GL_FLOAT, pixels);
+	read_pixels(x, y, w, h, GL_DEPTH_COMPONENT, GL_FLOAT, pixels);
 
 	for (j = 0; j < h; j++) {
 		for (i = 0; i < w; i++) {
@@ -2045,7 +2935,7 @@ int piglit_probe_rect_depth(int x, int y, int w, int h, float expected)
 int piglit_probe_pixel_stencil(int x, int y, unsigned expected)
 {
 	GLuint probe;
-	glReadPixels(x, y, 1, 1, GL_STENCIL_INDEX, GL_UNSIGNED_INT, &probe);
+	read_pixels(x, y, 1, 1, GL_STENCIL_INDEX, GL_UNSIGNED_INT, &probe);
 
 	if (probe == expected)
 		return 1;
@@ -2062,7 +2952,7 @@ int piglit_probe_rect_stencil(int x, int y, int w, int h, unsigned expected)
 	int i, j;
 	GLuint *pixels = malloc(w*h*sizeof(GLuint));
 
-	glReadPixels(x, y, w, h, GL_STENCIL_INDEX, GL_UNSIGNED_INT, pixels);
+	read_pixels(x, y, w, h, GL_STENCIL_INDEX, GL_UNSIGNED_INT, pixels);
 
 	for (j = 0; j < h; j++) {
 		for (i = 0; i < w; i++) {
@@ -2237,6 +3127,700 @@ piglit_draw_triangle_z(float z, float x1, float y1, float x2, float y2,
 	glDisableClientState(GL_VERTEX_ARRAY);
 }
 
+/**
+ * \name Test image cache
+ *
+ * The texture helpers below draw from a small set of patterns, which
+ * tests sweeping over formats ask for again and again with the same
+ * arguments.  So the images are generated straight into the client
+ * format and type they are uploaded with, one row at a time, and kept
+ * keyed by the generator, its arguments, the format and type, and the
+ * size, which also identifies the mipmap level.
+ *
+ * Once the cache holds IMAGE_CACHE_MAX_SIZE bytes, the images only the
+ * texture helpers have seen are dropped.  Images returned by the
+ * piglit_*_image_cached() functions are kept until
+ * piglit_free_image_cache(), since the caller may still hold them.
+ *
+ * Rows are padded to the default GL_UNPACK_ALIGNMENT of 4.
+ */
+/*@{*/
+
+enum image_generator {
+	IMAGE_RGBW,
+	IMAGE_CHECKERBOARD,
+	IMAGE_SOLID,
+	IMAGE_DEPTH_GRADIENT,
+};
+
+struct image_key {
+	enum image_generator generator;
+	GLenum format, type;
+	unsigned w, h;
+	unsigned params[3];
+	float colors[2][4];
+};
+
+struct cached_image {
+	struct image_key key;
+	unsigned serial;
+	size_t size;
+	void *data;
+
+	/* Returned by a piglit_*_image_cached() function */
+	bool pinned;
+};
+
+/* Past this many bytes of images, unpinned images are dropped. */
+#define IMAGE_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+static struct cached_image *image_cache;
+static unsigned image_cache_count, image_cache_capacity;
+
+/* Open-addressed index of image_cache, twice its capacity in size.
+ * Slots hold an index into image_cache plus one, or zero if empty.
+ */
+static unsigned *image_cache_slots;
+static size_t image_cache_size;
+static unsigned image_serial;
+
+/* -1 until the PIGLIT_TEXTURE_UPLOAD_PBO environment variable is read */
+static int upload_pbo_enabled = -1;
+static GLuint upload_pbo;
+static unsigned upload_pbo_serial;
+
+/* The caller's GL_PIXEL_UNPACK_BUFFER binding while the upload PBO is
+ * bound, or -1.
+ */
+static GLint upload_pbo_saved_binding = -1;
+
+static unsigned
+image_type_size(GLenum type)
+{
+	switch (type) {
+	case GL_BYTE:
+	case GL_UNSIGNED_BYTE:
+		return 1;
+	case GL_SHORT:
+	case GL_UNSIGNED_SHORT:
+	case GL_HALF_FLOAT:
+		return 2;
+	case GL_INT:
+	case GL_UNSIGNED_INT:
+	case GL_FLOAT:
+	case GL_UNSIGNED_INT_24_8:
+		return 4;
+	case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+		return 8;
+	default:
+		printf("Unsupported test image type %s\n",
+		       piglit_get_gl_enum_name(type));
+		piglit_report_result(PIGLIT_FAIL);
+		return 0;
+	}
+}
+
+static unsigned
+image_pixel_size(GLenum format, GLenum type)
+{
+	if (type == GL_UNSIGNED_INT_24_8 ||
+	    type == GL_FLOAT_32_UNSIGNED_INT_24_8_REV)
+		return image_type_size(type);
+
+	return piglit_num_components(format) * image_type_size(type);
+}
+
+static size_t
+image_row_stride(const struct image_key *key)
+{
+	return ALIGN(key->w * image_pixel_size(key->format, key->type), 4);
+}
+
+/**
+ * Convert an RGBA color to a single pixel of the given format and type,
+ * as glTexImage would convert it back.
+ */
+static void
+pack_color(const float *color, GLenum format, GLenum type, void *pixel)
+{
+	static const unsigned rgba[] = { 0, 1, 2, 3 };
+	static const unsigned bgra[] = { 2, 1, 0, 3 };
+	static const unsigned red[] = { 0 }, green[] = { 1 }, blue[] = { 2 };
+	static const unsigned alpha[] = { 3 }, la[] = { 0, 3 };
+	const unsigned *order;
+	unsigned i, n = piglit_num_components(format);
+
+	switch (format) {
+	case GL_BGR:
+	case GL_BGRA:
+		order = bgra;
+		break;
+	case GL_GREEN:
+		order = green;
+		break;
+	case GL_BLUE:
+		order = blue;
+		break;
+	case GL_ALPHA:
+		order = alpha;
+		break;
+	case GL_LUMINANCE_ALPHA:
+		order = la;
+		break;
+	case GL_RED:
+	case GL_LUMINANCE:
+	case GL_INTENSITY:
+	case GL_DEPTH_COMPONENT:
+		order = red;
+		break;
+	default:
+		order = rgba;
+		break;
+	}
+
+	for (i = 0; i < n; i++) {
+		float c = color[order[i]];
+
+		switch (type) {
+		case GL_FLOAT:
+			((GLfloat *) pixel)[i] = c;
+			break;
+		case GL_HALF_FLOAT:
+			((GLushort *) pixel)[i] = piglit_half_from_float(c);
+			break;
+		case GL_UNSIGNED_BYTE:
+			((GLubyte *) pixel)[i] = CLAMP(c, 0.0f, 1.0f) * 255.0f
+				+ 0.5f;
+			break;
+		case GL_BYTE:
+			((GLbyte *) pixel)[i] = lroundf(CLAMP(c, -1.0f, 1.0f) *
+							127.0f);
+			break;
+		case GL_UNSIGNED_SHORT:
+			((GLushort *) pixel)[i] = CLAMP(c, 0.0f, 1.0f) *
+				65535.0f + 0.5f;
+			break;
+		case GL_SHORT:
+			((GLshort *) pixel)[i] = lroundf(CLAMP(c, -1.0f, 1.0f) *
+							 32767.0f);
+			break;
+		case GL_UNSIGNED_INT:
+			((GLuint *) pixel)[i] = CLAMP(c, 0.0, 1.0) *
+				4294967295.0 + 0.5;
+			break;
+		case GL_INT:
+			((GLint *) pixel)[i] = lround(CLAMP(c, -1.0, 1.0) *
+						      2147483647.0);
+			break;
+		default:
+			image_type_size(type);
+			break;
+		}
+	}
+}
+
+/**
+ * Fill count pixels at dst with copies of the pixel_size bytes at
+ * pixel, doubling the filled span with each copy.
+ */
+static void
+fill_pixels(char *dst, const void *pixel, unsigned pixel_size, unsigned count)
+{
+	const size_t size = (size_t) pixel_size * count;
+	size_t filled = MIN2(pixel_size, size);
+
+	memcpy(dst, pixel, filled);
+	while (filled < size) {
+		const size_t n = MIN2(filled, size - filled);
+
+		memcpy(dst + filled, dst, n);
+		filled += n;
+	}
+}
+
+/**
+ * Fill count pixels at dst with the pixel for color.
+ */
+static void
+fill_color(char *dst, const float *color, GLenum format, GLenum type,
+	   unsigned count)
+{
+	char pixel[32];
+
+	pack_color(color, format, type, pixel);
+	fill_pixels(dst, pixel, image_pixel_size(format, type), count);
+}
+
+/**
+ * Copy the row at src to the count rows that follow it.
+ */
+static void
+copy_row(char *src, size_t stride, unsigned count)
+{
+	unsigned i;
+
+	for (i = 1; i <= count; i++)
+		memcpy(src + i * stride, src, stride);
+}
+
+/**
+ * The colors of the red, green, blue and white quadrants of
+ * piglit_rgbw_image().
+ */
+static void
+rgbw_colors(GLboolean alpha, GLenum basetype, float colors[4][4])
+{
+	static const float unorm[4][4] = {
+		{1.0, 0.0, 0.0, 0.0},
+		{0.0, 1.0, 0.0, 0.25},
+		{0.0, 0.0, 1.0, 0.5},
+		{1.0, 1.0, 1.0, 1.0},
+	};
+	int i, j;
+
+	memcpy(colors, unorm, sizeof(unorm));
+	for (i = 0; i < 4; i++) {
+		if (!alpha)
+			colors[i][3] = 1.0;
+
+		for (j = 0; j < 4; j++) {
+			switch (basetype) {
+			case GL_UNSIGNED_NORMALIZED:
+				break;
+			case GL_SIGNED_NORMALIZED:
+				colors[i][j] = colors[i][j] * 2 - 1;
+				break;
+			case GL_FLOAT:
+				colors[i][j] = colors[i][j] * 10 - 5;
+				break;
+			default:
+				assert(0);
+			}
+		}
+	}
+}
+
+/**
+ * Whether piglit_rgbw_image() makes the small levels of internalFormat
+ * a single color, rather than quadrants that split its blocks.
+ */
+static bool
+rgbw_is_blocky(GLenum internalFormat)
+{
+	switch (internalFormat) {
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RGB_FXT1_3DFX:
+	case GL_COMPRESSED_RGBA_FXT1_3DFX:
+	case GL_COMPRESSED_RED_RGTC1:
+	case GL_COMPRESSED_SIGNED_RED_RGTC1:
+	case GL_COMPRESSED_RG_RGTC2:
+	case GL_COMPRESSED_SIGNED_RG_RGTC2:
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+	case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+	case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void
+generate_rgbw(const struct image_key *key, char *data)
+{
+	const unsigned size = MAX2(key->w, key->h);
+	const size_t stride = image_row_stride(key);
+	const unsigned pixel_size = image_pixel_size(key->format, key->type);
+	const unsigned left = key->w / 2, top = key->h / 2;
+	float colors[4][4];
+	int i;
+
+	rgbw_colors(key->params[0], key->params[1], colors);
+
+	/* Whole levels of one color for small compressed images */
+	if (key->params[2] && size <= 4 && (size & (size - 1)) == 0 &&
+	    size != 0) {
+		i = size == 4 ? 0 : size == 2 ? 1 : 2;
+		fill_color(data, colors[i], key->format, key->type, key->w);
+		copy_row(data, stride, key->h - 1);
+		return;
+	}
+
+	for (i = 0; i < 2; i++) {
+		char *row = data + (i ? top : 0) * stride;
+		const unsigned rows = i ? key->h - top : top;
+
+		if (rows == 0)
+			continue;
+
+		fill_color(row, colors[2 * i], key->format, key->type, left);
+		fill_color(row + left * pixel_size, colors[2 * i + 1],
+			   key->format, key->type, key->w - left);
+		copy_row(row, stride, rows - 1);
+	}
+}
+
+static void
+generate_checkerboard(const struct image_key *key, char *data)
+{
+	const unsigned horiz_square_size = key->params[0];
+	const unsigned vert_square_size = key->params[1];
+	const size_t stride = image_row_stride(key);
+	const unsigned pixel_size = image_pixel_size(key->format, key->type);
+	unsigned y, x;
+
+	/* Build the rows that start with a black and a white square,
+	 * then copy them down the image.
+	 */
+	for (y = 0; y < MIN2(2 * vert_square_size, key->h);
+	     y += vert_square_size) {
+		char *row = data + y * stride;
+		const unsigned rows = MIN2(vert_square_size, key->h - y);
+
+		for (x = 0; x < key->w; x += horiz_square_size) {
+			const unsigned square = (y / vert_square_size) ^
+				(x / horiz_square_size);
+
+			fill_color(row + x * pixel_size,
+				   key->colors[square & 1],
+				   key->format, key->type,
+				   MIN2(horiz_square_size, key->w - x));
+		}
+		copy_row(row, stride, rows - 1);
+	}
+	for (; y < key->h; y++)
+		memcpy(data + y * stride,
+		       data + (y % (2 * vert_square_size)) * stride, stride);
+}
+
+static void
+generate_depth_gradient(const struct image_key *key, char *data)
+{
+	const size_t stride = image_row_stride(key);
+	unsigned x;
+
+	for (x = 0; x < key->w; x++) {
+		float val = (float)(x) / (key->w - 1);
+
+		if (key->type == GL_FLOAT)
+			((float *) data)[x] = val;
+		else if (key->type == GL_FLOAT_32_UNSIGNED_INT_24_8_REV)
+			((float *) data)[x * 2] = val;
+		else
+			((unsigned *) data)[x] = 0xffffff00 * val;
+	}
+	copy_row(data, stride, key->h - 1);
+}
+
+static void
+generate_image(const struct image_key *key, char *data)
+{
+	if (key->w == 0 || key->h == 0)
+		return;
+
+	switch (key->generator) {
+	case IMAGE_RGBW:
+		generate_rgbw(key, data);
+		break;
+	case IMAGE_CHECKERBOARD:
+		generate_checkerboard(key, data);
+		break;
+	case IMAGE_SOLID:
+		fill_color(data, key->colors[0], key->format, key->type,
+			   key->w);
+		copy_row(data, image_row_stride(key), key->h - 1);
+		break;
+	case IMAGE_DEPTH_GRADIENT:
+		generate_depth_gradient(key, data);
+		break;
+	}
+}
+
+static void
+init_image_key(struct image_key *key, enum image_generator generator,
+	       GLenum format, GLenum type, unsigned w, unsigned h)
+{
+	/* Keys are compared with memcmp(), padding and all */
+	memset(key, 0, sizeof(*key));
+	key->generator = generator;
+	key->format = format;
+	key->type = type;
+	key->w = w;
+	key->h = h;
+}
+
+static unsigned
+hash_image_key(const struct image_key *key)
+{
+	const unsigned char *bytes = (const unsigned char *) key;
+	uint32_t hash = 2166136261u;
+	unsigned i;
+
+	/* FNV-1a */
+	for (i = 0; i < sizeof(*key); i++)
+		hash = (hash ^ bytes[i]) * 16777619u;
+
+	return hash;
+}
+
+/**
+ * Find the slot of image_cache_slots that holds key, or the empty slot
+ * it would go in.
+ */
+static unsigned *
+find_image_slot(const struct image_key *key)
+{
+	const unsigned mask = image_cache_capacity * 2 - 1;
+	unsigned i = hash_image_key(key) & mask;
+
+	while (image_cache_slots[i] != 0 &&
+	       memcmp(&image_cache[image_cache_slots[i] - 1].key, key,
+		      sizeof(*key)) != 0)
+		i = (i + 1) & mask;
+
+	return &image_cache_slots[i];
+}
+
+/**
+ * Free the images that are not pinned, and index the rest again.
+ */
+static void
+evict_image_cache(void)
+{
+	unsigned i, kept = 0;
+
+	for (i = 0; i < image_cache_count; i++) {
+		if (image_cache[i].pinned) {
+			image_cache[kept++] = image_cache[i];
+		} else {
+			image_cache_size -= image_cache[i].size;
+			free(image_cache[i].data);
+		}
+	}
+	image_cache_count = kept;
+
+	memset(image_cache_slots, 0, image_cache_capacity * 2 *
+	       sizeof(*image_cache_slots));
+	for (i = 0; i < image_cache_count; i++)
+		*find_image_slot(&image_cache[i].key) = i + 1;
+}
+
+static struct cached_image *
+get_cached_image(const struct image_key *key)
+{
+	struct cached_image *image;
+	unsigned *slot;
+	unsigned i;
+
+	if (image_cache_count != 0) {
+		slot = find_image_slot(key);
+		if (*slot != 0)
+			return &image_cache[*slot - 1];
+	}
+
+	if (image_cache_size > IMAGE_CACHE_MAX_SIZE)
+		evict_image_cache();
+
+	if (image_cache_count == image_cache_capacity) {
+		image_cache_capacity = MAX2(16, image_cache_capacity * 2);
+		image_cache = realloc(image_cache, image_cache_capacity *
+				      sizeof(*image_cache));
+		free(image_cache_slots);
+		image_cache_slots = calloc(image_cache_capacity * 2,
+					   sizeof(*image_cache_slots));
+		for (i = 0; i < image_cache_count; i++)
+			*find_image_slot(&image_cache[i].key) = i + 1;
+	}
+
+	slot = find_image_slot(key);
+	*slot = image_cache_count + 1;
+	image = &image_cache[image_cache_count++];
+	image->key = *key;
+	image->serial = ++image_serial;
+	image->size = image_row_stride(key) * key->h;
+	image->data = calloc(1, MAX2(image->size, 1));
+	image->pinned = false;
+	image_cache_size += image->size;
+
+	generate_image(key, image->data);
+
+	return image;
+}
+
+/**
+ * Free the images returned by the piglit_*_image_cached() functions.
+ */
+void
+piglit_free_image_cache(void)
+{
+	unsigned i;
+
+	for (i = 0; i < image_cache_count; i++)
+		free(image_cache[i].data);
+	if (image_cache_slots != NULL)
+		memset(image_cache_slots, 0, image_cache_capacity * 2 *
+		       sizeof(*image_cache_slots));
+	image_cache_count = 0;
+	image_cache_size = 0;
+}
+
+/**
+ * Have the texture helpers upload their images through a pixel buffer
+ * object, which is kept and reused, rather than from client memory.
+ * Uploading the same image again then doesn't copy it at all.
+ *
+ * The default comes from the PIGLIT_TEXTURE_UPLOAD_PBO environment
+ * variable.
+ */
+void
+piglit_set_texture_upload_pbo(bool enable)
+{
+	upload_pbo_enabled = enable;
+}
+
+static bool
+use_upload_pbo(void)
+{
+	if (upload_pbo_enabled == -1) {
+		const char *env = getenv("PIGLIT_TEXTURE_UPLOAD_PBO");
+
+		upload_pbo_enabled = env != NULL && strcmp(env, "0") != 0;
+	}
+
+	return upload_pbo_enabled &&
+		(piglit_get_gl_version() >= (piglit_is_gles() ? 30 : 21) ||
+		 piglit_is_extension_supported("GL_ARB_pixel_buffer_object"));
+}
+
+/**
+ * Get the pointer to pass to glTexImage to upload image, binding the
+ * upload PBO if it is used.  Call finish_image_upload() afterwards, to
+ * restore the caller's binding.
+ */
+static const void *
+start_image_upload(const struct cached_image *image)
+{
+	if (!use_upload_pbo())
+		return image->data;
+
+	if (upload_pbo == 0) {
+		glGenBuffers(1, &upload_pbo);
+		upload_pbo_serial = 0;
+	}
+	if (upload_pbo_saved_binding == -1) {
+		glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING,
+			      &upload_pbo_saved_binding);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_pbo);
+	if (upload_pbo_serial != image->serial) {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, image->size, image->data,
+			     GL_STATIC_DRAW);
+		upload_pbo_serial = image->serial;
+	}
+
+	return NULL;
+}
+
+static void
+finish_image_upload(void)
+{
+	if (upload_pbo_saved_binding != -1) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_pbo_saved_binding);
+		upload_pbo_saved_binding = -1;
+	}
+}
+
+static struct cached_image *
+get_rgbw_image(GLenum internalFormat, int w, int h, GLboolean alpha,
+	       GLenum basetype, GLenum format, GLenum type)
+{
+	struct image_key key;
+
+	init_image_key(&key, IMAGE_RGBW, format, type, w, h);
+	key.params[0] = alpha;
+	key.params[1] = basetype;
+	key.params[2] = rgbw_is_blocky(internalFormat);
+
+	return get_cached_image(&key);
+}
+
+/**
+ * Like piglit_rgbw_image(), but in the given client format and type,
+ * and owned by the image cache.  The image stays valid until
+ * piglit_free_image_cache().
+ */
+const void *
+piglit_rgbw_image_cached(GLenum internalFormat, int w, int h,
+			 GLboolean alpha, GLenum basetype,
+			 GLenum format, GLenum type)
+{
+	struct cached_image *image =
+		get_rgbw_image(internalFormat, w, h, alpha, basetype,
+			       format, type);
+
+	image->pinned = true;
+	return image->data;
+}
+
+static struct cached_image *
+get_checkerboard_image(unsigned width, unsigned height,
+		       unsigned horiz_square_size, unsigned vert_square_size,
+		       const float *black, const float *white,
+		       GLenum format, GLenum type)
+{
+	struct image_key key;
+
+	init_image_key(&key, IMAGE_CHECKERBOARD, format, type, width, height);
+	key.params[0] = horiz_square_size;
+	key.params[1] = vert_square_size;
+	memcpy(key.colors[0], black, sizeof(key.colors[0]));
+	memcpy(key.colors[1], white, sizeof(key.colors[1]));
+
+	return get_cached_image(&key);
+}
+
+/**
+ * The image of piglit_checkerboard_texture(), in the given client
+ * format and type, and owned by the image cache.  The image stays valid
+ * until piglit_free_image_cache().
+ */
+const void *
+piglit_checkerboard_image_cached(unsigned width, unsigned height,
+				 unsigned horiz_square_size,
+				 unsigned vert_square_size,
+				 const float *black, const float *white,
+				 GLenum format, GLenum type)
+{
+	struct cached_image *image =
+		get_checkerboard_image(width, height, horiz_square_size,
+				       vert_square_size, black, white,
+				       format, type);
+
+	image->pinned = true;
+	return image->data;
+}
+
+static const struct cached_image *
+get_solid_image(const float *color, unsigned w, unsigned h,
+		GLenum format, GLenum type)
+{
+	struct image_key key;
+
+	init_image_key(&key, IMAGE_SOLID, format, type, w, h);
+	memcpy(key.colors[0], color, sizeof(key.colors[0]));
+
+	return get_cached_image(&key);
+}
+
+/*@}*/
+
 /**
  * Generate a checkerboard texture
  *
@@ -2276,44 +3860,11 @@ piglit_checkerboard_texture(GLuint tex, unsigned level,
 			    const float *black, const float *white)
 {
 	static const GLfloat border_color[4] = { 1.0, 0.0, 0.0, 1.0 };
-	unsigned i;
-	unsigned j;
-	void *tex_data;
-	char *texel;
-	unsigned pixel_size;
-	GLubyte black_b[4], white_b[4];
-	const void *black_data, *white_data;
-
-	if (piglit_is_gles()) {
-		pixel_size = 4 * sizeof(GLubyte);
-		for (i = 0; i < 4; i++) {
-			black_b[i] = black[i] * 255;
-			white_b[i] = white[i] * 255;
-		}
-		black_data = black_b;
-		white_data = white_b;
-	} else {
-		pixel_size = 4 * sizeof(float);
-		black_data = black;
-		white_data = white;
-	}
-	texel = tex_data = malloc(width * height * pixel_size);
-
-	for (i = 0; i < height; i++) {
-		const unsigned row = i / vert_square_size;
-
-		for (j = 0; j < width; j++) {
-			const unsigned col = j / horiz_square_size;
-
-			if ((row ^ col) & 1) {
-				memcpy(texel, white_data, pixel_size);
-			} else {
-				memcpy(texel, black_data, pixel_size);
-			}
-
-			texel += pixel_size;
-		}
-	}
+	const GLenum type = piglit_is_gles() ? GL_UNSIGNED_BYTE : GL_FLOAT;
+	const struct cached_image *image =
+		get_checkerboard_image(width, height, horiz_square_size,
+				       vert_square_size, black, white,
+				       GL_RGBA, type);
 
 	if (tex == 0) {
 		glGenTextures(1, &tex);
@@ -2342,7 +3893,8 @@ piglit_checkerboard_texture(GLuint tex, unsigned level,
 	}
 
 	glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, width, height, 0, GL_RGBA,
-		     piglit_is_gles() ? GL_UNSIGNED_BYTE : GL_FLOAT, tex_data);
+		     type, start_image_upload(image));
+	finish_image_upload();
 
 	return tex;
 }
@@ -2353,8 +3905,8 @@ piglit_checkerboard_texture(GLuint tex, unsigned level,
 GLuint
 piglit_miptree_texture()
 {
-	GLfloat *data;
-	int size, i, level;
+	const struct cached_image *image;
+	int size, level;
 	GLuint tex;
 
 	glGenTextures(1, &tex);
@@ -2368,14 +3920,12 @@ piglit_miptree_texture()
 	for (level = 0; level < 4; ++level) {
 		size = 8 >> level;
 
-		data = malloc(size*size*4*sizeof(GLfloat));
-		for (i = 0; i < size * size; ++i) {
-			memcpy(data + 4 * i, color_wheel[level],
-			       4 * sizeof(GLfloat));
-		}
+		image = get_solid_image(color_wheel[level], size, size,
+					GL_RGBA, GL_FLOAT);
 		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA,
-			     size, size, 0, GL_RGBA, GL_FLOAT, data);
-		free(data);
+			     size, size, 0, GL_RGBA, GL_FLOAT,
+			     start_image_upload(image));
+		finish_image_upload();
 	}
 	return tex;
 }
@@ -2398,96 +3948,14 @@ GLfloat *
 piglit_rgbw_image(GLenum internalFormat, int w, int h,
 		  GLboolean alpha, GLenum basetype)
 {
-	float red[4]   = {1.0, 0.0, 0.0, 0.0};
-	float green[4] = {0.0, 1.0, 0.0, 0.25};
-	float blue[4]  = {0.0, 0.0, 1.0, 0.5};
-	float white[4] = {1.0, 1.0, 1.0, 1.0};
-	GLfloat *data;
-	int x, y;
-
-	if (!alpha) {
-		red[3] = 1.0;
-		green[3] = 1.0;
-		blue[3] = 1.0;
-		white[3] = 1.0;
-	}
-
-	switch (basetype) {
-	case GL_UNSIGNED_NORMALIZED:
-		break;
-
-	case GL_SIGNED_NORMALIZED:
-		for (x = 0; x < 4; x++) {
-			red[x] = red[x] * 2 - 1;
-			green[x] = green[x] * 2 - 1;
-			blue[x] = blue[x] * 2 - 1;
-			white[x] = white[x] * 2 - 1;
-		}
-		break;
-
-	case GL_FLOAT:
-		for (x = 0; x < 4; x++) {
-			red[x] = red[x] * 10 - 5;
-			green[x] = green[x] * 10 - 5;
-			blue[x] = blue[x] * 10 - 5;
-			white[x] = white[x] * 10 - 5;
-		}
-		break;
-
-	default:
-		assert(0);
-	}
-
-	data = malloc(w * h * 4 * sizeof(GLfloat));
-
-	for (y = 0; y < h; y++) {
-		for (x = 0; x < w; x++) {
-			const int size = w > h ? w : h;
-			const float *color;
-
-			if (x < w / 2 && y < h / 2)
-				color = red;
-			else if (y < h / 2)
-				color = green;
-			else if (x < w / 2)
-				color = blue;
-			else
-				color = white;
-
-			switch (internalFormat) {
-			case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
-			case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
-			case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
-			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
-			case GL_COMPRESSED_RGB_FXT1_3DFX:
-			case GL_COMPRESSED_RGBA_FXT1_3DFX:
-			case GL_COMPRESSED_RED_RGTC1:
-			case GL_COMPRESSED_SIGNED_RED_RGTC1:
-			case GL_COMPRESSED_RG_RGTC2:
-			case GL_COMPRESSED_SIGNED_RG_RGTC2:
-			case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
-			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
-			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
-			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
-			case GL_COMPRESSED_RGBA_BPTC_UNORM:
-			case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
-			case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
-			case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
-				if (size == 4)
-					color = red;
-				else if (size == 2)
-					color = green;
-				else if (size == 1)
-					color = blue;
-				break;
-			default:
-				break;
-			}
+	struct image_key key;
+	GLfloat *data = malloc(w * h * 4 * sizeof(GLfloat));
 
-			memcpy(data + (y * w + x) * 4, color,
-			       4 * sizeof(float));
-		}
-	}
+	init_image_key(&key, IMAGE_RGBW, GL_RGBA, GL_FLOAT, w, h);
+	key.params[0] = alpha;
+	key.params[1] = basetype;
+	key.params[2] = rgbw_is_blocky(internalFormat);
+	generate_image(&key, (char *) data);
 
 	return data;
 }
@@ -2495,39 +3963,13 @@ piglit_rgbw_image(GLenum internalFormat, int w, int h,
 GLubyte *
 piglit_rgbw_image_ubyte(int w, int h, GLboolean alpha)
 {
-	GLubyte red[4]   = {255, 0, 0, 0};
-	GLubyte green[4] = {0, 255, 0, 64};
-	GLubyte blue[4]  = {0, 0, 255, 128};
-	GLubyte white[4] = {255, 255, 255, 255};
-	GLubyte *data;
-	int x, y;
-
-	if (!alpha) {
-		red[3] = 255;
-		green[3] = 255;
-		blue[3] = 255;
-		white[3] = 255;
-	}
+	struct image_key key;
+	GLubyte *data = malloc(w * h * 4 * sizeof(GLubyte));
 
-	data = malloc(w * h * 4 * sizeof(GLubyte));
-
-	for (y = 0; y < h; y++) {
-		for (x = 0; x < w; x++) {
-			const GLubyte *color;
-
-			if (x < w / 2 && y < h / 2)
-				color = red;
-			else if (y < h / 2)
-				color = green;
-			else if (x < w / 2)
-				color = blue;
-			else
-				color = white;
-
-			memcpy(data + (y * w + x) * 4, color,
-			       4 * sizeof(GLubyte));
-		}
-	}
+	init_image_key(&key, IMAGE_RGBW, GL_RGBA, GL_UNSIGNED_BYTE, w, h);
+	key.params[0] = alpha;
+	key.params[1] = GL_UNSIGNED_NORMALIZED;
+	generate_image(&key, (char *) data);
 
 	return data;
 }
@@ -2547,6 +3989,7 @@ piglit_rgbw_texture(GLenum internalFormat, int w, int h, GLboolean mip,
 	int size, level;
 	GLuint tex;
 	GLenum teximage_type;
+	GLenum image_format = internalFormat;
 
 	switch (basetype) {
 	case GL_UNSIGNED_NORMALIZED:
@@ -2556,6 +3999,9 @@ piglit_rgbw_texture(GLenum internalFormat, int w, int h, GLboolean mip,
 		break;
 	case GL_UNSIGNED_BYTE:
 		teximage_type = GL_UNSIGNED_BYTE;
+		basetype = GL_UNSIGNED_NORMALIZED;
+		/* The ubyte image has no whole-level colors */
+		image_format = GL_RGBA;
 		break;
 	default:
 		assert(0);
@@ -2579,19 +4025,16 @@ piglit_rgbw_texture(GLenum internalFormat, int w, int h, GLboolean mip,
 	}
 
 	for (level = 0, size = w > h ? w : h; size > 0; level++, size >>= 1) {
-		void *data;
-
-		if (teximage_type == GL_UNSIGNED_BYTE)
-			data = piglit_rgbw_image_ubyte(w, h, alpha);
-		else
-			data = piglit_rgbw_image(internalFormat, w, h,
-			                         alpha, basetype);
+		const struct cached_image *image =
+			get_rgbw_image(image_format, w, h, alpha, basetype,
+				       GL_RGBA, teximage_type);
 
 		glTexImage2D(GL_TEXTURE_2D, level,
 			     internalFormat,
 			     w, h, 0,
-			     GL_RGBA, teximage_type, data);
-		free(data);
+			     GL_RGBA, teximage_type,
+			     start_image_upload(image));
+		finish_image_upload();
 
 		if (!mip)
 			break;
@@ -2658,10 +4101,9 @@ GLuint piglit_integer_texture(GLenum internalFormat, int w, int h, int b, int a)
 GLuint
 piglit_depth_texture(GLenum target, GLenum internalformat, int w, int h, int d, GLboolean mip)
 {
-	void *data;
-	float *f = NULL, *f2 = NULL;
-	unsigned int  *i = NULL;
-	int size, x, y, level, layer;
+	const struct cached_image *image;
+	const void *data;
+	int size, level, layer;
 	GLuint tex;
 	GLenum type, format;
 
@@ -2680,38 +4122,28 @@ piglit_depth_texture(GLenum target, GLenum internalformat, int w, int h, int d,
 		glTexParameteri(target, GL_TEXTURE_MIN_FILTER,
 				GL_NEAREST);
 	}
-	data = malloc(w * h * 4 * sizeof(GLfloat));
-
 	if (internalformat == GL_DEPTH_STENCIL_EXT ||
 	    internalformat == GL_DEPTH24_STENCIL8_EXT) {
 		format = GL_DEPTH_STENCIL_EXT;
 		type = GL_UNSIGNED_INT_24_8_EXT;
-		i = data;
 	} else if (internalformat == GL_DEPTH32F_STENCIL8) {
 		format = GL_DEPTH_STENCIL;
 		type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
-		f2 = data;
 	} else {
 		format = GL_DEPTH_COMPONENT;
 		type = GL_FLOAT;
-		f = data;
 	}
 
 	for (level = 0, size = w > h ? w : h; size > 0; level++, size >>= 1) {
-		for (y = 0; y < h; y++) {
-			for (x = 0; x < w; x++) {
-				float val = (float)(x) / (w - 1);
-				if (f)
-					f[y * w + x] = val;
-				else if (f2)
-					f2[(y * w + x)*2] = val;
-				else
-					i[y * w + x] = 0xffffff00 * val;
-			}
-		}
+		struct image_key key;
+
+		init_image_key(&key, IMAGE_DEPTH_GRADIENT, format, type,
+			       w, h);
+		image = get_cached_image(&key);
 
 		switch (target) {
 		case GL_TEXTURE_1D:
+			data = start_image_upload(image);
 			glTexImage1D(target, level,
 				     internalformat,
 				     w, 0,
@@ -2721,6 +4153,7 @@ piglit_depth_texture(GLenum target, GLenum internalformat, int w, int h, int d,
 		case GL_TEXTURE_1D_ARRAY:
 		case GL_TEXTURE_2D:
 		case GL_TEXTURE_RECTANGLE:
+			data = start_image_upload(image);
 			glTexImage2D(target, level,
 				     internalformat,
 				     w, h, 0,
@@ -2732,6 +4165,7 @@ piglit_depth_texture(GLenum target, GLenum internalformat, int w, int h, int d,
 				     internalformat,
 				     w, h, d, 0,
 				     format, type, NULL);
+			data = start_image_upload(image);
 			for (layer = 0; layer < d; layer++) {
 				glTexSubImage3D(target, level,
 						0, 0, layer, w, h, 1,
@@ -2742,6 +4176,7 @@ piglit_depth_texture(GLenum target, GLenum internalformat, int w, int h, int d,
 		default:
 			assert(0);
 		}
+		finish_image_upload();
 
 		if (!mip)
 			break;
@@ -2753,7 +4188,6 @@ piglit_depth_texture(GLenum target, GLenum internalformat, int w, int h, int d,
 		    h > 1)
 			h >>= 1;
 	}
-	free(data);
 	return tex;
 }
 
@@ -2765,8 +4199,8 @@ GLuint
 piglit_array_texture(GLenum target, GLenum internalformat,
 		     int w, int h, int d, GLboolean mip)
 {
-	float *data;
-	int size, i, level, layer;
+	const struct cached_image *image;
+	int size, level, layer;
 	GLuint tex;
 	GLenum type = GL_FLOAT, format = GL_RGBA;
 
@@ -2792,8 +4226,6 @@ piglit_array_texture(GLenum target, GLenum internalformat,
 		glTexParameteri(target, GL_TEXTURE_MIN_FILTER,
 				GL_NEAREST);
 	}
-	data = malloc(w * h * 4 * sizeof(GLfloat));
-
 	size = w > h ? w : h;
 
 	for (level = 0; size > 0; level++, size >>= 1) {
@@ -2810,23 +4242,23 @@ piglit_array_texture(GLenum target, GLenum internalformat,
 
 		for (layer = 0; layer < d; layer++) {
 			/* Set whole layer to one color */
-			for (i = 0; i < w * h; i++) {
-				memcpy(data + 4 * i,
-				       color_wheel[layer %
-						   ARRAY_SIZE(color_wheel)],
-				       sizeof(color_wheel[0]));
-			}
+			image = get_solid_image(color_wheel[layer %
+						ARRAY_SIZE(color_wheel)],
+						w, h, format, type);
 
 			if (target == GL_TEXTURE_1D_ARRAY) {
 				glTexSubImage2D(target, level,
 						0, layer, w, 1,
-						format, type, data);
+						format, type,
+						start_image_upload(image));
 			}
 			else {
 				glTexSubImage3D(target, level,
 						0, 0, layer, w, h, 1,
-						format, type, data);
+						format, type,
+						start_image_upload(image));
 			}
+			finish_image_upload();
 		}
 
 		if (!mip)
@@ -2837,7 +4269,6 @@ piglit_array_texture(GLenum target, GLenum internalformat,
 		if (h > 1)
 			h >>= 1;
 	}
-	free(data);
 	return tex;
 }
 
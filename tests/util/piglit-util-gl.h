@@ -41,6 +41,7 @@ extern "C" {
 
 #include "piglit-framework-gl.h"
 #include "piglit-shader.h"
+#include "piglit-program-cache.h"
 
 extern const uint8_t fdo_bitmap[];
 extern const unsigned int fdo_bitmap_width;
@@ -71,6 +72,12 @@ int piglit_get_gl_version(void);
  */
 bool piglit_is_extension_supported(const char *name);
 
+/**
+ * Like piglit_is_extension_supported(), for an extension in the GL
+ * registry.  This is a single bit test.
+ */
+bool piglit_is_extension_id_supported(enum piglit_extension_id id);
+
 /**
  * reinitialize the supported extension List.
  */
@@ -142,6 +149,7 @@ void piglit_require_extension(const char *name);
 void piglit_require_not_extension(const char *name);
 unsigned piglit_num_components(GLenum format);
 bool piglit_get_luminance_intensity_bits(GLenum internalformat, int *bits);
+bool piglit_can_probe_ubyte(void);
 int piglit_probe_pixel_rgb_silent(int x, int y, const float* expected, float *out_probe);
 int piglit_probe_pixel_rgba_silent(int x, int y, const float* expected, float *out_probe);
 int piglit_probe_pixel_rgb(int x, int y, const float* expected);
@@ -154,6 +162,32 @@ int piglit_probe_rect_rgba_int(int x, int y, int w, int h, const int* expected);
 int piglit_probe_rect_rgba_uint(int x, int y, int w, int h, const unsigned int* expected);
 void piglit_compute_probe_tolerance(GLenum format, float *tolerance);
 
+enum piglit_probe_backend {
+	PIGLIT_PROBE_BACKEND_CPU,
+	PIGLIT_PROBE_BACKEND_GPU,
+	PIGLIT_PROBE_BACKEND_CHECK,
+};
+
+void piglit_set_probe_backend(enum piglit_probe_backend backend);
+
+/**
+ * Batched probes.
+ *
+ * The piglit_probe_batch_*() functions queue a probe that behaves like the
+ * matching piglit_probe_pixel_*() or piglit_probe_rect_*() call, using the
+ * value of piglit_tolerance at the time it is queued.  Nothing is read until
+ * piglit_probe_batch_flush(), which reads the bounding box of all queued
+ * probes back once, checks each probe in order, printing failures exactly
+ * like the unbatched probes, and empties the queue.
+ *
+ * \return false from piglit_probe_batch_flush() if any probe failed.
+ */
+void piglit_probe_batch_pixel_rgb(int x, int y, const float *expected);
+void piglit_probe_batch_pixel_rgba(int x, int y, const float *expected);
+void piglit_probe_batch_rect_rgb(int x, int y, int w, int h, const float *expected);
+void piglit_probe_batch_rect_rgba(int x, int y, int w, int h, const float *expected);
+bool piglit_probe_batch_flush(void);
+
 /**
  * Compare two pixels.
  * \param x the x coordinate of the pixel being probed
@@ -246,6 +280,12 @@ void piglit_draw_rect_from_arrays(const void *verts, const void *tex,
 				  bool use_patches);
 
 unsigned short piglit_half_from_float(float val);
+float piglit_float_from_half(unsigned short val);
+void piglit_half_from_float_array(const float *val, unsigned short *retval,
+				  size_t count);
+void piglit_float_from_half_array(const unsigned short *val, float *retval,
+				  size_t count);
+const char *piglit_packed_float_array_set_level(unsigned level);
 
 /**
  * Wrapper for piglit_half_from_float() which allows using an exact
@@ -297,6 +337,14 @@ GLuint piglit_rgbw_texture(GLenum internalFormat, int w, int h, GLboolean mip,
 GLuint piglit_integer_texture(GLenum internalFormat, int w, int h, int b, int a);
 GLuint piglit_depth_texture(GLenum target, GLenum format, int w, int h, int d, GLboolean mip);
 GLuint piglit_array_texture(GLenum target, GLenum format, int w, int h, int d, GLboolean mip);
+const void *piglit_rgbw_image_cached(GLenum internalFormat, int w, int h,
+				     GLboolean alpha, GLenum basetype,
+				     GLenum format, GLenum type);
+const void *piglit_checkerboard_image_cached(unsigned width, unsigned height,
+    unsigned horiz_square_size, unsigned vert_square_size,
+    const float *black, const float *white, GLenum format, GLenum type);
+void piglit_free_image_cache(void);
+void piglit_set_texture_upload_pbo(bool enable);
 GLuint piglit_multisample_texture(GLenum target, GLenum tex,
 				  GLenum internalFormat,
 				  unsigned width, unsigned height,
@@ -355,6 +403,21 @@ void
 piglit_write_png(const char *filename, GLenum base_format,
                  int width, int height, GLubyte *data, bool flip_y);
 
+uint64_t piglit_hash_data(const void *data, size_t size, uint64_t seed);
+uint64_t piglit_hash_rect(int x, int y, int w, int h, GLenum format,
+			  uint64_t seed);
+
+enum piglit_golden_hash_mode {
+	PIGLIT_GOLDEN_HASH_OFF,
+	PIGLIT_GOLDEN_HASH_CHECK,
+	PIGLIT_GOLDEN_HASH_RECORD,
+};
+
+enum piglit_golden_hash_mode piglit_golden_hash_mode(void);
+void piglit_golden_hash_set_file(const char *file);
+bool piglit_golden_hash_check(const char *key, uint64_t hash);
+void piglit_golden_hash_update(const char *key, uint64_t hash, bool pass);
+
 #ifdef __cplusplus
 } /* end extern "C" */
 #endif
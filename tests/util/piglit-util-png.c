@@ -22,15 +22,23 @@
  * IN THE SOFTWARE.
  */
 
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
 #ifdef PIGLIT_HAS_PNG
 #include <png.h>
 #endif
 
-#include <piglit/gl_wrap.h>
+#include "piglit-util-gl.h"
 
 #define aborts(s) _abortf("piglit_write_png: %s", s)
 #define abortf(s, ...) _abortf("piglit_write_png" s, __VA_ARGS__)
@@ -133,3 +141,377 @@ piglit_write_png(const char *filename,
 	fclose(fp);
 #endif
 }
+
+#define PRIME1 UINT64_C(0x9e3779b185ebca87)
+#define PRIME2 UINT64_C(0xc2b2ae3d27d4eb4f)
+#define PRIME3 UINT64_C(0x165667b19e3779f9)
+#define PRIME4 UINT64_C(0x85ebca77c2b2ae63)
+#define PRIME5 UINT64_C(0x27d4eb2f165667c5)
+
+static inline uint64_t
+rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+read64(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t
+hash_round(uint64_t acc, uint64_t input)
+{
+	acc += input * PRIME2;
+	acc = rotl64(acc, 31);
+	return acc * PRIME1;
+}
+
+static inline uint64_t
+hash_merge(uint64_t acc, uint64_t lane)
+{
+	acc ^= hash_round(0, lane);
+	return acc * PRIME1 + PRIME4;
+}
+
+/**
+ * Hash \p size bytes of \p data, continuing from \p seed.
+ *
+ * This is xxHash64: four independent lanes consume 32 bytes per step,
+ * which keeps up with a readback of a whole window.  The hash only
+ * serves to notice that an image is unchanged, it is not
+ * cryptographic.  The result depends on the host's byte order.
+ */
+uint64_t
+piglit_hash_data(const void *data, size_t size, uint64_t seed)
+{
+	const uint8_t *p = data;
+	const uint8_t *end = p + size;
+	uint64_t h;
+
+	if (size >= 32) {
+		uint64_t v1 = seed + PRIME1 + PRIME2;
+		uint64_t v2 = seed + PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME1;
+
+		do {
+			v1 = hash_round(v1, read64(p));
+			v2 = hash_round(v2, read64(p + 8));
+			v3 = hash_round(v3, read64(p + 16));
+			v4 = hash_round(v4, read64(p + 24));
+			p += 32;
+		} while (end - p >= 32);
+
+		h = rotl64(v1, 1) + rotl64(v2, 7) +
+		    rotl64(v3, 12) + rotl64(v4, 18);
+		h = hash_merge(h, v1);
+		h = hash_merge(h, v2);
+		h = hash_merge(h, v3);
+		h = hash_merge(h, v4);
+	} else {
+		h = seed + PRIME5;
+	}
+
+	h += size;
+
+	for (; end - p >= 8; p += 8) {
+		h ^= hash_round(0, read64(p));
+		h = rotl64(h, 27) * PRIME1 + PRIME4;
+	}
+	if (end - p >= 4) {
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		h ^= v * PRIME1;
+		h = rotl64(h, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		h ^= *p * PRIME5;
+		h = rotl64(h, 11) * PRIME1;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+/**
+ * Read back a rectangle of the current read buffer and hash it.
+ *
+ * Like the probes, this reads unsigned bytes from framebuffers with up
+ * to 8 bits per channel and floats otherwise, so the hash sees every
+ * bit of the stored color.  The size, format and type are hashed along
+ * with the pixels, so the same bytes read back differently don't
+ * collide.
+ */
+uint64_t
+piglit_hash_rect(int x, int y, int w, int h, GLenum format, uint64_t seed)
+{
+	GLenum type = piglit_can_probe_ubyte() ? GL_UNSIGNED_BYTE : GL_FLOAT;
+	const GLint header[4] = { w, h, format, type };
+	size_t size = (size_t) w * h * piglit_num_components(format) *
+		(type == GL_FLOAT ? sizeof(float) : 1);
+	GLint pack_alignment;
+	void *pixels;
+	uint64_t hash;
+
+	pixels = malloc(size);
+	glGetIntegerv(GL_PACK_ALIGNMENT, &pack_alignment);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	piglit_phase_push(PIGLIT_PHASE_READBACK);
+	glReadPixels(x, y, w, h, format, type, pixels);
+	piglit_phase_pop();
+	glPixelStorei(GL_PACK_ALIGNMENT, pack_alignment);
+
+	hash = piglit_hash_data(header, sizeof(header), seed);
+	hash = piglit_hash_data(pixels, size, hash);
+	free(pixels);
+	return hash;
+}
+
+/*
+ * Golden hashes.
+ *
+ * PIGLIT_GOLDEN_HASH_FILE names a reference file of "<hash> <key>"
+ * lines, one per image a test checks, and PIGLIT_GOLDEN_HASH_MODE says
+ * what to do with it.  "check" lets piglit_golden_hash_check() report
+ * images whose hash is in the file, so the test can skip comparing them
+ * pixel by pixel.  "record" runs every comparison in full and
+ * piglit_golden_hash_update() stores the hashes of the images that
+ * passed, writing the file back when the test exits.
+ *
+ * A process that runs several tests, like shader_runner with a batch of
+ * scripts, switches to each test's file with piglit_golden_hash_set_file().
+ *
+ * Hashes depend on the exact output of the driver, a reference file is
+ * only meaningful for the driver and hardware it was recorded on.
+ */
+struct golden_hash {
+	uint64_t hash;
+	char *key;
+};
+
+static bool golden_mode_known;
+static enum piglit_golden_hash_mode golden_mode;
+static char *golden_file;
+static bool golden_file_set;
+static struct golden_hash *golden_hashes;
+static unsigned num_golden_hashes, golden_hashes_size;
+static bool golden_dirty;
+
+static struct golden_hash *
+find_golden_hash(const char *key)
+{
+	unsigned i;
+
+	for (i = 0; i < num_golden_hashes; i++) {
+		if (strcmp(golden_hashes[i].key, key) == 0)
+			return &golden_hashes[i];
+	}
+
+	return NULL;
+}
+
+static void
+set_golden_hash(const char *key, uint64_t hash)
+{
+	struct golden_hash *entry = find_golden_hash(key);
+
+	if (entry == NULL) {
+		if (num_golden_hashes == golden_hashes_size) {
+			golden_hashes_size = MAX2(16, golden_hashes_size * 2);
+			golden_hashes = realloc(golden_hashes,
+						golden_hashes_size *
+						sizeof(*golden_hashes));
+		}
+
+		entry = &golden_hashes[num_golden_hashes++];
+		entry->key = strdup(key);
+	} else if (entry->hash == hash) {
+		return;
+	}
+
+	entry->hash = hash;
+	golden_dirty = true;
+}
+
+static void
+load_golden_hashes(void)
+{
+	FILE *f = fopen(golden_file, "r");
+	char line[4096];
+
+	if (f == NULL)
+		return;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		uint64_t hash;
+		int key_start;
+
+		line[strcspn(line, "\r\n")] = '\0';
+		if (sscanf(line, "%" SCNx64 " %n", &hash, &key_start) != 1 ||
+		    line[key_start] == '\0')
+			continue;
+
+		set_golden_hash(line + key_start, hash);
+	}
+
+	fclose(f);
+	golden_dirty = false;
+}
+
+static void
+write_golden_hashes(void)
+{
+	char *tmp;
+	FILE *f;
+	unsigned i;
+
+	if (!golden_dirty)
+		return;
+
+	/* Write to a temporary file and rename it into place, so that a
+	 * test killed halfway doesn't leave a truncated reference file.
+	 */
+	asprintf(&tmp, "%s.%d.tmp", golden_file, (int) getpid());
+	f = fopen(tmp, "w");
+	if (f == NULL) {
+		fprintf(stderr, "piglit: cannot write golden hashes to %s\n",
+			tmp);
+		free(tmp);
+		return;
+	}
+
+	for (i = 0; i < num_golden_hashes; i++) {
+		fprintf(f, "%016" PRIx64 " %s\n", golden_hashes[i].hash,
+			golden_hashes[i].key);
+	}
+
+	if (fclose(f) != 0) {
+		unlink(tmp);
+	} else {
+#if defined(_WIN32)
+		/* rename() doesn't replace existing files on Windows. */
+		remove(golden_file);
+#endif
+		rename(tmp, golden_file);
+	}
+	free(tmp);
+}
+
+enum piglit_golden_hash_mode
+piglit_golden_hash_mode(void)
+{
+	const char *mode;
+
+	if (golden_mode_known)
+		return golden_mode;
+
+	golden_mode_known = true;
+	golden_mode = PIGLIT_GOLDEN_HASH_OFF;
+
+	if (!golden_file_set) {
+		const char *file = getenv("PIGLIT_GOLDEN_HASH_FILE");
+
+		golden_file_set = true;
+		if (file != NULL && file[0] != '\0')
+			golden_file = strdup(file);
+	}
+
+	mode = getenv("PIGLIT_GOLDEN_HASH_MODE");
+	if (golden_file == NULL || mode == NULL)
+		return golden_mode;
+
+	if (strcmp(mode, "check") == 0) {
+		golden_mode = PIGLIT_GOLDEN_HASH_CHECK;
+	} else if (strcmp(mode, "record") == 0) {
+		static bool registered;
+
+		golden_mode = PIGLIT_GOLDEN_HASH_RECORD;
+		if (!registered) {
+			atexit(write_golden_hashes);
+			registered = true;
+		}
+	} else {
+		fprintf(stderr, "Unknown PIGLIT_GOLDEN_HASH_MODE \"%s\"\n",
+			mode);
+		piglit_report_result(PIGLIT_FAIL);
+	}
+
+	load_golden_hashes();
+	return golden_mode;
+}
+
+/**
+ * Use the golden hashes in \p file from now on, rather than the file
+ * named by PIGLIT_GOLDEN_HASH_FILE, or none if \p file is NULL.  When
+ * recording, the hashes of the previous file are written out first.
+ */
+void
+piglit_golden_hash_set_file(const char *file)
+{
+	unsigned i;
+
+	if (golden_mode_known && golden_mode == PIGLIT_GOLDEN_HASH_RECORD)
+		write_golden_hashes();
+
+	for (i = 0; i < num_golden_hashes; i++)
+		free(golden_hashes[i].key);
+	num_golden_hashes = 0;
+	golden_dirty = false;
+
+	free(golden_file);
+	golden_file = file != NULL && file[0] != '\0' ? strdup(file) : NULL;
+	golden_file_set = true;
+	golden_mode_known = false;
+}
+
+/**
+ * Return true if golden hashes are being checked and \p hash is the one
+ * recorded for \p key.  The caller can then skip its detailed
+ * comparison, and must do it otherwise.
+ */
+bool
+piglit_golden_hash_check(const char *key, uint64_t hash)
+{
+	const struct golden_hash *entry;
+
+	if (piglit_golden_hash_mode() != PIGLIT_GOLDEN_HASH_CHECK)
+		return false;
+
+	entry = find_golden_hash(key);
+	return entry != NULL && entry->hash == hash;
+}
+
+/**
+ * Report the outcome of the detailed comparison of the image that
+ * hashed to \p hash.  When recording, the hash of an image that passed
+ * becomes the golden hash of \p key, and a failing image drops it.
+ */
+void
+piglit_golden_hash_update(const char *key, uint64_t hash, bool pass)
+{
+	struct golden_hash *entry;
+
+	if (piglit_golden_hash_mode() != PIGLIT_GOLDEN_HASH_RECORD)
+		return;
+
+	if (pass) {
+		set_golden_hash(key, hash);
+		return;
+	}
+
+	entry = find_golden_hash(key);
+	if (entry != NULL) {
+		free(entry->key);
+		*entry = golden_hashes[--num_golden_hashes];
+		golden_dirty = true;
+	}
+}
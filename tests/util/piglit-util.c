@@ -246,6 +246,107 @@ piglit_result_to_string(enum piglit_result result)
         return "Unknown result";
 }
 
+/*
+ * Phase timing.
+ *
+ * Time is charged to the phase on top of phase_stack, so a nested phase,
+ * like compiling a shader in piglit_init(), is not counted twice.  The
+ * GL framework sets the top level phases, and helpers push the nested
+ * ones around their work.  Nothing is timed until the first
+ * piglit_phase_set(), which also arranges for the times to be printed
+ * as a PIGLIT: line when the test exits.
+ */
+static const char *const phase_names[PIGLIT_NUM_PHASES] = {
+	"context",
+	"init",
+	"compile",
+	"display",
+	"readback",
+	"teardown",
+};
+
+static int64_t phase_times[PIGLIT_NUM_PHASES];
+static enum piglit_phase phase_stack[8];
+static unsigned phase_depth, phase_overflow;
+static int64_t phase_start;
+
+static void
+charge_phase(void)
+{
+	int64_t now = piglit_time_get_nano();
+
+	phase_times[phase_stack[phase_depth - 1]] += now - phase_start;
+	phase_start = now;
+}
+
+static void
+report_phase_times(void)
+{
+	unsigned i;
+
+	charge_phase();
+
+	printf("PIGLIT: {\"phase_times\": {");
+	for (i = 0; i < PIGLIT_NUM_PHASES; i++) {
+		printf("%s\"%s\": %.6f", i ? ", " : "", phase_names[i],
+		       phase_times[i] / 1e9);
+	}
+	printf("}}\n");
+	fflush(stdout);
+}
+
+/**
+ * Switch to the top level \p phase, ending any nested ones.
+ */
+void
+piglit_phase_set(enum piglit_phase phase)
+{
+	if (phase_depth == 0) {
+		phase_start = piglit_time_get_nano();
+		atexit(report_phase_times);
+	} else {
+		charge_phase();
+	}
+
+	phase_stack[0] = phase;
+	phase_depth = 1;
+	phase_overflow = 0;
+}
+
+/**
+ * Start the nested \p phase, until the matching piglit_phase_pop().
+ * Does nothing when phases aren't being timed.
+ */
+void
+piglit_phase_push(enum piglit_phase phase)
+{
+	if (phase_depth == 0)
+		return;
+
+	if (phase_depth == ARRAY_SIZE(phase_stack)) {
+		phase_overflow++;
+		return;
+	}
+
+	charge_phase();
+	phase_stack[phase_depth++] = phase;
+}
+
+void
+piglit_phase_pop(void)
+{
+	if (phase_overflow > 0) {
+		phase_overflow--;
+		return;
+	}
+
+	if (phase_depth <= 1)
+		return;
+
+	charge_phase();
+	phase_depth--;
+}
+
 void
 piglit_report_result(enum piglit_result result)
 {
@@ -262,6 +363,9 @@ piglit_report_result(enum piglit_result result)
 	printf("PIGLIT: {\"result\": \"%s\" }\n", result_str);
 	fflush(stdout);
 
+	if (phase_depth > 0)
+		piglit_phase_set(PIGLIT_PHASE_TEARDOWN);
+
 	switch(result) {
 	case PIGLIT_PASS:
 	case PIGLIT_SKIP:
@@ -693,6 +797,14 @@ piglit_parse_subtest_args(int *argc, char *argv[],
 				exit(EXIT_FAILURE);
 			}
 
+			/* The count first, so that the framework can tell
+			 * this list from the output of a test that ignores
+			 * -list-subtests.
+			 */
+			for (i = 0; !PIGLIT_SUBTEST_END(&subtests[i]); ++i)
+				;
+			printf("PIGLIT: {\"subtests\": %d}\n", i);
+
 			for (i = 0; !PIGLIT_SUBTEST_END(&subtests[i]); ++i) {
 				printf("%s: %s\n",
 				       subtests[i].option,
@@ -357,6 +357,23 @@ void piglit_set_timeout(double seconds, enum piglit_result timeout_result);
 void piglit_report_subtest_result(enum piglit_result result,
 				  const char *format, ...) PRINTFLIKE(2, 3);
 
+/**
+ * Phases of a test whose time is reported in the "phase_times" trailer.
+ */
+enum piglit_phase {
+	PIGLIT_PHASE_CONTEXT,
+	PIGLIT_PHASE_INIT,
+	PIGLIT_PHASE_COMPILE,
+	PIGLIT_PHASE_DISPLAY,
+	PIGLIT_PHASE_READBACK,
+	PIGLIT_PHASE_TEARDOWN,
+	PIGLIT_NUM_PHASES
+};
+
+void piglit_phase_set(enum piglit_phase phase);
+void piglit_phase_push(enum piglit_phase phase);
+void piglit_phase_pop(void);
+
 void piglit_disable_error_message_boxes(void);
 
 extern void piglit_set_rlimit(unsigned long lim);
@@ -75,6 +75,21 @@
  * If an error occurs, setup_vbo_from_text() will print out a
  * description of the error and exit with PIGLIT_FAIL.
  *
+ * Large vertex data can instead be kept in a binary file, named on the
+ * line after the column headers:
+ *
+ *   \verbatim
+ *   vertex/float/vec3	foo/uint/uint	bar[0]/int/int	bar[1]/int/int
+ *   vertices.bin
+ *   \endverbatim
+ *
+ * The file holds the rows back to back, each laid out as the columns
+ * are, with no padding and in the host's byte order, so the number of
+ * rows is the size of the file divided by the size of a row.  It is
+ * mapped and handed to the GL as it is, rather than parsed.  To use
+ * it, call setup_vbo_from_file() with the column headers and file name
+ * as the text, and the file the name is relative to.
+ *
  * For the first example above, the call to setup_vbo_from_text() is
  * roughly equivalent to the following GL operations:
  *
@@ -136,6 +151,15 @@
 #include "piglit-util-gl.h"
 #include "piglit-vbo.h"
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_FCNTL_H) && \
+    defined(HAVE_SYS_STAT_H) && defined(HAVE_UNISTD_H) && !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define USE_MMAP
+#endif
+
 /**
  * Convert a type name string to a GLenum.
  */
@@ -616,18 +640,20 @@ vertex_attrib_description::setup(size_t *offset, size_t stride) const
 class vbo_data
 {
 public:
-	vbo_data(std::string const &text, GLuint prog);
+	vbo_data(const char *text, const char *text_end, GLuint prog);
+	vbo_data(const char *text, const char *text_end, GLuint prog,
+		 const char *relative_to);
+	~vbo_data();
 	size_t setup() const;
 
 private:
-	void parse_header_line(const std::string &line, GLuint prog);
-	void parse_data_line(const std::string &line, unsigned int line_num);
-	void parse_line(std::string line, unsigned int line_num, GLuint prog);
-
-	/**
-	 * True if the header line has already been parsed.
-	 */
-	bool header_seen;
+	const char *parse_header(const char *text, const char *text_end,
+				 GLuint prog);
+	void parse_header_line(const char *line, const char *line_end,
+			       GLuint prog);
+	void parse_data_line(const char *line, const char *line_end,
+			     unsigned int line_num);
+	void map_file(const char *file_name);
 
 	/**
 	 * Description of each attribute.
@@ -639,6 +665,17 @@ private:
 	 */
 	std::vector<char> raw_data;
 
+	/**
+	 * Rows of vertex data, either in raw_data or in a mapped file.
+	 */
+	const void *data;
+
+	/**
+	 * The mapping of a [vertex data file], and its size.
+	 */
+	void *mapping;
+	size_t mapping_size;
+
 	/**
 	 * Number of bytes in each row of raw_data.
 	 */
@@ -648,18 +685,53 @@ private:
 	 * Number of rows in raw_data.
 	 */
 	size_t num_rows;
-};
 
+	/**
+	 * Number of lines before the current one.
+	 */
+	unsigned int line_num;
+};
 
 
+/**
+ * Find the next line of input text in [*text, text_end) that isn't
+ * blank once its end-of-line comment is ignored, and advance *text
+ * past it.
+ *
+ * The line is returned in [*line, *line_end), without the comment or
+ * the newline.  Returns false if there are no more lines.
+ */
 static bool
-is_blank_line(const std::string &line)
+next_line(const char **text, const char *text_end, unsigned int *line_num,
+	  const char **line, const char **line_end)
 {
-	for (size_t i = 0; i < line.size(); ++i) {
-		if (!isspace(line[i]))
-			return false;
+	while (*text < text_end) {
+		const char *start = *text;
+		const char *end = (const char *)
+			memchr(start, '\n', text_end - start);
+
+		if (end == NULL)
+			end = text_end;
+		*text = end == text_end ? end : end + 1;
+		++*line_num;
+
+		/* Ignore end-of-line comments */
+		const char *comment = (const char *)
+			memchr(start, '#', end - start);
+		if (comment != NULL)
+			end = comment;
+
+		/* Ignore blank or comment-only lines */
+		while (start < end && isspace((unsigned char) *start))
+			++start;
+		if (start != end) {
+			*line = start;
+			*line_end = end;
+			return true;
+		}
 	}
-	return true;
+
+	return false;
 }
 
 
@@ -671,52 +743,82 @@ is_blank_line(const std::string &line)
  * then exit with PIGLIT_FAIL.
  */
 void
-vbo_data::parse_header_line(const std::string &line, GLuint prog)
+vbo_data::parse_header_line(const char *line, const char *line_end,
+			    GLuint prog)
 {
-	size_t pos = 0;
+	const char *pos = line;
 	this->stride = 0;
-	while (pos < line.size()) {
-		if (isspace(line[pos])) {
+	while (pos < line_end) {
+		if (isspace((unsigned char) *pos)) {
 			++pos;
 		} else {
-			size_t column_header_end = pos;
-			while (column_header_end < line.size() &&
-			       !isspace(line[column_header_end]))
+			const char *column_header_end = pos;
+			while (column_header_end < line_end &&
+			       !isspace((unsigned char) *column_header_end))
 				++column_header_end;
-			std::string column_header = line.substr(
-				pos, column_header_end - pos);
+			std::string column_header(pos, column_header_end);
 			vertex_attrib_description desc(
 				prog, column_header.c_str());
 			attribs.push_back(desc);
 			this->stride += desc.rows * desc.data_type_size;
-			pos = column_header_end + 1;
+			pos = column_header_end;
 		}
 	}
 }
 
 
 /**
- * Convert a data row into binary form and append it to this->raw_data.
+ * Parse the column headers, the first line of input text, and return
+ * what follows them.
+ *
+ * If there is no header, print a description of the problem and then
+ * exit with PIGLIT_FAIL.
+ */
+const char *
+vbo_data::parse_header(const char *text, const char *text_end, GLuint prog)
+{
+	const char *line, *line_end;
+
+	if (!next_line(&text, text_end, &this->line_num, &line, &line_end)) {
+		printf("No column headers in vertex data\n");
+		piglit_report_result(PIGLIT_FAIL);
+	}
+	parse_header_line(line, line_end, prog);
+
+	return text;
+}
+
+
+/**
+ * Convert a data row into binary form and append it to this->raw_data,
+ * which must have room for it.
  *
  * If there is a parse failure, print a description of the problem and
  * then exit with PIGLIT_FAIL.
  */
 void
-vbo_data::parse_data_line(const std::string &line, unsigned int line_num)
+vbo_data::parse_data_line(const char *line, const char *line_end,
+			  unsigned int line_num)
 {
-	/* Allocate space in raw_data for this line */
-	size_t old_size = this->raw_data.size();
-	this->raw_data.resize(old_size + this->stride);
-	char *data_ptr = &this->raw_data[old_size];
+	char *data_ptr = &this->raw_data[this->num_rows * this->stride];
 
-	const char *line_ptr = line.c_str();
+	const char *line_ptr = line;
 	for (size_t i = 0; i < this->attribs.size(); ++i) {
 		for (size_t j = 0; j < this->attribs[i].rows; ++j) {
-			if (!this->attribs[i].parse_datum(&line_ptr,
+			/* The line isn't nul-terminated, so don't let
+			 * the number parsers skip over its end.
+			 */
+			while (line_ptr < line_end &&
+			       isspace((unsigned char) *line_ptr))
+				++line_ptr;
+
+			if (line_ptr == line_end ||
+			    !this->attribs[i].parse_datum(&line_ptr,
 							  data_ptr)) {
 				printf("At line %u of [vertex data] section\n",
 				       line_num);
-				printf("Offending text: %s\n", line_ptr);
+				printf("Offending text: %.*s\n",
+				       (int) (line_end - line), line);
 				piglit_report_result(PIGLIT_FAIL);
 			}
 			data_ptr += this->attribs[i].data_type_size;
@@ -728,49 +830,140 @@ vbo_data::parse_data_line(const std::string &line, unsigned int line_num)
 
 
 /**
- * Parse a line of input text.
+ * Parse the input but don't execute any GL commands.
  *
  * If there is a parse failure, print a description of the problem and
  * then exit with PIGLIT_FAIL.
  */
-void
-vbo_data::parse_line(std::string line, unsigned int line_num, GLuint prog)
+vbo_data::vbo_data(const char *text, const char *text_end, GLuint prog)
+	: data(NULL), mapping(NULL), mapping_size(0), stride(0),
+	  num_rows(0), line_num(0)
 {
-	/* Ignore end-of-line comments */
-	line = line.substr(0, line.find('#'));
+	text = parse_header(text, text_end, prog);
 
-	/* Ignore blank or comment-only lines */
-	if (is_blank_line(line))
-		return;
+	/* Every row is at least a line, so this is enough room for
+	 * all of them.
+	 */
+	size_t max_rows = 1;
+	for (const char *nl = text;
+	     (nl = (const char *) memchr(nl, '\n', text_end - nl)) != NULL;
+	     ++nl)
+		++max_rows;
+	this->raw_data.resize(max_rows * this->stride);
+
+	const char *line, *line_end;
+	while (next_line(&text, text_end, &this->line_num, &line, &line_end))
+		parse_data_line(line, line_end, this->line_num);
+
+	this->raw_data.resize(this->num_rows * this->stride);
+	this->data = this->raw_data.empty() ? NULL : &this->raw_data[0];
+}
 
-	if (!this->header_seen) {
-		this->header_seen = true;
-		parse_header_line(line, prog);
-	} else {
-		parse_data_line(line, line_num);
+
+/**
+ * Parse a [vertex data file] section: the column headers, followed by
+ * the name of a file holding the rows of vertex data.  The name is
+ * relative to the directory of the file relative_to.
+ *
+ * If there is a parse failure, or the file can't be read, print a
+ * description of the problem and then exit with PIGLIT_FAIL.
+ */
+vbo_data::vbo_data(const char *text, const char *text_end, GLuint prog,
+		   const char *relative_to)
+	: data(NULL), mapping(NULL), mapping_size(0), stride(0),
+	  num_rows(0), line_num(0)
+{
+	text = parse_header(text, text_end, prog);
+
+	const char *line, *line_end;
+	if (!next_line(&text, text_end, &this->line_num, &line, &line_end)) {
+		printf("No file name in [vertex data file] section\n");
+		piglit_report_result(PIGLIT_FAIL);
 	}
+	while (line_end > line && isspace((unsigned char) line_end[-1]))
+		--line_end;
+
+	std::string file_name(line, line_end);
+	const char *slash = strrchr(relative_to, '/');
+#if defined(_WIN32)
+	const char *backslash = strrchr(relative_to, '\\');
+	if (backslash != NULL && (slash == NULL || backslash > slash))
+		slash = backslash;
+#endif
+	if (slash != NULL && file_name[0] != '/')
+		file_name.insert(0, relative_to, slash + 1 - relative_to);
+
+	map_file(file_name.c_str());
+
+	if (this->stride == 0 || this->mapping_size % this->stride != 0) {
+		printf("Size of %s (%lu bytes) is not a multiple of the"
+		       " vertex size (%lu bytes)\n", file_name.c_str(),
+		       (unsigned long) this->mapping_size,
+		       (unsigned long) this->stride);
+		piglit_report_result(PIGLIT_FAIL);
+	}
+	this->num_rows = this->mapping_size / this->stride;
+}
+
+
+vbo_data::~vbo_data()
+{
+#if defined(USE_MMAP)
+	if (this->mapping != NULL)
+		munmap(this->mapping, this->mapping_size);
+#endif
 }
 
 
 /**
- * Parse the input but don't execute any GL commands.
- *
- * If there is a parse failure, print a description of the problem and
- * then exit with PIGLIT_FAIL.
+ * Make the contents of file_name the rows of vertex data.  They are
+ * mapped rather than read where possible, so they are only copied once,
+ * into the buffer object.
  */
-vbo_data::vbo_data(const std::string &text, GLuint prog)
-	: header_seen(false), stride(0), num_rows(0)
+void
+vbo_data::map_file(const char *file_name)
 {
-	unsigned int line_num = 1;
+#if defined(USE_MMAP)
+	int fd = open(file_name, O_RDONLY);
+	struct stat st;
 
-	size_t pos = 0;
-	while (pos < text.size()) {
-		size_t end_of_line = text.find('\n', pos);
-		if (end_of_line == std::string::npos)
-			end_of_line = text.size();
-		parse_line(text.substr(pos, end_of_line), line_num++, prog);
-		pos = end_of_line + 1;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		printf("Could not open vertex data file %s\n", file_name);
+		piglit_report_result(PIGLIT_FAIL);
+	}
+
+	this->mapping_size = st.st_size;
+	if (this->mapping_size > 0) {
+		this->mapping = mmap(NULL, this->mapping_size, PROT_READ,
+				     MAP_PRIVATE, fd, 0);
+		if (this->mapping == MAP_FAILED) {
+			printf("Could not map vertex data file %s\n",
+			       file_name);
+			piglit_report_result(PIGLIT_FAIL);
+		}
+	}
+	close(fd);
+	this->data = this->mapping;
+#else
+	FILE *f = fopen(file_name, "rb");
+
+	if (f == NULL || fseek(f, 0, SEEK_END) != 0) {
+		printf("Could not open vertex data file %s\n", file_name);
+		piglit_report_result(PIGLIT_FAIL);
+	}
+
+	this->mapping_size = ftell(f);
+	this->raw_data.resize(this->mapping_size);
+	rewind(f);
+	if (this->mapping_size > 0 &&
+	    fread(&this->raw_data[0], 1, this->mapping_size, f) !=
+	    this->mapping_size) {
+		printf("Could not read vertex data file %s\n", file_name);
+		piglit_report_result(PIGLIT_FAIL);
 	}
+	fclose(f);
+	this->data = this->raw_data.empty() ? NULL : &this->raw_data[0];
+#endif
 }
 
 
@@ -785,7 +978,7 @@ vbo_data::setup() const
 	glGenBuffers(1, &buffer_handle);
 	glBindBuffer(GL_ARRAY_BUFFER, buffer_handle);
 	glBufferData(GL_ARRAY_BUFFER, this->stride * this->num_rows,
-		     &this->raw_data[0], GL_STATIC_DRAW);
+		     this->data, GL_STATIC_DRAW);
 
 	size_t offset = 0;
 	for (size_t i = 0; i < attribs.size(); ++i)
@@ -812,6 +1005,24 @@ setup_vbo_from_text(GLuint prog, const char *text_start, const char *text_end)
 {
 	if (text_end == NULL)
 		text_end = text_start + strlen(text_start);
-	std::string text(text_start, text_end);
-	return vbo_data(text, prog).setup();
+	return vbo_data(text_start, text_end, prog).setup();
+}
+
+
+/**
+ * Like setup_vbo_from_text(), but the text is only the column headers
+ * and the name of a file that holds the rows of vertex data in binary.
+ * A relative file name is relative to the directory of the file
+ * relative_to, for example the test script.
+ *
+ * For details about the format of the file, see the comment at the top
+ * of this file.
+ */
+size_t
+setup_vbo_from_file(GLuint prog, const char *text_start, const char *text_end,
+		    const char *relative_to)
+{
+	if (text_end == NULL)
+		text_end = text_start + strlen(text_start);
+	return vbo_data(text_start, text_end, prog, relative_to).setup();
 }
@@ -0,0 +1,389 @@
+/*
+ * Copyright (c) The Piglit project 2017
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file piglit-zygote.c
+ *
+ * Run GL tests in children forked from one long-lived process, so that
+ * each test doesn't dynamically link the piglit util library, waffle and
+ * the GL libraries all over again.  The tests must have been built as
+ * loadable modules too, see PIGLIT_BUILD_ZYGOTE.
+ *
+ *	piglit-zygote SOCKET
+ *
+ * The zygote loads the libraries, plus any listed in the colon separated
+ * PIGLIT_ZYGOTE_PRELOAD (the GL driver, say), listens on the unix socket
+ * SOCKET and prints "ready".  For each connection it forks a handler that
+ * reads one request, forks the test and reports back to the client:
+ *
+ *	request: "<length>\n" and <length> bytes of NUL terminated strings:
+ *	         the module, the working directory, the number of arguments,
+ *	         the arguments (argv[0] is the test binary) and the
+ *	         environment.
+ *	reply:   "pid <pid>\n" when the test has been forked, then
+ *	         "exit <returncode> <stdout length> <stderr length>\n" followed
+ *	         by the test's stdout and stderr when it has exited.
+ *
+ * The returncode is the exit status, or minus the signal that killed the
+ * test, as in Python's subprocess.  Closing the connection before the reply
+ * kills the test's process group.
+ *
+ * The test runs in its own session, with its own environment, and creates
+ * its context after the fork through the normal piglit_gl_framework path.
+ * If its module can't be loaded the child execs the test binary instead.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "piglit-util-gl.h"
+
+extern char **environ;
+
+/* Keep the util library, and so the GL libraries, linked in. */
+void (*volatile piglit_zygote_keep)(int, char **,
+				    const struct piglit_gl_test_config *) =
+	piglit_gl_test_run;
+
+struct buffer {
+	char *data;
+	size_t size;
+	size_t capacity;
+};
+
+static bool
+read_full(int fd, void *buf, size_t size)
+{
+	char *p = buf;
+
+	while (size) {
+		ssize_t n = read(fd, p, size);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+static bool
+write_full(int fd, const void *buf, size_t size)
+{
+	const char *p = buf;
+
+	while (size) {
+		ssize_t n = write(fd, p, size);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+/**
+ * Append what can be read from fd to buf. Returns false at end of file.
+ */
+static bool
+buffer_read(struct buffer *buf, int fd)
+{
+	ssize_t n;
+
+	if (buf->capacity - buf->size < 4096) {
+		buf->capacity = buf->capacity * 2 + 4096;
+		buf->data = realloc(buf->data, buf->capacity);
+		if (buf->data == NULL)
+			_exit(EXIT_FAILURE);
+	}
+
+	do {
+		n = read(fd, buf->data + buf->size, buf->capacity - buf->size);
+	} while (n < 0 && errno == EINTR);
+
+	if (n <= 0)
+		return false;
+	buf->size += n;
+	return true;
+}
+
+/**
+ * Read a request, returning the NUL terminated strings in it, or NULL.
+ */
+static char **
+read_request(int sock, size_t *count)
+{
+	char line[32];
+	char *payload, *p, **fields;
+	size_t i, length, n = 0;
+
+	for (i = 0; i < sizeof(line) - 1; i++) {
+		if (!read_full(sock, &line[i], 1))
+			return NULL;
+		if (line[i] == '\n')
+			break;
+	}
+	line[i] = '\0';
+	length = strtoul(line, NULL, 10);
+	if (length == 0)
+		return NULL;
+
+	payload = malloc(length);
+	if (payload == NULL || !read_full(sock, payload, length) ||
+	    payload[length - 1] != '\0')
+		return NULL;
+
+	for (p = payload; p < payload + length; p += strlen(p) + 1)
+		n++;
+
+	fields = calloc(n + 1, sizeof(char *));
+	if (fields == NULL)
+		return NULL;
+	for (i = 0, p = payload; i < n; i++, p += strlen(p) + 1)
+		fields[i] = p;
+
+	*count = n;
+	return fields;
+}
+
+/**
+ * Run the test in the child, never returns.
+ */
+static void
+run_test(const char *module, const char *cwd, int argc, char **argv,
+	 char **envp, int out, int err)
+{
+	int (*test_main)(int, char **) = NULL;
+	void *handle;
+
+	setsid();
+	dup2(out, STDOUT_FILENO);
+	dup2(err, STDERR_FILENO);
+	close(out);
+	close(err);
+
+	if (chdir(cwd) != 0) {
+		fprintf(stderr, "piglit-zygote: can't change to %s: %s\n",
+			cwd, strerror(errno));
+		_exit(EXIT_FAILURE);
+	}
+	environ = envp;
+
+	handle = dlopen(module, RTLD_NOW | RTLD_LOCAL);
+	if (handle)
+		test_main = (int (*)(int, char **))
+			dlsym(handle, "piglit_zygote_main");
+
+	if (test_main == NULL) {
+		execve(argv[0], argv, envp);
+		fprintf(stderr, "piglit-zygote: can't run %s: %s\n",
+			argv[0], strerror(errno));
+		_exit(EXIT_FAILURE);
+	}
+
+	exit(test_main(argc, argv));
+}
+
+/**
+ * Handle one connection, in a process forked for it.
+ */
+static void
+serve(int sock)
+{
+	struct buffer bufs[2] = {{ 0 }};
+	struct pollfd fds[3];
+	char header[96];
+	char **fields;
+	size_t count;
+	int argc, out[2], err[2], status, returncode, i;
+	pid_t pid;
+
+	fields = read_request(sock, &count);
+	if (fields == NULL || count < 3)
+		_exit(EXIT_FAILURE);
+
+	argc = atoi(fields[2]);
+	if (argc < 1 || (size_t) argc > count - 3)
+		_exit(EXIT_FAILURE);
+
+	if (pipe(out) != 0 || pipe(err) != 0)
+		_exit(EXIT_FAILURE);
+
+	pid = fork();
+	if (pid < 0)
+		_exit(EXIT_FAILURE);
+
+	if (pid == 0) {
+		/* argv needs its own NULL terminated copy, the environment
+		 * follows it in the request.
+		 */
+		char **argv = calloc(argc + 1, sizeof(char *));
+
+		if (argv == NULL)
+			_exit(EXIT_FAILURE);
+		memcpy(argv, &fields[3], argc * sizeof(char *));
+
+		close(sock);
+		close(out[0]);
+		close(err[0]);
+		run_test(fields[0], fields[1], argc, argv, &fields[3 + argc],
+			 out[1], err[1]);
+	}
+
+	close(out[1]);
+	close(err[1]);
+
+	snprintf(header, sizeof(header), "pid %d\n", (int) pid);
+	write_full(sock, header, strlen(header));
+
+	fds[0].fd = out[0];
+	fds[1].fd = err[0];
+	fds[2].fd = sock;
+	for (i = 0; i < 3; i++)
+		fds[i].events = POLLIN;
+
+	while (fds[0].fd >= 0 || fds[1].fd >= 0) {
+		if (poll(fds, 3, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (i = 0; i < 2; i++) {
+			if (fds[i].fd >= 0 && fds[i].revents &&
+			    !buffer_read(&bufs[i], fds[i].fd)) {
+				close(fds[i].fd);
+				fds[i].fd = -1;
+			}
+		}
+
+		/* The client gave up on the test, timed out probably. */
+		if (fds[2].fd >= 0 && fds[2].revents) {
+			kill(-pid, SIGKILL);
+			kill(pid, SIGKILL);
+			fds[2].fd = -1;
+		}
+	}
+
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+		;
+	returncode = WIFSIGNALED(status) ? -WTERMSIG(status) :
+		WEXITSTATUS(status);
+
+	snprintf(header, sizeof(header), "exit %d %zu %zu\n",
+		 returncode, bufs[0].size, bufs[1].size);
+	if (write_full(sock, header, strlen(header)) &&
+	    write_full(sock, bufs[0].data, bufs[0].size))
+		write_full(sock, bufs[1].data, bufs[1].size);
+
+	_exit(EXIT_SUCCESS);
+}
+
+static void
+preload(void)
+{
+	const char *list = getenv("PIGLIT_ZYGOTE_PRELOAD");
+	char *libs, *lib, *save = NULL;
+
+	if (list == NULL)
+		return;
+
+	libs = strdup(list);
+	for (lib = strtok_r(libs, ":", &save); lib;
+	     lib = strtok_r(NULL, ":", &save)) {
+		if (dlopen(lib, RTLD_NOW | RTLD_GLOBAL) == NULL)
+			fprintf(stderr, "piglit-zygote: %s\n", dlerror());
+	}
+	free(libs);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct sockaddr_un addr;
+	int sock;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s SOCKET\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(argv[1]) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "piglit-zygote: socket path too long\n");
+		return EXIT_FAILURE;
+	}
+	strcpy(addr.sun_path, argv[1]);
+
+	preload();
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0 ||
+	    bind(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+	    listen(sock, 64) != 0) {
+		perror("piglit-zygote");
+		return EXIT_FAILURE;
+	}
+
+	/* Handlers are reaped automatically. */
+	signal(SIGCHLD, SIG_IGN);
+
+	printf("ready\n");
+	fflush(stdout);
+
+	for (;;) {
+		pid_t pid;
+		int conn = accept(sock, NULL, NULL);
+
+		if (conn < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			perror("piglit-zygote");
+			return EXIT_FAILURE;
+		}
+
+		pid = fork();
+		if (pid == 0) {
+			close(sock);
+			signal(SIGCHLD, SIG_DFL);
+			serve(conn);
+		}
+		close(conn);
+	}
+}
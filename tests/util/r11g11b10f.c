@@ -147,6 +147,42 @@ unsigned f32_to_uf10(float val)
    return uf10;
 }
 
+/* Unsigned small floats with a 5 bit exponent to float, exactly. */
+static float uf_to_f32(unsigned val, int mantissa_bits)
+{
+   union {
+      float f;
+      uint32_t ui;
+   } f32;
+
+   unsigned exponent = val >> mantissa_bits;
+   unsigned mantissa = val & ((1 << mantissa_bits) - 1);
+
+   if (exponent == 0) {
+      /* 2^-14 * (M / 2^mantissa_bits) */
+      f32.f = ldexpf(mantissa, -14 - mantissa_bits);
+   } else if (exponent == UF11_EXPONENT_BITS) {
+      f32.ui = F32_INFINITY | (mantissa << (23 - mantissa_bits));
+      if (mantissa)
+         f32.ui |= 0x400000; /* quiet NaN */
+   } else {
+      f32.ui = (exponent + 127 - UF11_EXPONENT_BIAS) << 23 |
+               mantissa << (23 - mantissa_bits);
+   }
+
+   return f32.f;
+}
+
+float uf11_to_f32(unsigned val)
+{
+   return uf_to_f32(val & 0x7ff, UF11_EXPONENT_SHIFT);
+}
+
+float uf10_to_f32(unsigned val)
+{
+   return uf_to_f32(val & 0x3ff, UF10_EXPONENT_SHIFT);
+}
+
 unsigned float3_to_r11g11b10f(const float rgb[3])
 {
    return ( f32_to_uf11(rgb[0]) & 0x7ff) |
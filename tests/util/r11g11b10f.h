@@ -24,6 +24,9 @@
 #ifndef R11G11B10F_H
 #define R11G11B10F_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,6 +34,16 @@ extern "C" {
 unsigned f32_to_uf11(float val);
 unsigned f32_to_uf10(float val);
 unsigned float3_to_r11g11b10f(const float rgb[3]);
+float uf11_to_f32(unsigned val);
+float uf10_to_f32(unsigned val);
+
+/* The same for count values, or texels of three floats.  See
+ * packed-float-array.c.
+ */
+void f32_to_uf11_array(const float *val, uint16_t *retval, size_t count);
+void f32_to_uf10_array(const float *val, uint16_t *retval, size_t count);
+void float3_to_r11g11b10f_array(const float *rgb, unsigned *retval,
+				size_t count);
 
 #ifdef __cplusplus
 }
@@ -24,6 +24,8 @@
 #ifndef RGB9E5_H
 #define RGB9E5_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,6 +33,10 @@ extern "C" {
 void rgb9e5_to_float3(unsigned rgb, float retval[3]);
 unsigned float3_to_rgb9e5(const float rgb[3]);
 
+/* The same for count texels, three floats each.  See packed-float-array.c. */
+void rgb9e5_to_float3_array(const unsigned *rgb, float *retval, size_t count);
+void float3_to_rgb9e5_array(const float *rgb, unsigned *retval, size_t count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -74,6 +74,7 @@ def test_get_backend():
     # expect
     backends_ = {
         'json': backends.json.JSONBackend,
+        'jsonlog': backends.jsonlog.JSONLogBackend,
         'junit': backends.junit.JUnitBackend,
     }
 
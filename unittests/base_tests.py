@@ -23,6 +23,7 @@
 from __future__ import (
     absolute_import, division, print_function, unicode_literals
 )
+import hashlib
 import tempfile
 import textwrap
 import os
@@ -52,6 +53,7 @@ from framework.test.base import (
     TestRunError,
     ValgrindMixin,
     WindowResizeMixin,
+    golden_hash_file,
 )
 from framework.options import _Options as Options
 from framework import log, dmesg, monitoring
@@ -436,3 +438,54 @@ class TestExecuteTraceback(object):
         """
         nt.assert_not_equal(self.test.exception, str)
         nt.assert_is_instance(self.test.exception, six.string_types)
+
+
+@mock.patch('framework.test.base.options.OPTIONS', new_callable=Options)
+def test_golden_hash_file(mock_opts):
+    """test.base.golden_hash_file: makes the test name safe as a file name"""
+    mock_opts.golden_hashes = os.path.join('golden', 'dir')
+    nt.eq_(golden_hash_file('spec@arb_foo@a test/with:odd*chars'),
+           os.path.join('golden', 'dir',
+                        'spec@arb_foo@a_test_with_odd_chars-'
+                        '{}.hashes'.format(hashlib.sha1(
+                            b'spec@arb_foo@a test/with:odd*chars'
+                        ).hexdigest()[:8])))
+
+
+@mock.patch('framework.test.base.options.OPTIONS', new_callable=Options)
+def test_golden_hash_file_distinct(mock_opts):
+    """test.base.golden_hash_file: names that only differ in unsafe
+    characters get different files
+    """
+    mock_opts.golden_hashes = 'golden'
+    nt.assert_not_equal(golden_hash_file('spec@foo@a b'),
+                        golden_hash_file('spec@foo@a:b'))
+
+
+@mock.patch('framework.test.base.options.OPTIONS', new_callable=Options)
+def test_execute_golden_hash_file(mock_opts):
+    """test.base.Test.execute: sets PIGLIT_GOLDEN_HASH_FILE per test"""
+    mock_opts.golden_hashes = 'golden'
+    test = TestTest(['foo'])
+    test.run = mock.Mock()
+
+    test.execute('spec@foo@bar',
+                 mock.Mock(spec=log.BaseLog),
+                 mock.Mock(spec=dmesg.BaseDmesg),
+                 mock.Mock(spec=monitoring.Monitoring))
+
+    nt.eq_(test.env['PIGLIT_GOLDEN_HASH_FILE'],
+           golden_hash_file('spec@foo@bar'))
+
+
+def test_execute_no_golden_hash_file():
+    """test.base.Test.execute: no PIGLIT_GOLDEN_HASH_FILE by default"""
+    test = TestTest(['foo'])
+    test.run = mock.Mock()
+
+    test.execute('spec@foo@bar',
+                 mock.Mock(spec=log.BaseLog),
+                 mock.Mock(spec=dmesg.BaseDmesg),
+                 mock.Mock(spec=monitoring.Monitoring))
+
+    nt.ok_('PIGLIT_GOLDEN_HASH_FILE' not in test.env)
@@ -43,6 +43,7 @@ BLACKLIST = {
     'builtin_function.py',
     'builtin_function_fp64.py',
     'genclbuiltins.py',
+    'run_generator.py',
 
     # these (or some subset) should run eventually.
     'random_ubo.py',
@@ -0,0 +1,148 @@
+# Copyright (c) 2017 The Piglit project
+
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Tests for generated_tests/modules/utils.py."""
+
+from __future__ import (
+    absolute_import, division, print_function, unicode_literals
+)
+import os
+import sys
+
+import nose.tools as nt
+import six
+
+from .. import utils
+
+# Add <piglit root>/generated_tests to the module path, this allows it to be
+# imported for testing.
+sys.path.insert(0, os.path.abspath(
+    os.path.join(os.path.dirname(__file__), '..', '..', 'generated_tests')))
+
+# pylint can't figure out the sys.path manipulation.
+from modules import utils as gen_utils  # pylint: disable=import-error
+
+
+def _read(name):
+    with open(name, 'rb') as f:
+        return f.read()
+
+
+@utils.nose.test_in_tempdir
+def test_open_if_changed_new():
+    """modules.utils.open_if_changed: writes a new file"""
+    gen_utils.FILES.clear()
+    with gen_utils.open_if_changed('foo') as f:
+        f.write('foo\n')
+        f.write('bar\n')
+
+    nt.eq_(_read('foo'), b'foo\nbar\n')
+    nt.eq_(gen_utils.FILES['written'], 1)
+
+
+@utils.nose.test_in_tempdir
+def test_open_if_changed_unchanged():
+    """modules.utils.open_if_changed: leaves a file with the same contents alone"""
+    with open('foo', 'w') as f:
+        f.write('foo\n')
+    os.utime('foo', (1000, 1000))
+    gen_utils.FILES.clear()
+
+    with gen_utils.open_if_changed('foo') as f:
+        f.write('foo\n')
+
+    nt.eq_(os.path.getmtime('foo'), 1000)
+    nt.eq_(gen_utils.FILES['unchanged'], 1)
+    nt.eq_(gen_utils.FILES['written'], 0)
+
+
+@utils.nose.test_in_tempdir
+def test_open_if_changed_changed():
+    """modules.utils.open_if_changed: replaces a file with other contents"""
+    with open('foo', 'w') as f:
+        f.write('bar\n')
+
+    with gen_utils.open_if_changed('foo', 'w+') as f:
+        f.write('baz\n')
+
+    nt.eq_(_read('foo'), b'baz\n')
+
+
+@utils.nose.test_in_tempdir
+def test_open_if_changed_binary():
+    """modules.utils.open_if_changed: writes bytes in 'wb' mode"""
+    with gen_utils.open_if_changed('foo', 'wb') as f:
+        f.write(b'\x00\xff')
+
+    nt.eq_(_read('foo'), b'\x00\xff')
+
+
+@utils.nose.test_in_tempdir
+def test_open_if_changed_exception():
+    """modules.utils.open_if_changed: doesn't write if the block raises"""
+    with open('foo', 'w') as f:
+        f.write('foo\n')
+
+    with nt.assert_raises(utils.nose.SentinalException):
+        with gen_utils.open_if_changed('foo') as f:
+            f.write('bar\n')
+            raise utils.nose.SentinalException()
+
+    nt.eq_(_read('foo'), b'foo\n')
+
+
+def _run_parallel(jobs):
+    """Run a generator-like loop with run_parallel, return what it printed."""
+    def generate(i):
+        name = 'test{}'.format(i)
+        with gen_utils.open_if_changed(name) as f:
+            f.write(name)
+        print(name)
+
+    jobs, gen_utils.JOBS = gen_utils.JOBS, jobs
+    stdout, sys.stdout = sys.stdout, six.moves.StringIO()
+    try:
+        gen_utils.run_parallel(generate, range(100))
+        return sys.stdout.getvalue()
+    finally:
+        sys.stdout = stdout
+        gen_utils.JOBS = jobs
+
+
+@utils.nose.test_in_tempdir
+def test_run_parallel():
+    """modules.utils.run_parallel: prints in order and counts the files the workers write"""
+    gen_utils.FILES.clear()
+    out = _run_parallel(4)
+
+    nt.eq_(out, ''.join('test{}\n'.format(i) for i in range(100)))
+    nt.eq_(gen_utils.FILES['written'], 100)
+    for i in range(100):
+        nt.eq_(_read('test{}'.format(i)), 'test{}'.format(i).encode('ascii'))
+
+
+@utils.nose.test_in_tempdir
+def test_run_parallel_one_job():
+    """modules.utils.run_parallel: works without workers"""
+    gen_utils.FILES.clear()
+    out = _run_parallel(1)
+
+    nt.eq_(out, ''.join('test{}\n'.format(i) for i in range(100)))
+    nt.eq_(gen_utils.FILES['written'], 100)
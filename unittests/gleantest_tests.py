@@ -32,7 +32,8 @@ except ImportError:
 import nose.tools as nt
 
 from framework.options import _Options as Options
-from framework.test import GleanTest
+from framework.test import GleanTest, MultiGleanTest, PiglitGLTest
+from framework.test import gleantest
 from . import utils
 from framework.test.base import TestIsSkip
 
@@ -112,3 +113,86 @@ def test_crash():
     test.interpret_result()
 
     nt.eq_(test.result.result, 'crash')
+
+
+def _program_test(prefix, name):
+    test = GleanTest(prefix)
+    test.env['PIGLIT_TEST'] = name
+    return test
+
+
+def test_batch_glean_tests():
+    """test.gleantest.batch_glean_tests: one batch per glean test"""
+    tests = [
+        ('glsl1-a', _program_test('glsl1', 'a')),
+        ('basic', GleanTest('basic')),
+        ('fp-a', _program_test('fragProg1', 'a')),
+        ('glsl1-b', _program_test('glsl1', 'b')),
+        ('other', PiglitGLTest(['other'])),
+        ('fp-b', _program_test('fragProg1', 'b')),
+        ('vp-a', _program_test('vertProg1', 'a')),
+    ]
+
+    batched = list(gleantest.batch_glean_tests(tests))
+
+    nt.eq_([n for n, _ in batched],
+           ['basic', 'other', 'glsl1-a', 'fp-a', 'vp-a'])
+    nt.assert_is_instance(batched[2][1], MultiGleanTest)
+    nt.eq_([n for n, _ in batched[2][1].tests], ['glsl1-a', 'glsl1-b'])
+    nt.ok_('PIGLIT_TEST' not in batched[2][1].env)
+    nt.assert_is_instance(batched[4][1], GleanTest)
+    nt.assert_not_is_instance(batched[4][1], MultiGleanTest)
+
+
+class TestMultiGleanTest(object):
+    """Tests for MultiGleanTest splitting the subtests of a glean run."""
+    def setup(self):
+        self.tests = [(n, _program_test('glsl1', n))
+                      for n in ['a test', 'b test', 'c test']]
+        self.test = MultiGleanTest(self.tests)
+
+    def _execute(self, out, returncode):
+        def run_command():
+            self.test.result.out = out
+            self.test.result.err = ''
+            self.test.result.returncode = returncode
+
+        opts = Options()
+        opts.env['PIGLIT_PLATFORM'] = 'glx'
+        with mock.patch('framework.test.gleantest.options.OPTIONS', opts), \
+                mock.patch('framework.test.base.options.OPTIONS', opts), \
+                mock.patch.object(self.test, '_run_command', run_command):
+            self.test.execute('a test', mock.Mock(), mock.Mock(), mock.Mock())
+
+    def test_results(self):
+        """test.gleantest.MultiGleanTest: tests get the result of their subtest"""
+        self._execute('PIGLIT: {"subtest": {"a test" : "pass"}}\n'
+                      'wrong color\n'
+                      'PIGLIT: {"subtest": {"b test" : "fail"}}\n'
+                      'PIGLIT: {"subtest": {"unknown" : "fail"}}\n'
+                      'PIGLIT: {"subtest": {"c test" : "skip"}}\n', 1)
+
+        nt.eq_([t.result.result for _, t in self.tests],
+               ['pass', 'fail', 'skip'])
+        nt.eq_(self.tests[1][1].result.out, 'wrong color')
+
+    def test_worst_result(self):
+        """test.gleantest.MultiGleanTest: a subtest run on several visuals gets the worst result"""
+        self._execute('PIGLIT: {"subtest": {"a test" : "fail"}}\n'
+                      'PIGLIT: {"subtest": {"a test" : "pass"}}\n', 1)
+
+        nt.eq_(self.tests[0][1].result.result, 'fail')
+
+    def test_crash(self):
+        """test.gleantest.MultiGleanTest: subtests that didn't run crashed"""
+        self._execute('PIGLIT: {"subtest": {"a test" : "pass"}}\n', -11)
+
+        nt.eq_([t.result.result for _, t in self.tests],
+               ['pass', 'crash', 'crash'])
+
+    def test_not_applicable(self):
+        """test.gleantest.MultiGleanTest: subtests that weren't reported are skipped"""
+        self._execute('glsl1:  skipped.  Requires GL 2.0 or later.\n', 0)
+
+        nt.eq_([t.result.result for _, t in self.tests],
+               ['skip', 'skip', 'skip'])
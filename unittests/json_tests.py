@@ -72,6 +72,7 @@ class TestJsonOutput(utils.nose.StaticDirectory):
         args.test_profile = ['fake.py']
         args.platform = 'gbm'
         args.log_level = 'verbose'
+        args.backend = 'json'
 
         backend = JSONBackend(cls.tdir, file_fsync=True)
         backend.initialize(_create_metadata(args, 'test'))
@@ -0,0 +1,155 @@
+# Copyright (c) 2017 The Piglit project
+
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# pylint: disable=missing-docstring,protected-access
+
+"""Tests for the jsonlog backend."""
+
+from __future__ import (
+    absolute_import, division, print_function, unicode_literals
+)
+import copy
+import os
+
+try:
+    import simplejson as json
+except ImportError:
+    import json
+import nose.tools as nt
+
+from framework import results, backends, grouptools, status
+from framework.backends import jsonlog
+from . import utils
+from .backends_tests import BACKEND_INITIAL_META
+
+
+def setup_module():
+    utils.piglit.set_compression('none')
+
+
+def teardown_module():
+    utils.piglit.unset_compression()
+
+
+def _write_run(tdir, finalize=True):
+    backend = jsonlog.JSONLogBackend(tdir)
+    backend.initialize(copy.deepcopy(BACKEND_INITIAL_META))
+    with backend.write_test(grouptools.join('a', 'b')) as t:
+        t(results.TestResult('pass'))
+    with backend.write_test(grouptools.join('a', 'c d')) as t:
+        t(results.TestResult('fail'))
+    if finalize:
+        backend.finalize({'time_elapsed': results.TimeAttribute(end=1.2)})
+    return backend
+
+
+def test_load():
+    """backends.jsonlog: a finished log loads with the latest results"""
+    with utils.nose.tempdir() as tdir:
+        _write_run(tdir)
+        run = backends.load(tdir)
+
+        nt.eq_(run.name, 'name')
+        nt.eq_(run.tests[grouptools.join('a', 'b')].result, status.PASS)
+        nt.eq_(run.tests[grouptools.join('a', 'c d')].result, status.FAIL)
+        nt.eq_(run.time_elapsed.end, 1.2)
+        nt.eq_(run.totals['root']['fail'], 1)
+
+
+def test_load_unfinished():
+    """backends.jsonlog: a test that didn't finish is incomplete"""
+    with utils.nose.tempdir() as tdir:
+        backend = _write_run(tdir, finalize=False)
+        with backend.write_test('crashed'):
+            pass
+        backend._log.flush()
+
+        run = backends.load(tdir)
+        nt.eq_(run.tests['crashed'].result, status.INCOMPLETE)
+
+
+def test_load_torn_record():
+    """backends.jsonlog: a record cut short ends the log"""
+    with utils.nose.tempdir() as tdir:
+        _write_run(tdir)
+        log = os.path.join(tdir, jsonlog.LOG_NAME)
+        with open(log, 'rb') as f:
+            data = f.read()
+        with open(log, 'wb') as f:
+            f.write(data[:-3])
+
+        run = backends.load(tdir)
+        nt.eq_(run.tests[grouptools.join('a', 'c d')].result, status.FAIL)
+        nt.eq_(run.time_elapsed.end, 0.0)
+
+
+def test_load_without_index():
+    """backends.jsonlog: the log can be read without its index"""
+    with utils.nose.tempdir() as tdir:
+        _write_run(tdir)
+        os.unlink(os.path.join(tdir, jsonlog.INDEX_NAME))
+
+        run = backends.load(tdir)
+        nt.eq_(run.tests[grouptools.join('a', 'b')].result, status.PASS)
+
+
+def test_index_behind_log():
+    """backends.jsonlog: records missing from the index are still read"""
+    with utils.nose.tempdir() as tdir:
+        _write_run(tdir)
+        index = os.path.join(tdir, jsonlog.INDEX_NAME)
+        with open(index, 'r') as f:
+            lines = f.readlines()
+        with open(index, 'w') as f:
+            f.writelines(lines[:2])
+
+        run = backends.load(tdir)
+        nt.eq_(run.tests[grouptools.join('a', 'c d')].result, status.FAIL)
+        nt.eq_(run.time_elapsed.end, 1.2)
+
+
+def test_resume_appends():
+    """backends.jsonlog: a second backend on the same log appends to it"""
+    with utils.nose.tempdir() as tdir:
+        _write_run(tdir)
+        backend = jsonlog.JSONLogBackend(tdir)
+        with backend.write_test(grouptools.join('a', 'b')) as t:
+            t(results.TestResult('warn'))
+        backend.finalize()
+
+        run = backends.load(tdir)
+        nt.eq_(run.tests[grouptools.join('a', 'b')].result, status.WARN)
+        nt.eq_(len(run.tests), 2)
+
+
+def test_write_json():
+    """backends.jsonlog.write_json: writes results the json backend loads"""
+    with utils.nose.tempdir() as tdir:
+        _write_run(tdir)
+        out = os.path.join(tdir, 'results.json')
+        jsonlog.write_json(tdir, out)
+
+        with open(out, 'r') as f:
+            data = json.load(f)
+        nt.eq_(data['totals']['root']['pass'], 1)
+
+        run = backends.load(out)
+        nt.eq_(run.tests[grouptools.join('a', 'c d')].result, status.FAIL)
+        nt.eq_(run.name, 'name')
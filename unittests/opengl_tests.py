@@ -23,7 +23,11 @@
 from __future__ import (
     absolute_import, division, print_function, unicode_literals
 )
+import json
+import os
+import shutil
 import subprocess
+import tempfile
 import textwrap
 
 try:
@@ -52,6 +56,8 @@ class TestWflInfo(object):
         self.__patchers.append(mock.patch.dict(
             'framework.test.opengl.OPTIONS.env',
             {'PIGLIT_PLATFORM': 'foo'}))
+        self.__patchers.append(mock.patch(
+            'framework.test.opengl._CAPABILITIES_BIN', '/does/not/exist'))
         self.__patchers.append(mock.patch(
             'framework.test.opengl.WflInfo._WflInfo__shared_state', {}))
 
@@ -218,6 +224,8 @@ class TestWflInfo_WAFFLEINFO_GL_ERROR(object):
         cls.__patchers.append(mock.patch.dict(
             'framework.test.opengl.OPTIONS.env',
             {'PIGLIT_PLATFORM': 'foo'}))
+        cls.__patchers.append(mock.patch(
+            'framework.test.opengl._CAPABILITIES_BIN', '/does/not/exist'))
 
         rv = textwrap.dedent("""\
             Waffle platform: glx
@@ -281,6 +289,8 @@ class TestWflInfoOSError(object):
         cls.__patchers.append(mock.patch.dict(
             'framework.test.opengl.OPTIONS.env',
             {'PIGLIT_PLATFORM': 'foo'}))
+        cls.__patchers.append(mock.patch(
+            'framework.test.opengl._CAPABILITIES_BIN', '/does/not/exist'))
         cls.__patchers.append(mock.patch(
             'framework.test.opengl.subprocess.check_output',
             mock.Mock(side_effect=OSError(2, 'foo'))))
@@ -334,6 +344,8 @@ class TestWflInfoCalledProcessError(object):
         cls.__patchers.append(mock.patch.dict(
             'framework.test.opengl.OPTIONS.env',
             {'PIGLIT_PLATFORM': 'foo'}))
+        cls.__patchers.append(mock.patch(
+            'framework.test.opengl._CAPABILITIES_BIN', '/does/not/exist'))
         cls.__patchers.append(mock.patch(
             'framework.test.opengl.subprocess.check_output',
             mock.Mock(side_effect=subprocess.CalledProcessError(1, 'foo'))))
@@ -377,6 +389,102 @@ class TestWflInfoCalledProcessError(object):
         self.inst.glsl_es_version
 
 
+class TestWflInfoCapabilities(object):
+    """Tests for WflInfo using piglit-capabilities and its cache."""
+    __patchers = []
+
+    caps = {
+        'platform': 'glx',
+        'contexts': {
+            'gl core': {'version': '4.5 (Core Profile) Mesa 17.0.0',
+                        'glsl': '4.50',
+                        'extensions': ['GL_foo', 'GL_bar']},
+            'gl compat': {'version': '3.0 Mesa 17.0.0',
+                          'glsl': '1.30',
+                          'extensions': ['GL_baz']},
+            'gles2': {'version': 'OpenGL ES 3.2 Mesa 17.0.0',
+                      'glsl': 'OpenGL ES GLSL ES 3.20',
+                      'extensions': ['GL_OES_foo']},
+        },
+        'libraries': [],
+    }
+
+    def setup(self):
+        self.tdir = tempfile.mkdtemp()
+        binary = os.path.join(self.tdir, 'piglit-capabilities')
+        open(binary, 'w').close()
+
+        self.check_output = mock.Mock(
+            return_value=json.dumps(self.caps).encode('utf-8'))
+        self.__patchers = [
+            mock.patch.dict('framework.test.opengl.OPTIONS.env',
+                            {'PIGLIT_PLATFORM': 'glx'}),
+            mock.patch.dict('os.environ', {'XDG_CACHE_HOME': self.tdir}),
+            mock.patch('framework.test.opengl.WflInfo._WflInfo__shared_state',
+                       {}),
+            mock.patch('framework.test.opengl.subprocess.check_output',
+                       self.check_output),
+            mock.patch('framework.test.opengl._CAPABILITIES_BIN', binary),
+        ]
+        for f in self.__patchers:
+            f.start()
+
+    def teardown(self):
+        for f in self.__patchers:
+            f.stop()
+        shutil.rmtree(self.tdir)
+
+    def test_gl_extensions(self):
+        """test.opengl.WflInfo.gl_extensions: is the union of all contexts
+        from piglit-capabilities
+        """
+        nt.eq_(opengl.WflInfo().gl_extensions,
+               {'GL_foo', 'GL_bar', 'GL_baz', 'GL_OES_foo'})
+
+    def test_versions(self):
+        """test.opengl.WflInfo: versions come from piglit-capabilities"""
+        info = opengl.WflInfo()
+        nt.eq_(info.gl_version, 4.5)
+        nt.eq_(info.glsl_version, 4.5)
+        nt.eq_(info.gles_version, 3.2)
+        nt.eq_(info.glsl_es_version, 3.2)
+
+    def test_single_call(self):
+        """test.opengl.WflInfo: piglit-capabilities is only run once"""
+        info = opengl.WflInfo()
+        info.gl_extensions
+        info.gl_version
+        info.gles_version
+        nt.eq_(self.check_output.call_count, 1)
+
+    def test_cache(self):
+        """test.opengl.WflInfo: a second run is served from the cache"""
+        opengl.WflInfo().gl_version
+        with mock.patch(
+                'framework.test.opengl.WflInfo._WflInfo__shared_state', {}):
+            nt.eq_(opengl.WflInfo().gl_version, 4.5)
+        nt.eq_(self.check_output.call_count, 1)
+
+    def test_cache_key_env(self):
+        """test.opengl.WflInfo: the cache is keyed on driver variables"""
+        opengl.WflInfo().gl_version
+        with mock.patch(
+                'framework.test.opengl.WflInfo._WflInfo__shared_state', {}):
+            with mock.patch.dict('os.environ', {'MESA_GL_VERSION_OVERRIDE':
+                                                '3.3'}):
+                opengl.WflInfo().gl_version
+        nt.eq_(self.check_output.call_count, 2)
+
+    def test_failure_falls_back(self):
+        """test.opengl.WflInfo: falls back to wflinfo when
+        piglit-capabilities fails
+        """
+        self.check_output.side_effect = [
+            subprocess.CalledProcessError(1, 'piglit-capabilities'),
+            b'OpenGL version string: 2.1 Mesa 11.0.4\n']
+        nt.eq_(opengl.WflInfo().gl_version, 2.1)
+
+
 class TestFastSkipMixin(object):
     """Tests for the FastSkipMixin class."""
     __patchers = []
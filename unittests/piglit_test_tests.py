@@ -29,11 +29,15 @@ try:
 except ImportError:
     import mock
 
+import os
+import time
+
 import nose.tools as nt
 
 from . import utils
 from framework.options import _Options as Options
-from framework.test.base import TestIsSkip
+from framework.test import piglit_test
+from framework.test.base import TestIsSkip, TestRunError
 from framework.test.piglit_test import (PiglitBaseTest, PiglitGLTest,
                                         PiglitCLTest)
 
@@ -69,6 +73,19 @@ def test_piglittest_interpret_result_subtest():
     nt.eq_(test.result.subtests['subtest'], 'pass')
 
 
+def test_piglittest_interpret_result_phase_times():
+    """test.piglit_test.PiglitBaseTest.interpret_result(): parses phase times"""
+    test = PiglitBaseTest(['foo'])
+    test.result.out = (
+        'PIGLIT: {"result": "pass"}\n'
+        'PIGLIT: {"phase_times": {"init": 0.5, "display": 0.25}}\n')
+    test.result.returncode = 0
+    test.interpret_result()
+    nt.eq_(test.result.result, 'pass')
+    nt.eq_(test.result.phase_times, {'init': 0.5, 'display': 0.25})
+    nt.ok_('phase_times' not in test.result.out)
+
+
 def test_piglitest_no_clobber():
     """test.piglit_test.PiglitBaseTest.interpret_result(): does not clobber subtest entires"""
     test = PiglitBaseTest(['a', 'command'])
@@ -138,3 +155,169 @@ def test_PiglitGLTest_platform_not_in_exclude(mock_opts):
     mock_opts.env['PIGLIT_PLATFORM'] = 'gbm'
     test = PiglitGLTest(['foo'], exclude_platforms=['glx'])
     test.is_skip()
+
+
+def _list_subtests(text):
+    """Run list_subtests() on a shell script standing in for a test."""
+    with utils.nose.tempdir() as tdir:
+        path = os.path.join(tdir, 'foo')
+        with open(path, 'w') as f:
+            f.write('#!/bin/sh\n' + text)
+        os.chmod(path, 0o755)
+        return piglit_test.list_subtests(PiglitGLTest([path]))
+
+
+@utils.nose.Skip.platform('linux')
+def test_list_subtests():
+    """test.piglit_test.list_subtests: returns options and names"""
+    nt.eq_(_list_subtests('echo \'PIGLIT: {"subtests": 2}\'\n'
+                          'echo "a: first"\necho "b: second one"\n'),
+           [('a', 'first'), ('b', 'second one')])
+
+
+@utils.nose.Skip.platform('linux')
+def test_list_subtests_none():
+    """test.piglit_test.list_subtests: tests without subtests have none"""
+    nt.eq_(_list_subtests('exit 1\n'), [])
+
+
+@utils.nose.Skip.platform('linux')
+def test_list_subtests_no_marker():
+    """test.piglit_test.list_subtests: ignores tests that don't print the
+    framework's count line
+    """
+    nt.eq_(_list_subtests('echo "foo: bar"\n'), [])
+
+
+@utils.nose.Skip.platform('linux')
+def test_list_subtests_wrong_count():
+    """test.piglit_test.list_subtests: ignores lists that don't match their
+    count
+    """
+    nt.eq_(_list_subtests('echo \'PIGLIT: {"subtests": 1}\'\n'
+                          'echo "a: first"\necho "b: second"\n'), [])
+
+
+@utils.nose.Skip.platform('linux')
+@mock.patch('framework.test.piglit_test.LIST_SUBTESTS_TIMEOUT', 0.2)
+def test_list_subtests_hang():
+    """test.piglit_test.list_subtests: kills tests that hang"""
+    start = time.time()
+    nt.eq_(_list_subtests('exec sleep 10\n'), [])
+    nt.ok_(time.time() - start < 5)
+
+
+def test_shardedtest_shards():
+    """test.piglit_test.ShardedTest: deals the subtests out to the shards"""
+    group = piglit_test.ShardedTest(
+        PiglitGLTest(['foo']), [('a', 'A'), ('b', 'B'), ('c', 'C')], 2)
+    nt.eq_([s.test.command for s in group.shards],
+           [[os.path.join(piglit_test.TEST_BIN_DIR, 'foo'), '-subtest', 'a',
+             '-subtest', 'c', '-auto', '-fbo'],
+            [os.path.join(piglit_test.TEST_BIN_DIR, 'foo'), '-subtest', 'b',
+             '-auto', '-fbo']])
+
+
+def test_shardedtest_merge():
+    """test.piglit_test.ShardedTest.merge: merges the subtests of the shards"""
+    group = piglit_test.ShardedTest(
+        PiglitGLTest(['foo']), [('a', 'A'), ('b', 'B'), ('c', 'C')], 2)
+    first, second = (s.test.result for s in group.shards)
+    first.subtests['A'] = 'pass'
+    first.result = 'crash'
+    first.returncode = -11
+    second.subtests['B'] = 'fail'
+    second.returncode = 1
+    group.merge()
+
+    result = group.test.result
+    nt.eq_(result.subtests, {'A': 'pass', 'B': 'fail', 'C': 'crash'})
+    nt.eq_(result.result, 'crash')
+    nt.eq_(result.returncode, -11)
+
+
+def test_shardedtest_merge_no_subtests():
+    """test.piglit_test.ShardedTest.merge: shards that skipped add no subtests"""
+    group = piglit_test.ShardedTest(
+        PiglitGLTest(['foo']), [('a', 'A'), ('b', 'B')], 2)
+    for shard in group.shards:
+        shard.test.result.result = 'skip'
+    group.merge()
+
+    nt.eq_(group.test.result.subtests, {})
+    nt.eq_(group.test.result.result, 'skip')
+
+
+@mock.patch('framework.test.base.options.OPTIONS', new_callable=Options)
+def test_subtestshard_no_golden_hashes(mock_opts):
+    """test.piglit_test.SubtestShard: shards don't use golden hashes"""
+    mock_opts.golden_hashes = 'golden'
+    group = piglit_test.ShardedTest(
+        PiglitGLTest(['foo']), [('a', 'A'), ('b', 'B')], 2)
+    shard = group.shards[0]
+    shard.test.run = mock.Mock()
+
+    with mock.patch.object(group, 'finish'):
+        shard.execute('spec@foo', mock.Mock(), mock.Mock(), mock.Mock())
+
+    nt.ok_('PIGLIT_GOLDEN_HASH_FILE' not in shard.test.env)
+
+
+@mock.patch('framework.test.piglit_test.list_subtests')
+def test_shard_subtests(mock_list):
+    """test.piglit_test.shard_subtests: shards tests, caching their subtests"""
+    mock_list.side_effect = lambda t: ([('a', 'A'), ('b', 'B')]
+                                       if 'many' in t.command[0] else [])
+
+    with utils.nose.tempdir() as tdir:
+        for name in ['one', 'many']:
+            open(os.path.join(tdir, name), 'w').close()
+        tests = [
+            ('one', PiglitGLTest([os.path.join(tdir, 'one')])),
+            ('many', PiglitGLTest([os.path.join(tdir, 'many')])),
+            ('serial', PiglitGLTest([os.path.join(tdir, 'many')],
+                                    run_concurrent=False)),
+        ]
+        with mock.patch.dict('os.environ', {'XDG_CACHE_HOME': tdir}):
+            sharded = list(piglit_test.shard_subtests(tests, 4))
+            nt.eq_(mock_list.call_count, 2)
+            list(piglit_test.shard_subtests(tests, 4))
+            nt.eq_(mock_list.call_count, 2)
+
+    nt.eq_([n for n, _ in sharded], ['one', 'many', 'many', 'serial'])
+    nt.assert_is_instance(sharded[1][1], piglit_test.SubtestShard)
+    nt.eq_(len(sharded[1][1].group.shards), 2)
+
+
+@mock.patch('framework.test.piglit_test.zygote.get', return_value=None)
+def test_zygote_module_no_zygote(_):
+    """test.piglit_test.PiglitBaseTest: runs the binary without a zygote"""
+    nt.eq_(PiglitBaseTest(['foo'])._zygote_module(), None)
+
+
+@mock.patch('framework.test.piglit_test.zygote.get')
+def test_run_command_zygote_unreachable(mock_get):
+    """test.piglit_test.PiglitBaseTest: runs the binary if the zygote is gone"""
+    mock_get.return_value.run.side_effect = \
+        piglit_test.zygote.ZygoteUnreachable('gone')
+    test = PiglitBaseTest(['foo'])
+
+    with mock.patch.object(test, '_zygote_module', return_value='foo.so'), \
+            mock.patch('framework.test.base.Test._run_command') as mock_run:
+        test._run_command()
+
+    nt.eq_(mock_run.call_count, 1)
+
+
+@mock.patch('framework.test.piglit_test.zygote.get')
+def test_run_command_zygote_error(mock_get):
+    """test.piglit_test.PiglitBaseTest: a zygote lost during the test fails it"""
+    mock_get.return_value.run.side_effect = \
+        piglit_test.zygote.ZygoteError('closed')
+    test = PiglitBaseTest(['foo'])
+
+    with mock.patch.object(test, '_zygote_module', return_value='foo.so'):
+        with nt.assert_raises(TestRunError) as e:
+            test._run_command()
+
+    nt.eq_(e.exception.status, 'fail')
@@ -0,0 +1,108 @@
+# Copyright (c) 2017 The Piglit project
+
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""Tests for framework.profile_index."""
+
+from __future__ import (
+    absolute_import, division, print_function, unicode_literals
+)
+import io
+import os
+import shutil
+import tempfile
+
+try:
+    from unittest import mock
+except ImportError:
+    import mock
+
+import nose.tools as nt
+
+from framework import grouptools, profile, profile_index
+from framework.test import ShaderTest
+
+_SHADER_TEST = """\
+[require]
+GL >= 1.0
+GL_ARB_foo
+
+[vertex shader passthrough]
+"""
+
+
+class TestAddShaderTests(object):
+    """Tests for profile_index.add_shader_tests."""
+    def setup(self):
+        self.tdir = tempfile.mkdtemp()
+        self.tests = os.path.join(self.tdir, 'tests')
+        os.makedirs(os.path.join(self.tests, 'spec', 'foo'))
+        self.write('a.shader_test', _SHADER_TEST)
+        self.write('b.vert', '// no config, a legacy test\n')
+
+        self.__patchers = [
+            mock.patch.dict('os.environ',
+                            {'XDG_CACHE_HOME': os.path.join(self.tdir, 'c')}),
+            mock.patch('framework.profile_index._DISABLED', False),
+        ]
+        for f in self.__patchers:
+            f.start()
+
+    def teardown(self):
+        for f in self.__patchers:
+            f.stop()
+        shutil.rmtree(self.tdir)
+
+    def write(self, name, contents):
+        with io.open(os.path.join(self.tests, 'spec', 'foo', name), 'w',
+                     encoding='utf-8') as f:
+            f.write(contents)
+
+    def add(self):
+        test_list = profile.TestDict()
+        profile_index.add_shader_tests(test_list, self.tests)
+        return test_list
+
+    def test_adds_tests(self):
+        """profile_index.add_shader_tests: adds shader tests by path"""
+        test_list = self.add()
+        name = grouptools.join('spec', 'foo', 'a')
+        nt.eq_(list(test_list), [name])
+        nt.ok_(isinstance(test_list[name], ShaderTest))
+        nt.eq_(test_list[name].gl_required, {'GL_ARB_foo'})
+
+    def test_cached(self):
+        """profile_index.add_shader_tests: unchanged files aren't parsed
+        again
+        """
+        self.add()
+        with mock.patch('framework.profile_index._make_test') as make:
+            test_list = self.add()
+            nt.eq_(make.call_count, 0)
+        nt.eq_(test_list[grouptools.join('spec', 'foo', 'a')].gl_required,
+               {'GL_ARB_foo'})
+
+    def test_changed(self):
+        """profile_index.add_shader_tests: changed files are parsed again"""
+        self.add()
+        self.write('a.shader_test', _SHADER_TEST.replace('foo', 'barbaz'))
+        test_list = self.add()
+        nt.eq_(test_list[grouptools.join('spec', 'foo', 'a')].gl_required,
+               {'GL_ARB_barbaz'})
@@ -374,3 +374,68 @@ def test_testdict_update_reassignment():
     td2['test1'] = test2
 
     td1.update(td2)
+
+
+def test_testdict_add_lazy_not_loaded():
+    """profile.TestDict.add_lazy: the test isn't created until looked up"""
+    load = mock.Mock(return_value=utils.piglit.Test(['test1']))
+    td = profile.TestDict()
+    td.add_lazy('a/Test1', load)
+
+    nt.ok_('a/test1' in td)
+    nt.eq_(load.call_count, 0)
+    nt.eq_(td['a/test1'].command, ['test1'])
+    td['a/test1']
+    nt.eq_(load.call_count, 1)
+
+
+@nt.raises(exceptions.PiglitFatalError)
+def test_testdict_add_lazy_reassignment():
+    """profile.TestDict.add_lazy: Does not allow reassignment"""
+    td = profile.TestDict()
+    td['test1'] = utils.piglit.Test(['test1'])
+    td.add_lazy('test1', mock.Mock())
+
+
+def test_prepare_test_list_lazy():
+    """profile.TestProfile.prepare_test_list: tests removed by -t and -x are
+    not created
+    """
+    wanted = mock.Mock(return_value=utils.piglit.Test(['wanted']))
+    unwanted = mock.Mock(return_value=utils.piglit.Test(['unwanted']))
+
+    profile_ = profile.TestProfile()
+    profile_.test_list.add_lazy('group/wanted', wanted)
+    profile_.test_list.add_lazy('group/unwanted', unwanted)
+    profile_.filter_tests(lambda _, t: True)
+
+    with mock.patch('framework.profile.options.OPTIONS',
+                    new_callable=options._Options) as opts:
+        opts.include_filter = ['group/wanted']
+        profile_._prepare_test_list()
+
+    nt.eq_(list(profile_.test_list), ['group/wanted'])
+    nt.eq_(wanted.call_count, 1)
+    nt.eq_(unwanted.call_count, 0)
+
+
+def test_run_survives_test_exception():
+    """profile.TestProfile.run: an exception from one test doesn't stop the
+    tests after it
+    """
+    profile_ = profile.TestProfile()
+    profile_.test_list['group/broken'] = utils.piglit.Test(['broken'])
+    profile_.test_list['group/fine'] = utils.piglit.Test(['fine'])
+    broken = profile_.test_list['group/broken']
+    fine = profile_.test_list['group/fine']
+    broken.execute = mock.Mock(side_effect=RuntimeError('broken'))
+    fine.execute = mock.Mock()
+
+    with mock.patch('framework.profile.options.OPTIONS',
+                    new_callable=options._Options) as opts, \
+            mock.patch('framework.profile.sys.stderr'):
+        opts.jobs = 1
+        profile_.run('dummy', mock.MagicMock())
+
+    nt.eq_(broken.execute.call_count, 1)
+    nt.eq_(fine.execute.call_count, 1)
@@ -231,6 +231,7 @@ class TestTestResult_to_json(object):
         test.exception = 'an exception'
         test.dmesg = 'this is dmesg'
         test.pid = 1934
+        test.phase_times = {'init': 0.25, 'display': 0.5}
         test.traceback = 'a traceback'
 
         cls.test = test
@@ -285,6 +286,10 @@ class TestTestResult_to_json(object):
         """results.TestResult.to_json: Adds the pid attribute"""
         nt.eq_(self.test.pid, self.json['pid'])
 
+    def test_phase_times(self):
+        """results.TestResult.to_json: Adds the phase_times attribute"""
+        nt.eq_(self.test.phase_times, self.json['phase_times'])
+
     def test_traceback(self):
         """results.TestResult.to_json: Adds the traceback attribute"""
         nt.eq_(self.test.traceback, self.json['traceback'])
@@ -311,6 +316,7 @@ class TestTestResult_from_dict(object):
             'exception': 'an exception',
             'dmesg': 'this is dmesg',
             'pid': 1934,
+            'phase_times': {'init': 0.25, 'display': 0.5},
         }
 
         cls.test = results.TestResult.from_dict(cls.dict)
@@ -367,6 +373,10 @@ class TestTestResult_from_dict(object):
         """results.TestResult.from_dict: sets pid properly"""
         nt.eq_(self.test.pid, self.dict['pid'])
 
+    def test_phase_times(self):
+        """results.TestResult.from_dict: sets phase_times properly"""
+        nt.eq_(self.test.phase_times, self.dict['phase_times'])
+
 
 def test_TestResult_update():
     """results.TestResult.update: result is updated"""
@@ -382,6 +392,14 @@ def test_TestResult_update_subtests():
     nt.eq_(test.subtests['result'], 'incomplete')
 
 
+def test_TestResult_update_phase_times():
+    """results.TestResult.update: phase times are set"""
+    test = results.TestResult('pass')
+    test.update({'phase_times': {'init': 0.5}})
+    nt.eq_(test.result, 'pass')
+    nt.eq_(test.phase_times, {'init': 0.5})
+
+
 class TestStringDescriptor(object):
     """Test class for StringDescriptor."""
     @classmethod
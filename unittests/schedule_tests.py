@@ -0,0 +1,180 @@
+# Copyright (c) 2017 The Piglit project
+
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Tests for framework.schedule."""
+
+from __future__ import (
+    absolute_import, division, print_function, unicode_literals
+)
+import threading
+
+try:
+    from unittest import mock
+except ImportError:
+    import mock
+
+import nose.tools as nt
+
+from . import utils
+from framework import schedule, results
+
+
+def _tests(*specs):
+    """Make (name, test) pairs from (name, run_concurrent) pairs."""
+    pairs = []
+    for name, concurrent in specs:
+        test = utils.piglit.Test(['foo'])
+        test.run_concurrent = concurrent
+        pairs.append((name, test))
+    return pairs
+
+
+def _drain(sched):
+    names = []
+    while True:
+        pair = sched.next()
+        if pair is None:
+            return names
+        names.append(pair[0])
+        sched.done(pair)
+
+
+def test_no_durations_keeps_order():
+    """schedule.Scheduler: without durations tests keep profile order"""
+    sched = schedule.Scheduler(_tests(('a', True), ('b', True), ('c', True)))
+    nt.eq_(_drain(sched), ['a', 'b', 'c'])
+
+
+def test_longest_first():
+    """schedule.Scheduler: tests are handed out longest first"""
+    sched = schedule.Scheduler(_tests(('a', True), ('b', True), ('c', True)),
+                               {'a': 1.0, 'b': 5.0, 'c': 3.0})
+    nt.eq_(_drain(sched), ['b', 'c', 'a'])
+
+
+def test_unknown_uses_median():
+    """schedule.Scheduler: tests without a time are expected to take the
+    median time
+    """
+    sched = schedule.Scheduler(_tests(('new', True)),
+                               {'a': 1.0, 'b': 2.0, 'c': 9.0})
+    nt.eq_(sched.expected(('new', None)), 2.0)
+
+
+def test_serial_waits_for_idle():
+    """schedule.Scheduler: a serial test only starts when nothing runs"""
+    now = [0.0]
+    sched = schedule.Scheduler(_tests(('a', True), ('s', False), ('b', True)),
+                               {'a': 3.0, 's': 2.0, 'b': 1.0}, jobs=2)
+    with mock.patch('framework.schedule._now', lambda: now[0]):
+        first = sched.next()
+        nt.eq_(first[0], 'a')
+
+        # b would end after a, so it doesn't get to fill the wait for s
+        now[0] = 2.5
+        started = []
+        thread = threading.Thread(target=lambda: started.append(sched.next()))
+        thread.start()
+        thread.join(0.1)
+        nt.eq_(started, [], msg='a test started while a serial test waited')
+
+        sched.done(first)
+        thread.join()
+        nt.eq_(started[0][0], 's')
+
+        thread = threading.Thread(target=lambda: started.append(sched.next()))
+        thread.start()
+        thread.join(0.1)
+        nt.eq_(len(started), 1, msg='a test started next to a serial test')
+
+        sched.done(started[0])
+        thread.join()
+        nt.eq_(started[1][0], 'b')
+
+
+def test_serial_before_concurrent_tail():
+    """schedule.Scheduler: serial tests run in longest first order, before
+    the short concurrent tests, which fill the wait for them
+    """
+    now = [0.0]
+    shorts = ['x{}'.format(i) for i in range(8)]
+    durations = dict({'a': 10.0, 's': 5.0}, **{n: 2.0 for n in shorts})
+    sched = schedule.Scheduler(
+        _tests(('a', True), ('s', False), *[(n, True) for n in shorts]),
+        durations, jobs=2)
+    # a and 5 shorts fill the first 10s, s runs alone, then the last shorts
+    nt.eq_(sched.expected_makespan(), 19.0)
+
+    with mock.patch('framework.schedule._now', lambda: now[0]):
+        a = sched.next()
+        order = [a[0]]
+        for _ in range(5):
+            pair = sched.next()
+            order.append(pair[0])
+            now[0] += 2.0
+            sched.done(pair)
+        sched.done(a)
+        order.extend(_drain(sched))
+
+    nt.eq_(order, ['a', 'x7', 'x6', 'x5', 'x4', 'x3', 's', 'x0', 'x1', 'x2'])
+
+
+def test_serial_last_without_durations():
+    """schedule.Scheduler: without durations serial tests run last"""
+    sched = schedule.Scheduler(_tests(('s', False), ('a', True), ('b', True)),
+                               jobs=2)
+    nt.eq_(_drain(sched), ['a', 'b', 's'])
+
+
+def test_concurrent_none():
+    """schedule.Scheduler: concurrent='none' uses a single job"""
+    sched = schedule.Scheduler(_tests(('a', True)), jobs=8,
+                               concurrent='none')
+    nt.eq_(sched.jobs, 1)
+
+
+def test_stop():
+    """schedule.Scheduler: next() returns None after stop()"""
+    sched = schedule.Scheduler(_tests(('a', True), ('b', True)))
+    sched.stop()
+    nt.eq_(sched.next(), None)
+
+
+def test_expected_makespan():
+    """schedule.Scheduler.expected_makespan: follows the schedule next()
+    hands out
+    """
+    sched = schedule.Scheduler(
+        _tests(('a', True), ('b', True), ('c', True), ('s', False)),
+        {'a': 4.0, 'b': 3.0, 'c': 2.0, 's': 1.0}, jobs=2)
+    # a on one worker, b then c on the other, then s once c is done
+    nt.eq_(sched.expected_makespan(), 6.0)
+
+
+def test_load_durations():
+    """schedule.load_durations: returns the time of each test"""
+    run = results.TestrunResult()
+    run.tests['a'] = results.TestResult('pass')
+    run.tests['a'].time = results.TimeAttribute(1.0, 3.5)
+    run.tests['b'] = results.TestResult('pass')
+
+    with mock.patch('framework.schedule.backends.load',
+                    mock.Mock(return_value=run)):
+        nt.eq_(schedule.load_durations('foo'), {'a': 2.5})
@@ -34,6 +34,7 @@ import nose.tools as nt
 
 from framework import exceptions
 import framework.test as testm
+from framework.test.base import golden_hash_file
 from . import utils
 
 # pylint: disable=invalid-name
@@ -203,3 +204,210 @@ def test_ignore_shader_runner_directives():
                                 ignore))
 
         yield test, config
+
+
+def _shader_test(data, filename='null'):
+    with mock.patch('framework.test.shader_test.io.open',
+                    mock.mock_open(read_data=data)):
+        return testm.ShaderTest(filename)
+
+
+def test_context_glsl_promotes_gl():
+    """test.shader_test.ShaderTest: GLSL requirement promotes the context"""
+    test = _shader_test('[require]\n'
+                        'GL >= 2.0\n'
+                        'GLSL >= 1.50\n')
+    nt.eq_(test.context[1:], ('core-or-compat', 32, None, False))
+
+
+def test_context_old_gl_is_compat():
+    """test.shader_test.ShaderTest: GL < 3.1 tests share one compat context"""
+    a = _shader_test('[require]\nGL >= 2.0\nGLSL >= 1.10\n')
+    b = _shader_test('[require]\nGLSL >= 1.20\nGL_ARB_foo\n[test]\n')
+    nt.eq_(a.context, b.context)
+
+
+def test_context_size_and_depth():
+    """test.shader_test.ShaderTest: SIZE and depthbuffer are part of the context"""
+    test = _shader_test('[require]\n'
+                        'GL CORE >= 3.3\n'
+                        'SIZE 32 64\n'
+                        'depthbuffer\n'
+                        '[test]\n'
+                        'SIZE 1 1\n')
+    nt.eq_(test.context[1:], ('core', 33, (32, 64), True))
+
+
+def test_batch_shader_tests_groups_by_context():
+    """test.shader_test.batch_shader_tests: groups tests with the same context"""
+    compat = '[require]\nGL >= 2.0\n[test]\n'
+    core = '[require]\nGL CORE >= 3.2\n[test]\n'
+    tests = [
+        ('a', _shader_test(compat, 'a')),
+        ('b', _shader_test(core, 'b')),
+        ('c', _shader_test(compat, 'c')),
+        ('d', testm.PiglitGLTest(['d'])),
+    ]
+
+    batched = list(testm.batch_shader_tests(tests, 10))
+
+    nt.eq_([n for n, _ in batched], ['d', 'a', 'b'])
+    nt.assert_is_instance(batched[1][1], testm.MultiShaderTest)
+    nt.eq_([n for n, _ in batched[1][1].tests], ['a', 'c'])
+    nt.assert_is_instance(batched[2][1], testm.ShaderTest)
+
+
+def test_no_program_cache_linker():
+    """test.shader_test.ShaderTest: linker tests bypass the program cache"""
+    test = _shader_test('[require]\nGL >= 2.0\n[test]\n',
+                        'spec/glsl-1.10/linker/foo.shader_test')
+    nt.eq_(test.env.get('PIGLIT_NO_PROGRAM_CACHE'), '1')
+
+
+def test_program_cache_execution():
+    """test.shader_test.ShaderTest: other tests use the program cache"""
+    test = _shader_test('[require]\nGL >= 2.0\n[test]\n',
+                        'spec/glsl-1.10/execution/linker.shader_test')
+    nt.ok_('PIGLIT_NO_PROGRAM_CACHE' not in test.env)
+
+
+def test_expect_result_fail():
+    """test.shader_test.ShaderTest: expect_result: fail swaps pass and fail"""
+    test = _shader_test('# expect_result: fail\n[require]\nGL >= 2.0\n')
+    test.result.returncode = 1
+    test.result.out = 'PIGLIT: {"result": "fail"}\n'
+    test.interpret_result()
+    nt.eq_(test.result.result, 'pass')
+
+
+def test_expect_result_fail_crash():
+    """test.shader_test.ShaderTest: expect_result: fail still reports crashes"""
+    test = _shader_test('# expect_result: fail\n[require]\nGL >= 2.0\n')
+    test.result.returncode = -11
+    test.result.out = ''
+    test.interpret_result()
+    nt.eq_(test.result.result, 'crash')
+
+
+def test_expect_result_default():
+    """test.shader_test.ShaderTest: a failing test fails by default"""
+    test = _shader_test('[require]\nGL >= 2.0\n')
+    test.result.returncode = 1
+    test.result.out = 'PIGLIT: {"result": "fail"}\n'
+    test.interpret_result()
+    nt.eq_(test.result.result, 'fail')
+
+
+def test_expect_result_invalid():
+    """test.shader_test.ShaderTest: expect_result must be pass or fail"""
+    with nt.assert_raises(exceptions.PiglitFatalError):
+        _shader_test('# expect_result: warn\n[require]\nGL >= 2.0\n')
+
+
+def test_batch_shader_tests_env():
+    """test.shader_test.batch_shader_tests: tests with different env are not batched"""
+    data = '[require]\nGL >= 2.0\n[test]\n'
+    tests = [(n, _shader_test(data, n)) for n in 'abc']
+    tests[1][1].env['FOO'] = 'bar'
+
+    batched = list(testm.batch_shader_tests(tests, 10))
+
+    nt.eq_([n for n, _ in batched], ['a', 'b'])
+    nt.eq_([n for n, _ in batched[0][1].tests], ['a', 'c'])
+
+
+def test_batch_shader_tests_size():
+    """test.shader_test.batch_shader_tests: batches are no larger than size"""
+    data = '[require]\nGL >= 2.0\n'
+    tests = [(n, _shader_test(data, n)) for n in 'abcde']
+
+    batched = list(testm.batch_shader_tests(tests, 2))
+
+    nt.eq_([len(t.tests) if isinstance(t, testm.MultiShaderTest) else 1
+            for _, t in batched], [2, 2, 1])
+
+
+class TestMultiShaderTest(object):
+    """Tests for MultiShaderTest splitting shader_runner output."""
+    @classmethod
+    def setup_class(cls):
+        cls.data = '[require]\nGL >= 2.0\n'
+
+    def setup(self):
+        self.tests = [(n, _shader_test(self.data, n)) for n in 'abc']
+        self.test = testm.MultiShaderTest(self.tests)
+
+    def _run(self, outputs):
+        """Fake one shader_runner process per (out, err, returncode)."""
+        outputs = iter(outputs)
+        commands = []
+
+        def run_command():
+            commands.append(list(self.test.command))
+            out, err, returncode = next(outputs)
+            self.test.result.out = out
+            self.test.result.err = err
+            self.test.result.returncode = returncode
+
+        with mock.patch.object(self.test, '_run_command', run_command):
+            self.test.run()
+        return commands
+
+    def test_one_process(self):
+        """test.shader_test.MultiShaderTest: results are split per test"""
+        out = ('PIGLIT TEST: 0 - a\n'
+               'PIGLIT: {"result": "pass" }\n'
+               'PIGLIT TEST: 1 - b\n'
+               'probe failed\n'
+               'PIGLIT: {"result": "fail" }\n'
+               'PIGLIT TEST: 2 - c\n'
+               'PIGLIT: {"result": "skip" }\n')
+        self._run([(out, '', 1)])
+
+        nt.eq_([t.result.result for _, t in self.tests],
+               ['pass', 'fail', 'skip'])
+        nt.eq_(self.tests[1][1].result.out, 'probe failed\n')
+
+    def test_restart_after_exit(self):
+        """test.shader_test.MultiShaderTest: restarts after a script exits"""
+        first = ('PIGLIT TEST: 0 - a\n'
+                 'PIGLIT: {"result": "pass" }\n'
+                 'PIGLIT TEST: 1 - b\n')
+        second = ('PIGLIT TEST: 0 - c\n'
+                  'PIGLIT: {"result": "pass" }\n')
+        commands = self._run([(first, '', -11), (second, '', 0)])
+
+        nt.eq_([t.result.result for _, t in self.tests],
+               ['pass', 'crash', 'pass'])
+        nt.eq_(commands[1][1:], ['c', '-auto'])
+
+    def test_no_marker(self):
+        """test.shader_test.MultiShaderTest: output without a marker goes to the first test"""
+        self._run([('', 'could not create context\n', 1),
+                   ('PIGLIT TEST: 0 - b\nPIGLIT: {"result": "pass" }\n'
+                    'PIGLIT TEST: 1 - c\nPIGLIT: {"result": "pass" }\n',
+                    '', 0)])
+
+        nt.eq_([t.result.result for _, t in self.tests],
+               ['fail', 'pass', 'pass'])
+
+    @mock.patch('framework.test.shader_test.options.OPTIONS.golden_hashes',
+                'golden')
+    def test_golden_hash_files(self):
+        """test.shader_test.MultiShaderTest: names each script's golden hash file"""
+        files = []
+
+        def run_command():
+            files.append(self.test.env['PIGLIT_GOLDEN_HASH_FILES'])
+            self.test.result.out = 'PIGLIT TEST: 0 - a\n'
+            self.test.result.err = ''
+            self.test.result.returncode = -11
+
+        with mock.patch.object(self.test, '_run_command', run_command):
+            self.test.run()
+
+        nt.eq_(files, [
+            os.pathsep.join(golden_hash_file(n) for n in 'abc'),
+            os.pathsep.join(golden_hash_file(n) for n in 'bc'),
+            golden_hash_file('c'),
+        ])
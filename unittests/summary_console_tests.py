@@ -139,6 +139,31 @@ class Test_print_summary(object):
             yield test, value
 
 
+def test_print_summary_phase_times():
+    """summary.console_._print_summary: prints phase totals of each run"""
+    res1 = results.TestrunResult()
+    res1.name = 'one'
+    res1.tests['foo'] = results.TestResult('pass')
+    res1.tests['foo'].phase_times = {'init': 0.5, 'display': 1.0}
+    res1.tests['bar'] = results.TestResult('pass')
+    res1.tests['bar'].phase_times = {'init': 0.25, 'display': 2.0}
+    res1.calculate_group_totals()
+
+    res2 = results.TestrunResult()
+    res2.name = 'two'
+    res2.tests['foo'] = results.TestResult('pass')
+    res2.calculate_group_totals()
+
+    actual = get_stdout(
+        lambda: console_._print_summary(common.Results([res1, res2])))
+
+    nt.eq_(actual.split('\n')[-4:],
+           ['phase times (s):',
+            '       init:  0.750      -',
+            '    display:  3.000      -',
+            ''])
+
+
 def test_print_result():
     """summary.console_._print_result: prints expected values"""
     res1 = results.TestrunResult()
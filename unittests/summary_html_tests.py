@@ -27,6 +27,11 @@ from __future__ import (
 )
 import os
 
+try:
+    from unittest import mock
+except ImportError:
+    import mock
+
 import nose.tools as nt
 import six
 try:
@@ -39,6 +44,7 @@ except ImportError:
         getcwd = os.getcwd
     # pylint: enable=no-member
 
+from framework import exceptions, results
 from framework.summary import html_
 from . import utils
 
@@ -49,3 +55,80 @@ def test_copy_static():
     html_._copy_static_files(getcwd())
     nt.ok_(os.path.exists('index.css'), msg='index.css not created correctly')
     nt.ok_(os.path.exists('result.css'), msg='result.css not created correctly')
+
+
+def _run(name, **tests):
+    """Make a TestrunResult with tests of the given statuses."""
+    run = results.TestrunResult()
+    run.name = name
+    for test, status_ in six.iteritems(tests):
+        run.tests['group/' + test] = results.TestResult(status_)
+    run.calculate_group_totals()
+    return run
+
+
+def _html(*runs):
+    with mock.patch('framework.summary.html_.backends.load',
+                    mock.Mock(side_effect=list(runs))):
+        html_.html([r.name for r in runs], getcwd(), [], jobs=1)
+
+
+def _mtimes():
+    ret = {}
+    for dirpath, _, filenames in os.walk(getcwd()):
+        for name in filenames:
+            path = os.path.join(dirpath, name)
+            ret[os.path.relpath(path)] = os.stat(path).st_mtime
+    return ret
+
+
+@utils.nose.test_in_tempdir
+def test_html_incremental():
+    """summary.html_.html: only pages with changed inputs are rewritten"""
+    _html(_run('a', foo='pass', bar='fail'))
+    os.utime(os.path.join('a', 'group', 'foo.html'), (0, 0))
+    os.utime(os.path.join('a', 'group', 'bar.html'), (0, 0))
+
+    _html(_run('a', foo='pass', bar='pass'))
+    mtimes = _mtimes()
+    nt.eq_(mtimes[os.path.join('a', 'group', 'foo.html')], 0)
+    nt.ok_(mtimes[os.path.join('a', 'group', 'bar.html')] > 0)
+
+
+@utils.nose.test_in_tempdir
+def test_html_removes_stale():
+    """summary.html_.html: pages that are no longer generated are removed"""
+    _html(_run('a', foo='pass', bar='fail'))
+    _html(_run('a', foo='pass'))
+    nt.ok_(os.path.exists(os.path.join('a', 'group', 'foo.html')))
+    nt.ok_(not os.path.exists(os.path.join('a', 'group', 'bar.html')))
+
+
+@utils.nose.test_in_tempdir
+@nt.raises(exceptions.PiglitFatalError)
+def test_html_duplicate_names():
+    """summary.html_.html: two results with the same name are an error"""
+    _html(_run('a', foo='pass'), _run('a', foo='fail'))
+
+
+@utils.nose.test_in_tempdir
+def test_html_failure_keeps_pages():
+    """summary.html_.html: a results file that fails to load leaves the old
+    pages and manifest alone
+    """
+    _html(_run('a', foo='pass'), _run('b', foo='pass'))
+    with open(html_.MANIFEST_NAME, 'rb') as f:
+        manifest = f.read()
+
+    with mock.patch('framework.summary.html_.backends.load',
+                    mock.Mock(side_effect=[
+                        _run('a', foo='fail'),
+                        exceptions.PiglitFatalError('bad results')])):
+        with nt.assert_raises(exceptions.PiglitFatalError):
+            html_.html(['a', 'b'], getcwd(), [], jobs=1)
+
+    nt.ok_(os.path.exists(os.path.join('b', 'group', 'foo.html')))
+    nt.ok_(os.path.exists(os.path.join('b', 'index.html')))
+    nt.ok_(os.path.exists('changes.html'))
+    with open(html_.MANIFEST_NAME, 'rb') as f:
+        nt.eq_(f.read(), manifest)
@@ -0,0 +1,151 @@
+# Copyright (c) 2017 The Piglit project
+
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Tests for framework.zygote."""
+
+from __future__ import (
+    absolute_import, division, print_function, unicode_literals
+)
+import os
+import socket
+import threading
+import time
+
+try:
+    from unittest import mock
+except ImportError:
+    import mock
+
+import nose.tools as nt
+
+from . import utils
+from framework import exceptions, zygote
+
+
+class _FakeZygote(object):
+    """Answers one request on a unix socket the way piglit-zygote does."""
+    def __init__(self, tdir, reply):
+        self.path = os.path.join(tdir, 'socket')
+        self.request = None
+        self.__reply = reply
+        self.__sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.__sock.bind(self.path)
+        self.__sock.listen(1)
+        self.__thread = threading.Thread(target=self.__serve)
+        self.__thread.start()
+
+    def __serve(self):
+        conn, _ = self.__sock.accept()
+        data = b''
+        while b'\n' not in data:
+            data += conn.recv(4096)
+        length, data = data.split(b'\n', 1)
+        while len(data) < int(length):
+            data += conn.recv(4096)
+        self.request = data.split(b'\0')[:-1]
+        conn.sendall(self.__reply)
+        # Wait for the client to hang up, as a running test would
+        conn.recv(1)
+        conn.close()
+        self.__sock.close()
+
+    def client(self):
+        """Return a Zygote talking to the fake."""
+        client = zygote.Zygote.__new__(zygote.Zygote)
+        client.path = self.path
+        return client
+
+    def join(self):
+        self.__thread.join()
+
+
+def test_run():
+    """zygote.Zygote.run: sends the request and returns the reply"""
+    with utils.nose.tempdir() as tdir:
+        fake = _FakeZygote(tdir, b'pid 42\nexit -11 4 3\nout\nerr')
+        ret = fake.client().run('a.so', ['a', '-auto'], {'X': '1'}, cwd='/')
+        fake.join()
+
+    nt.eq_(ret, (42, -11, 'out\n', 'err'))
+    nt.eq_(fake.request, [b'a.so', b'/', b'2', b'a', b'-auto', b'X=1'])
+
+
+@nt.raises(zygote.ZygoteTimeout)
+def test_run_timeout():
+    """zygote.Zygote.run: raises ZygoteTimeout when the test runs too long"""
+    with utils.nose.tempdir() as tdir:
+        fake = _FakeZygote(tdir, b'pid 42\n')
+        try:
+            fake.client().run('a.so', ['a'], {}, timeout=0.1)
+        finally:
+            fake.join()
+
+
+@nt.raises(zygote.ZygoteError)
+def test_run_no_zygote():
+    """zygote.Zygote.run: raises ZygoteError if the zygote isn't there"""
+    with utils.nose.tempdir() as tdir:
+        client = zygote.Zygote.__new__(zygote.Zygote)
+        client.path = os.path.join(tdir, 'socket')
+        client.run('a.so', ['a'], {})
+
+
+@nt.raises(zygote.ZygoteUnreachable)
+def test_run_no_zygote_unreachable():
+    """zygote.Zygote.run: a missing zygote is ZygoteUnreachable"""
+    with utils.nose.tempdir() as tdir:
+        client = zygote.Zygote.__new__(zygote.Zygote)
+        client.path = os.path.join(tdir, 'socket')
+        client.run('a.so', ['a'], {})
+
+
+def _script(tdir, text):
+    """Write an executable shell script standing in for piglit-zygote."""
+    path = os.path.join(tdir, 'piglit-zygote')
+    with open(path, 'w') as f:
+        f.write('#!/bin/sh\n' + text)
+    os.chmod(path, 0o755)
+    return path
+
+
+@utils.nose.Skip.platform('linux')
+def test_start_ready():
+    """zygote.Zygote: starts once the zygote prints ready"""
+    with utils.nose.tempdir() as tdir:
+        zygote.Zygote(_script(tdir, 'echo ready\nexec sleep 10\n')).stop()
+
+
+@utils.nose.Skip.platform('linux')
+@mock.patch('framework.zygote.Zygote.START_TIMEOUT', 0.2)
+def test_start_hang():
+    """zygote.Zygote: gives up on a zygote that never says it is ready"""
+    with utils.nose.tempdir() as tdir:
+        start = time.time()
+        with nt.assert_raises(exceptions.PiglitFatalError):
+            zygote.Zygote(_script(tdir, 'exec sleep 10\n'))
+        nt.ok_(time.time() - start < 5)
+
+
+@utils.nose.Skip.platform('linux')
+def test_start_exit():
+    """zygote.Zygote: raises if the zygote exits before it is ready"""
+    with utils.nose.tempdir() as tdir:
+        with nt.assert_raises(exceptions.PiglitFatalError):
+            zygote.Zygote(_script(tdir, 'exit 1\n'))